@@ -188,7 +188,8 @@ public class AndroidAudioRenderer implements AudioRenderer {
     @Override
     public void playDecodedAudio(short[] audioData) {
         // Only queue up to 40 ms of pending audio data in addition to what AudioTrack is buffering for us.
-        if (MoonBridge.getPendingAudioDuration() < 40) {
+        // If the jitter buffer is holding packets back on purpose, that latency doesn't count against us.
+        if (MoonBridge.getPendingAudioDuration() < 40 + MoonBridge.getAudioJitterBufferTargetLatency()) {
             // This will block until the write is completed. That can cause a backlog
             // of pending audio data, so we do the above check to be able to bound
             // latency at 40 ms in that situation.
@@ -1484,8 +1484,7 @@ public class MediaCodecDecoderRenderer extends VideoDecoderRenderer implements C
     @Override
     public int submitDecodeUnit(byte[] decodeUnitData, int decodeUnitLength, int decodeUnitType,
                                 int frameNumber, int frameType, char frameHostProcessingLatency,
-                                long receiveTimeMs, long enqueueTimeMs) {
-        android.util.Log.d("MediaCodecDecoderRenderer", "submitDecodeUnit: type=" + decodeUnitType + " frame=" + frameNumber + " frameType=" + frameType);
+                                long receiveTimeUs, long enqueueTimeUs) {
         if (stopping) {
             // Don't bother if we're stopping
             return MoonBridge.DR_OK;
@@ -1763,12 +1762,6 @@ public class MediaCodecDecoderRenderer extends VideoDecoderRenderer implements C
                 }
             }
         }
-        else if (decodeUnitType == MoonBridge.BUFFER_TYPE_PICDATA) {
-            android.util.Log.d("MediaCodecDecoderRenderer", "submitDecodeUnit: PICDATA branch frame=" + frameNumber + " len=" + decodeUnitLength);
-        }
-        else {
-            android.util.Log.d("MediaCodecDecoderRenderer", "submitDecodeUnit: non-IDR non-PICDATA branch type=" + decodeUnitType + " frame=" + frameNumber);
-        }
 
         if (frameHostProcessingLatency != 0) {
             if (activeWindowVideoStats.minHostProcessingLatency != 0) {
@@ -1788,10 +1781,9 @@ public class MediaCodecDecoderRenderer extends VideoDecoderRenderer implements C
             // Count time from first packet received to enqueue time as receive time
             // We will count DU queue time as part of decoding, because it is directly
             // caused by a slow decoder.
-            activeWindowVideoStats.totalTimeMs += enqueueTimeMs - receiveTimeMs;
+            activeWindowVideoStats.totalTimeMs += (enqueueTimeUs / 1000) - (receiveTimeUs / 1000);
         }
 
-        android.util.Log.d("MediaCodecDecoderRenderer", "submitDecodeUnit: calling fetchNextInputBuffer");
         if (!fetchNextInputBuffer()) {
             android.util.Log.w("MediaCodecDecoderRenderer", "submitDecodeUnit: fetchNextInputBuffer returned false");
             return MoonBridge.DR_NEED_IDR;
@@ -1816,7 +1808,7 @@ public class MediaCodecDecoderRenderer extends VideoDecoderRenderer implements C
             }
         }
 
-        long timestampUs = enqueueTimeMs * 1000;
+        long timestampUs = enqueueTimeUs;
         if (timestampUs <= lastTimestampUs) {
             // We can't submit multiple buffers with the same timestamp
             // so bump it up by one before queuing
@@ -1844,7 +1836,6 @@ public class MediaCodecDecoderRenderer extends VideoDecoderRenderer implements C
             return MoonBridge.DR_NEED_IDR;
         }
 
-        android.util.Log.d("MediaCodecDecoderRenderer", "submitDecodeUnit: return DR_OK frame=" + frameNumber);
         return MoonBridge.DR_OK;
     }
 
@@ -46,6 +46,15 @@ public class MoonBridge {
     public static final int DR_OK = 0;
     public static final int DR_NEED_IDR = -1;
 
+    public static final int PACING_POLICY_IMMEDIATE = 0;
+    public static final int PACING_POLICY_LATEST_FRAME = 1;
+    public static final int PACING_POLICY_DISPLAY_TIMED = 2;
+
+    public static final int AUDIO_SINK_JAVA = 0;
+    public static final int AUDIO_SINK_AAUDIO = 1;
+    public static final int AUDIO_SINK_NULL = 2;
+    public static final int AUDIO_SINK_WAV = 3;
+
     public static final int CONN_STATUS_OKAY = 0;
     public static final int CONN_STATUS_POOR = 1;
 
@@ -229,11 +238,10 @@ public class MoonBridge {
 
     public static int bridgeDrSubmitDecodeUnit(byte[] decodeUnitData, int decodeUnitLength, int decodeUnitType,
                                                int frameNumber, int frameType, char frameHostProcessingLatency,
-                                               long receiveTimeMs, long enqueueTimeMs) {
+                                               long receiveTimeUs, long enqueueTimeUs) {
         if (videoRenderer != null) {
-            android.util.Log.d("MoonBridge", "bridgeDrSubmitDecodeUnit: frame=" + frameNumber + " frameType=" + frameType + " len=" + decodeUnitLength + " type=" + decodeUnitType);
             return videoRenderer.submitDecodeUnit(decodeUnitData, decodeUnitLength,
-                    decodeUnitType, frameNumber, frameType, frameHostProcessingLatency, receiveTimeMs, enqueueTimeMs);
+                    decodeUnitType, frameNumber, frameType, frameHostProcessingLatency, receiveTimeUs, enqueueTimeUs);
         }
         else {
             return DR_OK;
@@ -416,6 +424,12 @@ public class MoonBridge {
 
     public static native int getPendingVideoFrames();
 
+    // A maximum of 0 disables the audio jitter buffer. This applies to streams started after this call.
+    public static native void setAudioJitterBufferLatency(int minTargetMs, int maxTargetMs);
+
+    // Returns the jitter buffer's current target latency in ms, or 0 if it isn't active
+    public static native int getAudioJitterBufferTargetLatency();
+
     public static native int testClientConnectivity(String testServerHostName, int referencePort, int testFlags);
 
     public static native int getPortFlagsFromStage(int stage);
@@ -443,11 +457,20 @@ public class MoonBridge {
     public static native void nativeDecoderStart();
     public static native void nativeDecoderStop();
     public static native void nativeDecoderCleanup();
+    public static native void nativeDecoderSetPacingPolicy(int policy);
     public static native void nativeDecoderSetColorConfig(int colorRange, int colorStandard, int colorTransfer, int dataspace);
     public static native void nativeDecoderSetHdrMode(boolean enabled, byte[] hdrMetadata);
     public static native int nativeDecoderSubmit(byte[] decodeUnitData, int decodeUnitLength, int decodeUnitType,
                                                 int frameNumber, int frameType, char frameHostProcessingLatency,
-                                                long receiveTimeMs, long enqueueTimeMs);
+                                                long receiveTimeUs, long enqueueTimeUs);
+
+    // Native audio entry points. The sink applies to streams started after this call,
+    // and path is only used by the WAV sink.
+    public static native void nativeAudioSetSink(int sinkType, String path);
+
+    // Splits surround audio into its Opus streams and decodes them on up to this many
+    // threads. This applies to both native and Java playback of streams started later.
+    public static native void nativeAudioSetDecoderThreads(int threads);
     
     // Phase 2: Decoder selection helper for native code
     public static String findBestDecoderForMime(String mimeType) {
@@ -0,0 +1,151 @@
+#include "async_log.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Number of messages that can be waiting to be written (must be a power of 2)
+#define LOG_RING_SIZE 256
+#define LOG_TAG_MAX 32
+#define LOG_MESSAGE_MAX 480
+
+// How long the writer thread sleeps when the ring is empty
+#define LOG_DRAIN_INTERVAL_NS (10 * 1000 * 1000)
+
+// Each slot's sequence number says who owns it. A producer may fill a slot
+// when its sequence equals the producer's ticket, and the writer may read it
+// once the producer publishes ticket + 1. This is a bounded MPSC queue that
+// needs no locks, so logging never waits on the writer or on other threads.
+typedef struct {
+    atomic_uint sequence;
+    int priority;
+    char tag[LOG_TAG_MAX];
+    char message[LOG_MESSAGE_MAX];
+} log_slot_t;
+
+static log_slot_t g_slots[LOG_RING_SIZE];
+static atomic_uint g_enqueuePos;
+static unsigned int g_dequeuePos;
+static atomic_uint g_droppedMessages;
+static atomic_int g_minPriority = ALOG_MIN_LEVEL;
+
+static pthread_once_t g_initOnce = PTHREAD_ONCE_INIT;
+static pthread_t g_writerThread;
+static bool g_writerStarted;
+
+static bool drain_ring(void) {
+    bool drained = false;
+
+    for (;;) {
+        log_slot_t* slot = &g_slots[g_dequeuePos & (LOG_RING_SIZE - 1)];
+        unsigned int seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (seq != g_dequeuePos + 1) {
+            // The next message hasn't been published yet
+            break;
+        }
+
+        __android_log_write(slot->priority, slot->tag, slot->message);
+
+        // Hand the slot back to producers for the next lap of the ring
+        atomic_store_explicit(&slot->sequence, g_dequeuePos + LOG_RING_SIZE, memory_order_release);
+        g_dequeuePos++;
+        drained = true;
+    }
+
+    unsigned int dropped = atomic_exchange_explicit(&g_droppedMessages, 0, memory_order_relaxed);
+    if (dropped != 0) {
+        char message[64];
+        snprintf(message, sizeof(message), "Dropped %u log messages", dropped);
+        __android_log_write(ANDROID_LOG_WARN, "AsyncLog", message);
+    }
+
+    return drained;
+}
+
+static void* writer_thread_proc(void* context) {
+    (void)context;
+
+    for (;;) {
+        if (!drain_ring()) {
+            struct timespec ts = { 0, LOG_DRAIN_INTERVAL_NS };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+static void init_async_log(void) {
+    for (unsigned int i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_init(&g_slots[i].sequence, i);
+    }
+
+    g_writerStarted = pthread_create(&g_writerThread, NULL, writer_thread_proc, NULL) == 0;
+    if (g_writerStarted) {
+        pthread_detach(g_writerThread);
+    }
+}
+
+void async_log_set_level(int priority) {
+    atomic_store_explicit(&g_minPriority, priority, memory_order_relaxed);
+}
+
+void async_log_vwrite(int priority, const char* tag, const char* format, va_list va) {
+    if (priority < atomic_load_explicit(&g_minPriority, memory_order_relaxed)) {
+        return;
+    }
+
+    pthread_once(&g_initOnce, init_async_log);
+
+    if (!g_writerStarted) {
+        // There's nobody to drain the ring, so just log synchronously
+        __android_log_vprint(priority, tag, format, va);
+        return;
+    }
+
+    unsigned int pos = atomic_load_explicit(&g_enqueuePos, memory_order_relaxed);
+    log_slot_t* slot;
+    for (;;) {
+        slot = &g_slots[pos & (LOG_RING_SIZE - 1)];
+
+        int32_t diff = (int32_t)(atomic_load_explicit(&slot->sequence, memory_order_acquire) - pos);
+        if (diff == 0) {
+            // The slot is free, so try to claim it
+            unsigned int expected = pos;
+            if (atomic_compare_exchange_weak_explicit(&g_enqueuePos, &expected, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+            pos = expected;
+        }
+        else if (diff < 0) {
+            // The ring is full. Drop the message rather than waiting.
+            atomic_fetch_add_explicit(&g_droppedMessages, 1, memory_order_relaxed);
+            return;
+        }
+        else {
+            // Another producer claimed this slot first
+            pos = atomic_load_explicit(&g_enqueuePos, memory_order_relaxed);
+        }
+    }
+
+    slot->priority = priority;
+    strncpy(slot->tag, tag, sizeof(slot->tag) - 1);
+    slot->tag[sizeof(slot->tag) - 1] = 0;
+    vsnprintf(slot->message, sizeof(slot->message), format, va);
+
+    // Publish the message to the writer thread
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+}
+
+void async_log_write(int priority, const char* tag, const char* format, ...) {
+    va_list va;
+
+    va_start(va, format);
+    async_log_vwrite(priority, tag, format, va);
+    va_end(va);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <android/log.h>
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Messages below this level are compiled out entirely. Debug builds keep
+// debug messages, while release builds only keep info and above.
+#ifndef ALOG_MIN_LEVEL
+#ifdef LC_DEBUG
+#define ALOG_MIN_LEVEL ANDROID_LOG_DEBUG
+#else
+#define ALOG_MIN_LEVEL ANDROID_LOG_INFO
+#endif
+#endif
+
+// Formats a message into a lock-free ring that is drained to logcat by a
+// background thread. This never blocks. If the ring is full, the message
+// is dropped and counted, and the count is logged once there's room again.
+void async_log_write(int priority, const char* tag, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+void async_log_vwrite(int priority, const char* tag, const char* format, va_list va)
+    __attribute__((format(printf, 3, 0)));
+
+// Sets the minimum level that is logged at runtime (on top of ALOG_MIN_LEVEL)
+void async_log_set_level(int priority);
+
+#define ALOG(priority, tag, ...) \
+    do { \
+        if ((priority) >= ALOG_MIN_LEVEL) { \
+            async_log_write((priority), (tag), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ALOGV(tag, ...) ALOG(ANDROID_LOG_VERBOSE, tag, __VA_ARGS__)
+#define ALOGD(tag, ...) ALOG(ANDROID_LOG_DEBUG, tag, __VA_ARGS__)
+#define ALOGI(tag, ...) ALOG(ANDROID_LOG_INFO, tag, __VA_ARGS__)
+#define ALOGW(tag, ...) ALOG(ANDROID_LOG_WARN, tag, __VA_ARGS__)
+#define ALOGE(tag, ...) ALOG(ANDROID_LOG_ERROR, tag, __VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,634 @@
+#include "audio_sink.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __ANDROID__
+#include <aaudio/AAudio.h>
+#include "async_log.h"
+
+#define LOG_TAG "AudioSink"
+#define LOGI(...) ALOGI(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) ALOGE(LOG_TAG, __VA_ARGS__)
+#else
+#define LOGI(...) do { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOGE(...) LOGI(__VA_ARGS__)
+#endif
+
+int pcm_ring_init(pcm_ring_t* ring, uint32_t minFrames, int channelCount) {
+    uint32_t capacity = 1;
+
+    while (capacity < minFrames) {
+        capacity <<= 1;
+    }
+
+    ring->samples = calloc(capacity, sizeof(int16_t) * channelCount);
+    if (ring->samples == NULL) {
+        return -1;
+    }
+
+    ring->capacityFrames = capacity;
+    ring->channelCount = channelCount;
+    atomic_init(&ring->writePos, 0);
+    atomic_init(&ring->readPos, 0);
+    return 0;
+}
+
+void pcm_ring_destroy(pcm_ring_t* ring) {
+    free(ring->samples);
+    ring->samples = NULL;
+}
+
+// Copies frames between the ring and a linear buffer, wrapping around the end of the ring
+static void copy_frames(pcm_ring_t* ring, uint32_t pos, int16_t* pcm, uint32_t frames, bool toRing) {
+    uint32_t index = pos & (ring->capacityFrames - 1);
+    uint32_t firstFrames = ring->capacityFrames - index;
+    size_t frameSize = sizeof(int16_t) * ring->channelCount;
+
+    if (firstFrames > frames) {
+        firstFrames = frames;
+    }
+
+    if (toRing) {
+        memcpy(&ring->samples[index * ring->channelCount], pcm, firstFrames * frameSize);
+        memcpy(ring->samples, &pcm[firstFrames * ring->channelCount], (frames - firstFrames) * frameSize);
+    }
+    else {
+        memcpy(pcm, &ring->samples[index * ring->channelCount], firstFrames * frameSize);
+        memcpy(&pcm[firstFrames * ring->channelCount], ring->samples, (frames - firstFrames) * frameSize);
+    }
+}
+
+bool pcm_ring_write(pcm_ring_t* ring, const int16_t* pcm, uint32_t frames) {
+    uint32_t writePos = atomic_load_explicit(&ring->writePos, memory_order_relaxed);
+    uint32_t readPos = atomic_load_explicit(&ring->readPos, memory_order_acquire);
+
+    if (ring->capacityFrames - (writePos - readPos) < frames) {
+        return false;
+    }
+
+    copy_frames(ring, writePos, (int16_t*)pcm, frames, true);
+
+    // Publish the samples to the reader
+    atomic_store_explicit(&ring->writePos, writePos + frames, memory_order_release);
+    return true;
+}
+
+uint32_t pcm_ring_read(pcm_ring_t* ring, int16_t* pcm, uint32_t frames) {
+    uint32_t readPos = atomic_load_explicit(&ring->readPos, memory_order_relaxed);
+    uint32_t writePos = atomic_load_explicit(&ring->writePos, memory_order_acquire);
+    uint32_t available = writePos - readPos;
+
+    if (frames > available) {
+        frames = available;
+    }
+
+    copy_frames(ring, readPos, pcm, frames, false);
+
+    // Hand the space back to the writer
+    atomic_store_explicit(&ring->readPos, readPos + frames, memory_order_release);
+    return frames;
+}
+
+uint32_t pcm_ring_frames_queued(pcm_ring_t* ring) {
+    return atomic_load_explicit(&ring->writePos, memory_order_acquire) -
+           atomic_load_explicit(&ring->readPos, memory_order_acquire);
+}
+
+bool audio_sink_write(audio_sink_t* sink, const int16_t* pcm, int frames) {
+    if (!pcm_ring_write(&sink->ring, pcm, (uint32_t)frames)) {
+        // The playback side has fallen behind. Dropping this packet keeps
+        // latency bounded, and the playback side will catch up on its own.
+        sink->stats.packetsDropped++;
+        return false;
+    }
+
+    sink->stats.packetsQueued++;
+    return true;
+}
+
+void audio_sink_pull(audio_sink_t* sink, int16_t* pcm, int frames) {
+    uint32_t read = pcm_ring_read(&sink->ring, pcm, (uint32_t)frames);
+
+    sink->stats.pulls++;
+    if (read < (uint32_t)frames) {
+        memset(&pcm[read * sink->channelCount], 0, (frames - read) * sizeof(int16_t) * sink->channelCount);
+
+        // Don't count the silence before the first packet arrives
+        if (atomic_load_explicit(&sink->ring.writePos, memory_order_relaxed) != 0) {
+            sink->stats.underrunFrames += frames - read;
+        }
+    }
+}
+
+// Paced sinks have no device to drive them, so a thread pulls one packet of
+// PCM per packet interval on the monotonic clock, like a device callback would.
+typedef struct {
+    pthread_t thread;
+    atomic_bool running;
+    bool threadStarted;
+    int16_t* buffer;
+
+    // Consumes each period that was pulled from the ring
+    void (*consume)(audio_sink_t* sink, const int16_t* pcm, int frames);
+
+    // Only used by the WAV sink
+    FILE* file;
+    uint32_t dataBytes;
+} paced_sink_t;
+
+static void add_ns(struct timespec* ts, long ns) {
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= 1000000000L) {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+static void* paced_sink_thread_proc(void* context) {
+    audio_sink_t* sink = context;
+    paced_sink_t* paced = sink->impl;
+    long periodNs = (long)((int64_t)sink->samplesPerFrame * 1000000000LL / sink->sampleRate);
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    while (atomic_load_explicit(&paced->running, memory_order_relaxed)) {
+        add_ns(&deadline, periodNs);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+        audio_sink_pull(sink, paced->buffer, sink->samplesPerFrame);
+        if (paced->consume != NULL) {
+            paced->consume(sink, paced->buffer, sink->samplesPerFrame);
+        }
+    }
+
+    return NULL;
+}
+
+static int paced_sink_open(audio_sink_t* sink) {
+    paced_sink_t* paced = calloc(1, sizeof(*paced));
+    if (paced == NULL) {
+        return -1;
+    }
+
+    paced->buffer = malloc(sizeof(int16_t) * sink->samplesPerFrame * sink->channelCount);
+    if (paced->buffer == NULL) {
+        free(paced);
+        return -1;
+    }
+
+    atomic_init(&paced->running, false);
+    sink->impl = paced;
+    return 0;
+}
+
+static int paced_sink_start(audio_sink_t* sink) {
+    paced_sink_t* paced = sink->impl;
+
+    atomic_store(&paced->running, true);
+    if (pthread_create(&paced->thread, NULL, paced_sink_thread_proc, sink) != 0) {
+        atomic_store(&paced->running, false);
+        return -1;
+    }
+
+    paced->threadStarted = true;
+    return 0;
+}
+
+static void paced_sink_stop(audio_sink_t* sink) {
+    paced_sink_t* paced = sink->impl;
+
+    if (paced->threadStarted) {
+        atomic_store(&paced->running, false);
+        pthread_join(paced->thread, NULL);
+        paced->threadStarted = false;
+    }
+}
+
+static void paced_sink_close(audio_sink_t* sink) {
+    paced_sink_t* paced = sink->impl;
+
+    free(paced->buffer);
+    free(paced);
+    sink->impl = NULL;
+}
+
+static int null_sink_open(audio_sink_t* sink, const char* path) {
+    (void)path;
+    return paced_sink_open(sink);
+}
+
+static void put_le16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+#define WAV_HEADER_SIZE 44
+
+static void write_wav_header(audio_sink_t* sink, FILE* file, uint32_t dataBytes) {
+    uint8_t header[WAV_HEADER_SIZE];
+    uint16_t blockAlign = (uint16_t)(sink->channelCount * sizeof(int16_t));
+
+    memcpy(header, "RIFF", 4);
+    put_le32(header + 4, 36 + dataBytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le32(header + 16, 16);
+    put_le16(header + 20, 1); // PCM
+    put_le16(header + 22, (uint16_t)sink->channelCount);
+    put_le32(header + 24, (uint32_t)sink->sampleRate);
+    put_le32(header + 28, (uint32_t)sink->sampleRate * blockAlign);
+    put_le16(header + 32, blockAlign);
+    put_le16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put_le32(header + 40, dataBytes);
+
+    fwrite(header, sizeof(header), 1, file);
+}
+
+static void wav_sink_consume(audio_sink_t* sink, const int16_t* pcm, int frames) {
+    paced_sink_t* paced = sink->impl;
+    size_t bytes = sizeof(int16_t) * frames * sink->channelCount;
+
+    // WAV is little endian, like every platform we build for
+    if (fwrite(pcm, 1, bytes, paced->file) == bytes) {
+        paced->dataBytes += (uint32_t)bytes;
+    }
+}
+
+static int wav_sink_open(audio_sink_t* sink, const char* path) {
+    paced_sink_t* paced;
+
+    if (path == NULL || paced_sink_open(sink) != 0) {
+        return -1;
+    }
+
+    paced = sink->impl;
+    paced->file = fopen(path, "wb");
+    if (paced->file == NULL) {
+        LOGE("Failed to open %s: %d", path, errno);
+        paced_sink_close(sink);
+        return -1;
+    }
+
+    // The sizes are filled in when the file is closed
+    write_wav_header(sink, paced->file, 0);
+    paced->consume = wav_sink_consume;
+    return 0;
+}
+
+static void wav_sink_close(audio_sink_t* sink) {
+    paced_sink_t* paced = sink->impl;
+
+    fseek(paced->file, 0, SEEK_SET);
+    write_wav_header(sink, paced->file, paced->dataBytes);
+    fclose(paced->file);
+
+    paced_sink_close(sink);
+}
+
+static const audio_sink_ops_t g_nullSinkOps = {
+    .name = "null",
+    .open = null_sink_open,
+    .start = paced_sink_start,
+    .stop = paced_sink_stop,
+    .close = paced_sink_close,
+};
+
+static const audio_sink_ops_t g_wavSinkOps = {
+    .name = "wav",
+    .open = wav_sink_open,
+    .start = paced_sink_start,
+    .stop = paced_sink_stop,
+    .close = wav_sink_close,
+};
+
+#ifdef __ANDROID__
+// A disconnected stream (for example after the output device changed) is
+// replaced by a new stream on the current default device. AAudio doesn't
+// allow that from its own callbacks, so it is done on a separate thread.
+#define AAUDIO_REOPEN_ATTEMPTS 5
+#define AAUDIO_REOPEN_RETRY_MS 200
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t reopenDone;
+
+    // Protected by the mutex
+    AAudioStream* stream;
+    bool started;
+    bool closing;
+    bool reopening;
+} aaudio_sink_t;
+
+static aaudio_data_callback_result_t aaudio_data_callback(AAudioStream* stream, void* userData, void* audioData, int32_t numFrames) {
+    (void)stream;
+
+    audio_sink_pull(userData, audioData, numFrames);
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+static void aaudio_error_callback(AAudioStream* stream, void* userData, aaudio_result_t error);
+
+static int aaudio_open_stream(audio_sink_t* sink, AAudioStream** stream) {
+    AAudioStreamBuilder* builder;
+    aaudio_result_t result;
+
+    result = AAudio_createStreamBuilder(&builder);
+    if (result != AAUDIO_OK) {
+        LOGE("AAudio_createStreamBuilder() failed: %s", AAudio_convertResultToText(result));
+        return -1;
+    }
+
+    AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+    AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_I16);
+    AAudioStreamBuilder_setSampleRate(builder, sink->sampleRate);
+    AAudioStreamBuilder_setChannelCount(builder, sink->channelCount);
+    AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    AAudioStreamBuilder_setUsage(builder, AAUDIO_USAGE_GAME);
+    AAudioStreamBuilder_setDataCallback(builder, aaudio_data_callback, sink);
+    AAudioStreamBuilder_setErrorCallback(builder, aaudio_error_callback, sink);
+
+    result = AAudioStreamBuilder_openStream(builder, stream);
+    AAudioStreamBuilder_delete(builder);
+    if (result != AAUDIO_OK) {
+        LOGE("AAudioStreamBuilder_openStream() failed: %s", AAudio_convertResultToText(result));
+        return -1;
+    }
+
+    LOGI("AAudio stream opened: %d Hz, %d channels, burst %d frames",
+         AAudioStream_getSampleRate(*stream), AAudioStream_getChannelCount(*stream),
+         AAudioStream_getFramesPerBurst(*stream));
+    return 0;
+}
+
+static void* aaudio_reopen_thread_proc(void* context) {
+    audio_sink_t* sink = context;
+    aaudio_sink_t* aaudio = sink->impl;
+    AAudioStream* stream;
+    int attempt;
+
+    // The stream is closed and opened without holding the mutex, since
+    // closing waits for callbacks that may be trying to take it
+    pthread_mutex_lock(&aaudio->mutex);
+    stream = aaudio->stream;
+    aaudio->stream = NULL;
+    pthread_mutex_unlock(&aaudio->mutex);
+
+    if (stream != NULL) {
+        AAudioStream_close(stream);
+    }
+
+    for (attempt = 1; attempt <= AAUDIO_REOPEN_ATTEMPTS; attempt++) {
+        bool installed = false;
+
+        if (aaudio_open_stream(sink, &stream) == 0) {
+            pthread_mutex_lock(&aaudio->mutex);
+            if (!aaudio->closing) {
+                if (!aaudio->started || AAudioStream_requestStart(stream) == AAUDIO_OK) {
+                    aaudio->stream = stream;
+                    installed = true;
+                }
+            }
+            pthread_mutex_unlock(&aaudio->mutex);
+
+            if (installed) {
+                LOGI("AAudio stream reopened after disconnection");
+                break;
+            }
+
+            AAudioStream_close(stream);
+        }
+
+        pthread_mutex_lock(&aaudio->mutex);
+        if (aaudio->closing) {
+            pthread_mutex_unlock(&aaudio->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&aaudio->mutex);
+
+        if (attempt == AAUDIO_REOPEN_ATTEMPTS) {
+            LOGE("Unable to reopen the AAudio stream, audio will stay silent");
+        }
+        else {
+            struct timespec delay = { 0, AAUDIO_REOPEN_RETRY_MS * 1000000L };
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    pthread_mutex_lock(&aaudio->mutex);
+    aaudio->reopening = false;
+    pthread_cond_broadcast(&aaudio->reopenDone);
+    pthread_mutex_unlock(&aaudio->mutex);
+    return NULL;
+}
+
+static void aaudio_error_callback(AAudioStream* stream, void* userData, aaudio_result_t error) {
+    audio_sink_t* sink = userData;
+    aaudio_sink_t* aaudio = sink->impl;
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    (void)stream;
+
+    LOGE("AAudio stream error: %s", AAudio_convertResultToText(error));
+    if (error != AAUDIO_ERROR_DISCONNECTED) {
+        return;
+    }
+
+    pthread_mutex_lock(&aaudio->mutex);
+    if (!aaudio->closing && !aaudio->reopening) {
+        aaudio->reopening = true;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, aaudio_reopen_thread_proc, sink) != 0) {
+            LOGE("Failed to start the AAudio reopen thread");
+            aaudio->reopening = false;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    pthread_mutex_unlock(&aaudio->mutex);
+}
+
+static int aaudio_sink_open(audio_sink_t* sink, const char* path) {
+    aaudio_sink_t* aaudio;
+
+    (void)path;
+
+    aaudio = calloc(1, sizeof(*aaudio));
+    if (aaudio == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_init(&aaudio->mutex, NULL);
+    pthread_cond_init(&aaudio->reopenDone, NULL);
+
+    // The error callback can run as soon as the stream is open
+    sink->impl = aaudio;
+    if (aaudio_open_stream(sink, &aaudio->stream) != 0) {
+        pthread_cond_destroy(&aaudio->reopenDone);
+        pthread_mutex_destroy(&aaudio->mutex);
+        free(aaudio);
+        sink->impl = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int aaudio_sink_start(audio_sink_t* sink) {
+    aaudio_sink_t* aaudio = sink->impl;
+    aaudio_result_t result = AAUDIO_OK;
+
+    pthread_mutex_lock(&aaudio->mutex);
+    aaudio->started = true;
+
+    // While the stream is being reopened, the new stream is started once it is open
+    if (aaudio->stream != NULL) {
+        result = AAudioStream_requestStart(aaudio->stream);
+    }
+    pthread_mutex_unlock(&aaudio->mutex);
+
+    if (result != AAUDIO_OK) {
+        LOGE("AAudioStream_requestStart() failed: %s", AAudio_convertResultToText(result));
+        return -1;
+    }
+
+    return 0;
+}
+
+static void aaudio_sink_stop(audio_sink_t* sink) {
+    aaudio_sink_t* aaudio = sink->impl;
+
+    pthread_mutex_lock(&aaudio->mutex);
+    aaudio->started = false;
+    if (aaudio->stream != NULL) {
+        AAudioStream_requestStop(aaudio->stream);
+    }
+    pthread_mutex_unlock(&aaudio->mutex);
+}
+
+static void aaudio_sink_close(audio_sink_t* sink) {
+    aaudio_sink_t* aaudio = sink->impl;
+
+    // Wait for a reopen in progress to finish before tearing down
+    pthread_mutex_lock(&aaudio->mutex);
+    aaudio->closing = true;
+    while (aaudio->reopening) {
+        pthread_cond_wait(&aaudio->reopenDone, &aaudio->mutex);
+    }
+    pthread_mutex_unlock(&aaudio->mutex);
+
+    if (aaudio->stream != NULL) {
+        AAudioStream_close(aaudio->stream);
+    }
+
+    pthread_cond_destroy(&aaudio->reopenDone);
+    pthread_mutex_destroy(&aaudio->mutex);
+    free(aaudio);
+    sink->impl = NULL;
+}
+
+static const audio_sink_ops_t g_aaudioSinkOps = {
+    .name = "aaudio",
+    .open = aaudio_sink_open,
+    .start = aaudio_sink_start,
+    .stop = aaudio_sink_stop,
+    .close = aaudio_sink_close,
+};
+#endif
+
+static const audio_sink_ops_t* get_sink_ops(audio_sink_type_t type) {
+    switch (type) {
+#ifdef __ANDROID__
+    case AUDIO_SINK_AAUDIO:
+        return &g_aaudioSinkOps;
+#endif
+    case AUDIO_SINK_NULL:
+        return &g_nullSinkOps;
+    case AUDIO_SINK_WAV:
+        return &g_wavSinkOps;
+    default:
+        return NULL;
+    }
+}
+
+audio_sink_t* audio_sink_create(audio_sink_type_t type, int sampleRate, int channelCount,
+                                int samplesPerFrame, int bufferMs, const char* path) {
+    const audio_sink_ops_t* ops = get_sink_ops(type);
+    audio_sink_t* sink;
+    uint32_t ringFrames;
+
+    if (ops == NULL || sampleRate <= 0 || channelCount <= 0 || samplesPerFrame <= 0) {
+        return NULL;
+    }
+
+    sink = calloc(1, sizeof(*sink));
+    if (sink == NULL) {
+        return NULL;
+    }
+
+    sink->ops = ops;
+    sink->sampleRate = sampleRate;
+    sink->channelCount = channelCount;
+    sink->samplesPerFrame = samplesPerFrame;
+
+    // Always leave room for at least two packets
+    ringFrames = (uint32_t)((int64_t)sampleRate * bufferMs / 1000);
+    if (ringFrames < (uint32_t)samplesPerFrame * 2) {
+        ringFrames = (uint32_t)samplesPerFrame * 2;
+    }
+
+    if (pcm_ring_init(&sink->ring, ringFrames, channelCount) != 0) {
+        free(sink);
+        return NULL;
+    }
+
+    if (ops->open(sink, path) != 0) {
+        pcm_ring_destroy(&sink->ring);
+        free(sink);
+        return NULL;
+    }
+
+    LOGI("Created %s audio sink: %d Hz, %d channels, %u frame ring",
+         ops->name, sampleRate, channelCount, sink->ring.capacityFrames);
+    return sink;
+}
+
+void audio_sink_destroy(audio_sink_t* sink) {
+    sink->ops->close(sink);
+    pcm_ring_destroy(&sink->ring);
+    free(sink);
+}
+
+int audio_sink_start(audio_sink_t* sink) {
+    return sink->ops->start(sink);
+}
+
+void audio_sink_stop(audio_sink_t* sink) {
+    sink->ops->stop(sink);
+}
+
+const char* audio_sink_type_name(audio_sink_type_t type) {
+    switch (type) {
+    case AUDIO_SINK_JAVA:
+        return "java";
+    case AUDIO_SINK_AAUDIO:
+        return "aaudio";
+    case AUDIO_SINK_NULL:
+        return "null";
+    case AUDIO_SINK_WAV:
+        return "wav";
+    default:
+        return "unknown";
+    }
+}
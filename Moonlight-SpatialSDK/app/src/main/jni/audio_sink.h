@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Where decoded PCM is played. The values are shared with MoonBridge.
+typedef enum {
+    // Decoded audio goes up to the Java AudioTrack renderer
+    AUDIO_SINK_JAVA = 0,
+
+    // Played natively through AAudio
+    AUDIO_SINK_AAUDIO = 1,
+
+    // Pulled at the stream rate and discarded (for measurement)
+    AUDIO_SINK_NULL = 2,
+
+    // Pulled at the stream rate and written to a WAV file
+    AUDIO_SINK_WAV = 3,
+
+    AUDIO_SINK_COUNT
+} audio_sink_type_t;
+
+// Single producer, single consumer ring of interleaved 16-bit PCM. The
+// decoder thread writes whole packets, and the sink's playback thread
+// reads whatever it needs, so neither side ever blocks on the other.
+typedef struct {
+    int16_t* samples;
+    uint32_t capacityFrames; // Power of 2
+    int channelCount;
+
+    // Positions are in frames and wrap naturally
+    atomic_uint writePos;
+    atomic_uint readPos;
+} pcm_ring_t;
+
+typedef struct {
+    // Packets handed to the sink by the decoder thread
+    uint32_t packetsQueued;
+
+    // Packets that didn't fit in the ring and were dropped
+    uint32_t packetsDropped;
+
+    // Callbacks from the playback side, and the frames they were short
+    uint32_t pulls;
+    uint32_t underrunFrames;
+
+    // Time spent decoding and enqueueing each packet on the decoder thread
+    uint64_t totalDecodeNs;
+    uint32_t maxDecodeNs;
+    uint64_t totalEnqueueNs;
+    uint32_t maxEnqueueNs;
+} audio_sink_stats_t;
+
+typedef struct audio_sink audio_sink_t;
+
+typedef struct {
+    const char* name;
+
+    // Opens the output. Playback pulls PCM from the ring with audio_sink_pull().
+    int (*open)(audio_sink_t* sink, const char* path);
+    int (*start)(audio_sink_t* sink);
+    void (*stop)(audio_sink_t* sink);
+    void (*close)(audio_sink_t* sink);
+} audio_sink_ops_t;
+
+struct audio_sink {
+    const audio_sink_ops_t* ops;
+    void* impl;
+
+    int sampleRate;
+    int channelCount;
+    int samplesPerFrame;
+
+    pcm_ring_t ring;
+
+    // The playback side only touches the pull and underrun counters, and
+    // the decoder thread only touches the rest.
+    audio_sink_stats_t stats;
+};
+
+int pcm_ring_init(pcm_ring_t* ring, uint32_t minFrames, int channelCount);
+void pcm_ring_destroy(pcm_ring_t* ring);
+
+// Writes all of the frames or none of them. Returns false if the ring is full.
+bool pcm_ring_write(pcm_ring_t* ring, const int16_t* pcm, uint32_t frames);
+
+// Reads up to the requested number of frames and returns the number read
+uint32_t pcm_ring_read(pcm_ring_t* ring, int16_t* pcm, uint32_t frames);
+
+uint32_t pcm_ring_frames_queued(pcm_ring_t* ring);
+
+// Creates a sink of the given type with a ring holding bufferMs of audio.
+// path is only used by file sinks. Returns NULL if the sink is unavailable.
+audio_sink_t* audio_sink_create(audio_sink_type_t type, int sampleRate, int channelCount,
+                                int samplesPerFrame, int bufferMs, const char* path);
+void audio_sink_destroy(audio_sink_t* sink);
+
+int audio_sink_start(audio_sink_t* sink);
+void audio_sink_stop(audio_sink_t* sink);
+
+// Called by the decoder thread with one decoded packet of PCM
+bool audio_sink_write(audio_sink_t* sink, const int16_t* pcm, int frames);
+
+// Called by the playback side. Fills the entire buffer, padding it with
+// silence if the ring runs dry.
+void audio_sink_pull(audio_sink_t* sink, int16_t* pcm, int frames);
+
+const char* audio_sink_type_name(audio_sink_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
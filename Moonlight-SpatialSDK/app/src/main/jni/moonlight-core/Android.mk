@@ -14,9 +14,12 @@ LOCAL_SRC_FILES := moonlight-common-c/src/AudioStream.c \
                    moonlight-common-c/src/ConnectionTester.c \
                    moonlight-common-c/src/ControlStream.c \
                    moonlight-common-c/src/FakeCallbacks.c \
+                   moonlight-common-c/src/FrameTrace.c \
                    moonlight-common-c/src/InputStream.c \
                    moonlight-common-c/src/LinkedBlockingQueue.c \
+                   moonlight-common-c/src/LockFreeQueue.c \
                    moonlight-common-c/src/Misc.c \
+                   moonlight-common-c/src/PacketPool.c \
                    moonlight-common-c/src/Platform.c \
                    moonlight-common-c/src/PlatformCrypto.c \
                    moonlight-common-c/src/PlatformSockets.c \
@@ -41,7 +44,12 @@ LOCAL_SRC_FILES := moonlight-common-c/src/AudioStream.c \
                    simplejni.c \
                    callbacks.c \
                    minisdl.c \
+                   ../async_log.c \
+                   ../audio_sink.c \
+                   ../native_audio.c \
                    ../native_decoder.c \
+                   ../parallel_opus.c \
+                   ../output_pacer.c \
 
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/moonlight-common-c/enet/include \
@@ -54,7 +62,13 @@ ifeq ($(NDK_DEBUG),1)
 LOCAL_CFLAGS += -DLC_DEBUG
 endif
 
-LOCAL_LDLIBS := -llog -lmediandk -landroid -lnativewindow
+# FEC validation mode is always compiled into debug builds. Pass
+# MOONLIGHT_FEC_VALIDATION=1 to ndk-build to add it to release builds.
+ifeq ($(MOONLIGHT_FEC_VALIDATION),1)
+LOCAL_CFLAGS += -DLC_FEC_VALIDATION
+endif
+
+LOCAL_LDLIBS := -llog -lmediandk -landroid -lnativewindow -laaudio
 
 LOCAL_STATIC_LIBRARIES := libopus libssl libcrypto cpufeatures
 LOCAL_LDFLAGS += -Wl,--exclude-libs,ALL
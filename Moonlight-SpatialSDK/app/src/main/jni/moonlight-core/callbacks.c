@@ -5,12 +5,16 @@
 
 #include <Limelight.h>
 
-#include <opus_multistream.h>
 #include <android/log.h>
 
 #include <cpu-features.h>
 
-static OpusMSDecoder* Decoder;
+#include "../async_log.h"
+#include "../native_audio.h"
+#include "../native_decoder.h"
+#include "../parallel_opus.h"
+
+static parallel_opus_decoder_t* Decoder;
 static OPUS_MULTISTREAM_CONFIGURATION OpusConfig;
 
 static JavaVM *JVM;
@@ -41,6 +45,9 @@ static jmethodID BridgeClSetControllerLEDMethod;
 static jbyteArray DecodedFrameBuffer;
 static jshortArray DecodedAudioBuffer;
 
+// Set when the current stream's audio is played by a native sink
+static bool NativeAudioActive;
+
 void DetachThread(void* context) {
     (*JVM)->DetachCurrentThread(JVM);
 }
@@ -148,10 +155,16 @@ void BridgeDrCleanup(void) {
 }
 
 int BridgeDrSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
-    JNIEnv* env = GetThreadEnv();
+    JNIEnv* env;
     int ret;
 
-    __android_log_print(ANDROID_LOG_INFO, "MoonBridge", "BridgeDrSubmitDecodeUnit: frame=%d frameType=%d fullLength=%d", decodeUnit->frameNumber, decodeUnit->frameType, decodeUnit->fullLength);
+    // The native decoder can read the buffer list directly, so skip the
+    // copy into a Java array and the round trip through Java to reach it.
+    if (nativeDecoderIsActive()) {
+        return nativeDecoderSubmitDecodeUnit(decodeUnit);
+    }
+
+    env = GetThreadEnv();
 
     // Increase the size of our frame data buffer if our frame won't fit
     if ((*env)->GetArrayLength(env, DecodedFrameBuffer) < decodeUnit->fullLength) {
@@ -174,7 +187,7 @@ int BridgeDrSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
             ret = (*env)->CallStaticIntMethod(env, GlobalBridgeClass, BridgeDrSubmitDecodeUnitMethod,
                                               DecodedFrameBuffer, currentEntry->length, currentEntry->bufferType,
                                               decodeUnit->frameNumber, decodeUnit->frameType, (jchar)decodeUnit->frameHostProcessingLatency,
-                                              (jlong)decodeUnit->receiveTimeMs, (jlong)decodeUnit->enqueueTimeMs);
+                                              (jlong)decodeUnit->receiveTimeUs, (jlong)decodeUnit->enqueueTimeUs);
             if ((*env)->ExceptionCheck(env)) {
                 // We will crash here
                 (*JVM)->DetachCurrentThread(JVM);
@@ -195,7 +208,7 @@ int BridgeDrSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
     ret = (*env)->CallStaticIntMethod(env, GlobalBridgeClass, BridgeDrSubmitDecodeUnitMethod,
                                        DecodedFrameBuffer, offset, BUFFER_TYPE_PICDATA,
                                        decodeUnit->frameNumber, decodeUnit->frameType, (jchar)decodeUnit->frameHostProcessingLatency,
-                                       (jlong)decodeUnit->receiveTimeMs, (jlong)decodeUnit->enqueueTimeMs);
+                                       (jlong)decodeUnit->receiveTimeUs, (jlong)decodeUnit->enqueueTimeUs);
     if ((*env)->ExceptionCheck(env)) {
         // We will crash here
         (*JVM)->DetachCurrentThread(JVM);
@@ -210,6 +223,12 @@ int BridgeArInit(int audioConfiguration, POPUS_MULTISTREAM_CONFIGURATION opusCon
     JNIEnv* env = GetThreadEnv();
     int err;
 
+    // A native sink plays the audio without calling up into Java for each packet
+    NativeAudioActive = nativeAudioIsEnabled();
+    if (NativeAudioActive) {
+        return nativeAudioInit(audioConfiguration, opusConfig);
+    }
+
     err = (*env)->CallStaticIntMethod(env, GlobalBridgeClass, BridgeArInitMethod, audioConfiguration, opusConfig->sampleRate, opusConfig->samplesPerFrame);
     if ((*env)->ExceptionCheck(env)) {
         // This is called on a Java thread, so it's safe to return
@@ -217,12 +236,8 @@ int BridgeArInit(int audioConfiguration, POPUS_MULTISTREAM_CONFIGURATION opusCon
     }
     if (err == 0) {
         memcpy(&OpusConfig, opusConfig, sizeof(*opusConfig));
-        Decoder = opus_multistream_decoder_create(opusConfig->sampleRate,
-                                                  opusConfig->channelCount,
-                                                  opusConfig->streams,
-                                                  opusConfig->coupledStreams,
-                                                  opusConfig->mapping,
-                                                  &err);
+        // Surround streams may be split up and decoded on multiple threads
+        Decoder = parallel_opus_decoder_create(opusConfig, nativeAudioGetDecoderThreads());
         if (Decoder == NULL) {
             (*env)->CallStaticVoidMethod(env, GlobalBridgeClass, BridgeArCleanupMethod);
             return -1;
@@ -238,19 +253,35 @@ int BridgeArInit(int audioConfiguration, POPUS_MULTISTREAM_CONFIGURATION opusCon
 void BridgeArStart(void) {
     JNIEnv* env = GetThreadEnv();
 
+    if (NativeAudioActive) {
+        nativeAudioStart();
+        return;
+    }
+
     (*env)->CallStaticVoidMethod(env, GlobalBridgeClass, BridgeArStartMethod);
 }
 
 void BridgeArStop(void) {
     JNIEnv* env = GetThreadEnv();
 
+    if (NativeAudioActive) {
+        nativeAudioStop();
+        return;
+    }
+
     (*env)->CallStaticVoidMethod(env, GlobalBridgeClass, BridgeArStopMethod);
 }
 
 void BridgeArCleanup() {
     JNIEnv* env = GetThreadEnv();
 
-    opus_multistream_decoder_destroy(Decoder);
+    if (NativeAudioActive) {
+        nativeAudioCleanup();
+        NativeAudioActive = false;
+        return;
+    }
+
+    parallel_opus_decoder_destroy(Decoder);
 
     (*env)->DeleteGlobalRef(env, DecodedAudioBuffer);
 
@@ -258,16 +289,20 @@ void BridgeArCleanup() {
 }
 
 void BridgeArDecodeAndPlaySample(char* sampleData, int sampleLength) {
+    if (NativeAudioActive) {
+        nativeAudioDecodeAndPlaySample(sampleData, sampleLength);
+        return;
+    }
+
     JNIEnv* env = GetThreadEnv();
 
     jshort* decodedData = (*env)->GetPrimitiveArrayCritical(env, DecodedAudioBuffer, NULL);
 
-    int decodeLen = opus_multistream_decode(Decoder,
-                                            (const unsigned char*)sampleData,
-                                            sampleLength,
-                                            decodedData,
-                                            OpusConfig.samplesPerFrame,
-                                            0);
+    int decodeLen = parallel_opus_decoder_decode(Decoder,
+                                                 (const unsigned char*)sampleData,
+                                                 sampleLength,
+                                                 decodedData,
+                                                 OpusConfig.samplesPerFrame);
     if (decodeLen > 0) {
         // We must release the array elements before making further JNI calls
         (*env)->ReleasePrimitiveArrayCritical(env, DecodedAudioBuffer, decodedData, 0);
@@ -407,7 +442,8 @@ void BridgeClSetControllerLED(uint16_t controllerNumber, uint8_t r, uint8_t g, u
 void BridgeClLogMessage(const char* format, ...) {
     va_list va;
     va_start(va, format);
-    __android_log_vprint(ANDROID_LOG_INFO, "moonlight-common-c", format, va);
+    // This is called from the streaming threads, so it must never block
+    async_log_vwrite(ANDROID_LOG_INFO, "moonlight-common-c", format, va);
     va_end(va);
 }
 
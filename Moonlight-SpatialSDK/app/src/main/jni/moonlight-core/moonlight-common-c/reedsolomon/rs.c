@@ -46,6 +46,26 @@
 #define alloca(x) _alloca(x)
 #endif
 
+/*
+ * SIMD kernels use the split nibble technique: the product of a constant c and
+ * a byte x is lookup_lo[x & 0xf] ^ lookup_hi[x >> 4], where each lookup is a 16 byte
+ * table that fits in a vector register and can be indexed with pshufb or vtbl.
+ * x86 kernels are selected at runtime, NEON is used whenever the compiler enables it.
+ */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RS_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RS_TARGET(x)
+#else
+#define RS_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define RS_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 typedef unsigned char gf;
 
 #define GF_BITS  8
@@ -77,8 +97,12 @@ static int gf_log[GF_SIZE + 1];
 static gf inverse[GF_SIZE+1];
 #ifdef _MSC_VER
 static gf __declspec(align (256)) gf_mul_table[(GF_SIZE + 1)*(GF_SIZE + 1)];
+static gf __declspec(align (16)) gf_mul_lo[GF_SIZE + 1][16];
+static gf __declspec(align (16)) gf_mul_hi[GF_SIZE + 1][16];
 #else
 static gf gf_mul_table[(GF_SIZE + 1)*(GF_SIZE + 1)] __attribute__((aligned (256)));
+static gf gf_mul_lo[GF_SIZE + 1][16] __attribute__((aligned (16)));
+static gf gf_mul_hi[GF_SIZE + 1][16] __attribute__((aligned (16)));
 #endif
 
 /*
@@ -114,9 +138,181 @@ static void mul(gf *dst1, gf *src1, gf c, int sz) {
         for (; dst < lim; dst++, src++)
             GF_MULC(*dst , *src);
     } else
-        memset(dst1, 0, c);
+        memset(dst1, 0, sz);
 }
 
+#ifdef RS_SIMD_X86
+RS_TARGET("ssse3")
+static void addmul_ssse3(gf *dst, gf *src, gf c, int sz) {
+    int i = 0;
+    if (c != 0) {
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i lo = _mm_load_si128((const __m128i*)gf_mul_lo[c]);
+        const __m128i hi = _mm_load_si128((const __m128i*)gf_mul_hi[c]);
+        for (; i + 16 <= sz; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i*)&src[i]);
+            __m128i d = _mm_loadu_si128((const __m128i*)&dst[i]);
+            __m128i p = _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(x, mask)),
+                                      _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(x, 4), mask)));
+            _mm_storeu_si128((__m128i*)&dst[i], _mm_xor_si128(d, p));
+        }
+        addmul(&dst[i], &src[i], c, sz - i);
+    }
+}
+
+RS_TARGET("ssse3")
+static void mul_ssse3(gf *dst, gf *src, gf c, int sz) {
+    int i = 0;
+    if (c != 0) {
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i lo = _mm_load_si128((const __m128i*)gf_mul_lo[c]);
+        const __m128i hi = _mm_load_si128((const __m128i*)gf_mul_hi[c]);
+        for (; i + 16 <= sz; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i*)&src[i]);
+            __m128i p = _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(x, mask)),
+                                      _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(x, 4), mask)));
+            _mm_storeu_si128((__m128i*)&dst[i], p);
+        }
+    }
+    mul(&dst[i], &src[i], c, sz - i);
+}
+
+RS_TARGET("avx2")
+static void addmul_avx2(gf *dst, gf *src, gf c, int sz) {
+    int i = 0;
+    if (c != 0) {
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)gf_mul_lo[c]));
+        const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)gf_mul_hi[c]));
+        for (; i + 32 <= sz; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)&src[i]);
+            __m256i d = _mm256_loadu_si256((const __m256i*)&dst[i]);
+            __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask)),
+                                         _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask)));
+            _mm256_storeu_si256((__m256i*)&dst[i], _mm256_xor_si256(d, p));
+        }
+        addmul(&dst[i], &src[i], c, sz - i);
+    }
+}
+
+RS_TARGET("avx2")
+static void mul_avx2(gf *dst, gf *src, gf c, int sz) {
+    int i = 0;
+    if (c != 0) {
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)gf_mul_lo[c]));
+        const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)gf_mul_hi[c]));
+        for (; i + 32 <= sz; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)&src[i]);
+            __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask)),
+                                         _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask)));
+            _mm256_storeu_si256((__m256i*)&dst[i], p);
+        }
+    }
+    mul(&dst[i], &src[i], c, sz - i);
+}
+
+static int cpu_has_ssse3(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static int cpu_has_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    /* the OS must also save the YMM registers on context switch */
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+        return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef RS_SIMD_NEON
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define gf_vtbl(t, i) vqtbl1q_u8(t, i)
+#else
+static inline uint8x16_t gf_vtbl(uint8x16_t t, uint8x16_t i) {
+    uint8x8x2_t tt = {{ vget_low_u8(t), vget_high_u8(t) }};
+    return vcombine_u8(vtbl2_u8(tt, vget_low_u8(i)), vtbl2_u8(tt, vget_high_u8(i)));
+}
+#endif
+
+static void addmul_neon(gf *dst, gf *src, gf c, int sz) {
+    int i = 0;
+    if (c != 0) {
+        const uint8x16_t mask = vdupq_n_u8(0x0f);
+        const uint8x16_t lo = vld1q_u8(gf_mul_lo[c]);
+        const uint8x16_t hi = vld1q_u8(gf_mul_hi[c]);
+        for (; i + 16 <= sz; i += 16) {
+            uint8x16_t x = vld1q_u8(&src[i]);
+            uint8x16_t d = vld1q_u8(&dst[i]);
+            uint8x16_t p = veorq_u8(gf_vtbl(lo, vandq_u8(x, mask)), gf_vtbl(hi, vshrq_n_u8(x, 4)));
+            vst1q_u8(&dst[i], veorq_u8(d, p));
+        }
+        addmul(&dst[i], &src[i], c, sz - i);
+    }
+}
+
+static void mul_neon(gf *dst, gf *src, gf c, int sz) {
+    int i = 0;
+    if (c != 0) {
+        const uint8x16_t mask = vdupq_n_u8(0x0f);
+        const uint8x16_t lo = vld1q_u8(gf_mul_lo[c]);
+        const uint8x16_t hi = vld1q_u8(gf_mul_hi[c]);
+        for (; i + 16 <= sz; i += 16) {
+            uint8x16_t x = vld1q_u8(&src[i]);
+            uint8x16_t p = veorq_u8(gf_vtbl(lo, vandq_u8(x, mask)), gf_vtbl(hi, vshrq_n_u8(x, 4)));
+            vst1q_u8(&dst[i], p);
+        }
+    }
+    mul(&dst[i], &src[i], c, sz - i);
+}
+#endif
+
+static int cpu_has_nothing_special(void) {
+    return 1;
+}
+
+typedef struct _gf_kernel {
+    const char* name;
+    void (*addmul)(gf *dst, gf *src, gf c, int sz);
+    void (*mul)(gf *dst, gf *src, gf c, int sz);
+    int (*supported)(void);
+} gf_kernel;
+
+/*
+ * kernels built for this target, in order of preference
+ * addmul() and mul() remain the reference implementation
+ * */
+static const gf_kernel gf_kernels[] = {
+#if defined(RS_SIMD_X86)
+    { "AVX2", addmul_avx2, mul_avx2, cpu_has_avx2 },
+    { "SSSE3", addmul_ssse3, mul_ssse3, cpu_has_ssse3 },
+#elif defined(RS_SIMD_NEON)
+    { "NEON", addmul_neon, mul_neon, cpu_has_nothing_special },
+#endif
+    { "scalar", addmul, mul, cpu_has_nothing_special },
+};
+
+/*
+ * kernels used for the shard data, selected by reed_solomon_init()
+ * */
+static void (*addmul_shards)(gf *dst, gf *src, gf c, int sz) = addmul;
+static void (*mul_shards)(gf *dst, gf *src, gf c, int sz) = mul;
+static const char* kernel_name = "scalar";
+
 /* y = a.dot(b) */
 static gf* multiply1(gf *a, int ar, int ac, gf *b, int br, int bc) {
     gf *new_m, tg;
@@ -149,6 +345,14 @@ static void init_mul_table(void) {
 
     for (j=0; j< GF_SIZE+1; j++)
         gf_mul_table[j] = gf_mul_table[j<<8] = 0;
+
+    /* split nibble tables for the SIMD kernels */
+    for (i=0; i< GF_SIZE+1; i++) {
+        for (j=0; j< 16; j++) {
+            gf_mul_lo[i][j] = gf_mul(i, j);
+            gf_mul_hi[i][j] = gf_mul(i, (j << 4));
+        }
+    }
 }
 
 /*
@@ -368,9 +572,9 @@ static inline int code_some_shards(gf* matrixRows, gf** inputs, gf** outputs, in
         in = inputs[c];
         for (iRow = 0; iRow < outputCount; iRow++) {
             if (0 == c)
-                mul(outputs[iRow], in, matrixRows[iRow*dataShards+c], byteCount);
+                mul_shards(outputs[iRow], in, matrixRows[iRow*dataShards+c], byteCount);
             else
-                addmul(outputs[iRow], in, matrixRows[iRow*dataShards+c], byteCount);
+                addmul_shards(outputs[iRow], in, matrixRows[iRow*dataShards+c], byteCount);
         }
     }
 
@@ -378,8 +582,38 @@ static inline int code_some_shards(gf* matrixRows, gf** inputs, gf** outputs, in
 }
 
 void reed_solomon_init(void) {
+    size_t i;
+
     generate_gf();
     init_mul_table();
+
+    for (i = 0; i < sizeof(gf_kernels) / sizeof(gf_kernels[0]); i++) {
+        if (gf_kernels[i].supported()) {
+            addmul_shards = gf_kernels[i].addmul;
+            mul_shards = gf_kernels[i].mul;
+            kernel_name = gf_kernels[i].name;
+            break;
+        }
+    }
+}
+
+int reed_solomon_select_kernel(const char* name) {
+    size_t i;
+
+    for (i = 0; i < sizeof(gf_kernels) / sizeof(gf_kernels[0]); i++) {
+        if (strcmp(gf_kernels[i].name, name) == 0 && gf_kernels[i].supported()) {
+            addmul_shards = gf_kernels[i].addmul;
+            mul_shards = gf_kernels[i].mul;
+            kernel_name = gf_kernels[i].name;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char* reed_solomon_kernel_name(void) {
+    return kernel_name;
 }
 
 reed_solomon* reed_solomon_new(int data_shards, int parity_shards) {
@@ -398,6 +632,8 @@ reed_solomon* reed_solomon_new(int data_shards, int parity_shards) {
         rs->shards = (data_shards + parity_shards);
         rs->m = NULL;
         rs->parity = NULL;
+        memset(rs->decode_cache, 0, sizeof(rs->decode_cache));
+        rs->decode_cache_clock = 0;
 
         if (rs->shards > DATA_SHARDS_MAX || data_shards <= 0 || parity_shards <= 0) {
             err = 1;
@@ -472,7 +708,14 @@ reed_solomon* reed_solomon_new(int data_shards, int parity_shards) {
 }
 
 void reed_solomon_release(reed_solomon* rs) {
+    int i;
+
     if (NULL != rs) {
+        for (i = 0; i < DECODE_CACHE_MAX; i++) {
+            if (NULL != rs->decode_cache[i].matrix)
+                free(rs->decode_cache[i].matrix);
+        }
+
         if (NULL != rs->m)
             free(rs->m);
 
@@ -483,6 +726,62 @@ void reed_solomon_release(reed_solomon* rs) {
     }
 }
 
+/*
+ * find the cached decode matrix for this erasure pattern
+ * return NULL if not cached
+ * */
+static gf* decode_cache_lookup(reed_solomon* rs, unsigned int *fec_block_nos, unsigned int *erased_blocks, int nr_fec_blocks) {
+    reed_solomon_decode_cache* entry;
+    int i, j;
+
+    for (i = 0; i < DECODE_CACHE_MAX; i++) {
+        entry = &rs->decode_cache[i];
+        if (entry->nr_fec_blocks != nr_fec_blocks || NULL == entry->matrix)
+            continue;
+
+        for (j = 0; j < nr_fec_blocks; j++) {
+            if (entry->erased_blocks[j] != erased_blocks[j] || entry->fec_block_nos[j] != fec_block_nos[j])
+                break;
+        }
+
+        if (j == nr_fec_blocks) {
+            entry->last_use = ++rs->decode_cache_clock;
+            return entry->matrix;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * remember the decode matrix for this erasure pattern, replacing the least recently used entry
+ * matrix[nr_fec_blocks][data_shards]
+ * */
+static void decode_cache_insert(reed_solomon* rs, gf* matrix, unsigned int *fec_block_nos, unsigned int *erased_blocks, int nr_fec_blocks) {
+    reed_solomon_decode_cache* entry = &rs->decode_cache[0];
+    int i;
+
+    for (i = 1; i < DECODE_CACHE_MAX; i++) {
+        if (rs->decode_cache[i].last_use < entry->last_use)
+            entry = &rs->decode_cache[i];
+    }
+
+    /* size each entry for the most erasures we can recover, so replacing it never allocates */
+    if (NULL == entry->matrix) {
+        entry->matrix = (gf*) malloc(rs->parity_shards * rs->data_shards);
+        if (NULL == entry->matrix)
+            return;
+    }
+
+    memcpy(entry->matrix, matrix, nr_fec_blocks * rs->data_shards);
+    for (i = 0; i < nr_fec_blocks; i++) {
+        entry->erased_blocks[i] = (unsigned char)erased_blocks[i];
+        entry->fec_block_nos[i] = (unsigned char)fec_block_nos[i];
+    }
+    entry->nr_fec_blocks = nr_fec_blocks;
+    entry->last_use = ++rs->decode_cache_clock;
+}
+
 /**
  * decode one shard
  * input:
@@ -499,6 +798,7 @@ static int reed_solomon_decode(reed_solomon* rs, unsigned char **data_blocks, in
     unsigned char* subShards[DATA_SHARDS_MAX];
     unsigned char* outputs[DATA_SHARDS_MAX];
     gf* m = rs->m;
+    gf* cached_m;
     int i, j, c, swap, subMatrixRow, dataShards;
 
     /* the erased_blocks should always sorted
@@ -521,6 +821,9 @@ static int reed_solomon_decode(reed_solomon* rs, unsigned char **data_blocks, in
             break;
     }
 
+    /* the same erasure pattern always yields the same inverted matrix, so skip the inversion if we have it */
+    cached_m = decode_cache_lookup(rs, fec_block_nos, erased_blocks, nr_fec_blocks);
+
     j = 0;
     subMatrixRow = 0;
     dataShards = rs->data_shards;
@@ -529,8 +832,10 @@ static int reed_solomon_decode(reed_solomon* rs, unsigned char **data_blocks, in
             j++;
         else {
             /* this row is ok */
-            for (c = 0; c < dataShards; c++)
-                dataDecodeMatrix[subMatrixRow*dataShards + c] = m[i*dataShards + c];
+            if (NULL == cached_m) {
+                for (c = 0; c < dataShards; c++)
+                    dataDecodeMatrix[subMatrixRow*dataShards + c] = m[i*dataShards + c];
+            }
 
             subShards[subMatrixRow] = data_blocks[i];
             subMatrixRow++;
@@ -539,9 +844,11 @@ static int reed_solomon_decode(reed_solomon* rs, unsigned char **data_blocks, in
 
     for (i = 0; i < nr_fec_blocks && subMatrixRow < dataShards; i++) {
         subShards[subMatrixRow] = dec_fec_blocks[i];
-        j = dataShards + fec_block_nos[i];
-        for (c = 0; c < dataShards; c++)
-            dataDecodeMatrix[subMatrixRow*dataShards + c] = m[j*dataShards + c];
+        if (NULL == cached_m) {
+            j = dataShards + fec_block_nos[i];
+            for (c = 0; c < dataShards; c++)
+                dataDecodeMatrix[subMatrixRow*dataShards + c] = m[j*dataShards + c];
+        }
 
         subMatrixRow++;
     }
@@ -549,14 +856,22 @@ static int reed_solomon_decode(reed_solomon* rs, unsigned char **data_blocks, in
     if (subMatrixRow < dataShards)
         return -1;
 
-    invert_mat(dataDecodeMatrix, dataShards);
+    for (i = 0; i < nr_fec_blocks; i++)
+        outputs[i] = data_blocks[erased_blocks[i]];
+
+    if (NULL != cached_m)
+        return code_some_shards(cached_m, subShards, outputs, dataShards, nr_fec_blocks, block_size);
+
+    if (invert_mat(dataDecodeMatrix, dataShards))
+        return -1;
 
     for (i = 0; i < nr_fec_blocks; i++) {
         j = erased_blocks[i];
-        outputs[i] = data_blocks[j];
         memmove(dataDecodeMatrix+i*dataShards, dataDecodeMatrix+j*dataShards, dataShards);
     }
 
+    decode_cache_insert(rs, dataDecodeMatrix, fec_block_nos, erased_blocks, nr_fec_blocks);
+
     return code_some_shards(dataDecodeMatrix, subShards, outputs, dataShards, nr_fec_blocks, block_size);
 }
 
@@ -625,7 +940,8 @@ int reed_solomon_reconstruct(reed_solomon* rs, unsigned char** shards, unsigned
             }
 
             if (dn == pn) {
-                reed_solomon_decode(rs, data_blocks, block_size, dec_fec_blocks, fec_block_nos, erased_blocks, dn);
+                if (reed_solomon_decode(rs, data_blocks, block_size, dec_fec_blocks, fec_block_nos, erased_blocks, dn))
+                    err = -1;
             } else
                 err = -1;
         }
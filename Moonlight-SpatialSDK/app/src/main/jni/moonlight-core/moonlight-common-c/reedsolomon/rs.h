@@ -4,12 +4,33 @@
 /* use small value to save memory */
 #define DATA_SHARDS_MAX 255
 
+/* number of decode matrices cached per codec instance */
+#define DECODE_CACHE_MAX 4
+
+/**
+ * inverted decode matrix for one erasure pattern
+ * erased_blocks[nr_fec_blocks]: erased data shard indexes (sorted)
+ * fec_block_nos[nr_fec_blocks]: parity shard indexes used to recover them
+ * matrix[nr_fec_blocks][data_shards]
+ * */
+typedef struct _reed_solomon_decode_cache {
+    int nr_fec_blocks;
+    unsigned int last_use;
+    unsigned char erased_blocks[DATA_SHARDS_MAX];
+    unsigned char fec_block_nos[DATA_SHARDS_MAX];
+    unsigned char* matrix;
+} reed_solomon_decode_cache;
+
 typedef struct _reed_solomon {
     int data_shards;
     int parity_shards;
     int shards;
     unsigned char* m;
     unsigned char* parity;
+
+    /* not thread safe, each instance must only be used by one thread at a time */
+    reed_solomon_decode_cache decode_cache[DECODE_CACHE_MAX];
+    unsigned int decode_cache_clock;
 } reed_solomon;
 
 /**
@@ -17,6 +38,18 @@ typedef struct _reed_solomon {
  * */
 void reed_solomon_init(void);
 
+/**
+ * name of the GF(2^8) kernel selected by reed_solomon_init()
+ * */
+const char* reed_solomon_kernel_name(void);
+
+/**
+ * force a GF(2^8) kernel by name ("scalar", "SSSE3", "AVX2" or "NEON")
+ * returns -1 if it isn't built for this target or the CPU lacks support
+ * must be called after reed_solomon_init(), which picks the fastest one
+ * */
+int reed_solomon_select_kernel(const char* name);
+
 reed_solomon* reed_solomon_new(int data_shards, int parity_shards);
 void reed_solomon_release(reed_solomon* rs);
 
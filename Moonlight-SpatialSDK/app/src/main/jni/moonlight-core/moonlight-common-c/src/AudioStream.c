@@ -2,8 +2,10 @@
 
 static SOCKET rtpSocket = INVALID_SOCKET;
 
-static LINKED_BLOCKING_QUEUE packetQueue;
+static LOCK_FREE_QUEUE packetQueue;
 static RTP_AUDIO_QUEUE rtpAudioQueue;
+static PACKET_POOL packetPool;
+static bool packetPoolInitialized;
 
 static PLT_THREAD udpPingThread;
 static PLT_THREAD receiveThread;
@@ -23,10 +25,18 @@ static uint64_t firstReceiveTime;
 static uint8_t opusHeaderByte;
 #endif
 
-#define MAX_PACKET_SIZE 1400
+#define MAX_PACKET_SIZE RTPA_MAX_PACKET_SIZE
+
+#define PACKET_QUEUE_BOUND 30
+
+// Packet buffers held by the receive thread and the decoder thread
+// on top of a full packet queue
+#define PACKET_POOL_EXTRA_BUFFERS 3
+
+// The packet queue bound and pool size, which grow with the jitter buffer's maximum latency
+static int packetQueueBound;
 
 typedef struct _QUEUE_AUDIO_PACKET_HEADER {
-    LINKED_BLOCKING_QUEUE_ENTRY lentry;
     int size;
 } QUEUED_AUDIO_PACKET_HEADER, *PQUEUED_AUDIO_PACKET_HEADER;
 
@@ -35,6 +45,46 @@ typedef struct _QUEUED_AUDIO_PACKET {
     char data[MAX_PACKET_SIZE];
 } QUEUED_AUDIO_PACKET, *PQUEUED_AUDIO_PACKET;
 
+// The jitter buffer's target latency covers this multiple of the mean arrival jitter
+#define JITTER_BUFFER_JITTER_MULTIPLIER 3
+
+// Drift is corrected by at most one packet in this interval, so corrections
+// are spread out rather than audible as a burst of drops or concealment.
+#define JITTER_BUFFER_CORRECTION_INTERVAL_MS 200
+
+// If nothing arrives for this long, the host has likely stopped sending audio,
+// so we stop concealing and wait to restart playout with the next packet.
+#define JITTER_BUFFER_MAX_CONCEALMENT_MS 100
+
+// Longest target latency the jitter buffer supports
+#define JITTER_BUFFER_MAX_TARGET_MS 500
+
+// The packet queue holds this much audio beyond the jitter buffer's maximum target,
+// so packets arriving in a burst after a delay don't overflow it
+#define JITTER_BUFFER_QUEUE_MARGIN_MS 50
+
+// The queue is sized before the audio packet duration is negotiated, so it assumes
+// the shortest packets a host sends
+#define MIN_AUDIO_PACKET_DURATION_MS 5
+
+// Jitter buffer settings, which are latched when the stream is initialized
+static int jitterBufferMinTargetMs;
+static int jitterBufferMaxTargetMs;
+static bool jitterBufferEnabled;
+
+// Arrival jitter is measured by the receive thread and read by the decoder thread
+static PLT_ATOMIC_INT arrivalJitterUs;
+static bool haveLastArrival;
+static unsigned short lastArrivalSeq;
+static uint64_t lastArrivalUs;
+
+// Jitter buffer statistics are only updated by the decoder thread
+static AUDIO_JITTER_BUFFER_STATS jitterBufferStats;
+static bool jitterBufferStatsValid;
+
+// Packet queue overflows are counted by the receive thread
+static uint32_t packetQueueOverflows;
+
 static void AudioPingThreadProc(void* context) {
     char legacyPingData[] = { 0x50, 0x49, 0x4E, 0x47 };
     LC_SOCKADDR saddr;
@@ -66,7 +116,35 @@ static void AudioPingThreadProc(void* context) {
 
 // Initialize the audio stream and start
 int initializeAudioStream(void) {
-    LbqInitializeLinkedBlockingQueue(&packetQueue, 30);
+    int err;
+
+    jitterBufferEnabled = jitterBufferMaxTargetMs > 0 && (AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0;
+    PltAtomicStore(&arrivalJitterUs, 0);
+    haveLastArrival = false;
+    memset(&jitterBufferStats, 0, sizeof(jitterBufferStats));
+    packetQueueOverflows = 0;
+
+    // The queue has to hold the jitter buffer's maximum target latency
+    packetQueueBound = PACKET_QUEUE_BOUND;
+    if (jitterBufferEnabled) {
+        int maxTargetMs = jitterBufferMaxTargetMs < JITTER_BUFFER_MAX_TARGET_MS ?
+                              jitterBufferMaxTargetMs : JITTER_BUFFER_MAX_TARGET_MS;
+        int bound = (maxTargetMs + JITTER_BUFFER_QUEUE_MARGIN_MS) / MIN_AUDIO_PACKET_DURATION_MS;
+
+        if (bound > packetQueueBound) {
+            packetQueueBound = bound;
+        }
+    }
+
+    err = PktPoolInitialize(&packetPool, sizeof(QUEUED_AUDIO_PACKET),
+                            packetQueueBound + PACKET_POOL_EXTRA_BUFFERS,
+                            packetQueueBound + PACKET_POOL_EXTRA_BUFFERS);
+    if (err != 0) {
+        return err;
+    }
+    packetPoolInitialized = true;
+
+    LfqInitializeQueue(&packetQueue, packetQueueBound);
     RtpaInitializeQueue(&rtpAudioQueue);
     lastSeq = 0;
     receivedDataFromPeer = false;
@@ -81,6 +159,8 @@ int initializeAudioStream(void) {
     memcpy(&avRiKeyId, StreamConfig.remoteInputAesIv, sizeof(avRiKeyId));
     avRiKeyId = BE32(avRiKeyId);
 
+    jitterBufferStatsValid = jitterBufferEnabled;
+
     return 0;
 }
 
@@ -109,16 +189,20 @@ int notifyAudioPortNegotiationComplete(void) {
     return 0;
 }
 
-static void freePacketList(PLINKED_BLOCKING_QUEUE_ENTRY entry) {
-    PLINKED_BLOCKING_QUEUE_ENTRY nextEntry;
+// Audio packet buffers must only be allocated on the receive thread
+static PQUEUED_AUDIO_PACKET allocAudioPacket(void) {
+    return (PQUEUED_AUDIO_PACKET)PktPoolAlloc(&packetPool);
+}
 
-    while (entry != NULL) {
-        nextEntry = entry->flink;
+static void freeAudioPacket(PQUEUED_AUDIO_PACKET packet) {
+    PktPoolFree(&packetPool, packet);
+}
 
-        // The entry is stored within the data allocation
-        free(entry->data);
+static void flushPacketQueue(void) {
+    PQUEUED_AUDIO_PACKET packet;
 
-        entry = nextEntry;
+    while (LfqFlushQueueElement(&packetQueue, (void**)&packet) == LBQ_SUCCESS) {
+        freeAudioPacket(packet);
     }
 }
 
@@ -134,25 +218,68 @@ void destroyAudioStream(void) {
         rtpSocket = INVALID_SOCKET;
     }
 
+    jitterBufferStatsValid = false;
+
     PltDestroyCryptoContext(audioDecryptionCtx);
-    freePacketList(LbqDestroyLinkedBlockingQueue(&packetQueue));
+    flushPacketQueue();
+    LfqDestroyQueue(&packetQueue);
     RtpaCleanupQueue(&rtpAudioQueue);
+    if (packetPoolInitialized) {
+        packetPoolInitialized = false;
+        PktPoolCleanup(&packetPool);
+    }
 }
 
-static bool queuePacketToLbq(PQUEUED_AUDIO_PACKET* packet) {
+// Updates the mean deviation of the packet arrival times from their spacing
+// in the stream, like the RTP interarrival jitter (RFC 3550, section 6.4.1).
+static void updateArrivalJitter(PQUEUED_AUDIO_PACKET packet) {
+    PRTP_PACKET rtp = (PRTP_PACKET)&packet->data[0];
+    uint64_t nowUs = PltGetMicros();
+
+    if (haveLastArrival) {
+        short seqDelta = (short)(rtp->sequenceNumber - lastArrivalSeq);
+        int32_t jitterUs = PltAtomicLoad(&arrivalJitterUs);
+        int64_t deviationUs;
+
+        // Ignore duplicate and reordered packets
+        if (seqDelta <= 0) {
+            return;
+        }
+
+        deviationUs = (int64_t)(nowUs - lastArrivalUs) - (int64_t)seqDelta * AudioPacketDuration * 1000;
+        if (deviationUs < 0) {
+            deviationUs = -deviationUs;
+        }
+
+        jitterUs += (int32_t)((deviationUs - jitterUs) / 16);
+        PltAtomicStore(&arrivalJitterUs, jitterUs);
+    }
+
+    haveLastArrival = true;
+    lastArrivalSeq = rtp->sequenceNumber;
+    lastArrivalUs = nowUs;
+}
+
+static bool queuePacketToLfq(PQUEUED_AUDIO_PACKET* packet) {
     int err;
 
+    // Placeholders for lost packets aren't real arrivals
+    if (jitterBufferEnabled && (*packet)->header.size != 0) {
+        updateArrivalJitter(*packet);
+    }
+
     do {
-        err = LbqOfferQueueItem(&packetQueue, *packet, &(*packet)->header.lentry);
+        err = LfqOfferQueueItem(&packetQueue, *packet);
         if (err == LBQ_SUCCESS) {
-            // The LBQ owns the buffer now
+            // The queue owns the buffer now
             *packet = NULL;
         }
         else if (err == LBQ_BOUND_EXCEEDED) {
             Limelog("Audio packet queue overflow\n");
+            packetQueueOverflows++;
 
             // The audio queue is full, so free all existing items and try again
-            freePacketList(LbqFlushQueueItems(&packetQueue));
+            flushPacketQueue();
         }
     } while (err == LBQ_BOUND_EXCEEDED);
 
@@ -235,10 +362,96 @@ static void decodeInputData(PQUEUED_AUDIO_PACKET packet) {
     }
 }
 
+// Adds a received packet to the RTP queue and passes any packets that are ready on to
+// the decoder. The packet buffer is set to NULL if ownership was taken. Returns false
+// if an exit signal was received.
+static bool queueReceivedAudioPacket(PQUEUED_AUDIO_PACKET* packet) {
+    PRTP_PACKET rtp = (PRTP_PACKET)&(*packet)->data[0];
+    int queueStatus;
+
+    capturePacket(PACKET_CAPTURE_AUDIO, rtp, (*packet)->header.size);
+
+    // Convert fields to host byte-order
+    rtp->sequenceNumber = BE16(rtp->sequenceNumber);
+    rtp->timestamp = BE32(rtp->timestamp);
+    rtp->ssrc = BE32(rtp->ssrc);
+
+    queueStatus = RtpaAddPacket(&rtpAudioQueue, rtp, (uint16_t)(*packet)->header.size);
+    if (RTPQ_HANDLE_NOW(queueStatus)) {
+        if ((AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
+            if (!queuePacketToLfq(packet)) {
+                // An exit signal was received
+                return false;
+            }
+            else {
+                // Ownership should have been taken by the packet queue
+                LC_ASSERT(*packet == NULL);
+            }
+        }
+        else {
+            decodeInputData(*packet);
+        }
+    }
+    else {
+        if (RTPQ_PACKET_CONSUMED(queueStatus)) {
+            // The queue consumed our packet, so we must allocate a new one
+            *packet = NULL;
+        }
+
+        if (RTPQ_PACKET_READY(queueStatus)) {
+            // If packets are ready, pull them and send them to the decoder
+            uint16_t length;
+            PQUEUED_AUDIO_PACKET queuedPacket = NULL;
+            bool exiting = false;
+            for (;;) {
+                if (queuedPacket == NULL) {
+                    queuedPacket = allocAudioPacket();
+                    if (queuedPacket == NULL) {
+                        Limelog("Audio Receive: malloc() failed\n");
+                        ListenerCallbacks.connectionTerminated(-1);
+                        exiting = true;
+                        break;
+                    }
+                }
+
+                if (!RtpaGetQueuedPacket(&rtpAudioQueue, (PRTP_PACKET)&queuedPacket->data[0], MAX_PACKET_SIZE, &length)) {
+                    break;
+                }
+
+                // Populate header data (not preserved in queued packets)
+                queuedPacket->header.size = length;
+
+                if ((AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
+                    if (!queuePacketToLfq(&queuedPacket)) {
+                        // An exit signal was received
+                        exiting = true;
+                        break;
+                    }
+                    else {
+                        // Ownership should have been taken by the packet queue
+                        LC_ASSERT(queuedPacket == NULL);
+                    }
+                }
+                else {
+                    // Reuse this buffer for the next packet
+                    decodeInputData(queuedPacket);
+                }
+            }
+
+            freeAudioPacket(queuedPacket);
+
+            if (exiting) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 static void AudioReceiveThreadProc(void* context) {
     PRTP_PACKET rtp;
     PQUEUED_AUDIO_PACKET packet;
-    int queueStatus;
     bool useSelect;
     uint32_t packetsToDrop;
     int waitingForAudioMs;
@@ -258,7 +471,7 @@ static void AudioReceiveThreadProc(void* context) {
     waitingForAudioMs = 0;
     while (!PltIsThreadInterrupted(&receiveThread)) {
         if (packet == NULL) {
-            packet = (PQUEUED_AUDIO_PACKET)malloc(sizeof(*packet));
+            packet = allocAudioPacket();
             if (packet == NULL) {
                 Limelog("Audio Receive: malloc() failed\n");
                 ListenerCallbacks.connectionTerminated(-1);
@@ -314,77 +527,171 @@ static void AudioReceiveThreadProc(void* context) {
             continue;
         }
 
-        // Convert fields to host byte-order
-        rtp->sequenceNumber = BE16(rtp->sequenceNumber);
-        rtp->timestamp = BE32(rtp->timestamp);
-        rtp->ssrc = BE32(rtp->ssrc);
+        if (!queueReceivedAudioPacket(&packet)) {
+            // An exit signal was received
+            break;
+        }
+    }
+    
+    freeAudioPacket(packet);
+}
+
+static int getJitterBufferTargetUs(void) {
+    int targetUs = PltAtomicLoad(&arrivalJitterUs) * JITTER_BUFFER_JITTER_MULTIPLIER;
+    int minTargetUs = jitterBufferMinTargetMs * 1000;
+    int maxTargetUs = jitterBufferMaxTargetMs * 1000;
+
+    // The packet queue was sized for targets up to the supported maximum
+    if (maxTargetUs > JITTER_BUFFER_MAX_TARGET_MS * 1000) {
+        maxTargetUs = JITTER_BUFFER_MAX_TARGET_MS * 1000;
+    }
+    if (minTargetUs > maxTargetUs) {
+        minTargetUs = maxTargetUs;
+    }
 
-        queueStatus = RtpaAddPacket(&rtpAudioQueue, (PRTP_PACKET)&packet->data[0], (uint16_t)packet->header.size);
-        if (RTPQ_HANDLE_NOW(queueStatus)) {
-            if ((AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-                if (!queuePacketToLbq(&packet)) {
+    // Always aim to have at least one packet queued ahead of the decoder
+    if (minTargetUs < AudioPacketDuration * 1000) {
+        minTargetUs = AudioPacketDuration * 1000;
+    }
+    if (maxTargetUs < minTargetUs) {
+        maxTargetUs = minTargetUs;
+    }
+
+    if (targetUs < minTargetUs) {
+        return minTargetUs;
+    }
+    else if (targetUs > maxTargetUs) {
+        return maxTargetUs;
+    }
+    else {
+        return targetUs;
+    }
+}
+
+static void concealAudioFrame(void) {
+    AudioCallbacks.decodeAndPlaySample(NULL, 0);
+}
+
+// Releases packets to the decoder one packet duration apart, holding them back
+// by the target latency. The decoder is fed concealed audio when a packet
+// doesn't arrive in time, and drift is corrected by dropping or concealing
+// packets when the queue strays from the target.
+static void AudioJitterBufferThreadProc(void) {
+    PQUEUED_AUDIO_PACKET packet = NULL;
+    uint64_t frameUs = (uint64_t)AudioPacketDuration * 1000;
+    uint64_t playoutBaseUs = 0;
+    uint32_t framesPlayed = 0;
+    uint32_t framesSinceCorrection = 0;
+    int consecutiveConcealedFrames = 0;
+    int smoothedLatencyUs = 0;
+    bool playing = false;
+    int err;
+
+    while (!PltIsThreadInterrupted(&decoderThread)) {
+        uint64_t nextFrameUs, nowUs;
+        int targetUs;
+
+        if (!playing) {
+            // Wait for the host to start sending audio
+            if (packet == NULL) {
+                err = LfqWaitForQueueElement(&packetQueue, (void**)&packet);
+                if (err != LBQ_SUCCESS) {
                     // An exit signal was received
                     break;
                 }
-                else {
-                    // Ownership should have been taken by the LBQ
-                    LC_ASSERT(packet == NULL);
-                }
             }
-            else {
-                decodeInputData(packet);
+
+            // Hold the first packet for the target latency to let the queue fill
+            smoothedLatencyUs = 0;
+            playoutBaseUs = PltGetMicros() + getJitterBufferTargetUs();
+            framesPlayed = 0;
+            framesSinceCorrection = 0;
+            consecutiveConcealedFrames = 0;
+            playing = true;
+        }
+
+        nextFrameUs = playoutBaseUs + framesPlayed * frameUs;
+        nowUs = PltGetMicros();
+        if (nextFrameUs > nowUs) {
+            PltSleepMsInterruptible(&decoderThread, (int)((nextFrameUs - nowUs + 999) / 1000));
+            continue;
+        }
+
+        if (packet == NULL) {
+            err = LfqPollQueueElement(&packetQueue, (void**)&packet);
+            if (err == LBQ_INTERRUPTED) {
+                break;
+            }
+            else if (err != LBQ_SUCCESS) {
+                // Nothing arrived in time, so conceal the gap unless the host has stopped sending
+                consecutiveConcealedFrames++;
+                if (consecutiveConcealedFrames * AudioPacketDuration > JITTER_BUFFER_MAX_CONCEALMENT_MS) {
+                    jitterBufferStats.restarts++;
+                    playing = false;
+                    continue;
+                }
+
+                jitterBufferStats.lateFrames++;
+                concealAudioFrame();
+                framesPlayed++;
+                continue;
             }
         }
-        else {
-            if (RTPQ_PACKET_CONSUMED(queueStatus)) {
-                // The queue consumed our packet, so we must allocate a new one
+
+        consecutiveConcealedFrames = 0;
+        framesSinceCorrection++;
+
+        // The queued packets behind this one are how far ahead of playout we are
+        smoothedLatencyUs += (int)((LfqGetItemCount(&packetQueue) * (int)frameUs - smoothedLatencyUs) / 16);
+        targetUs = getJitterBufferTargetUs();
+
+        jitterBufferStats.currentLatencyMs = smoothedLatencyUs / 1000;
+        jitterBufferStats.targetLatencyMs = targetUs / 1000;
+        jitterBufferStats.arrivalJitterUs = PltAtomicLoad(&arrivalJitterUs);
+
+        if (framesSinceCorrection * AudioPacketDuration >= JITTER_BUFFER_CORRECTION_INTERVAL_MS) {
+            if (smoothedLatencyUs > targetUs + (int)frameUs && LfqGetItemCount(&packetQueue) > 0) {
+                // We're falling behind the host, so skip this packet to catch up
+                freeAudioPacket(packet);
                 packet = NULL;
-            }
 
-            if (RTPQ_PACKET_READY(queueStatus)) {
-                // If packets are ready, pull them and send them to the decoder
-                uint16_t length;
-                PQUEUED_AUDIO_PACKET queuedPacket;
-                while ((queuedPacket = (PQUEUED_AUDIO_PACKET)RtpaGetQueuedPacket(&rtpAudioQueue, sizeof(QUEUED_AUDIO_PACKET_HEADER), &length)) != NULL) {
-                    // Populate header data (not preserved in queued packets)
-                    queuedPacket->header.size = length;
-
-                    if ((AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-                        if (!queuePacketToLbq(&queuedPacket)) {
-                            // An exit signal was received
-                            free(queuedPacket);
-                            break;
-                        }
-                        else {
-                            // Ownership should have been taken by the LBQ
-                            LC_ASSERT(queuedPacket == NULL);
-                        }
-                    }
-                    else {
-                        decodeInputData(queuedPacket);
-                        free(queuedPacket);
-                    }
-                }
-                
-                // Break on exit
-                if (queuedPacket != NULL) {
-                    break;
-                }
+                smoothedLatencyUs -= (int)frameUs;
+                framesSinceCorrection = 0;
+                jitterBufferStats.framesDropped++;
+                continue;
+            }
+            else if (smoothedLatencyUs + (int)frameUs < targetUs) {
+                // We're getting ahead of the host, so conceal a frame and play this packet after it
+                concealAudioFrame();
+                framesPlayed++;
+
+                smoothedLatencyUs += (int)frameUs;
+                framesSinceCorrection = 0;
+                jitterBufferStats.framesInserted++;
+                continue;
             }
         }
+
+        decodeInputData(packet);
+        freeAudioPacket(packet);
+        packet = NULL;
+        framesPlayed++;
     }
-    
-    if (packet != NULL) {
-        free(packet);
-    }
+
+    freeAudioPacket(packet);
 }
 
 static void AudioDecoderThreadProc(void* context) {
     int err;
     PQUEUED_AUDIO_PACKET packet;
 
+    if (jitterBufferEnabled) {
+        AudioJitterBufferThreadProc();
+        return;
+    }
+
     while (!PltIsThreadInterrupted(&decoderThread)) {
-        err = LbqWaitForQueueElement(&packetQueue, (void**)&packet);
+        err = LfqWaitForQueueElement(&packetQueue, (void**)&packet);
         if (err != LBQ_SUCCESS) {
             // An exit signal was received
             return;
@@ -392,7 +699,7 @@ static void AudioDecoderThreadProc(void* context) {
 
         decodeInputData(packet);
 
-        free(packet);
+        freeAudioPacket(packet);
     }
 }
 
@@ -405,8 +712,8 @@ void stopAudioStream(void) {
 
     PltInterruptThread(&receiveThread);
     if ((AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {        
-        // Signal threads waiting on the LBQ
-        LbqSignalQueueShutdown(&packetQueue);
+        // Signal threads waiting on the packet queue
+        LfqSignalQueueShutdown(&packetQueue);
         PltInterruptThread(&decoderThread);
     }
     
@@ -436,6 +743,12 @@ int startAudioStream(void* audioContext, int arFlags) {
 
     chosenConfig.samplesPerFrame = 48 * AudioPacketDuration;
 
+    // The FEC block arena is sized by the negotiated packet duration
+    err = RtpaAllocateBlockArena(&rtpAudioQueue, AudioPacketDuration);
+    if (err != 0) {
+        return err;
+    }
+
     err = AudioCallbacks.init(StreamConfig.audioConfiguration, &chosenConfig, audioContext, arFlags);
     if (err != 0) {
         return err;
@@ -466,10 +779,64 @@ int startAudioStream(void* audioContext, int arFlags) {
     return 0;
 }
 
+// Prepares an initialized audio stream to be fed captured packets with replayAudioPacket()
+// instead of being started. Only the decodeAndPlaySample() renderer callback is invoked,
+// so the renderer must use CAPABILITY_DIRECT_SUBMIT.
+int prepareAudioReplay(void) {
+    LC_ASSERT(AudioCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT);
+
+    return RtpaAllocateBlockArena(&rtpAudioQueue, AudioPacketDuration);
+}
+
+// Feeds a captured packet through the same path as the receive thread. The RTP header must be
+// in network byte order, as it was captured. This must only be called from a single thread.
+void replayAudioPacket(const void* data, int length) {
+    PQUEUED_AUDIO_PACKET packet;
+
+    if (length < (int)sizeof(RTP_PACKET) || length > MAX_PACKET_SIZE) {
+        return;
+    }
+
+    packet = allocAudioPacket();
+    if (packet == NULL) {
+        return;
+    }
+
+    memcpy(&packet->data[0], data, length);
+    packet->header.size = length;
+
+    queueReceivedAudioPacket(&packet);
+    freeAudioPacket(packet);
+}
+
 int LiGetPendingAudioFrames(void) {
-    return LbqGetItemCount(&packetQueue);
+    return LfqGetItemCount(&packetQueue);
+}
+
+bool LiGetAudioPacketPoolStats(PPACKET_POOL_STATS stats) {
+    if (!packetPoolInitialized) {
+        return false;
+    }
+
+    PktPoolGetStats(&packetPool, &stats->hits, &stats->misses, &stats->totalBuffers);
+    return true;
 }
 
 int LiGetPendingAudioDuration(void) {
     return LiGetPendingAudioFrames() * AudioPacketDuration;
 }
+
+void LiSetAudioJitterBufferLatency(int minTargetMs, int maxTargetMs) {
+    jitterBufferMinTargetMs = minTargetMs;
+    jitterBufferMaxTargetMs = maxTargetMs;
+}
+
+bool LiGetAudioJitterBufferStats(PAUDIO_JITTER_BUFFER_STATS stats) {
+    if (!jitterBufferStatsValid) {
+        return false;
+    }
+
+    memcpy(stats, &jitterBufferStats, sizeof(*stats));
+    stats->queueOverflows = packetQueueOverflows;
+    return true;
+}
@@ -318,15 +318,8 @@ int initializeControlStream(void) {
         }
     }
 
-    lastGoodFrame = 0;
-    lastSeenFrame = 0;
+    resetControlStreamFrameStats();
     disconnectPending = false;
-    intervalGoodFrameCount = 0;
-    intervalTotalFrameCount = 0;
-    intervalStartTimeMs = 0;
-    lastIntervalLossPercentage = 0;
-    lastConnectionStatusUpdate = CONN_STATUS_OKAY;
-    firstFrameTimeMs = 0;
     currentEnetSequenceNumber = 0;
     usePeriodicPing = APP_VERSION_AT_LEAST(7, 1, 415);
     encryptionCtx = PltCreateCryptoContext();
@@ -337,6 +330,18 @@ int initializeControlStream(void) {
     return 0;
 }
 
+// Forgets the frames seen so far, so a replayed video stream can start over from the first frame
+void resetControlStreamFrameStats(void) {
+    lastGoodFrame = 0;
+    lastSeenFrame = 0;
+    intervalGoodFrameCount = 0;
+    intervalTotalFrameCount = 0;
+    intervalStartTimeMs = 0;
+    lastIntervalLossPercentage = 0;
+    lastConnectionStatusUpdate = CONN_STATUS_OKAY;
+    firstFrameTimeMs = 0;
+}
+
 static void freeBasicLbqList(PLINKED_BLOCKING_QUEUE_ENTRY entry) {
     PLINKED_BLOCKING_QUEUE_ENTRY nextEntry;
 
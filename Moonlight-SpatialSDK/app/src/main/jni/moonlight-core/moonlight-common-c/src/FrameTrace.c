@@ -0,0 +1,131 @@
+#include "Limelight-internal.h"
+
+// Each frame has a fixed slot in the history based on its frame number, so
+// the stages of a frame can be recorded from any thread without any locking
+// or allocation. A slot is claimed by the first packet of a frame, and later
+// stages are only recorded if the slot still belongs to that frame.
+//
+// This is best-effort by design. A snapshot racing with a writer may see a
+// partially updated record, but that just skews a single sample.
+typedef struct _FRAME_TRACE_RECORD {
+    uint32_t frameNumber;
+    uint32_t stageMask;
+    uint64_t firstPacketTimeUs;
+
+    // Offset of each stage from the first packet
+    uint32_t stageOffsetUs[FRAME_TRACE_STAGE_COUNT];
+} FRAME_TRACE_RECORD, *PFRAME_TRACE_RECORD;
+
+static volatile FRAME_TRACE_RECORD traceHistory[FRAME_TRACE_HISTORY];
+
+void FtInitialize(void) {
+    for (int i = 0; i < FRAME_TRACE_HISTORY; i++) {
+        traceHistory[i].stageMask = 0;
+    }
+}
+
+void FtRecordFrameStage(uint32_t frameNumber, int stage, uint64_t timeUs) {
+    volatile FRAME_TRACE_RECORD* record = &traceHistory[frameNumber & (FRAME_TRACE_HISTORY - 1)];
+
+    if (stage < 0 || stage >= FRAME_TRACE_STAGE_COUNT) {
+        LC_ASSERT(false);
+        return;
+    }
+
+    if (stage == FRAME_TRACE_FIRST_PACKET) {
+        // Invalidate the old record before reusing the slot
+        record->stageMask = 0;
+        record->frameNumber = frameNumber;
+        record->firstPacketTimeUs = timeUs;
+        record->stageOffsetUs[FRAME_TRACE_FIRST_PACKET] = 0;
+        record->stageMask = 1 << FRAME_TRACE_FIRST_PACKET;
+    }
+    else if (record->frameNumber == frameNumber && (record->stageMask & (1 << FRAME_TRACE_FIRST_PACKET))) {
+        uint64_t offsetUs = timeUs > record->firstPacketTimeUs ? timeUs - record->firstPacketTimeUs : 0;
+
+        record->stageOffsetUs[stage] = offsetUs > UINT32_MAX ? UINT32_MAX : (uint32_t)offsetUs;
+        record->stageMask |= 1 << stage;
+    }
+}
+
+void LiTraceVideoFrame(unsigned int frameNumber, int stage) {
+    FtRecordFrameStage(frameNumber, stage, PltGetMicros());
+}
+
+static int compareSamples(const void* a, const void* b) {
+    uint32_t sampleA = *(const uint32_t*)a;
+    uint32_t sampleB = *(const uint32_t*)b;
+
+    return sampleA < sampleB ? -1 : (sampleA > sampleB ? 1 : 0);
+}
+
+// Samples must be sorted
+static uint32_t getPercentile(uint32_t* samples, uint32_t count, uint32_t percentile) {
+    if (count == 0) {
+        return 0;
+    }
+
+    return samples[(uint64_t)(count - 1) * percentile / 100];
+}
+
+bool LiGetFrameTraceStats(PFRAME_TRACE_STATS stats) {
+    uint32_t* stageSamples;
+    uint32_t* totalSamples;
+    bool tracedFrame = false;
+
+    memset(stats, 0, sizeof(*stats));
+
+    stageSamples = malloc(sizeof(*stageSamples) * FRAME_TRACE_STAGE_COUNT * FRAME_TRACE_HISTORY * 2);
+    if (stageSamples == NULL) {
+        return false;
+    }
+    totalSamples = &stageSamples[FRAME_TRACE_STAGE_COUNT * FRAME_TRACE_HISTORY];
+
+    for (int i = 0; i < FRAME_TRACE_HISTORY; i++) {
+        FRAME_TRACE_RECORD record;
+
+        record.frameNumber = traceHistory[i].frameNumber;
+        record.stageMask = traceHistory[i].stageMask;
+        for (int stage = 0; stage < FRAME_TRACE_STAGE_COUNT; stage++) {
+            record.stageOffsetUs[stage] = traceHistory[i].stageOffsetUs[stage];
+        }
+
+        // Skip records that are empty or were reused while we were reading them
+        if (!(record.stageMask & (1 << FRAME_TRACE_FIRST_PACKET)) || record.frameNumber != traceHistory[i].frameNumber) {
+            continue;
+        }
+
+        tracedFrame = true;
+
+        uint32_t previousOffsetUs = 0;
+        for (int stage = 0; stage < FRAME_TRACE_STAGE_COUNT; stage++) {
+            if (!(record.stageMask & (1 << stage))) {
+                continue;
+            }
+
+            uint32_t offsetUs = record.stageOffsetUs[stage];
+            uint32_t count = stats->frameCount[stage]++;
+
+            stageSamples[stage * FRAME_TRACE_HISTORY + count] = offsetUs > previousOffsetUs ? offsetUs - previousOffsetUs : 0;
+            totalSamples[stage * FRAME_TRACE_HISTORY + count] = offsetUs;
+            previousOffsetUs = offsetUs;
+        }
+    }
+
+    for (int stage = 0; stage < FRAME_TRACE_STAGE_COUNT; stage++) {
+        uint32_t* stageSorted = &stageSamples[stage * FRAME_TRACE_HISTORY];
+        uint32_t* totalSorted = &totalSamples[stage * FRAME_TRACE_HISTORY];
+        uint32_t count = stats->frameCount[stage];
+
+        qsort(stageSorted, count, sizeof(*stageSorted), compareSamples);
+        qsort(totalSorted, count, sizeof(*totalSorted), compareSamples);
+
+        stats->stageP50Us[stage] = getPercentile(stageSorted, count, 50);
+        stats->stageP99Us[stage] = getPercentile(stageSorted, count, 99);
+        stats->totalP50Us[stage] = getPercentile(totalSorted, count, 50);
+        stats->totalP99Us[stage] = getPercentile(totalSorted, count, 99);
+    }
+
+    free(stageSamples);
+    return tracedFrame;
+}
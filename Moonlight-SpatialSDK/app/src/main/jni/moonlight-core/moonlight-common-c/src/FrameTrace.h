@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Limelight.h"
+#include "Platform.h"
+
+// Number of most recent frames kept in the trace history (must be a power of 2)
+#define FRAME_TRACE_HISTORY 512
+
+void FtInitialize(void);
+void FtRecordFrameStage(uint32_t frameNumber, int stage, uint64_t timeUs);
@@ -55,9 +55,12 @@ static struct {
 // per millisecond, we'll wait a little bit to try to batch with
 // the next one. This batching wait paradoxically _decreases_
 // effective input latency by avoiding packet queuing in ENet.
-#define CONTROLLER_BATCHING_INTERVAL_MS 1
-#define MOUSE_BATCHING_INTERVAL_MS 1
-#define PEN_BATCHING_INTERVAL_MS 1
+//
+// The wait is tracked per control stream channel, so batching one
+// device never holds up input from another.
+#define CONTROLLER_BATCHING_INTERVAL_US 1000
+#define MOUSE_BATCHING_INTERVAL_US 1000
+#define PEN_BATCHING_INTERVAL_US 1000
 
 // Don't batch up/down/cancel events
 #define TOUCH_EVENT_IS_BATCHABLE(x) ((x) == LI_TOUCH_EVENT_HOVER || (x) == LI_TOUCH_EVENT_MOVE)
@@ -65,6 +68,7 @@ static struct {
 // Contains input stream packets
 typedef struct _PACKET_HOLDER {
     LINKED_BLOCKING_QUEUE_ENTRY entry;
+    struct _PACKET_HOLDER* nextDeferred;
     uint32_t enetPacketFlags;
     uint8_t channelId;
 
@@ -92,6 +96,24 @@ typedef struct _PACKET_HOLDER {
     } packet;
 } PACKET_HOLDER, *PPACKET_HOLDER;
 
+// Packets waiting on a control stream channel for its batching interval to
+// elapse. Anything else sent on the channel queues up behind them to keep
+// the channel in order. Only accessed by the input send thread.
+typedef struct _INPUT_CHANNEL_STATE {
+    PPACKET_HOLDER deferredHead;
+    PPACKET_HOLDER deferredTail;
+    uint64_t lastBatchedSendTimeUs;
+} INPUT_CHANNEL_STATE, *PINPUT_CHANNEL_STATE;
+
+static INPUT_CHANNEL_STATE inputChannelState[CTRL_CHANNEL_COUNT];
+static int deferredInputPacketCount;
+
+// Set when the last packet was sent with moreData, so ENet may be holding it
+static bool inputFlushPending;
+
+static uint32_t multiControllerMagicLE;
+static uint32_t relMouseMagicLE;
+
 // Initializes the input stream
 int initializeInputStream(void) {
     memcpy(currentAesIv, StreamConfig.remoteInputAesIv, sizeof(currentAesIv));
@@ -303,6 +325,7 @@ static bool sendInputPacket(PPACKET_HOLDER holder, bool moreData) {
         }
     }
 
+    inputFlushPending = moreData;
     return true;
 }
 
@@ -319,346 +342,448 @@ static void floatToNetfloat(float in, netfloat out) {
     }
 }
 
-// Input thread proc
-static void inputSendThreadProc(void* context) {
-    SOCK_RET err;
-    PPACKET_HOLDER holder;
-    uint32_t multiControllerMagicLE;
-    uint32_t relMouseMagicLE;
-
-    if (AppVersionQuad[0] >= 5) {
-        multiControllerMagicLE = LE32(MULTI_CONTROLLER_MAGIC_GEN5);
-        relMouseMagicLE = LE32(MOUSE_MOVE_REL_MAGIC_GEN5);
+// Returns the minimum spacing between packets of this type on its channel, or 0 if it is sent as-is
+static uint32_t getBatchingIntervalUs(PPACKET_HOLDER holder) {
+    if (holder->packet.header.magic == multiControllerMagicLE) {
+        return CONTROLLER_BATCHING_INTERVAL_US;
+    }
+    else if (holder->packet.header.magic == relMouseMagicLE ||
+             holder->packet.header.magic == LE32(MOUSE_MOVE_ABS_MAGIC)) {
+        return MOUSE_BATCHING_INTERVAL_US;
+    }
+    else if (holder->packet.header.magic == LE32(SS_PEN_MAGIC) && TOUCH_EVENT_IS_BATCHABLE(holder->packet.pen.eventType)) {
+        return PEN_BATCHING_INTERVAL_US;
     }
     else {
-        multiControllerMagicLE = LE32(MULTI_CONTROLLER_MAGIC);
-        relMouseMagicLE = LE32(MOUSE_MOVE_REL_MAGIC);
+        return 0;
     }
+}
 
-    uint64_t lastControllerPacketTime[MAX_GAMEPADS] = { 0 };
-    uint64_t lastMousePacketTime = 0;
-    uint64_t lastPenPacketTime = 0;
+// Returns true if the newer packet can be folded into the older one without losing anything
+static bool canBatchInputPackets(PPACKET_HOLDER holder, PPACKET_HOLDER newHolder) {
+    if (holder->packet.header.magic != newHolder->packet.header.magic) {
+        return false;
+    }
 
-    while (!PltIsThreadInterrupted(&inputSendThread)) {
-        err = LbqWaitForQueueElement(&packetQueue, (void**)&holder);
-        if (err != LBQ_SUCCESS) {
-            return;
-        }
+    if (holder->packet.header.magic == multiControllerMagicLE) {
+        PNV_MULTI_CONTROLLER_PACKET origPkt = &holder->packet.multiController;
+        PNV_MULTI_CONTROLLER_PACKET newPkt = &newHolder->packet.multiController;
 
-        // If it's a multi-controller packet we can do batching
-        if (holder->packet.header.magic == multiControllerMagicLE) {
-            PPACKET_HOLDER controllerBatchHolder;
-            PNV_MULTI_CONTROLLER_PACKET origPkt;
-            short controllerNumber = LE16(holder->packet.multiController.controllerNumber);
-            uint64_t now = PltGetMillis();
+        // NB: GFE does some discarding of gamepad packets received very soon after another.
+        // Thus, this batching is needed for correctness in some cases, as GFE will inexplicably
+        // drop *newer* packets in that scenario. The brokenness can be tested with consecutive
+        // calls to LiSendMultiControllerEvent() with different values for analog sticks (max -> zero).
+        return newPkt->buttonFlags == origPkt->buttonFlags &&
+               newPkt->buttonFlags2 == origPkt->buttonFlags2 &&
+               newPkt->controllerNumber == origPkt->controllerNumber &&
+               newPkt->activeGamepadMask == origPkt->activeGamepadMask;
+    }
+    else if (holder->packet.header.magic == LE32(SS_PEN_MAGIC)) {
+        // We only send the latest move or hover event, as long as the buttons haven't changed
+        return TOUCH_EVENT_IS_BATCHABLE(holder->packet.pen.eventType) &&
+               holder->packet.pen.penButtons == newHolder->packet.pen.penButtons &&
+               holder->packet.pen.eventType == newHolder->packet.pen.eventType;
+    }
 
-            LC_ASSERT(controllerNumber < MAX_GAMEPADS);
+    // Mouse motion doesn't need this since it only ever has one packet
+    // holder queued and the latest state is populated when it is sent.
+    return false;
+}
 
-            // Delay for batching if required
-            if (now < lastControllerPacketTime[controllerNumber] + CONTROLLER_BATCHING_INTERVAL_MS) {
-                flushInputOnControlStream();
-                PltSleepMs((int)(lastControllerPacketTime[controllerNumber] + CONTROLLER_BATCHING_INTERVAL_MS - now));
-                now = PltGetMillis();
-            }
+static void batchInputPackets(PPACKET_HOLDER holder, PPACKET_HOLDER newHolder) {
+    if (holder->packet.header.magic == multiControllerMagicLE) {
+        PNV_MULTI_CONTROLLER_PACKET origPkt = &holder->packet.multiController;
+        PNV_MULTI_CONTROLLER_PACKET newPkt = &newHolder->packet.multiController;
 
-            origPkt = &holder->packet.multiController;
-            for (;;) {
-                PNV_MULTI_CONTROLLER_PACKET newPkt;
+        origPkt->leftTrigger = newPkt->leftTrigger;
+        origPkt->rightTrigger = newPkt->rightTrigger;
+        origPkt->leftStickX = newPkt->leftStickX;
+        origPkt->leftStickY = newPkt->leftStickY;
+        origPkt->rightStickX = newPkt->rightStickX;
+        origPkt->rightStickY = newPkt->rightStickY;
+    }
+    else {
+        LC_ASSERT(holder->packet.header.magic == LE32(SS_PEN_MAGIC));
+        holder->packet.pen = newHolder->packet.pen;
+    }
+}
 
-                // Peek at the next packet
-                if (LbqPeekQueueElement(&packetQueue, (void**)&controllerBatchHolder) != LBQ_SUCCESS) {
-                    break;
-                }
+// Sends the packet in the holder and frees it. Returns false if the connection is dead.
+static bool sendQueuedInputPacket(PPACKET_HOLDER holder) {
+    // If it's a relative mouse move packet, send the accumulated delta
+    if (holder->packet.header.magic == relMouseMagicLE) {
+        PltLockMutex(&batchedInputMutex);
 
-                // If it's not a controller packet, we're done
-                if (controllerBatchHolder->packet.header.magic != multiControllerMagicLE) {
-                    break;
-                }
+        // Send as many packets as it takes to get the entire delta through
+        while (currentRelativeMouseState.deltaX != 0 || currentRelativeMouseState.deltaY != 0) {
+            bool more = false;
 
-                // Check if it's able to be batched
-                // NB: GFE does some discarding of gamepad packets received very soon after another.
-                // Thus, this batching is needed for correctness in some cases, as GFE will inexplicably
-                // drop *newer* packets in that scenario. The brokenness can be tested with consecutive
-                // calls to LiSendMultiControllerEvent() with different values for analog sticks (max -> zero).
-                newPkt = &controllerBatchHolder->packet.multiController;
-                if (newPkt->buttonFlags != origPkt->buttonFlags ||
-                    newPkt->buttonFlags2 != origPkt->buttonFlags2 ||
-                    newPkt->controllerNumber != origPkt->controllerNumber ||
-                    newPkt->activeGamepadMask != origPkt->activeGamepadMask) {
-                    // Batching not allowed
-                    break;
-                }
+            if (currentRelativeMouseState.deltaX < INT16_MIN) {
+                holder->packet.mouseMoveRel.deltaX = BE16(INT16_MIN);
+                currentRelativeMouseState.deltaX -= INT16_MIN;
+                more = true;
+            }
+            else if (currentRelativeMouseState.deltaX > INT16_MAX) {
+                holder->packet.mouseMoveRel.deltaX = BE16(INT16_MAX);
+                currentRelativeMouseState.deltaX -= INT16_MAX;
+                more = true;
+            }
+            else {
+                holder->packet.mouseMoveRel.deltaX = BE16(currentRelativeMouseState.deltaX);
+                currentRelativeMouseState.deltaX = 0;
+            }
 
-                // Remove the batchable controller packet
-                if (LbqPollQueueElement(&packetQueue, (void**)&controllerBatchHolder) != LBQ_SUCCESS) {
-                    break;
-                }
+            if (currentRelativeMouseState.deltaY < INT16_MIN) {
+                holder->packet.mouseMoveRel.deltaY = BE16(INT16_MIN);
+                currentRelativeMouseState.deltaY -= INT16_MIN;
+                more = true;
+            }
+            else if (currentRelativeMouseState.deltaY > INT16_MAX) {
+                holder->packet.mouseMoveRel.deltaY = BE16(INT16_MAX);
+                currentRelativeMouseState.deltaY -= INT16_MAX;
+                more = true;
+            }
+            else {
+                holder->packet.mouseMoveRel.deltaY = BE16(currentRelativeMouseState.deltaY);
+                currentRelativeMouseState.deltaY = 0;
+            }
 
-                // Update the original packet
-                origPkt->leftTrigger = newPkt->leftTrigger;
-                origPkt->rightTrigger = newPkt->rightTrigger;
-                origPkt->leftStickX = newPkt->leftStickX;
-                origPkt->leftStickY = newPkt->leftStickY;
-                origPkt->rightStickX = newPkt->rightStickX;
-                origPkt->rightStickY = newPkt->rightStickY;
+            // Don't hold the batching lock while we're doing network I/O
+            PltUnlockMutex(&batchedInputMutex);
 
-                // Free the batched packet holder
-                freePacketHolder(controllerBatchHolder);
+            // Encrypt and send the split packet
+            if (!sendInputPacket(holder, more)) {
+                freePacketHolder(holder);
+                return false;
             }
 
-            lastControllerPacketTime[controllerNumber] = now;
+            PltLockMutex(&batchedInputMutex);
         }
-        // If it's a relative mouse move packet, we can also do batching
-        else if (holder->packet.header.magic == relMouseMagicLE) {
-            uint64_t now = PltGetMillis();
-
-            // Delay for batching if required
-            if (now < lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS) {
-                flushInputOnControlStream();
-                PltSleepMs((int)(lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS - now));
-                now = PltGetMillis();
-            }
 
-            PltLockMutex(&batchedInputMutex);
+        // The state change is no longer pending
+        currentRelativeMouseState.dirty = false;
 
-            // Send as many packets as it takes to get the entire delta through
-            while (currentRelativeMouseState.deltaX != 0 || currentRelativeMouseState.deltaY != 0) {
-                bool more = false;
+        PltUnlockMutex(&batchedInputMutex);
 
-                if (currentRelativeMouseState.deltaX < INT16_MIN) {
-                    holder->packet.mouseMoveRel.deltaX = BE16(INT16_MIN);
-                    currentRelativeMouseState.deltaX -= INT16_MIN;
-                    more = true;
-                }
-                else if (currentRelativeMouseState.deltaX > INT16_MAX) {
-                    holder->packet.mouseMoveRel.deltaX = BE16(INT16_MAX);
-                    currentRelativeMouseState.deltaX -= INT16_MAX;
-                    more = true;
-                }
-                else {
-                    holder->packet.mouseMoveRel.deltaX = BE16(currentRelativeMouseState.deltaX);
-                    currentRelativeMouseState.deltaX = 0;
-                }
+        // We sent everything we needed in the loop above, so we can just free the
+        // holder of the original packet and wait for another input event.
+        freePacketHolder(holder);
+        return true;
+    }
+    // If it's an absolute mouse move packet, we should only send the latest
+    else if (holder->packet.header.magic == LE32(MOUSE_MOVE_ABS_MAGIC)) {
+        PltLockMutex(&batchedInputMutex);
 
-                if (currentRelativeMouseState.deltaY < INT16_MIN) {
-                    holder->packet.mouseMoveRel.deltaY = BE16(INT16_MIN);
-                    currentRelativeMouseState.deltaY -= INT16_MIN;
-                    more = true;
-                }
-                else if (currentRelativeMouseState.deltaY > INT16_MAX) {
-                    holder->packet.mouseMoveRel.deltaY = BE16(INT16_MAX);
-                    currentRelativeMouseState.deltaY -= INT16_MAX;
-                    more = true;
-                }
-                else {
-                    holder->packet.mouseMoveRel.deltaY = BE16(currentRelativeMouseState.deltaY);
-                    currentRelativeMouseState.deltaY = 0;
-                }
+        // Populate the packet with the latest state
+        holder->packet.mouseMoveAbs.x = BE16(currentAbsoluteMouseState.x);
+        holder->packet.mouseMoveAbs.y = BE16(currentAbsoluteMouseState.y);
 
-                // Don't hold the batching lock while we're doing network I/O
-                PltUnlockMutex(&batchedInputMutex);
+        // There appears to be a rounding error in GFE's scaling calculation which prevents
+        // the cursor from reaching the far edge of the screen when streaming at smaller
+        // resolutions with a higher desktop resolution (like streaming 720p with a desktop
+        // resolution of 1080p, or streaming 720p/1080p with a desktop resolution of 4K).
+        // Subtracting one from the reference dimensions seems to work around this issue.
+        holder->packet.mouseMoveAbs.width = BE16(currentAbsoluteMouseState.width - 1);
+        holder->packet.mouseMoveAbs.height = BE16(currentAbsoluteMouseState.height - 1);
 
-                // Encrypt and send the split packet
-                if (!sendInputPacket(holder, more)) {
-                    freePacketHolder(holder);
-                    return;
-                }
+        // The state change is no longer pending
+        currentAbsoluteMouseState.dirty = false;
 
-                PltLockMutex(&batchedInputMutex);
-            }
+        PltUnlockMutex(&batchedInputMutex);
+    }
+    // If it's a motion packet, only send the latest for each sensor type
+    else if (holder->packet.header.magic == LE32(SS_CONTROLLER_MOTION_MAGIC)) {
+        uint8_t controllerNumber = holder->packet.controllerMotion.controllerNumber;
+        uint8_t motionType = holder->packet.controllerMotion.motionType;
 
-            // The state change is no longer pending
-            currentRelativeMouseState.dirty = false;
+        LC_ASSERT(controllerNumber < MAX_GAMEPADS);
+        LC_ASSERT(motionType - 1 < MAX_MOTION_EVENTS);
 
-            PltUnlockMutex(&batchedInputMutex);
+        PltLockMutex(&batchedInputMutex);
 
-            lastMousePacketTime = now;
+        // LI_MOTION_TYPE_* values are 1-based, so we have to subtract 1 to index into our state array
+        float x = currentGamepadSensorState[controllerNumber][motionType - 1].x;
+        float y = currentGamepadSensorState[controllerNumber][motionType - 1].y;
+        float z = currentGamepadSensorState[controllerNumber][motionType - 1].z;
 
-            // We sent everything we needed in the loop above, so we can just free the
-            // holder of the original packet and wait for another input event.
-            freePacketHolder(holder);
-            continue;
+        // Motion events are so rapid that we can just drop any events that are lost in transit,
+        // but we will treat (0, 0, 0) as a special value for gyro events to allow clients to
+        // reliably set the gyro to a null state when sensor events are halted due to focus loss
+        // or similar client-side constraints.
+        if (motionType == LI_MOTION_TYPE_GYRO && x == 0.0f && y == 0.0f && z == 0.0f) {
+            holder->enetPacketFlags = ENET_PACKET_FLAG_RELIABLE;
         }
-        // If it's an absolute mouse move packet, we should only send the latest
-        else if (holder->packet.header.magic == LE32(MOUSE_MOVE_ABS_MAGIC)) {
-            uint64_t now = PltGetMillis();
-
-            // Delay for batching if required
-            if (now < lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS) {
-                flushInputOnControlStream();
-                PltSleepMs((int)(lastMousePacketTime + MOUSE_BATCHING_INTERVAL_MS - now));
-                now = PltGetMillis();
+        else {
+            holder->enetPacketFlags = 0;
+        }
+
+        // Populate the packet with the latest state
+        floatToNetfloat(x, holder->packet.controllerMotion.x);
+        floatToNetfloat(y, holder->packet.controllerMotion.y);
+        floatToNetfloat(z, holder->packet.controllerMotion.z);
+
+        // The state change is no longer pending
+        currentGamepadSensorState[controllerNumber][motionType - 1].dirty = false;
+
+        PltUnlockMutex(&batchedInputMutex);
+    }
+    // If it's a UTF-8 text packet, we may need to split it into a several packets to send
+    else if (holder->packet.header.magic == LE32(UTF8_TEXT_EVENT_MAGIC)) {
+        PACKET_HOLDER splitPacket;
+        uint32_t totalLength = PAYLOAD_SIZE(holder) - sizeof(uint32_t);
+        uint32_t i = 0;
+
+        // HACK: This is a workaround for the fact that GFE doesn't appear to synchronize keyboard
+        // and UTF-8 text events with each other. We need to make sure any previous keyboard events
+        // have been processed prior to sending these UTF-8 events to avoid interference between
+        // the two (especially with modifier keys).
+        flushInputOnControlStream();
+        while (!PltIsThreadInterrupted(&inputSendThread) && isControlDataInTransit()) {
+            PltSleepMs(10);
+        }
+
+        // Finally, sleep an additional 50 ms to allow the events to be processed by Windows
+        PltSleepMs(50);
+
+        // We send each Unicode code point individually. This way we can always ensure they will
+        // never straddle a packet boundary (which will cause a parsing error on the host).
+        while (i < totalLength && !PltIsThreadInterrupted(&inputSendThread)) {
+            uint32_t codePointLength;
+            uint8_t firstByte = (uint8_t)holder->packet.unicode.text[i];
+            if ((firstByte & 0x80) == 0x00) {
+                // 1 byte code point
+                codePointLength = 1;
+            }
+            else if ((firstByte & 0xE0) == 0xC0) {
+                // 2 byte code point
+                codePointLength = 2;
+            }
+            else if ((firstByte & 0xF0) == 0xE0) {
+                // 3 byte code point
+                codePointLength = 3;
+            }
+            else if ((firstByte & 0xF8) == 0xF0) {
+                // 4 byte code point
+                codePointLength = 4;
+            }
+            else {
+                Limelog("Invalid unicode code point starting byte: %02x\n", firstByte);
+                break;
             }
 
-            PltLockMutex(&batchedInputMutex);
+            // Use the original packet as a template and fixup to send one code point at a time
+            splitPacket = *holder;
+            splitPacket.packet.unicode.header.size = BE32(sizeof(uint32_t) + codePointLength);
+            memcpy(splitPacket.packet.unicode.text, &holder->packet.unicode.text[i], codePointLength);
 
-            // Populate the packet with the latest state
-            holder->packet.mouseMoveAbs.x = BE16(currentAbsoluteMouseState.x);
-            holder->packet.mouseMoveAbs.y = BE16(currentAbsoluteMouseState.y);
+            // Encrypt and send the split packet
+            if (!sendInputPacket(&splitPacket, i + 1 < totalLength)) {
+                freePacketHolder(holder);
+                return false;
+            }
 
-            // There appears to be a rounding error in GFE's scaling calculation which prevents
-            // the cursor from reaching the far edge of the screen when streaming at smaller
-            // resolutions with a higher desktop resolution (like streaming 720p with a desktop
-            // resolution of 1080p, or streaming 720p/1080p with a desktop resolution of 4K).
-            // Subtracting one from the reference dimensions seems to work around this issue.
-            holder->packet.mouseMoveAbs.width = BE16(currentAbsoluteMouseState.width - 1);
-            holder->packet.mouseMoveAbs.height = BE16(currentAbsoluteMouseState.height - 1);
+            i += codePointLength;
+        }
 
-            // The state change is no longer pending
-            currentAbsoluteMouseState.dirty = false;
+        freePacketHolder(holder);
+        return true;
+    }
 
-            PltUnlockMutex(&batchedInputMutex);
+    // Encrypt and send the input packet
+    if (!sendInputPacket(holder, LbqGetItemCount(&packetQueue) > 0)) {
+        freePacketHolder(holder);
+        return false;
+    }
 
-            lastMousePacketTime = now;
-        }
-        // If it's a pen packet, we should only send the latest move or hover events
-        else if (holder->packet.header.magic == LE32(SS_PEN_MAGIC) && TOUCH_EVENT_IS_BATCHABLE(holder->packet.pen.eventType)) {
-            uint64_t now = PltGetMillis();
-
-            // Delay for batching if required
-            if (now < lastPenPacketTime + PEN_BATCHING_INTERVAL_MS) {
-                flushInputOnControlStream();
-                PltSleepMs((int)(lastPenPacketTime + PEN_BATCHING_INTERVAL_MS - now));
-                now = PltGetMillis();
-            }
+    freePacketHolder(holder);
+    return true;
+}
 
-            for (;;) {
-                PPACKET_HOLDER penBatchHolder;
+static void deferInputPacket(PINPUT_CHANNEL_STATE channel, PPACKET_HOLDER holder) {
+    holder->nextDeferred = NULL;
+    if (channel->deferredTail != NULL) {
+        channel->deferredTail->nextDeferred = holder;
+    }
+    else {
+        channel->deferredHead = holder;
+    }
+    channel->deferredTail = holder;
+    deferredInputPacketCount++;
+}
 
-                // Peek at the next packet
-                if (LbqPeekQueueElement(&packetQueue, (void**)&penBatchHolder) != LBQ_SUCCESS) {
-                    break;
-                }
+static bool sendChannelInputPacket(PINPUT_CHANNEL_STATE channel, PPACKET_HOLDER holder, uint64_t nowUs) {
+    if (getBatchingIntervalUs(holder) != 0) {
+        channel->lastBatchedSendTimeUs = nowUs;
+    }
 
-                // If it's not a pen packet, we're done
-                if (penBatchHolder->packet.header.magic != LE32(SS_PEN_MAGIC)) {
-                    break;
-                }
+    return sendQueuedInputPacket(holder);
+}
 
-                // If the buttons or event type is different, we cannot batch
-                if (holder->packet.pen.penButtons != penBatchHolder->packet.pen.penButtons ||
-                    holder->packet.pen.eventType != penBatchHolder->packet.pen.eventType) {
-                    break;
-                }
+// Handles a packet just taken off the input queue by either sending it or deferring it
+// until its channel's batching interval has elapsed.
+static bool processInputPacket(PPACKET_HOLDER holder, uint64_t nowUs) {
+    PINPUT_CHANNEL_STATE channel;
+    uint32_t batchingIntervalUs;
 
-                // Remove the next packet
-                if (LbqPollQueueElement(&packetQueue, (void**)&penBatchHolder) != LBQ_SUCCESS) {
-                    break;
-                }
+    LC_ASSERT(holder->channelId < CTRL_CHANNEL_COUNT);
+    channel = &inputChannelState[holder->channelId];
 
-                // Replace the current packet with the new one
-                freePacketHolder(holder);
-                holder = penBatchHolder;
-            }
+    // Fold any directly following packets into this one
+    for (;;) {
+        PPACKET_HOLDER batchHolder;
 
-            lastPenPacketTime = now;
+        // Peek at the next packet
+        if (LbqPeekQueueElement(&packetQueue, (void**)&batchHolder) != LBQ_SUCCESS) {
+            break;
         }
-        // If it's a motion packet, only send the latest for each sensor type
-        else if (holder->packet.header.magic == LE32(SS_CONTROLLER_MOTION_MAGIC)) {
-            uint8_t controllerNumber = holder->packet.controllerMotion.controllerNumber;
-            uint8_t motionType = holder->packet.controllerMotion.motionType;
 
-            LC_ASSERT(controllerNumber < MAX_GAMEPADS);
-            LC_ASSERT(motionType - 1 < MAX_MOTION_EVENTS);
+        if (!canBatchInputPackets(holder, batchHolder)) {
+            break;
+        }
 
-            PltLockMutex(&batchedInputMutex);
+        // Remove the batchable packet
+        if (LbqPollQueueElement(&packetQueue, (void**)&batchHolder) != LBQ_SUCCESS) {
+            break;
+        }
 
-            // LI_MOTION_TYPE_* values are 1-based, so we have to subtract 1 to index into our state array
-            float x = currentGamepadSensorState[controllerNumber][motionType - 1].x;
-            float y = currentGamepadSensorState[controllerNumber][motionType - 1].y;
-            float z = currentGamepadSensorState[controllerNumber][motionType - 1].z;
-
-            // Motion events are so rapid that we can just drop any events that are lost in transit,
-            // but we will treat (0, 0, 0) as a special value for gyro events to allow clients to
-            // reliably set the gyro to a null state when sensor events are halted due to focus loss
-            // or similar client-side constraints.
-            if (motionType == LI_MOTION_TYPE_GYRO && x == 0.0f && y == 0.0f && z == 0.0f) {
-                holder->enetPacketFlags = ENET_PACKET_FLAG_RELIABLE;
-            }
-            else {
-                holder->enetPacketFlags = 0;
-            }
+        batchInputPackets(holder, batchHolder);
+        freePacketHolder(batchHolder);
+    }
+
+    // If the channel is already waiting, this packet either updates the
+    // last deferred one or must be sent after everything deferred.
+    if (channel->deferredTail != NULL) {
+        if (canBatchInputPackets(channel->deferredTail, holder)) {
+            batchInputPackets(channel->deferredTail, holder);
+            freePacketHolder(holder);
+        }
+        else {
+            deferInputPacket(channel, holder);
+        }
+        return true;
+    }
 
-            // Populate the packet with the latest state
-            floatToNetfloat(x, holder->packet.controllerMotion.x);
-            floatToNetfloat(y, holder->packet.controllerMotion.y);
-            floatToNetfloat(z, holder->packet.controllerMotion.z);
+    // Delay for batching if required
+    batchingIntervalUs = getBatchingIntervalUs(holder);
+    if (batchingIntervalUs != 0 && nowUs < channel->lastBatchedSendTimeUs + batchingIntervalUs) {
+        deferInputPacket(channel, holder);
+        return true;
+    }
 
-            // The state change is no longer pending
-            currentGamepadSensorState[controllerNumber][motionType - 1].dirty = false;
+    return sendChannelInputPacket(channel, holder, nowUs);
+}
 
-            PltUnlockMutex(&batchedInputMutex);
-        }
-        // If it's a UTF-8 text packet, we may need to split it into a several packets to send
-        else if (holder->packet.header.magic == LE32(UTF8_TEXT_EVENT_MAGIC)) {
-            PACKET_HOLDER splitPacket;
-            uint32_t totalLength = PAYLOAD_SIZE(holder) - sizeof(uint32_t);
-            uint32_t i = 0;
-
-            // HACK: This is a workaround for the fact that GFE doesn't appear to synchronize keyboard
-            // and UTF-8 text events with each other. We need to make sure any previous keyboard events
-            // have been processed prior to sending these UTF-8 events to avoid interference between
-            // the two (especially with modifier keys).
-            flushInputOnControlStream();
-            while (!PltIsThreadInterrupted(&inputSendThread) && isControlDataInTransit()) {
-                PltSleepMs(10);
-            }
+// Sends deferred packets whose batching interval has elapsed and returns the
+// time when the next deferred packet is due in nextDeadlineUs (UINT64_MAX if none)
+static bool sendDueInputPackets(uint64_t nowUs, uint64_t* nextDeadlineUs) {
+    *nextDeadlineUs = UINT64_MAX;
 
-            // Finally, sleep an additional 50 ms to allow the events to be processed by Windows
-            PltSleepMs(50);
-
-            // We send each Unicode code point individually. This way we can always ensure they will
-            // never straddle a packet boundary (which will cause a parsing error on the host).
-            while (i < totalLength && !PltIsThreadInterrupted(&inputSendThread)) {
-                uint32_t codePointLength;
-                uint8_t firstByte = (uint8_t)holder->packet.unicode.text[i];
-                if ((firstByte & 0x80) == 0x00) {
-                    // 1 byte code point
-                    codePointLength = 1;
-                }
-                else if ((firstByte & 0xE0) == 0xC0) {
-                    // 2 byte code point
-                    codePointLength = 2;
-                }
-                else if ((firstByte & 0xF0) == 0xE0) {
-                    // 3 byte code point
-                    codePointLength = 3;
-                }
-                else if ((firstByte & 0xF8) == 0xF0) {
-                    // 4 byte code point
-                    codePointLength = 4;
-                }
-                else {
-                    Limelog("Invalid unicode code point starting byte: %02x\n", firstByte);
-                    break;
-                }
+    if (deferredInputPacketCount == 0) {
+        return true;
+    }
+
+    for (int i = 0; i < CTRL_CHANNEL_COUNT; i++) {
+        PINPUT_CHANNEL_STATE channel = &inputChannelState[i];
 
-                // Use the original packet as a template and fixup to send one code point at a time
-                splitPacket = *holder;
-                splitPacket.packet.unicode.header.size = BE32(sizeof(uint32_t) + codePointLength);
-                memcpy(splitPacket.packet.unicode.text, &holder->packet.unicode.text[i], codePointLength);
+        while (channel->deferredHead != NULL) {
+            PPACKET_HOLDER holder = channel->deferredHead;
+            uint32_t batchingIntervalUs = getBatchingIntervalUs(holder);
 
-                // Encrypt and send the split packet
-                if (!sendInputPacket(&splitPacket, i + 1 < totalLength)) {
-                    freePacketHolder(holder);
-                    return;
+            if (batchingIntervalUs != 0 && nowUs < channel->lastBatchedSendTimeUs + batchingIntervalUs) {
+                if (channel->lastBatchedSendTimeUs + batchingIntervalUs < *nextDeadlineUs) {
+                    *nextDeadlineUs = channel->lastBatchedSendTimeUs + batchingIntervalUs;
                 }
+                break;
+            }
 
-                i += codePointLength;
+            channel->deferredHead = holder->nextDeferred;
+            if (channel->deferredHead == NULL) {
+                channel->deferredTail = NULL;
             }
+            deferredInputPacketCount--;
 
-            freePacketHolder(holder);
-            continue;
+            if (!sendChannelInputPacket(channel, holder, nowUs)) {
+                return false;
+            }
         }
+    }
+
+    return true;
+}
+
+static void freeDeferredInputPackets(void) {
+    for (int i = 0; i < CTRL_CHANNEL_COUNT; i++) {
+        while (inputChannelState[i].deferredHead != NULL) {
+            PPACKET_HOLDER holder = inputChannelState[i].deferredHead;
 
-        // Encrypt and send the input packet
-        if (!sendInputPacket(holder, LbqGetItemCount(&packetQueue) > 0)) {
+            inputChannelState[i].deferredHead = holder->nextDeferred;
             freePacketHolder(holder);
-            return;
         }
+        inputChannelState[i].deferredTail = NULL;
+    }
 
-        freePacketHolder(holder);
+    deferredInputPacketCount = 0;
+}
+
+// Input thread proc
+static void inputSendThreadProc(void* context) {
+    PPACKET_HOLDER holder;
+    uint64_t nextDeadlineUs;
+    int err;
+
+    if (AppVersionQuad[0] >= 5) {
+        multiControllerMagicLE = LE32(MULTI_CONTROLLER_MAGIC_GEN5);
+        relMouseMagicLE = LE32(MOUSE_MOVE_REL_MAGIC_GEN5);
     }
+    else {
+        multiControllerMagicLE = LE32(MULTI_CONTROLLER_MAGIC);
+        relMouseMagicLE = LE32(MOUSE_MOVE_REL_MAGIC);
+    }
+
+    memset(inputChannelState, 0, sizeof(inputChannelState));
+    deferredInputPacketCount = 0;
+    inputFlushPending = false;
+
+    while (!PltIsThreadInterrupted(&inputSendThread)) {
+        if (!sendDueInputPackets(PltGetMicros(), &nextDeadlineUs)) {
+            break;
+        }
+
+        // Push out anything ENet is holding for us before we block
+        if (inputFlushPending && LbqGetItemCount(&packetQueue) == 0) {
+            flushInputOnControlStream();
+            inputFlushPending = false;
+        }
+
+        if (nextDeadlineUs == UINT64_MAX) {
+            err = LbqWaitForQueueElement(&packetQueue, (void**)&holder);
+        }
+        else {
+            // Only wait until the earliest deferred packet is due
+            uint64_t nowUs = PltGetMicros();
+            if (nowUs >= nextDeadlineUs) {
+                continue;
+            }
+
+            err = LbqWaitForQueueElementTimeout(&packetQueue, (void**)&holder, (uint32_t)(nextDeadlineUs - nowUs));
+        }
+
+        if (err == LBQ_SUCCESS) {
+            if (!processInputPacket(holder, PltGetMicros())) {
+                break;
+            }
+        }
+        else if (err == LBQ_INTERRUPTED) {
+            // The queue is drained, but some packets may still be waiting on their
+            // batching interval. Send them at the usual pace before we exit.
+            while (sendDueInputPackets(PltGetMicros(), &nextDeadlineUs) && nextDeadlineUs != UINT64_MAX) {
+                PltSleepMs(1);
+            }
+            break;
+        }
+    }
+
+    freeDeferredInputPackets();
 }
 
 // This function tells GFE that we support haptics and it should send rumble events to us
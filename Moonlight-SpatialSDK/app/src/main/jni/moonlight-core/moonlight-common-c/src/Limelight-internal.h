@@ -9,6 +9,8 @@
 #include "Input.h"
 #include "RtpAudioQueue.h"
 #include "RtpVideoQueue.h"
+#include "PacketPool.h"
+#include "FrameTrace.h"
 #include "ByteBuffer.h"
 
 #include <enet/enet.h>
@@ -41,6 +43,8 @@ extern uint16_t VideoPortNumber;
 extern SS_PING AudioPingPayload;
 extern SS_PING VideoPingPayload;
 extern uint32_t ControlConnectData;
+extern PacketCaptureCallback PacketCaptureHandler;
+extern void* PacketCaptureContext;
 
 extern uint32_t SunshineFeatureFlags;
 
@@ -106,7 +110,9 @@ int gracefullyDisconnectEnetPeer(ENetHost* host, ENetPeer* peer, enet_uint32 lin
 int extractVersionQuadFromString(const char* string, int* quad);
 bool isReferenceFrameInvalidationSupportedByDecoder(void);
 bool isReferenceFrameInvalidationEnabled(void);
+bool isFecValidationEnabled(void);
 void* extendBuffer(void* ptr, size_t newSize);
+void capturePacket(int stream, const void* packet, int length);
 
 void fixupMissingCallbacks(PDECODER_RENDERER_CALLBACKS* drCallbacks, PAUDIO_RENDERER_CALLBACKS* arCallbacks,
     PCONNECTION_LISTENER_CALLBACKS* clCallbacks);
@@ -122,6 +128,7 @@ void connectionDetectedFrameLoss(uint32_t startFrame, uint32_t endFrame);
 void connectionReceivedCompleteFrame(uint32_t frameIndex);
 void connectionSawFrame(uint32_t frameIndex);
 void connectionSendFrameFecStatus(PSS_FRAME_FEC_STATUS fecStatus);
+void resetControlStreamFrameStats(void);
 int sendInputPacketOnControlStream(unsigned char* data, int length, uint8_t channelId, uint32_t flags, bool moreData);
 void flushInputOnControlStream(void);
 bool isControlDataInTransit(void);
@@ -134,18 +141,25 @@ void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntry);
 void stopVideoDepacketizer(void);
 void requestDecoderRefresh(void);
 void notifyFrameLost(unsigned int frameNumber, bool speculative);
+unsigned int getAnnexBStartSequenceLength(const char* data, unsigned int length);
+unsigned int findAnnexBStartSequence(const char* data, unsigned int length);
 
 void initializeVideoStream(void);
 void destroyVideoStream(void);
 void notifyKeyFrameReceived(void);
 int startVideoStream(void* rendererContext, int drFlags);
 void stopVideoStream(void);
+void* allocVideoPacketBuffer(void);
+void freeVideoPacketBuffer(void* buffer);
+void replayVideoPacket(const void* data, int length);
 
 int initializeAudioStream(void);
 int notifyAudioPortNegotiationComplete(void);
 void destroyAudioStream(void);
 int startAudioStream(void* audioContext, int arFlags);
 void stopAudioStream(void);
+int prepareAudioReplay(void);
+void replayAudioPacket(const void* data, int length);
 
 int initializeInputStream(void);
 void destroyInputStream(void);
@@ -165,6 +165,12 @@ typedef struct _DECODE_UNIT {
     // can be calculated by LiGetMillis() - enqueueTimeMs.
     uint64_t enqueueTimeMs;
 
+    // These are the same as receiveTimeMs and enqueueTimeMs, but in microseconds
+    // using the epoch of LiGetMicros(). They should be preferred for pacing and
+    // for presentation timestamps, since the millisecond values are truncated.
+    uint64_t receiveTimeUs;
+    uint64_t enqueueTimeUs;
+
     // Presentation time in milliseconds with the epoch at the first captured frame.
     // This can be used to aid frame pacing or to drop old frames that were queued too
     // long prior to display.
@@ -266,6 +272,15 @@ typedef struct _DECODE_UNIT {
 // supports reference frame invalidation for AV1 streams. This flag is only valid on video renderers.
 #define CAPABILITY_REFERENCE_FRAME_INVALIDATION_AV1 0x40
 
+// If set in the video renderer capabilities field, this flag specifies that the renderer wants
+// the data of each decode unit in a single contiguous buffer. The bufferList entries still
+// describe the parameter sets and picture data, but they are laid out back to back in memory,
+// so the entire frame is the fullLength bytes starting at bufferList->data. Adjacent picture
+// data is also combined into a single entry. The data is copied out of each packet as it
+// arrives, which costs an extra copy for renderers that gather the entries themselves anyway.
+// This flag is only valid on video renderers.
+#define CAPABILITY_CONTIGUOUS_DECODE_UNIT 0x80
+
 // If set in the video renderer capabilities field, this macro specifies that the renderer
 // supports slicing to increase decoding performance. The parameter specifies the desired
 // number of slices per frame. This capability is only valid on video renderers.
@@ -816,6 +831,9 @@ int LiSendHighResHScrollEvent(short scrollAmount);
 // This function returns a time in milliseconds with an implementation-defined epoch.
 uint64_t LiGetMillis(void);
 
+// This function returns a time in microseconds with the same epoch as LiGetMillis().
+uint64_t LiGetMicros(void);
+
 // This is a simplistic STUN function that can assist clients in getting the WAN address
 // for machines they find using mDNS over IPv4. This can be used to pre-populate the external
 // address for streaming after GFE stopped sending it a while back. wanAddr is returned in
@@ -836,6 +854,48 @@ int LiGetPendingAudioFrames(void);
 // negotiated audio frame duration.
 int LiGetPendingAudioDuration(void);
 
+// This function enables the adaptive audio jitter buffer for audio renderers that don't use
+// CAPABILITY_DIRECT_SUBMIT. Packets are released to the decoder on a fixed schedule, held
+// back by a target latency that covers the measured arrival jitter, clamped between the
+// minimum and maximum target. Setting both values the same gives a fixed target latency.
+// If the queue drifts away from the target (for example, because the host's audio clock runs
+// slightly faster or slower than ours), the jitter buffer drops a packet or conceals an extra
+// one with packet loss concealment to bring it back. A maximum of 0 disables the jitter buffer,
+// which is the default. This must be called before starting the connection.
+//
+// Targets are limited to 500 ms. The audio packet queue is enlarged to hold the maximum target
+// plus 50 ms of bursty arrivals, so the queue doesn't overflow and get flushed.
+void LiSetAudioJitterBufferLatency(int minTargetMs, int maxTargetMs);
+
+typedef struct _AUDIO_JITTER_BUFFER_STATS {
+    // Smoothed audio latency queued ahead of the decoder
+    int currentLatencyMs;
+
+    // Latency the jitter buffer is currently aiming for
+    int targetLatencyMs;
+
+    // Mean deviation of packet arrival times from the stream's packet duration
+    int arrivalJitterUs;
+
+    // Packets dropped and concealed packets added to correct drift
+    uint32_t framesDropped;
+    uint32_t framesInserted;
+
+    // Packets that weren't received in time to be played and were concealed
+    uint32_t lateFrames;
+
+    // Times playout restarted after the host stopped sending audio
+    uint32_t restarts;
+
+    // Times the packet queue overflowed and its packets were dropped
+    uint32_t queueOverflows;
+} AUDIO_JITTER_BUFFER_STATS, *PAUDIO_JITTER_BUFFER_STATS;
+
+// This function populates the provided struct with statistics from the audio jitter buffer.
+// The values are updated by the audio decoder thread, so they may be slightly inconsistent.
+// Returns false if the jitter buffer is disabled or no stream is active.
+bool LiGetAudioJitterBufferStats(PAUDIO_JITTER_BUFFER_STATS stats);
+
 // Port index flags for use with LiGetPortFromPortFlagIndex() and LiGetProtocolFromPortFlagIndex()
 #define ML_PORT_INDEX_TCP_47984 0
 #define ML_PORT_INDEX_TCP_47989 1
@@ -901,6 +961,47 @@ bool LiPeekNextVideoFrame(PDECODE_UNIT* decodeUnit);
 void LiWakeWaitForVideoFrame(void);
 void LiCompleteVideoFrame(VIDEO_FRAME_HANDLE handle, int drStatus);
 
+// This function sets the maximum age of a queued video frame for renderers that don't use
+// CAPABILITY_DIRECT_SUBMIT. The age of a frame is how far its presentationTimeMs trails the
+// newest frame in the decode unit queue. When the next frame to be dequeued is older than
+// this, frames are skipped up to the newest queued IDR frame. If no IDR frame is queued, the
+// queue is flushed and an IDR frame is requested instead. A value of 0 disables frame age
+// dropping, which is the default. This setting takes effect immediately.
+void LiSetVideoFrameAgeLimit(int maxAgeMs);
+
+#define VIDEO_QUEUE_DEPTH_BUCKETS 16
+#define VIDEO_QUEUE_AGE_BUCKETS 16
+#define VIDEO_QUEUE_AGE_BUCKET_MS 5
+
+typedef struct _VIDEO_QUEUE_STATS {
+    // Frames handed to the renderer from the decode unit queue
+    uint32_t framesDequeued;
+
+    // Frames skipped because they exceeded the age limit and a newer IDR frame was queued
+    uint32_t framesSkipped;
+
+    // Number of times a frame exceeded the age limit with no IDR frame queued behind it,
+    // so the queue was flushed and an IDR frame was requested
+    uint32_t ageRefreshes;
+
+    // Number of times the queue overflowed while queuing an IDR frame, so the older
+    // frames were dropped without requesting another IDR frame
+    uint32_t overflowIdrSkips;
+
+    // Frames still queued after each frame was dequeued. The last bucket also
+    // counts deeper queues.
+    uint32_t depthHistogram[VIDEO_QUEUE_DEPTH_BUCKETS];
+
+    // Age of each dequeued frame in VIDEO_QUEUE_AGE_BUCKET_MS buckets. The last
+    // bucket also counts older frames.
+    uint32_t ageHistogram[VIDEO_QUEUE_AGE_BUCKETS];
+} VIDEO_QUEUE_STATS, *PVIDEO_QUEUE_STATS;
+
+// This function populates the provided struct with statistics about the decode unit queue.
+// The values are updated by the renderer thread, so they may be slightly inconsistent.
+// Returns false if the renderer uses CAPABILITY_DIRECT_SUBMIT or no stream is active.
+bool LiGetVideoQueueStats(PVIDEO_QUEUE_STATS stats);
+
 // This function returns the last reported HDR mode from the host PC.
 // See ConnListenerSetHdrMode() for more details.
 bool LiGetCurrentHostDisplayHdrMode(void);
@@ -940,11 +1041,130 @@ bool LiGetHdrMetadata(PSS_HDR_METADATA metadata);
 // frame, just that an IDR frame will arrive soon.
 void LiRequestIdrFrame(void);
 
+// This function enables or disables FEC validation mode for subsequent connections. In this
+// mode, the RTP queues drop a received data shard from each FEC block and check the recovered
+// data against the original. This costs an extra parity shard of latency and a full FEC recovery
+// per block, so it is only compiled into debug builds (or builds defining LC_FEC_VALIDATION),
+// where it is enabled by default. Returns false if the requested mode is unavailable.
+bool LiSetFecValidationMode(bool enabled);
+
 // This function returns any extended feature flags supported by the host.
 #define LI_FF_PEN_TOUCH_EVENTS        0x01 // LiSendTouchEvent()/LiSendPenEvent() supported
 #define LI_FF_CONTROLLER_TOUCH_EVENTS 0x02 // LiSendControllerTouchEvent() supported
 uint32_t LiGetHostFeatureFlags(void);
 
+typedef struct _PACKET_POOL_STATS {
+    // Packet buffer allocations satisfied by the pool
+    uint64_t hits;
+
+    // Packet buffer allocations that required a new allocation
+    uint64_t misses;
+
+    // Number of packet buffers currently owned by the pool (free or in use)
+    int totalBuffers;
+} PACKET_POOL_STATS, *PPACKET_POOL_STATS;
+
+// This function populates the provided struct with statistics about the pool of video
+// packet buffers. Once the stream reaches a steady state, misses should stop increasing.
+// Hits are updated in batches, so they may lag slightly behind the actual value.
+// Returns false if the video stream has not been initialized.
+bool LiGetVideoPacketPoolStats(PPACKET_POOL_STATS stats);
+
+// This function populates the provided struct with statistics about the pool of audio
+// packet buffers. The pool is sized to hold a full audio packet queue, so misses should
+// only occur if the decoder falls behind. Returns false if the audio stream has not been
+// initialized.
+bool LiGetAudioPacketPoolStats(PPACKET_POOL_STATS stats);
+
+// This function enables pipelined decryption of encrypted video. The video receive thread
+// will only read packets from the socket, while a separate thread decrypts them and feeds
+// the RTP queue. This helps clients where AES-GCM can't keep up with high bitrate video on
+// the receive thread. Decode units submitted with CAPABILITY_DIRECT_SUBMIT will come from
+// the decrypt thread. It has no effect if the host doesn't encrypt video. This setting is
+// applied when the next connection is started. It is disabled by default.
+void LiSetPipelinedVideoDecryption(bool enabled);
+
+typedef struct _VIDEO_DECRYPT_STATS {
+    // Number of packets that the decrypt ring can hold
+    int ringSize;
+
+    // Packets waiting in the decrypt ring right now
+    uint32_t currentDepth;
+
+    // Maximum and average number of packets waiting in the decrypt ring
+    // after each batch of packets was received
+    uint32_t maxDepth;
+    uint32_t averageDepth;
+
+    // Total packets handed to the decrypt thread
+    uint64_t packetsQueued;
+
+    // Number of times the receive thread had to wait for the decrypt thread
+    // to free space in the decrypt ring
+    uint64_t fullWaits;
+} VIDEO_DECRYPT_STATS, *PVIDEO_DECRYPT_STATS;
+
+// This function populates the provided struct with statistics about the decrypt ring.
+// If the ring is regularly full, decryption can't keep up with the video bitrate.
+// Returns false if pipelined decryption is not in use for the current connection.
+bool LiGetVideoDecryptStats(PVIDEO_DECRYPT_STATS stats);
+
+// Stages of the video pipeline that are timestamped for each frame by the frame trace.
+// The stages before FRAME_TRACE_SUBMITTED are recorded by this library. The later stages
+// must be reported by the decoder using LiTraceVideoFrame() if they are to be traced.
+#define FRAME_TRACE_FIRST_PACKET    0 // First packet of the frame received
+#define FRAME_TRACE_LAST_PACKET     1 // Packet that completed the frame received
+#define FRAME_TRACE_FEC_COMPLETE    2 // All FEC blocks of the frame recovered
+#define FRAME_TRACE_REASSEMBLED     3 // Decode unit assembled by the depacketizer
+#define FRAME_TRACE_SUBMITTED       4 // Decode unit handed to the decoder
+#define FRAME_TRACE_INPUT_ACQUIRED  5 // Decoder input buffer obtained
+#define FRAME_TRACE_QUEUED          6 // Decoder input buffer queued
+#define FRAME_TRACE_OUTPUT_RELEASED 7 // Decoded frame released for display
+#define FRAME_TRACE_STAGE_COUNT     8
+
+// This function records the current time for the specified stage of the given video frame.
+// It is safe to call from any thread and never blocks. Stages reported for a frame that
+// is no longer in the trace history (or was never seen by the RTP queue) are ignored.
+void LiTraceVideoFrame(unsigned int frameNumber, int stage);
+
+typedef struct _FRAME_TRACE_STATS {
+    // Number of frames in the trace history that reached each stage
+    uint32_t frameCount[FRAME_TRACE_STAGE_COUNT];
+
+    // Time in microseconds between the most recent earlier stage that was
+    // recorded for a frame and this stage. These are 0 for the first stage.
+    uint32_t stageP50Us[FRAME_TRACE_STAGE_COUNT];
+    uint32_t stageP99Us[FRAME_TRACE_STAGE_COUNT];
+
+    // Time in microseconds between the first packet of a frame and this stage
+    uint32_t totalP50Us[FRAME_TRACE_STAGE_COUNT];
+    uint32_t totalP99Us[FRAME_TRACE_STAGE_COUNT];
+} FRAME_TRACE_STATS, *PFRAME_TRACE_STATS;
+
+// This function populates the provided struct with latency percentiles for each stage of the
+// video pipeline computed over the most recently traced frames. The trace is updated without
+// locking, so a frame that is being traced while the snapshot is taken may be skipped.
+// Returns false if no frames have been traced since the video stream was initialized.
+bool LiGetFrameTraceStats(PFRAME_TRACE_STATS stats);
+
+// Streams reported to the packet capture callback
+#define PACKET_CAPTURE_VIDEO 0
+#define PACKET_CAPTURE_AUDIO 1
+
+// This callback receives each RTP packet just before it is handed to the video or audio RTP queue.
+// Packets that were discarded before that point (runts, packets for stale frames, or the audio
+// packets dropped during the initial resync period) are not captured. The RTP header fields are
+// in network byte order, exactly as they arrived on the socket. Video packets have already been
+// decrypted. Audio payloads are captured as received, so they remain encrypted if audio
+// encryption is enabled. This lets a replay tool feed a capture through the RTP queues without
+// needing the session keys. The receive time is from LiGetMicros(). The callback is invoked on
+// the receive threads, so it must copy the packet and return quickly.
+typedef void(*PacketCaptureCallback)(int stream, uint64_t receiveTimeUs, const void* packet, int length, void* context);
+
+// This function sets the packet capture callback. Pass NULL to disable capture, which is the
+// default. It must not be called while a connection is active.
+void LiSetPacketCaptureCallback(PacketCaptureCallback callback, void* context);
+
 #ifdef __cplusplus
 }
 #endif
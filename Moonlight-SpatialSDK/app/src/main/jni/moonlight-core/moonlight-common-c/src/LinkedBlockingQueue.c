@@ -197,16 +197,10 @@ int LbqPollQueueElement(PLINKED_BLOCKING_QUEUE queueHead, void** data) {
     return LBQ_SUCCESS;
 }
 
-int LbqWaitForQueueElement(PLINKED_BLOCKING_QUEUE queueHead, void** data) {
+// Called with the queue mutex held after a wait has completed. Releases the mutex.
+static int takeQueueElementLocked(PLINKED_BLOCKING_QUEUE queueHead, void** data) {
     PLINKED_BLOCKING_QUEUE_ENTRY entry;
 
-    PltLockMutex(&queueHead->mutex);
-
-    // Wait for a waking condition: either data available or rundown
-    while (queueHead->head == NULL && !queueHead->draining && !queueHead->shutdown && !queueHead->pendingUserWake) {
-        PltWaitForConditionVariable(&queueHead->cond, &queueHead->mutex);
-    }
-
     // If we're shutting down, abort immediately, even if there's data available
     if (queueHead->shutdown) {
         PltUnlockMutex(&queueHead->mutex);
@@ -247,3 +241,33 @@ int LbqWaitForQueueElement(PLINKED_BLOCKING_QUEUE queueHead, void** data) {
 
     return LBQ_SUCCESS;
 }
+
+int LbqWaitForQueueElement(PLINKED_BLOCKING_QUEUE queueHead, void** data) {
+    PltLockMutex(&queueHead->mutex);
+
+    // Wait for a waking condition: either data available or rundown
+    while (queueHead->head == NULL && !queueHead->draining && !queueHead->shutdown && !queueHead->pendingUserWake) {
+        PltWaitForConditionVariable(&queueHead->cond, &queueHead->mutex);
+    }
+
+    return takeQueueElementLocked(queueHead, data);
+}
+
+int LbqWaitForQueueElementTimeout(PLINKED_BLOCKING_QUEUE queueHead, void** data, uint32_t timeoutUs) {
+    uint64_t deadlineUs = PltGetMicros() + timeoutUs;
+
+    PltLockMutex(&queueHead->mutex);
+
+    // Same waking conditions as LbqWaitForQueueElement(), plus the deadline
+    while (queueHead->head == NULL && !queueHead->draining && !queueHead->shutdown && !queueHead->pendingUserWake) {
+        uint64_t nowUs = PltGetMicros();
+        if (nowUs >= deadlineUs) {
+            PltUnlockMutex(&queueHead->mutex);
+            return LBQ_NO_ELEMENT;
+        }
+
+        PltWaitForConditionVariableTimeout(&queueHead->cond, &queueHead->mutex, (uint32_t)(deadlineUs - nowUs));
+    }
+
+    return takeQueueElementLocked(queueHead, data);
+}
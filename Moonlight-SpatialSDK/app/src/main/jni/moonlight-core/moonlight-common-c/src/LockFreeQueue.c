@@ -0,0 +1,278 @@
+#include "LockFreeQueue.h"
+
+// This is a bounded MPMC ring where each slot carries a sequence number
+// telling producers and consumers whose turn it is to use it. A slot at
+// position P is free for the producer when its sequence is P, and holds
+// data for the consumer when its sequence is P + 1. Positions are 32-bit
+// and are compared using wrapping arithmetic.
+
+static PLOCK_FREE_QUEUE_SLOT getSlot(PLOCK_FREE_QUEUE queue, uint32_t pos) {
+    return &queue->slots[pos & queue->slotMask];
+}
+
+// Attempts to remove (or just look at) the oldest element in the queue
+static bool tryTakeElement(PLOCK_FREE_QUEUE queue, void** data, bool remove) {
+    PLOCK_FREE_QUEUE_SLOT slot;
+    uint32_t pos;
+
+    pos = (uint32_t)PltAtomicLoad(&queue->dequeuePos);
+    for (;;) {
+        int32_t diff;
+
+        slot = getSlot(queue, pos);
+        diff = (int32_t)((uint32_t)PltAtomicLoad(&slot->sequence) - (pos + 1));
+        if (diff == 0) {
+            if (!remove) {
+                *data = slot->data;
+                return true;
+            }
+            else if (PltAtomicCompareExchange(&queue->dequeuePos, (int32_t)pos, (int32_t)(pos + 1))) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // The producer hasn't filled this slot yet, so the queue is empty
+            return false;
+        }
+
+        // Another consumer beat us to this slot
+        pos = (uint32_t)PltAtomicLoad(&queue->dequeuePos);
+    }
+
+    *data = slot->data;
+
+    // Hand the slot back to the producer for its next trip around the ring
+    PltAtomicStore(&slot->sequence, (int32_t)(pos + queue->slotMask + 1));
+    return true;
+}
+
+// This also counts elements that a producer has claimed a slot for
+// but not finished writing yet.
+static bool hasClaimedElements(PLOCK_FREE_QUEUE queue) {
+    return PltAtomicLoad(&queue->enqueuePos) != PltAtomicLoad(&queue->dequeuePos);
+}
+
+static void wakeWaiter(PLOCK_FREE_QUEUE queue) {
+    PltLockMutex(&queue->mutex);
+    PltSignalConditionVariable(&queue->cond);
+    PltUnlockMutex(&queue->mutex);
+}
+
+static void signalQueueState(PLOCK_FREE_QUEUE queue, PLT_ATOMIC_INT* state) {
+    PltAtomicStore(state, 1);
+
+    // This pairs with the increment of the waiter count in LfqWaitForQueueElement()
+    PltAtomicFullBarrier();
+    wakeWaiter(queue);
+}
+
+int LfqInitializeQueue(PLOCK_FREE_QUEUE queue, int sizeBound) {
+    uint32_t slotCount;
+    uint32_t i;
+    int err;
+
+    LC_ASSERT(sizeBound > 0);
+
+    memset(queue, 0, sizeof(*queue));
+
+    // Round the ring up to a power of two so positions can be masked
+    slotCount = 1;
+    while (slotCount < (uint32_t)sizeBound) {
+        slotCount <<= 1;
+    }
+
+    queue->slots = malloc(slotCount * sizeof(*queue->slots));
+    if (queue->slots == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < slotCount; i++) {
+        queue->slots[i].sequence = (int32_t)i;
+        queue->slots[i].data = NULL;
+    }
+
+    err = PltCreateMutex(&queue->mutex);
+    if (err != 0) {
+        free(queue->slots);
+        return err;
+    }
+
+    err = PltCreateConditionVariable(&queue->cond, &queue->mutex);
+    if (err != 0) {
+        PltDeleteMutex(&queue->mutex);
+        free(queue->slots);
+        return err;
+    }
+
+    queue->slotMask = slotCount - 1;
+    queue->sizeBound = sizeBound;
+
+    return 0;
+}
+
+// The caller must flush any remaining elements before destroying the queue
+void LfqDestroyQueue(PLOCK_FREE_QUEUE queue) {
+    LC_ASSERT(!hasClaimedElements(queue));
+    LC_ASSERT(queue->waiters == 0);
+
+    PltDeleteConditionVariable(&queue->cond);
+    PltDeleteMutex(&queue->mutex);
+
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+int LfqOfferQueueItem(PLOCK_FREE_QUEUE queue, void* data) {
+    PLOCK_FREE_QUEUE_SLOT slot;
+    uint32_t pos;
+    int32_t waiters;
+
+    if (PltAtomicLoad(&queue->shutdown) || PltAtomicLoad(&queue->draining)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    pos = (uint32_t)PltAtomicLoad(&queue->enqueuePos);
+    for (;;) {
+        int32_t diff;
+
+        slot = getSlot(queue, pos);
+        diff = (int32_t)((uint32_t)PltAtomicLoad(&slot->sequence) - pos);
+        if (diff == 0) {
+            if ((int32_t)(pos - (uint32_t)PltAtomicLoad(&queue->dequeuePos)) >= queue->sizeBound) {
+                return LBQ_BOUND_EXCEEDED;
+            }
+            else if (PltAtomicCompareExchange(&queue->enqueuePos, (int32_t)pos, (int32_t)(pos + 1))) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // The consumer hasn't drained this slot yet, so the ring is full
+            return LBQ_BOUND_EXCEEDED;
+        }
+
+        // Another producer beat us to this slot
+        pos = (uint32_t)PltAtomicLoad(&queue->enqueuePos);
+    }
+
+    // The successful compare-exchange above is a full barrier, which pairs with
+    // the increment of the waiter count in LfqWaitForQueueElement(). Either we
+    // see the waiter here, or it sees our claimed slot and won't park.
+    waiters = PltAtomicLoad(&queue->waiters);
+
+    slot->data = data;
+    PltAtomicStore(&slot->sequence, (int32_t)(pos + 1));
+
+    if (waiters != 0) {
+        wakeWaiter(queue);
+    }
+
+    return LBQ_SUCCESS;
+}
+
+int LfqWaitForQueueElement(PLOCK_FREE_QUEUE queue, void** data) {
+    int spins = 0;
+
+    for (;;) {
+        // If we're shutting down, abort immediately, even if there's data available
+        if (PltAtomicLoad(&queue->shutdown)) {
+            return LBQ_INTERRUPTED;
+        }
+
+        // If this is a user requested wake, process it now
+        if (PltAtomicLoad(&queue->pendingUserWake) &&
+                PltAtomicCompareExchange(&queue->pendingUserWake, 1, 0)) {
+            return LBQ_USER_WAKE;
+        }
+
+        if (tryTakeElement(queue, data, true)) {
+            return LBQ_SUCCESS;
+        }
+
+        // If we're draining, only abort if we have no data available. Elements
+        // offered before the drain was signaled may have landed since we last
+        // looked, and a producer may still be writing one it has claimed.
+        if (PltAtomicLoad(&queue->draining)) {
+            if (tryTakeElement(queue, data, true)) {
+                return LBQ_SUCCESS;
+            }
+            else if (!hasClaimedElements(queue)) {
+                return LBQ_INTERRUPTED;
+            }
+
+            continue;
+        }
+
+        // Data usually arrives in bursts, so briefly check again before
+        // paying for a trip through the scheduler.
+        if (spins < LFQ_SPIN_COUNT) {
+            spins++;
+            continue;
+        }
+
+        PltLockMutex(&queue->mutex);
+        PltAtomicFetchAdd(&queue->waiters, 1);
+        if (!PltAtomicLoad(&queue->shutdown) && !PltAtomicLoad(&queue->pendingUserWake) &&
+                !PltAtomicLoad(&queue->draining) && !hasClaimedElements(queue)) {
+            PltWaitForConditionVariable(&queue->cond, &queue->mutex);
+        }
+        PltAtomicFetchAdd(&queue->waiters, -1);
+        PltUnlockMutex(&queue->mutex);
+
+        spins = 0;
+    }
+}
+
+// Non-blocking version of the drain check in LfqWaitForQueueElement()
+static int pollElement(PLOCK_FREE_QUEUE queue, void** data, bool remove) {
+    if (PltAtomicLoad(&queue->shutdown)) {
+        return LBQ_INTERRUPTED;
+    }
+
+    if (tryTakeElement(queue, data, remove)) {
+        return LBQ_SUCCESS;
+    }
+    else if (!PltAtomicLoad(&queue->draining)) {
+        return LBQ_NO_ELEMENT;
+    }
+
+    // Look again, since an element offered before the drain was signaled
+    // may have landed after our first attempt
+    return tryTakeElement(queue, data, remove) ? LBQ_SUCCESS : LBQ_INTERRUPTED;
+}
+
+int LfqPollQueueElement(PLOCK_FREE_QUEUE queue, void** data) {
+    return pollElement(queue, data, true);
+}
+
+// This must be synchronized with LfqFlushQueueElement by the caller
+int LfqPeekQueueElement(PLOCK_FREE_QUEUE queue, void** data) {
+    return pollElement(queue, data, false);
+}
+
+// Removes the oldest element regardless of the shutdown or drain state. Call
+// this until it returns LBQ_NO_ELEMENT to flush the queue.
+int LfqFlushQueueElement(PLOCK_FREE_QUEUE queue, void** data) {
+    return tryTakeElement(queue, data, true) ? LBQ_SUCCESS : LBQ_NO_ELEMENT;
+}
+
+void LfqSignalQueueShutdown(PLOCK_FREE_QUEUE queue) {
+    signalQueueState(queue, &queue->shutdown);
+}
+
+void LfqSignalQueueDrain(PLOCK_FREE_QUEUE queue) {
+    signalQueueState(queue, &queue->draining);
+}
+
+void LfqSignalQueueUserWake(PLOCK_FREE_QUEUE queue) {
+    signalQueueState(queue, &queue->pendingUserWake);
+}
+
+// This is only a snapshot while producers or consumers are active
+int LfqGetItemCount(PLOCK_FREE_QUEUE queue) {
+    uint32_t dequeuePos = (uint32_t)PltAtomicLoad(&queue->dequeuePos);
+    uint32_t enqueuePos = (uint32_t)PltAtomicLoad(&queue->enqueuePos);
+    int32_t count = (int32_t)(enqueuePos - dequeuePos);
+
+    // The positions are read separately, so clamp anything that raced
+    return count < 0 ? 0 : count;
+}
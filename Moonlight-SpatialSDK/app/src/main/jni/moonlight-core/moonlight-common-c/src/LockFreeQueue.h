@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Platform.h"
+#include "PlatformThreads.h"
+
+// Lock-free queues share the LBQ_* return codes so callers can be moved
+// between the two implementations without changing their error handling.
+#include "LinkedBlockingQueue.h"
+
+// Bounded array-backed queue for the hot producer/consumer paths. Offers and
+// removals only take a lock when the consumer has parked on an empty queue.
+//
+// Offers are safe from any number of threads. Removals are also safe from any
+// number of threads, which allows a producer to flush the queue while the
+// consumer is waiting on it. Like LBQ, peeking must be synchronized with
+// flushing by the caller.
+
+#define LFQ_CACHE_LINE_SIZE 64
+
+// Number of times a waiter re-checks the queue before parking
+#define LFQ_SPIN_COUNT 128
+
+typedef struct _LOCK_FREE_QUEUE_SLOT {
+    PLT_ATOMIC_INT sequence;
+    void* data;
+} LOCK_FREE_QUEUE_SLOT, *PLOCK_FREE_QUEUE_SLOT;
+
+typedef struct _LOCK_FREE_QUEUE {
+    PLOCK_FREE_QUEUE_SLOT slots;
+    uint32_t slotMask;
+    int sizeBound;
+
+    // The producer and consumer positions live on separate cache lines
+    char pad0[LFQ_CACHE_LINE_SIZE];
+    PLT_ATOMIC_INT enqueuePos;
+    char pad1[LFQ_CACHE_LINE_SIZE - sizeof(PLT_ATOMIC_INT)];
+    PLT_ATOMIC_INT dequeuePos;
+    char pad2[LFQ_CACHE_LINE_SIZE - sizeof(PLT_ATOMIC_INT)];
+
+    PLT_ATOMIC_INT shutdown;
+    PLT_ATOMIC_INT draining;
+    PLT_ATOMIC_INT pendingUserWake;
+
+    // Parking state for waiters that found the queue empty
+    PLT_ATOMIC_INT waiters;
+    PLT_MUTEX mutex;
+    PLT_COND cond;
+} LOCK_FREE_QUEUE, *PLOCK_FREE_QUEUE;
+
+int LfqInitializeQueue(PLOCK_FREE_QUEUE queue, int sizeBound);
+void LfqDestroyQueue(PLOCK_FREE_QUEUE queue);
+int LfqOfferQueueItem(PLOCK_FREE_QUEUE queue, void* data);
+int LfqWaitForQueueElement(PLOCK_FREE_QUEUE queue, void** data);
+int LfqPollQueueElement(PLOCK_FREE_QUEUE queue, void** data);
+int LfqPeekQueueElement(PLOCK_FREE_QUEUE queue, void** data);
+int LfqFlushQueueElement(PLOCK_FREE_QUEUE queue, void** data);
+void LfqSignalQueueShutdown(PLOCK_FREE_QUEUE queue);
+void LfqSignalQueueDrain(PLOCK_FREE_QUEUE queue);
+void LfqSignalQueueUserWake(PLOCK_FREE_QUEUE queue);
+int LfqGetItemCount(PLOCK_FREE_QUEUE queue);
@@ -148,6 +148,21 @@ uint64_t LiGetMillis(void) {
     return PltGetMillis();
 }
 
+uint64_t LiGetMicros(void) {
+    return PltGetMicros();
+}
+
+void LiSetPacketCaptureCallback(PacketCaptureCallback callback, void* context) {
+    PacketCaptureHandler = callback;
+    PacketCaptureContext = context;
+}
+
+void capturePacket(int stream, const void* packet, int length) {
+    if (PacketCaptureHandler != NULL) {
+        PacketCaptureHandler(stream, PltGetMicros(), packet, length, PacketCaptureContext);
+    }
+}
+
 uint32_t LiGetHostFeatureFlags(void) {
     return SunshineFeatureFlags;
 }
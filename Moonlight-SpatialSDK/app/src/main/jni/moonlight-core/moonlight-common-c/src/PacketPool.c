@@ -0,0 +1,127 @@
+#include "PacketPool.h"
+
+static int freeEntryList(PPACKET_POOL_ENTRY entry) {
+    int count = 0;
+
+    while (entry != NULL) {
+        PPACKET_POOL_ENTRY next = entry->next;
+        free(entry);
+        entry = next;
+        count++;
+    }
+
+    return count;
+}
+
+int PktPoolInitialize(PPACKET_POOL pool, int bufferSize, int initialBuffers, int maxBuffers) {
+    int err;
+    int i;
+
+    LC_ASSERT(bufferSize >= (int)sizeof(PACKET_POOL_ENTRY));
+    LC_ASSERT(initialBuffers <= maxBuffers);
+
+    memset(pool, 0, sizeof(*pool));
+
+    err = PltCreateMutex(&pool->mutex);
+    if (err != 0) {
+        return err;
+    }
+
+    pool->bufferSize = bufferSize;
+    pool->maxBuffers = maxBuffers;
+
+    // Preallocate the initial buffers so we don't take misses at stream start.
+    // If this fails, we'll just allocate the remaining buffers on demand.
+    for (i = 0; i < initialBuffers; i++) {
+        PPACKET_POOL_ENTRY entry = (PPACKET_POOL_ENTRY)malloc(bufferSize);
+        if (entry == NULL) {
+            break;
+        }
+
+        entry->next = pool->allocCache;
+        pool->allocCache = entry;
+        pool->totalBuffers++;
+    }
+
+    return 0;
+}
+
+void* PktPoolAlloc(PPACKET_POOL pool) {
+    PPACKET_POOL_ENTRY entry;
+
+    // If our private cache is empty, take the whole shared free list
+    if (pool->allocCache == NULL) {
+        PltLockMutex(&pool->mutex);
+        pool->allocCache = pool->freeList;
+        pool->freeList = NULL;
+        pool->hits += pool->pendingHits;
+        pool->pendingHits = 0;
+        PltUnlockMutex(&pool->mutex);
+    }
+
+    entry = pool->allocCache;
+    if (entry != NULL) {
+        pool->allocCache = entry->next;
+        pool->pendingHits++;
+        return entry;
+    }
+
+    // The pool is exhausted, so we must allocate a new buffer. It will join
+    // the pool when it's freed (unless we're already at the maximum size).
+    entry = (PPACKET_POOL_ENTRY)malloc(pool->bufferSize);
+
+    PltLockMutex(&pool->mutex);
+    pool->misses++;
+    if (entry != NULL) {
+        pool->totalBuffers++;
+    }
+    PltUnlockMutex(&pool->mutex);
+
+    return entry;
+}
+
+void PktPoolFree(PPACKET_POOL pool, void* buffer) {
+    PPACKET_POOL_ENTRY entry = (PPACKET_POOL_ENTRY)buffer;
+
+    if (entry == NULL) {
+        return;
+    }
+
+    PltLockMutex(&pool->mutex);
+    if (pool->totalBuffers > pool->maxBuffers) {
+        // Shrink the pool back down after a burst of allocations
+        pool->totalBuffers--;
+        PltUnlockMutex(&pool->mutex);
+        free(entry);
+        return;
+    }
+
+    entry->next = pool->freeList;
+    pool->freeList = entry;
+    PltUnlockMutex(&pool->mutex);
+}
+
+void PktPoolGetStats(PPACKET_POOL pool, uint64_t* hits, uint64_t* misses, int* totalBuffers) {
+    // Hits made from the allocating thread's cache are only published
+    // when that cache is refilled, so this may slightly lag behind.
+    PltLockMutex(&pool->mutex);
+    *hits = pool->hits;
+    *misses = pool->misses;
+    *totalBuffers = pool->totalBuffers;
+    PltUnlockMutex(&pool->mutex);
+}
+
+// All buffers must have been returned to the pool prior to cleanup
+void PktPoolCleanup(PPACKET_POOL pool) {
+    int freedBuffers = 0;
+
+    freedBuffers += freeEntryList(pool->allocCache);
+    freedBuffers += freeEntryList(pool->freeList);
+    LC_ASSERT(freedBuffers == pool->totalBuffers);
+    (void)freedBuffers;
+
+    pool->allocCache = NULL;
+    pool->freeList = NULL;
+
+    PltDeleteMutex(&pool->mutex);
+}
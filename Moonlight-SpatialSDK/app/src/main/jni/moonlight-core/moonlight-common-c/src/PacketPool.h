@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Platform.h"
+#include "PlatformThreads.h"
+
+typedef struct _PACKET_POOL_ENTRY {
+    struct _PACKET_POOL_ENTRY* next;
+} PACKET_POOL_ENTRY, *PPACKET_POOL_ENTRY;
+
+// A pool of fixed-size buffers. Buffers may be freed from any thread, but
+// PktPoolAlloc() must only be called from a single thread at a time. That
+// thread takes buffers from a private cache without locking and only takes
+// the mutex to refill the cache in bulk from the shared free list.
+typedef struct _PACKET_POOL {
+    PLT_MUTEX mutex;
+    int bufferSize;
+    int maxBuffers;
+
+    // Buffers returned by PktPoolFree() (protected by mutex)
+    PPACKET_POOL_ENTRY freeList;
+    int totalBuffers;
+    uint64_t hits;
+    uint64_t misses;
+
+    // Buffers owned by the allocating thread (no lock required)
+    PPACKET_POOL_ENTRY allocCache;
+    uint64_t pendingHits;
+} PACKET_POOL, *PPACKET_POOL;
+
+int PktPoolInitialize(PPACKET_POOL pool, int bufferSize, int initialBuffers, int maxBuffers);
+void* PktPoolAlloc(PPACKET_POOL pool);
+void PktPoolFree(PPACKET_POOL pool, void* buffer);
+void PktPoolGetStats(PPACKET_POOL pool, uint64_t* hits, uint64_t* misses, int* totalBuffers);
+void PktPoolCleanup(PPACKET_POOL pool);
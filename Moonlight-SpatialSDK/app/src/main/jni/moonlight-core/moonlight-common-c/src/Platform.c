@@ -411,6 +411,18 @@ void PltWaitForEvent(PLT_EVENT* event) {
 #endif
 }
 
+// Timed condition variable waits should use the same monotonic clock as PltGetMicros(),
+// so changes to the wall clock don't shorten or stretch them. Apple has no
+// pthread_condattr_setclock(), but it has a relative timed wait. Android before
+// API 21 has a monotonic variant of pthread_cond_timedwait() instead.
+#if defined(__APPLE__)
+#define COND_WAIT_RELATIVE
+#elif defined(__ANDROID__) && __ANDROID_API__ < 21
+#define COND_WAIT_MONOTONIC_NP
+#elif defined(CLOCK_MONOTONIC) && !defined(NO_CLOCK_GETTIME)
+#define COND_CLOCK_MONOTONIC
+#endif
+
 int PltCreateConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex) {
 #if defined(LC_WINDOWS)
     InitializeConditionVariable(cond);
@@ -423,6 +435,13 @@ int PltCreateConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex) {
     OSFastCond_Init(cond, "");
 #elif defined(__3DS__)
     CondVar_Init(cond);
+#elif defined(COND_CLOCK_MONOTONIC)
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
 #else
     pthread_cond_init(cond, NULL);
 #endif
@@ -474,24 +493,84 @@ void PltWaitForConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex) {
 #endif
 }
 
-uint64_t PltGetMillis(void) {
+void PltWaitForConditionVariableTimeout(PLT_COND* cond, PLT_MUTEX* mutex, uint32_t timeoutUs) {
 #if defined(LC_WINDOWS)
-    return GetTickCount64();
+    // SRW waits only have millisecond granularity, so round up to avoid spinning
+    SleepConditionVariableSRW(cond, mutex, (timeoutUs + 999) / 1000, 0);
+#elif defined(__vita__)
+    SceUInt timeout = timeoutUs;
+    sceKernelWaitCond(*cond, &timeout);
+#elif defined(__WIIU__)
+    // OSFastCondition has no timed wait. Callers recheck their predicate
+    // after the timeout, so a plain sleep with the mutex released is enough.
+    PltUnlockMutex(mutex);
+    usleep(timeoutUs);
+    PltLockMutex(mutex);
+#elif defined(__3DS__)
+    CondVar_WaitTimeout(cond, mutex, (s64)timeoutUs * 1000);
+#elif defined(COND_WAIT_RELATIVE)
+    struct timespec timeout;
+
+    timeout.tv_sec = timeoutUs / 1000000;
+    timeout.tv_nsec = (timeoutUs % 1000000) * 1000;
+    pthread_cond_timedwait_relative_np(cond, mutex, &timeout);
+#else
+    struct timespec deadline;
+
+#if defined(COND_CLOCK_MONOTONIC) || defined(COND_WAIT_MONOTONIC_NP)
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+#else
+    clock_gettime(CLOCK_REALTIME, &deadline);
+#endif
+    deadline.tv_sec += timeoutUs / 1000000;
+    deadline.tv_nsec += (timeoutUs % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+#if defined(COND_WAIT_MONOTONIC_NP)
+    pthread_cond_timedwait_monotonic_np(cond, mutex, &deadline);
+#else
+    pthread_cond_timedwait(cond, mutex, &deadline);
+#endif
+#endif
+}
+
+uint64_t PltGetMicros(void) {
+#if defined(LC_WINDOWS)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion to avoid overflowing the intermediate product
+    return ((uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000) +
+           ((uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
 #elif defined(CLOCK_MONOTONIC) && !defined(NO_CLOCK_GETTIME)
     struct timespec tv;
 
     clock_gettime(CLOCK_MONOTONIC, &tv);
 
-    return ((uint64_t)tv.tv_sec * 1000) + (tv.tv_nsec / 1000000);
+    return ((uint64_t)tv.tv_sec * 1000000) + (tv.tv_nsec / 1000);
 #else
     struct timeval tv;
 
     gettimeofday(&tv, NULL);
 
-    return ((uint64_t)tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+    return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
 #endif
 }
 
+// This uses the same clock as PltGetMicros() so that millisecond and
+// microsecond timestamps can be compared with each other.
+uint64_t PltGetMillis(void) {
+    return PltGetMicros() / 1000;
+}
+
 bool PltSafeStrcpy(char* dest, size_t dest_size, const char* src) {
     LC_ASSERT(dest_size > 0);
 
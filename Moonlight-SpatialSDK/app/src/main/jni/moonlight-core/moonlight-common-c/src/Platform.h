@@ -148,4 +148,5 @@ int initializePlatform(void);
 void cleanupPlatform(void);
 
 uint64_t PltGetMillis(void);
+uint64_t PltGetMicros(void);
 bool PltSafeStrcpy(char* dest, size_t dest_size, const char* src);
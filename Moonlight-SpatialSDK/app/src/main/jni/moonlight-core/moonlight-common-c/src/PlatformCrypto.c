@@ -421,6 +421,106 @@ bool PltDecryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
 #endif
 }
 
+// Decrypts a batch of AES-GCM messages that share the same key, IV length and tag length.
+// The key schedule is set up on the first call and reused for every message after that,
+// so only the IV and tag change from message to message. On input, outputDataLength is
+// the size of the output buffer (at least inputDataLength). On output, it's the length
+// of the plaintext and decrypted is set if the message was authenticated successfully.
+// Returns the number of messages that were decrypted successfully.
+// Changing the key between encrypt/decrypt calls on a single context is not supported.
+int PltDecryptMessageBatch(PPLT_CRYPTO_CONTEXT ctx, int algorithm,
+                           unsigned char* key, int keyLength,
+                           int ivLength, int tagLength,
+                           PPLT_CRYPTO_MESSAGE messages, int messageCount) {
+    int decryptedCount = 0;
+    int i;
+
+    // Only AEAD messages can be decrypted independently of each other
+    LC_ASSERT(algorithm == ALGORITHM_AES_GCM);
+    if (algorithm != ALGORITHM_AES_GCM) {
+        return 0;
+    }
+
+#ifdef USE_MBEDTLS
+    // mbedTLS sets up the key schedule once per context, so we can
+    // simply decrypt each message with its own IV and tag.
+    for (i = 0; i < messageCount; i++) {
+        messages[i].decrypted = PltDecryptMessage(ctx, algorithm, 0, key, keyLength,
+                                                  messages[i].iv, ivLength,
+                                                  messages[i].tag, tagLength,
+                                                  messages[i].inputData, messages[i].inputDataLength,
+                                                  messages[i].outputData, &messages[i].outputDataLength);
+        if (messages[i].decrypted) {
+            decryptedCount++;
+        }
+    }
+#else
+    LC_ASSERT(keyLength == 16);
+    LC_ASSERT(tagLength > 0);
+
+    if (messageCount == 0) {
+        return 0;
+    }
+
+    // Perform a full initialization of the context with the first IV if this is the
+    // first use of the context. Every other message only needs its IV to be set.
+    //
+    // NB: OpenSSL's pipelined cipher interface (EVP_CTRL_SET_PIPELINE_*) is only
+    // implemented by engines for some non-AEAD ciphers, so it can't be used for GCM.
+    if (!ctx->initialized) {
+        if (EVP_DecryptInit_ex(ctx->ctx, EVP_aes_128_gcm(), NULL, NULL, NULL) != 1) {
+            return 0;
+        }
+
+        if (EVP_CIPHER_CTX_ctrl(ctx->ctx, EVP_CTRL_GCM_SET_IVLEN, ivLength, NULL) != 1) {
+            return 0;
+        }
+
+        if (EVP_DecryptInit_ex(ctx->ctx, NULL, NULL, key, NULL) != 1) {
+            return 0;
+        }
+
+        ctx->initialized = true;
+    }
+
+    for (i = 0; i < messageCount; i++) {
+        PPLT_CRYPTO_MESSAGE message = &messages[i];
+        int len;
+
+        LC_ASSERT(message->outputDataLength >= message->inputDataLength);
+        message->decrypted = false;
+
+        // Calling with cipher == NULL and key == NULL only sets the IV
+        // on the existing key schedule for this message.
+        if (EVP_DecryptInit_ex(ctx->ctx, NULL, NULL, NULL, message->iv) != 1) {
+            continue;
+        }
+
+        if (EVP_DecryptUpdate(ctx->ctx, message->outputData, &message->outputDataLength,
+                              message->inputData, message->inputDataLength) != 1) {
+            continue;
+        }
+
+        // Set the GCM tag before calling EVP_DecryptFinal_ex()
+        if (EVP_CIPHER_CTX_ctrl(ctx->ctx, EVP_CTRL_GCM_SET_TAG, tagLength, message->tag) != 1) {
+            continue;
+        }
+
+        // GCM will never have additional plaintext here, but we need to call it to
+        // ensure that the GCM authentication tag is correct for this data.
+        if (EVP_DecryptFinal_ex(ctx->ctx, message->outputData, &len) != 1) {
+            continue;
+        }
+        LC_ASSERT(len == 0);
+
+        message->decrypted = true;
+        decryptedCount++;
+    }
+#endif
+
+    return decryptedCount;
+}
+
 PPLT_CRYPTO_CONTEXT PltCreateCryptoContext(void) {
     PPLT_CRYPTO_CONTEXT ctx = malloc(sizeof(*ctx));
     if (!ctx) {
@@ -45,4 +45,20 @@ bool PltDecryptMessage(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int flags,
                        unsigned char* inputData, int inputDataLength,
                        unsigned char* outputData, int* outputDataLength);
 
+// A single message to be decrypted by PltDecryptMessageBatch()
+typedef struct _PLT_CRYPTO_MESSAGE {
+    unsigned char* iv;
+    unsigned char* tag;
+    unsigned char* inputData;
+    int inputDataLength;
+    unsigned char* outputData;
+    int outputDataLength;
+    bool decrypted;
+} PLT_CRYPTO_MESSAGE, *PPLT_CRYPTO_MESSAGE;
+
+int PltDecryptMessageBatch(PPLT_CRYPTO_CONTEXT ctx, int algorithm,
+                           unsigned char* key, int keyLength,
+                           int ivLength, int tagLength,
+                           PPLT_CRYPTO_MESSAGE messages, int messageCount);
+
 void PltGenerateRandomData(unsigned char* data, int length);
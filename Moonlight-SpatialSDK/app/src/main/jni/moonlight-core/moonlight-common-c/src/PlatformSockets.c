@@ -1,3 +1,6 @@
+// Needed for recvmmsg() on Linux
+#define _GNU_SOURCE
+
 #include "Limelight-internal.h"
 
 #define TEST_PORT_TIMEOUT_SEC 3
@@ -230,6 +233,98 @@ int recvUdpSocket(SOCKET s, char* buffer, int size, bool useSelect) {
     return err;
 }
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define HAVE_RECVMMSG 1
+
+// Set if the kernel (or a seccomp filter) rejects recvmmsg()
+static bool recvmmsgUnsupported;
+#endif
+
+int recvUdpSocketBatch(SOCKET s, char** buffers, int* lengths, int count, int size, bool useSelect) {
+#if defined(HAVE_RECVMMSG)
+    struct mmsghdr msgs[UDP_RECV_BATCH_MAX];
+    struct iovec iovs[UDP_RECV_BATCH_MAX];
+    int flags;
+    int err;
+    int i;
+
+    LC_ASSERT(count > 0 && count <= UDP_RECV_BATCH_MAX);
+
+    if (recvmmsgUnsupported || count <= 1) {
+        goto SingleRecv;
+    }
+
+    if (count > UDP_RECV_BATCH_MAX) {
+        count = UDP_RECV_BATCH_MAX;
+    }
+
+    for (i = 0; i < count; i++) {
+        iovs[i].iov_base = buffers[i];
+        iovs[i].iov_len = size;
+
+        memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_len = 0;
+    }
+
+    do {
+        if (useSelect) {
+            struct pollfd pfd;
+
+            // Wait up to 100 ms for the socket to be readable
+            pfd.fd = s;
+            pfd.events = POLLIN;
+            err = pollSockets(&pfd, 1, UDP_RECV_POLL_TIMEOUT_MS);
+            if (err <= 0) {
+                // Return if an error or timeout occurs
+                return err;
+            }
+
+            // The socket is readable, so just drain whatever is queued
+            flags = MSG_DONTWAIT;
+        }
+        else {
+            // MSG_WAITFORONE blocks (subject to SO_RCVTIMEO) only until the
+            // first datagram arrives, then returns whatever else is already
+            // queued without waiting for the batch to fill.
+            flags = MSG_WAITFORONE;
+        }
+
+        // The timeout parameter of recvmmsg() is only checked after each datagram
+        // is received, so we rely on SO_RCVTIMEO or poll() for the timeout instead.
+        err = recvmmsg(s, msgs, count, flags, NULL);
+        if (err < 0) {
+            if (LastSocketError() == ENOSYS) {
+                Limelog("recvmmsg() is unavailable; falling back to recvfrom()\n");
+                recvmmsgUnsupported = true;
+                goto SingleRecv;
+            }
+            else if (LastSocketError() == EWOULDBLOCK ||
+                     LastSocketError() == EINTR ||
+                     LastSocketError() == EAGAIN ||
+                     LastSocketError() == ETIMEDOUT) {
+                // Return 0 for timeout
+                return 0;
+            }
+        }
+
+    // See recvUdpSocket() for why we ignore ECONNREFUSED here
+    } while (err < 0 && LastSocketError() == ECONNREFUSED);
+
+    for (i = 0; i < err; i++) {
+        lengths[i] = (int)msgs[i].msg_len;
+    }
+
+    return err;
+
+SingleRecv:
+#endif
+    // Batched receive is unavailable, so just receive a single datagram
+    lengths[0] = recvUdpSocket(s, buffers[0], size, useSelect);
+    return lengths[0] > 0 ? 1 : lengths[0];
+}
+
 void closeSocket(SOCKET s) {
 #if defined(LC_WINDOWS)
     closesocket(s);
@@ -106,6 +106,12 @@ SOCKET bindUdpSocket(int addressFamily, struct sockaddr_storage* localAddr, SOCK
 int enableNoDelay(SOCKET s);
 int setSocketNonBlocking(SOCKET s, bool enabled);
 int recvUdpSocket(SOCKET s, char* buffer, int size, bool useSelect);
+
+// Receives up to count datagrams of at most size bytes each into the supplied buffers
+// and stores their lengths. Returns the number of datagrams received, 0 on timeout,
+// or negative on error. Platforms without recvmmsg() receive a single datagram per call.
+#define UDP_RECV_BATCH_MAX 64
+int recvUdpSocketBatch(SOCKET s, char** buffers, int* lengths, int count, int size, bool useSelect);
 void shutdownTcpSocket(SOCKET s);
 int setNonFatalRecvTimeoutMs(SOCKET s, int timeoutMs);
 void closeSocket(SOCKET s);
@@ -56,6 +56,27 @@ typedef struct _PLT_EVENT {
 } PLT_EVENT;
 #endif
 
+// Atomic operations on 32-bit integers for lock-free data structures.
+// Loads have acquire semantics, stores have release semantics, and the
+// read-modify-write operations are full barriers.
+#if defined(_MSC_VER)
+typedef volatile LONG PLT_ATOMIC_INT;
+#define PltAtomicLoad(x) InterlockedCompareExchange((x), 0, 0)
+#define PltAtomicStore(x, v) InterlockedExchange((x), (v))
+#define PltAtomicFetchAdd(x, v) InterlockedExchangeAdd((x), (v))
+#define PltAtomicCompareExchange(x, expected, desired) \
+    (InterlockedCompareExchange((x), (desired), (expected)) == (expected))
+#define PltAtomicFullBarrier() MemoryBarrier()
+#else
+typedef int32_t PLT_ATOMIC_INT;
+#define PltAtomicLoad(x) __atomic_load_n((x), __ATOMIC_ACQUIRE)
+#define PltAtomicStore(x, v) __atomic_store_n((x), (v), __ATOMIC_RELEASE)
+#define PltAtomicFetchAdd(x, v) __atomic_fetch_add((x), (v), __ATOMIC_SEQ_CST)
+#define PltAtomicCompareExchange(x, expected, desired) \
+    __sync_bool_compare_and_swap((x), (expected), (desired))
+#define PltAtomicFullBarrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
 int PltCreateMutex(PLT_MUTEX* mutex);
 void PltDeleteMutex(PLT_MUTEX* mutex);
 void PltLockMutex(PLT_MUTEX* mutex);
@@ -77,6 +98,7 @@ int PltCreateConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex);
 void PltDeleteConditionVariable(PLT_COND* cond);
 void PltSignalConditionVariable(PLT_COND* cond);
 void PltWaitForConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex);
+void PltWaitForConditionVariableTimeout(PLT_COND* cond, PLT_MUTEX* mutex, uint32_t timeoutUs);
 
 void PltSleepMs(int ms);
 void PltSleepMsInterruptible(PLT_THREAD* thread, int ms);
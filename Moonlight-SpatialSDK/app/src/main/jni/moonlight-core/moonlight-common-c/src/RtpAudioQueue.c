@@ -1,9 +1,10 @@
 #include "Limelight-internal.h"
 
-#if defined(LC_DEBUG) && !defined(LC_FUZZING)
+#if (defined(LC_DEBUG) || defined(LC_FEC_VALIDATION)) && !defined(LC_FUZZING)
 // This enables FEC validation mode with a synthetic drop
 // and recovered packet checks vs the original input. It
-// is on by default for debug builds.
+// is compiled in by default for debug builds and can be
+// toggled at runtime like the video FEC validation mode.
 //
 // NB: Unlike the video FEC feature of the same name, this
 // is much more restrictive in terms of when the validation
@@ -49,6 +50,8 @@ void RtpaInitializeQueue(PRTP_AUDIO_QUEUE queue) {
     // the same RS matrices for all traffic.
     queue->rs = reed_solomon_new(RTPA_DATA_SHARDS, RTPA_FEC_SHARDS);
 
+    queue->fecValidationMode = isFecValidationEnabled();
+
     // For unknown reasons, the RS parity matrix computed by our RS implementation
     // doesn't match the one Nvidia uses for audio data. I'm not exactly sure why,
     // but we can simply replace it with the matrix generated by OpenFEC which
@@ -103,41 +106,80 @@ static void validateFecBlockState(PRTP_AUDIO_QUEUE queue) {
 #endif
 }
 
-static PRTPA_FEC_BLOCK allocateFecBlock(PRTP_AUDIO_QUEUE queue, uint16_t blockSize) {
+#define FEC_BLOCK_ALLOCATION_SIZE \
+    (sizeof(RTPA_FEC_BLOCK) + (RTPA_DATA_SHARDS * RTPA_MAX_PACKET_SIZE) + (RTPA_FEC_SHARDS * RTPA_MAX_SHARD_SIZE))
+
+// Preallocates enough FEC blocks to cover the window in which we may be waiting
+// on missing shards. This must be called after the packet duration is negotiated
+// and before any packets are added to the queue.
+int RtpaAllocateBlockArena(PRTP_AUDIO_QUEUE queue, int packetDurationMs) {
+    int blockDurationMs = packetDurationMs * RTPA_DATA_SHARDS;
+
+    LC_ASSERT(queue->blockArena == NULL);
+
+    // We don't use FEC blocks for incompatible hosts
+    if (queue->incompatibleServer) {
+        return 0;
+    }
+
+    // We'll hold on to the oldest block for up to a block duration plus the OOS
+    // wait time while the blocks after it continue to arrive.
+    queue->arenaBlockCount = 1 + (blockDurationMs + RTPQ_OOS_WAIT_TIME_MS + blockDurationMs - 1) / blockDurationMs +
+                             RTPA_ARENA_SPARE_BLOCKS;
+
+    queue->blockArena = malloc(queue->arenaBlockCount * FEC_BLOCK_ALLOCATION_SIZE);
+    if (queue->blockArena == NULL) {
+        queue->arenaBlockCount = 0;
+        return -1;
+    }
+
+    for (int i = queue->arenaBlockCount - 1; i >= 0; i--) {
+        PRTPA_FEC_BLOCK block = (PRTPA_FEC_BLOCK)(queue->blockArena + (i * FEC_BLOCK_ALLOCATION_SIZE));
+
+        block->heapAllocated = false;
+        block->next = queue->freeBlockHead;
+        queue->freeBlockHead = block;
+        queue->freeBlockCount++;
+    }
+
+    return 0;
+}
+
+static PRTPA_FEC_BLOCK allocateFecBlock(PRTP_AUDIO_QUEUE queue) {
     PRTPA_FEC_BLOCK block = queue->freeBlockHead;
 
     if (block != NULL) {
         LC_ASSERT(queue->freeBlockCount > 0);
 
-        // If the block size matches, we're good to go
-        if (block->blockSize == blockSize) {
-            // Advance the free block list to the next entry
-            queue->freeBlockHead = block->next;
-            queue->freeBlockCount--;
+        // Advance the free block list to the next entry
+        queue->freeBlockHead = block->next;
+        queue->freeBlockCount--;
 
-            // Return the new block
-            return block;
-        }
-        else {
-            // The block size didn't match. This should never happen with GFE
-            // because it uses constant sized data shards, but Sunshine can
-            // trigger this condition. If it does happen, let's free the cached
-            // entry so we can populate the cache with correctly sized blocks.
-            queue->freeBlockHead = block->next;
-            queue->freeBlockCount--;
-
-            // Free the existing block
-            free(block);
-        }
+        return block;
     }
-    else {
-        LC_ASSERT(queue->freeBlockCount == 0);
+
+    LC_ASSERT(queue->freeBlockCount == 0);
+
+    // The arena is exhausted, which means the host is sending packets far
+    // out of order. Allocate a block on the heap to handle it.
+    queue->arenaMisses++;
+    block = malloc(FEC_BLOCK_ALLOCATION_SIZE);
+    if (block != NULL) {
+        block->heapAllocated = true;
     }
+    return block;
+}
 
-    // We either didn't have any free entries or the block
-    // size didn't match, so allocate a new FEC block now.
-    uint16_t dataPacketSize = blockSize + sizeof(RTP_PACKET);
-    return malloc(sizeof(*block) + (RTPA_DATA_SHARDS * dataPacketSize) + (RTPA_FEC_SHARDS * blockSize));
+static void freeFecBlock(PRTP_AUDIO_QUEUE queue, PRTPA_FEC_BLOCK block) {
+    if (block->heapAllocated) {
+        free(block);
+    }
+    else {
+        // Place this entry at the head of the free list for better cache behavior
+        block->next = queue->freeBlockHead;
+        queue->freeBlockHead = block;
+        queue->freeBlockCount++;
+    }
 }
 
 static void freeFecBlockHead(PRTP_AUDIO_QUEUE queue) {
@@ -159,35 +201,31 @@ static void freeFecBlockHead(PRTP_AUDIO_QUEUE queue) {
 
     validateFecBlockState(queue);
 
-    if (queue->freeBlockCount >= RTPA_CACHED_FEC_BLOCK_LIMIT) {
-        // Too many entries cached, so just free this one
-        free(blockHead);
-    }
-    else {
-        // Place this entry at the head of the free list for better cache behavior
-        blockHead->next = queue->freeBlockHead;
-        queue->freeBlockHead = blockHead;
-        queue->freeBlockCount++;
-    }
+    freeFecBlock(queue, blockHead);
 }
 
 void RtpaCleanupQueue(PRTP_AUDIO_QUEUE queue) {
     while (queue->blockHead != NULL) {
         PRTPA_FEC_BLOCK block = queue->blockHead;
         queue->blockHead = block->next;
-        free(block);
+        freeFecBlock(queue, block);
     }
 
     queue->blockTail = NULL;
 
-    while (queue->freeBlockHead != NULL) {
-        PRTPA_FEC_BLOCK block = queue->freeBlockHead;
-        queue->freeBlockHead = block->next;
-        queue->freeBlockCount--;
-        free(block);
+    // Only arena blocks can be on the free list
+    LC_ASSERT(queue->freeBlockCount == queue->arenaBlockCount);
+    queue->freeBlockHead = NULL;
+    queue->freeBlockCount = 0;
+
+    if (queue->arenaMisses != 0) {
+        Limelog("Audio FEC block arena of %u blocks was exhausted %u times\n",
+                queue->arenaBlockCount, queue->arenaMisses);
     }
 
-    LC_ASSERT(queue->freeBlockCount == 0);
+    free(queue->blockArena);
+    queue->blockArena = NULL;
+    queue->arenaBlockCount = 0;
 
     reed_solomon_release(queue->rs);
     queue->rs = NULL;
@@ -202,6 +240,12 @@ static PRTPA_FEC_BLOCK getFecBlockForRtpPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACK
 
     validateFecBlockState(queue);
 
+    if (length > RTPA_MAX_PACKET_SIZE) {
+        Limelog("RTP audio packet too large: %u\n", length);
+        LC_ASSERT_VT(false);
+        return NULL;
+    }
+
     if (packet->packetType == RTP_PAYLOAD_TYPE_AUDIO) {
         if (length < sizeof(RTP_PACKET)) {
             Limelog("RTP audio data packet too small: %u\n", length);
@@ -324,12 +368,14 @@ static PRTPA_FEC_BLOCK getFecBlockForRtpPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACK
 
     // We didn't find an existing FEC block, so we'll have to allocate one
     uint16_t dataPacketSize = blockSize + sizeof(RTP_PACKET);
-    PRTPA_FEC_BLOCK block = allocateFecBlock(queue, blockSize);
+    PRTPA_FEC_BLOCK block = allocateFecBlock(queue);
     if (block == NULL) {
         return NULL;
     }
 
+    bool heapAllocated = block->heapAllocated;
     memset(block, 0, sizeof(*block));
+    block->heapAllocated = heapAllocated;
 
     block->queueTimeMs = PltGetMillis();
     block->blockSize = blockSize;
@@ -341,7 +387,7 @@ static PRTPA_FEC_BLOCK getFecBlockForRtpPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACK
     block->fecHeader.baseTimestamp = fecBlockBaseTs;
     block->fecHeader.ssrc = fecBlockSsrc;
 
-    // Set up packet buffers pointing into the slab we allocated
+    // Set up packet buffers pointing into the block's slab
     uint8_t* data = (uint8_t*)(block + 1);
     for (int i = 0; i < RTPA_DATA_SHARDS; i++) {
         block->dataPackets[i] = (PRTP_PACKET)data;
@@ -392,22 +438,16 @@ static bool completeFecBlock(PRTP_AUDIO_QUEUE queue, PRTPA_FEC_BLOCK block) {
 
     // If we don't have enough shards, we can't do anything.
     // FEC validation mode requires one additional shard.
-#ifdef FEC_VALIDATION_MODE
-    if (block->dataShardsReceived + block->fecShardsReceived < RTPA_DATA_SHARDS + 1) {
-#else
-    if (block->dataShardsReceived + block->fecShardsReceived < RTPA_DATA_SHARDS) {
-#endif
+    if (block->dataShardsReceived + block->fecShardsReceived < RTPA_DATA_SHARDS + (queue->fecValidationMode ? 1 : 0)) {
         return false;
     }
 
     // If we have all data shards, don't bother with any recovery
     // unless we're in FEC validation mode
     LC_ASSERT(block->dataShardsReceived <= RTPA_DATA_SHARDS);
-#ifndef FEC_VALIDATION_MODE
-    if (block->dataShardsReceived == RTPA_DATA_SHARDS) {
+    if (!queue->fecValidationMode && block->dataShardsReceived == RTPA_DATA_SHARDS) {
         return true;
     }
-#endif
 
     // We have recovery to do. Let's build the array.
     for (int i = 0; i < RTPA_DATA_SHARDS; i++) {
@@ -418,20 +458,24 @@ static bool completeFecBlock(PRTP_AUDIO_QUEUE queue, PRTPA_FEC_BLOCK block) {
     }
 
 #ifdef FEC_VALIDATION_MODE
-    unsigned int dropIndex;
+    unsigned int dropIndex = 0;
+    uint8_t droppedPacketBuffer[RTPA_MAX_PACKET_SIZE];
+    PRTP_PACKET droppedRtpPacket = NULL;
 
-    // Choose a successfully received packet to drop
-    do {
-        dropIndex = rand() % RTPA_DATA_SHARDS;
-    } while (block->marks[dropIndex]);
+    if (queue->fecValidationMode) {
+        // Choose a successfully received packet to drop
+        do {
+            dropIndex = rand() % RTPA_DATA_SHARDS;
+        } while (block->marks[dropIndex]);
 
-    // Copy the original data to validate later
-    PRTP_PACKET droppedRtpPacket = malloc(sizeof(RTP_PACKET) + block->blockSize);
-    memcpy(droppedRtpPacket, block->dataPackets[dropIndex], sizeof(RTP_PACKET) + block->blockSize);
+        // Copy the original data to validate later
+        droppedRtpPacket = (PRTP_PACKET)droppedPacketBuffer;
+        memcpy(droppedRtpPacket, block->dataPackets[dropIndex], sizeof(RTP_PACKET) + block->blockSize);
 
-    // Fake the drop by setting the mark bit and zeroing the "missing" packet
-    block->marks[dropIndex] = 1;
-    memset(block->dataPackets[dropIndex], 0, sizeof(RTP_PACKET) + block->blockSize);
+        // Fake the drop by setting the mark bit and zeroing the "missing" packet
+        block->marks[dropIndex] = 1;
+        memset(block->dataPackets[dropIndex], 0, sizeof(RTP_PACKET) + block->blockSize);
+    }
 #endif
 
     int res = reed_solomon_reconstruct(queue->rs, shards, block->marks, RTPA_TOTAL_SHARDS, block->blockSize);
@@ -463,31 +507,31 @@ static bool completeFecBlock(PRTP_AUDIO_QUEUE queue, PRTPA_FEC_BLOCK block) {
 #endif
 
 #ifdef FEC_VALIDATION_MODE
-    // Check the RTP header values
-    LC_ASSERT_VT(block->dataPackets[dropIndex]->header == droppedRtpPacket->header);
-    LC_ASSERT_VT(block->dataPackets[dropIndex]->packetType == droppedRtpPacket->packetType);
-    LC_ASSERT_VT(block->dataPackets[dropIndex]->sequenceNumber == droppedRtpPacket->sequenceNumber);
-    LC_ASSERT_VT(block->dataPackets[dropIndex]->timestamp == droppedRtpPacket->timestamp);
-    LC_ASSERT_VT(block->dataPackets[dropIndex]->ssrc == droppedRtpPacket->ssrc);
-
-    // Check the data itself - use memcmp() and only loop if an error is detected
-    if (memcmp(block->dataPackets[dropIndex] + 1, droppedRtpPacket + 1, block->blockSize)) {
-        unsigned char* actualData = (unsigned char*)(block->dataPackets[dropIndex] + 1);
-        unsigned char* expectedData = (unsigned char*)(droppedRtpPacket + 1);
-        int recoveryErrors = 0;
-
-        for (int j = 0; j < block->blockSize; j++) {
-            if (actualData[j] != expectedData[j]) {
-                Limelog("Recovery error at %d: expected 0x%02x, actual 0x%02x\n",
-                        j, expectedData[j], actualData[j]);
-                recoveryErrors++;
+    if (droppedRtpPacket != NULL) {
+        // Check the RTP header values
+        LC_ASSERT_VT(block->dataPackets[dropIndex]->header == droppedRtpPacket->header);
+        LC_ASSERT_VT(block->dataPackets[dropIndex]->packetType == droppedRtpPacket->packetType);
+        LC_ASSERT_VT(block->dataPackets[dropIndex]->sequenceNumber == droppedRtpPacket->sequenceNumber);
+        LC_ASSERT_VT(block->dataPackets[dropIndex]->timestamp == droppedRtpPacket->timestamp);
+        LC_ASSERT_VT(block->dataPackets[dropIndex]->ssrc == droppedRtpPacket->ssrc);
+
+        // Check the data itself - use memcmp() and only loop if an error is detected
+        if (memcmp(block->dataPackets[dropIndex] + 1, droppedRtpPacket + 1, block->blockSize)) {
+            unsigned char* actualData = (unsigned char*)(block->dataPackets[dropIndex] + 1);
+            unsigned char* expectedData = (unsigned char*)(droppedRtpPacket + 1);
+            int recoveryErrors = 0;
+
+            for (int j = 0; j < block->blockSize; j++) {
+                if (actualData[j] != expectedData[j]) {
+                    Limelog("Recovery error at %d: expected 0x%02x, actual 0x%02x\n",
+                            j, expectedData[j], actualData[j]);
+                    recoveryErrors++;
+                }
             }
-        }
 
-        LC_ASSERT_VT(recoveryErrors == 0);
+            LC_ASSERT_VT(recoveryErrors == 0);
+        }
     }
-
-    free(droppedRtpPacket);
 #endif
 
     return true;
@@ -645,23 +689,24 @@ int RtpaAddPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t length) {
     return queueHasPacketReady(queue) ? RTPQ_RET_PACKET_READY : 0;
 }
 
-PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLength, uint16_t* length) {
+// Copies the next packet into the caller's buffer, which must have room for
+// RTPA_MAX_PACKET_SIZE bytes. Returns false if there are no packets ready.
+bool RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t maxLength, uint16_t* length) {
     validateFecBlockState(queue);
 
+    LC_ASSERT(maxLength >= RTPA_MAX_PACKET_SIZE);
+
     // If we're returning audio data even with discontinuities, we'll fill in blank entries
     // for packets that were lost and could not be recovered.
     if (queue->blockHead != NULL && queue->blockHead->allowDiscontinuity) {
         PRTPA_FEC_BLOCK nextBlock = queue->blockHead;
-        PRTP_PACKET lostPacket;
+        bool lostPacket;
 
         LC_ASSERT(nextBlock->fecHeader.baseSequenceNumber + nextBlock->nextDataPacketIndex == queue->nextRtpSequenceNumber);
         if (nextBlock->marks[nextBlock->nextDataPacketIndex]) {
             // This packet is missing. Return an empty entry to let the caller
             // know to perform packet loss concealment for this frame.
-            lostPacket = malloc(customHeaderLength);
-            if (lostPacket == NULL) {
-                return NULL;
-            }
+            lostPacket = true;
 
             // Lost packet placeholder entries have no associated data
             *length = 0;
@@ -671,7 +716,7 @@ PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLen
             queue->nextRtpSequenceNumber++;
         }
         else {
-            lostPacket = NULL;
+            lostPacket = false;
             LC_ASSERT(queueHasPacketReady(queue));
         }
 
@@ -683,21 +728,18 @@ PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLen
             validateFecBlockState(queue);
         }
 
-        if (lostPacket != NULL) {
-            return lostPacket;
+        if (lostPacket) {
+            return true;
         }
     }
 
     // Return the next RTP sequence number by indexing into the most recent FEC block
     if (queueHasPacketReady(queue)) {
         PRTPA_FEC_BLOCK nextBlock = queue->blockHead;
-        PRTP_PACKET packet = malloc(customHeaderLength + sizeof(RTP_PACKET) + nextBlock->blockSize);
-        if (packet == NULL) {
-            return NULL;
-        }
 
         *length = nextBlock->blockSize + sizeof(RTP_PACKET);
-        memcpy((uint8_t*)packet + customHeaderLength, nextBlock->dataPackets[nextBlock->nextDataPacketIndex], *length);
+        LC_ASSERT(*length <= maxLength);
+        memcpy(packet, nextBlock->dataPackets[nextBlock->nextDataPacketIndex], *length);
         nextBlock->nextDataPacketIndex++;
 
         queue->nextRtpSequenceNumber++;
@@ -710,8 +752,8 @@ PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLen
             validateFecBlockState(queue);
         }
 
-        return packet;
+        return true;
     }
 
-    return NULL;
+    return false;
 }
@@ -12,8 +12,16 @@
 #define RTPA_FEC_SHARDS 2
 #define RTPA_TOTAL_SHARDS (RTPA_DATA_SHARDS + RTPA_FEC_SHARDS)
 
-// Maximum number of FEC block entries to cache
-#define RTPA_CACHED_FEC_BLOCK_LIMIT 4
+// Largest audio datagram we accept, including the RTP header
+#define RTPA_MAX_PACKET_SIZE 1400
+
+// Every FEC block in the arena has room for shards of this size
+#define RTPA_MAX_SHARD_SIZE (RTPA_MAX_PACKET_SIZE - sizeof(RTP_PACKET))
+
+// Extra FEC blocks in the arena beyond those spanning the OOS wait window
+// to cover a block being filled behind the window and reordering across
+// block boundaries.
+#define RTPA_ARENA_SPARE_BLOCKS 2
 
 typedef struct _AUDIO_FEC_HEADER {
     uint8_t fecShardIndex;
@@ -44,6 +52,9 @@ typedef struct _RTPA_FEC_BLOCK {
 
     uint16_t blockSize;
 
+    // Allocated on the heap after the arena was exhausted
+    bool heapAllocated;
+
     // Data for shards comes here
 } RTPA_FEC_BLOCK, *PRTPA_FEC_BLOCK;
 
@@ -53,6 +64,11 @@ typedef struct _RTP_AUDIO_QUEUE {
 
     reed_solomon* rs;
 
+    // Preallocated FEC blocks, which are sized for the largest shards
+    uint8_t* blockArena;
+    uint16_t arenaBlockCount;
+    uint32_t arenaMisses;
+
     PRTPA_FEC_BLOCK freeBlockHead;
     uint16_t freeBlockCount;
 
@@ -63,6 +79,7 @@ typedef struct _RTP_AUDIO_QUEUE {
     bool receivedOosData;
     bool synchronizing;
     bool incompatibleServer;
+    bool fecValidationMode;
 } RTP_AUDIO_QUEUE, *PRTP_AUDIO_QUEUE;
 
 #define RTPQ_RET_PACKET_CONSUMED 0x1
@@ -74,6 +91,7 @@ typedef struct _RTP_AUDIO_QUEUE {
 #define RTPQ_HANDLE_NOW(x)      ((x) == RTPQ_RET_HANDLE_NOW)
 
 void RtpaInitializeQueue(PRTP_AUDIO_QUEUE queue);
+int RtpaAllocateBlockArena(PRTP_AUDIO_QUEUE queue, int packetDurationMs);
 void RtpaCleanupQueue(PRTP_AUDIO_QUEUE queue);
 int RtpaAddPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t length);
-PRTP_PACKET RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, uint16_t customHeaderLength, uint16_t* length);
+bool RtpaGetQueuedPacket(PRTP_AUDIO_QUEUE queue, PRTP_PACKET packet, uint16_t maxLength, uint16_t* length);
@@ -1,14 +1,20 @@
 #include "Limelight-internal.h"
-#include "rs.h"
 
-#if defined(LC_DEBUG) && !defined(LC_FUZZING)
+#if (defined(LC_DEBUG) || defined(LC_FEC_VALIDATION)) && !defined(LC_FUZZING)
 // This enables FEC validation mode with a synthetic drop
 // and recovered packet checks vs the original input. It
-// is on by default for debug builds.
+// is compiled in by default for debug builds and can be
+// added to other builds by defining LC_FEC_VALIDATION.
+// When compiled in, it can be toggled at runtime using
+// LiSetFecValidationMode().
 #define FEC_VALIDATION_MODE
 #define FEC_VERBOSE
 #endif
 
+#ifdef FEC_VALIDATION_MODE
+static bool fecValidationEnabled = true;
+#endif
+
 // Don't try speculative RFI for 5 minutes after seeing
 // an out of order packet or incorrect prediction
 #define SPECULATIVE_RFI_COOLDOWN_PERIOD_MS 300000
@@ -16,28 +22,81 @@
 // RTP packets use a 90 KHz presentation timestamp clock
 #define PTS_DIVISOR 90
 
+// Returned by reconstructFrame() when the FEC block was handed off to the recovery pool
+#define RTPV_RECOVERY_QUEUED 1
+
+// Number of recovery pool threads started by RtpvInitializeQueue()
+static int recoveryThreadCount = RTPV_FEC_RECOVERY_THREADS;
+
+static void startRecoveryPool(PRTPV_RECOVERY_POOL pool);
+static void stopRecoveryPool(PRTPV_RECOVERY_POOL pool);
+static void purgeCompletedFecBlocks(PRTP_VIDEO_QUEUE queue);
+
 void RtpvInitializeQueue(PRTP_VIDEO_QUEUE queue) {
     reed_solomon_init();
+    Limelog("Using %s kernels for video FEC recovery\n", reed_solomon_kernel_name());
     memset(queue, 0, sizeof(*queue));
 
     queue->currentFrameNumber = 1;
+    queue->fecValidationMode = isFecValidationEnabled();
     queue->multiFecCapable = APP_VERSION_AT_LEAST(7, 1, 431);
+
+    // Only multi-FEC frames have FEC blocks that can be recovered in parallel
+    if (queue->multiFecCapable && recoveryThreadCount > 0) {
+        startRecoveryPool(&queue->recoveryPool);
+    }
 }
 
 static void purgeListEntries(PRTPV_QUEUE_LIST list) {
     while (list->head != NULL) {
         PRTPV_QUEUE_ENTRY entry = list->head;
         list->head = entry->next;
-        free(entry->packet);
+        freeVideoPacketBuffer(entry->packet);
     }
 
     list->tail = NULL;
     list->count = 0;
 }
 
+bool LiSetFecValidationMode(bool enabled) {
+#ifdef FEC_VALIDATION_MODE
+    fecValidationEnabled = enabled;
+    return true;
+#else
+    // FEC validation mode is not compiled in
+    return !enabled;
+#endif
+}
+
+void RtpvSetRecoveryThreadCount(int threadCount) {
+    LC_ASSERT(threadCount >= 0 && threadCount <= RTPV_FEC_RECOVERY_THREADS);
+    recoveryThreadCount = threadCount;
+}
+
+bool isFecValidationEnabled(void) {
+#ifdef FEC_VALIDATION_MODE
+    return fecValidationEnabled;
+#else
+    return false;
+#endif
+}
+
 void RtpvCleanupQueue(PRTP_VIDEO_QUEUE queue) {
+    int i;
+
     purgeListEntries(&queue->pendingFecBlockList);
-    purgeListEntries(&queue->completedFecBlockList);
+    purgeCompletedFecBlocks(queue);
+    stopRecoveryPool(&queue->recoveryPool);
+
+    if (queue->asyncRecoveries != 0) {
+        Limelog("Recovered %u FEC blocks on the recovery pool (receive thread waited %u ms)\n",
+                queue->asyncRecoveries, (unsigned int)(queue->recoveryWaitUs / 1000));
+    }
+
+    for (i = 0; i < RTPV_RS_CACHE_SIZE; i++) {
+        reed_solomon_release(queue->rsCache[i]);
+        queue->rsCache[i] = NULL;
+    }
 }
 
 static void insertEntryIntoList(PRTPV_QUEUE_LIST list, PRTPV_QUEUE_ENTRY entry) {
@@ -180,110 +239,83 @@ static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP
     return true;
 }
 
+// Returns a Reed-Solomon codec for the specified shard counts. Frames of similar
+// size share the same shard counts, so we keep an LRU cache of codecs (and their
+// cached decode matrices) rather than building a new one for every recovery.
+static reed_solomon* getReedSolomonCodec(reed_solomon** rsCache, int dataShards, int parityShards) {
+    reed_solomon* rs;
+    int i;
+
+    for (i = 0; i < RTPV_RS_CACHE_SIZE && rsCache[i] != NULL; i++) {
+        rs = rsCache[i];
+        if (rs->data_shards == dataShards && rs->parity_shards == parityShards) {
+            // Move this codec to the front
+            memmove(&rsCache[1], &rsCache[0], i * sizeof(rsCache[0]));
+            rsCache[0] = rs;
+            return rs;
+        }
+    }
+
+    rs = reed_solomon_new(dataShards, parityShards);
+    if (rs == NULL) {
+        return NULL;
+    }
+
+    // Evict the least recently used codec if the cache is full
+    if (i == RTPV_RS_CACHE_SIZE) {
+        i--;
+        reed_solomon_release(rsCache[i]);
+    }
+
+    memmove(&rsCache[1], &rsCache[0], i * sizeof(rsCache[0]));
+    rsCache[0] = rs;
+    return rs;
+}
+
 #define PACKET_RECOVERY_FAILURE()                     \
     ret = -1;                                         \
     Limelog("FEC recovery returned corrupt packet %d" \
             " (frame %d)", rtpPacket->sequenceNumber, \
-            queue->currentFrameNumber);               \
-    free(packets[i]);                                 \
+            block->frameNumber);                      \
+    freeVideoPacketBuffer(packets[i]);                \
     continue
 
-// Returns 0 if the frame is completely constructed
-static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
+// Detaches the pending FEC block from the queue and allocates buffers for the
+// shards that must be recovered. Video packet buffers may only be allocated on
+// the receive thread, so this must be done before the block is handed off.
+static int captureFecBlock(PRTP_VIDEO_QUEUE queue, PRTPV_FEC_BLOCK block) {
     unsigned int totalPackets = queue->bufferDataPackets + queue->bufferParityPackets;
-    unsigned int neededPackets = queue->bufferDataPackets;
-    int ret;
-
-    LC_ASSERT(totalPackets == U16(queue->bufferHighestSequenceNumber - queue->bufferLowestSequenceNumber) + 1U);
-    
-#ifdef FEC_VALIDATION_MODE
-    // We'll need an extra packet to run in FEC validation mode, because we will
-    // be "dropping" one below and recovering it using parity. However, some frames
-    // are so large that FEC is disabled entirely, so don't wait for parity on those.
-    neededPackets += queue->fecPercentage ? 1 : 0;
-#endif
-
-    LC_ASSERT(totalPackets - neededPackets <= queue->bufferParityPackets);
-
-    if (queue->pendingFecBlockList.count < neededPackets) {
-        // If we've never received OOS data from this host, we can predict whether this frame will be recoverable
-        // based on the packets we've received (or not) so far. If the number of missing shards exceeds the total
-        // needed shards, there is no hope of recovering the data. The only way we could recover this frame is by
-        // receiving OOS data, which is unlikely because we've not seen any recently from this host.
-        if (!queue->reportedLostFrame && !queue->receivedOosData) {
-            // NB: We use totalPackets - neededPackets instead of just bufferParityPackets here because we require
-            // one extra parity shard for recovery if we're in FEC validation mode.
-            if (queue->missingPackets > totalPackets - neededPackets) {
-                notifyFrameLost(queue->currentFrameNumber, true);
-                queue->reportedLostFrame = true;
-            }
-            else {
-                // Assert that there are enough remaining packets to possibly recover this frame.
-                LC_ASSERT(neededPackets - queue->pendingFecBlockList.count <= U16(queue->bufferHighestSequenceNumber - queue->receivedHighestSequenceNumber));
-            }
-        }
+    int receiveSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
+    unsigned int i;
 
-        // Not enough data to recover yet
-        return -1;
+    memset(block, 0, sizeof(*block));
+    block->firstRecvTimeUs = queue->bufferFirstRecvTimeUs;
+    block->frameNumber = queue->currentFrameNumber;
+    block->lowestSequenceNumber = queue->bufferLowestSequenceNumber;
+    block->firstParitySequenceNumber = queue->bufferFirstParitySequenceNumber;
+    block->dataPackets = queue->bufferDataPackets;
+    block->parityPackets = queue->bufferParityPackets;
+    block->receivedDataPackets = queue->receivedDataPackets;
+    block->multiFecBlockNumber = queue->multiFecCurrentBlockNumber;
+    block->multiFecLastBlockNumber = queue->multiFecLastBlockNumber;
+    block->multiFecCapable = queue->multiFecCapable;
+    block->dropIndex = UINT32_MAX;
+
+    block->packets = calloc(totalPackets, sizeof(unsigned char*));
+    block->marks = calloc(totalPackets, sizeof(unsigned char));
+    if (block->packets == NULL || block->marks == NULL) {
+        free(block->packets);
+        free(block->marks);
+        return -2;
     }
 
-    // If we make it here and reported a lost frame, we lied to the host. This can happen if we happen to get
-    // unlucky and this particular frame happens to be the one with OOS data, but it should almost never happen.
-    LC_ASSERT(queue->missingPackets <= queue->bufferParityPackets);
-    LC_ASSERT(!queue->reportedLostFrame || queue->receivedOosData);
-    if (queue->reportedLostFrame && !queue->receivedOosData) {
-        // If it turns out that we lied to the host, stop further speculative RFI requests for a while.
-        queue->receivedOosData = true;
-        queue->lastOosFramePresentationTimestamp = queue->pendingFecBlockList.head->presentationTimeMs;
-        Limelog("Leaving speculative RFI mode due to incorrect loss prediction of frame %u\n", queue->currentFrameNumber);
-    }
+    memset(block->marks, 1, sizeof(char) * (totalPackets));
 
 #ifdef FEC_VALIDATION_MODE
-    // If FEC is disabled or unsupported for this frame, we must bail early here.
-    if ((queue->fecPercentage == 0 || AppVersionQuad[0] < 5) &&
-            queue->receivedDataPackets == queue->bufferDataPackets) {
-#else
-    if (queue->receivedDataPackets == queue->bufferDataPackets) {
-#endif
-        // We've received a full frame with no need for FEC.
-        return 0;
+    // Choose a packet to drop (or none if validation is disabled at runtime)
+    if (queue->fecValidationMode) {
+        block->dropIndex = rand() % queue->bufferDataPackets;
     }
-
-    if (AppVersionQuad[0] < 5) {
-        // Our FEC recovery code doesn't work properly until Gen 5
-        Limelog("FEC recovery not supported on Gen %d servers\n",
-                AppVersionQuad[0]);
-        return -1;
-    }
-
-    reed_solomon* rs = NULL;
-    unsigned char** packets = calloc(totalPackets, sizeof(unsigned char*));
-    unsigned char* marks = calloc(totalPackets, sizeof(unsigned char));
-    if (packets == NULL || marks == NULL) {
-        ret = -2;
-        goto cleanup;
-    }
-    
-    rs = reed_solomon_new(queue->bufferDataPackets, queue->bufferParityPackets);
-    
-    // This could happen in an OOM condition, but it could also mean the FEC data
-    // that we fed to reed_solomon_new() is bogus, so we'll assert to get a better look.
-    LC_ASSERT(rs != NULL);
-    if (rs == NULL) {
-        ret = -3;
-        goto cleanup;
-    }
-    
-    memset(marks, 1, sizeof(char) * (totalPackets));
-    
-    int receiveSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
-    int packetBufferSize = receiveSize + sizeof(RTPV_QUEUE_ENTRY);
-
-#ifdef FEC_VALIDATION_MODE
-    // Choose a packet to drop
-    unsigned int dropIndex = rand() % queue->bufferDataPackets;
-    PRTP_PACKET droppedRtpPacket = NULL;
-    int droppedRtpPacketLength = 0;
 #endif
 
     PRTPV_QUEUE_ENTRY entry = queue->pendingFecBlockList.head;
@@ -291,70 +323,98 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
         unsigned int index = U16(entry->packet->sequenceNumber - queue->bufferLowestSequenceNumber);
 
 #ifdef FEC_VALIDATION_MODE
-        if (index == dropIndex) {
+        if (index == block->dropIndex) {
             // If this was the drop choice, remember the original contents
             // and "drop" it.
-            droppedRtpPacket = entry->packet;
-            droppedRtpPacketLength = entry->length;
+            block->droppedPacket = entry->packet;
+            block->droppedPacketLength = entry->length;
             entry = entry->next;
             continue;
         }
 #endif
 
         // We should never have duplicate packets enqueued
-        LC_ASSERT(packets[index] == NULL);
-        LC_ASSERT(marks[index] != 0);
+        LC_ASSERT(block->packets[index] == NULL);
+        LC_ASSERT(block->marks[index] != 0);
 
-        packets[index] = (unsigned char*) entry->packet;
-        marks[index] = 0;
+        block->packets[index] = (unsigned char*) entry->packet;
+        block->marks[index] = 0;
         
         //Set padding to zero
         if (entry->length < receiveSize) {
-            memset(&packets[index][entry->length], 0, receiveSize - entry->length);
+            memset(&block->packets[index][entry->length], 0, receiveSize - entry->length);
         }
 
         entry = entry->next;
     }
 
-    unsigned int i;
     for (i = 0; i < totalPackets; i++) {
-        if (marks[i]) {
-            packets[i] = malloc(packetBufferSize);
-            if (packets[i] == NULL) {
-                ret = -4;
-                goto cleanup_packets;
+        if (block->marks[i]) {
+            block->packets[i] = allocVideoPacketBuffer();
+            if (block->packets[i] == NULL) {
+                while (i-- > 0) {
+                    if (block->marks[i]) {
+                        freeVideoPacketBuffer(block->packets[i]);
+                    }
+                }
+
+                free(block->packets);
+                free(block->marks);
+                return -4;
             }
         }
     }
-    
+
+    // The block owns the pending FEC data now
+    block->entries = queue->pendingFecBlockList;
+    memset(&queue->pendingFecBlockList, 0, sizeof(queue->pendingFecBlockList));
+    return 0;
+}
+
+// Recovers the missing data shards of a captured FEC block and adds them to the
+// block's entry list. This only touches the block itself, so it is safe to call
+// from a recovery worker as long as the worker passes its own codec.
+static int recoverFecBlock(PRTPV_FEC_BLOCK block, reed_solomon* rs) {
+    unsigned int totalPackets = block->dataPackets + block->parityPackets;
+    unsigned char** packets = block->packets;
+    unsigned char* marks = block->marks;
+    int receiveSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
+    unsigned int i;
+    int ret;
+
+    // This could happen in an OOM condition, but it could also mean the FEC data
+    // that we fed to reed_solomon_new() is bogus, so we'll assert to get a better look.
+    LC_ASSERT(rs != NULL);
+    if (rs == NULL) {
+        ret = -3;
+        goto cleanup_packets;
+    }
+
     ret = reed_solomon_reconstruct(rs, packets, marks, totalPackets, receiveSize);
     
     // We should always provide enough parity to recover the missing data successfully.
     // If this fails, something is probably wrong with our FEC state.
     LC_ASSERT(ret == 0);
 
-    if (queue->bufferDataPackets != queue->receivedDataPackets) {
 #ifdef FEC_VERBOSE
+    if (block->dataPackets != block->receivedDataPackets) {
         Limelog("Recovered %d video data shards from frame %d\n",
-                queue->bufferDataPackets - queue->receivedDataPackets,
-                queue->currentFrameNumber);
-#endif
-        
-        // Report the final FEC status if we needed to perform a recovery
-        reportFinalFrameFecStatus(queue);
+                block->dataPackets - block->receivedDataPackets,
+                block->frameNumber);
     }
+#endif
 
 cleanup_packets:
     for (i = 0; i < totalPackets; i++) {
         if (marks[i]) {
             // Only submit frame data, not FEC packets
-            if (ret == 0 && i < queue->bufferDataPackets) {
+            if (ret == 0 && i < block->dataPackets) {
                 PRTPV_QUEUE_ENTRY queueEntry = (PRTPV_QUEUE_ENTRY)&packets[i][receiveSize];
                 PRTP_PACKET rtpPacket = (PRTP_PACKET) packets[i];
-                rtpPacket->sequenceNumber = U16(i + queue->bufferLowestSequenceNumber);
-                rtpPacket->header = queue->pendingFecBlockList.head->packet->header;
-                rtpPacket->timestamp = queue->pendingFecBlockList.head->packet->timestamp;
-                rtpPacket->ssrc = queue->pendingFecBlockList.head->packet->ssrc;
+                rtpPacket->sequenceNumber = U16(i + block->lowestSequenceNumber);
+                rtpPacket->header = block->entries.head->packet->header;
+                rtpPacket->timestamp = block->entries.head->packet->timestamp;
+                rtpPacket->ssrc = block->entries.head->packet->ssrc;
                 
                 int dataOffset = sizeof(*rtpPacket);
                 if (rtpPacket->header & FLAG_EXTENSION) {
@@ -362,16 +422,16 @@ cleanup_packets:
                 }
 
                 PNV_VIDEO_PACKET nvPacket = (PNV_VIDEO_PACKET)(((char*)rtpPacket) + dataOffset);
-                nvPacket->frameIndex = queue->currentFrameNumber;
+                nvPacket->frameIndex = block->frameNumber;
                 nvPacket->multiFecBlocks =
-                        ((queue->multiFecLastBlockNumber << 2) | queue->multiFecCurrentBlockNumber) << 4;
+                        ((block->multiFecLastBlockNumber << 2) | block->multiFecBlockNumber) << 4;
                 // TODO: nvPacket->multiFecFlags?
 
 #ifdef FEC_VALIDATION_MODE
-                if (i == dropIndex && droppedRtpPacket != NULL) {
+                if (i == block->dropIndex && block->droppedPacket != NULL) {
                     // Check the packet contents if this was our known drop
-                    PNV_VIDEO_PACKET droppedNvPacket = (PNV_VIDEO_PACKET)(((char*)droppedRtpPacket) + dataOffset);
-                    int droppedDataLength = droppedRtpPacketLength - dataOffset - sizeof(*nvPacket);
+                    PNV_VIDEO_PACKET droppedNvPacket = (PNV_VIDEO_PACKET)(((char*)block->droppedPacket) + dataOffset);
+                    int droppedDataLength = block->droppedPacketLength - dataOffset - sizeof(*nvPacket);
                     int recoveredDataLength = StreamConfig.packetSize - sizeof(*nvPacket);
                     int j;
                     int recoveryErrors = 0;
@@ -384,7 +444,7 @@ cleanup_packets:
                     LC_ASSERT_VT(nvPacket->frameIndex == droppedNvPacket->frameIndex);
                     LC_ASSERT_VT(nvPacket->streamPacketIndex == droppedNvPacket->streamPacketIndex);
                     LC_ASSERT_VT(nvPacket->reserved == droppedNvPacket->reserved);
-                    LC_ASSERT_VT(!queue->multiFecCapable || nvPacket->multiFecBlocks == droppedNvPacket->multiFecBlocks);
+                    LC_ASSERT_VT(!block->multiFecCapable || nvPacket->multiFecBlocks == droppedNvPacket->multiFecBlocks);
 
                     // Check the data itself - use memcmp() and only loop if an error is detected
                     if (memcmp(nvPacket + 1, droppedNvPacket + 1, droppedDataLength)) {
@@ -413,7 +473,7 @@ cleanup_packets:
 
                     // This drop was fake, so we don't want to actually submit it to the depacketizer.
                     // It will get confused because it's already seen this packet before.
-                    free(packets[i]);
+                    freeVideoPacketBuffer(packets[i]);
                     continue;
                 }
 #endif
@@ -426,10 +486,10 @@ cleanup_packets:
                 if (i == 0 && !(nvPacket->flags & FLAG_SOF)) {
                     PACKET_RECOVERY_FAILURE();
                 }
-                if (i == queue->bufferDataPackets - 1 && !(nvPacket->flags & FLAG_EOF)) {
+                if (i == block->dataPackets - 1 && !(nvPacket->flags & FLAG_EOF)) {
                     PACKET_RECOVERY_FAILURE();
                 }
-                if (i > 0 && i < queue->bufferDataPackets - 1 && !(nvPacket->flags & FLAG_CONTAINS_PIC_DATA)) {
+                if (i > 0 && i < block->dataPackets - 1 && !(nvPacket->flags & FLAG_CONTAINS_PIC_DATA)) {
                     PACKET_RECOVERY_FAILURE();
                 }
                 if (nvPacket->flags & ~(FLAG_SOF | FLAG_EOF | FLAG_CONTAINS_PIC_DATA)) {
@@ -441,31 +501,271 @@ cleanup_packets:
                 // discarded by decoders. It's not safe to strip all zero padding because
                 // it may be a legitimate part of the H.264 bytestream.
 
-                LC_ASSERT(isBefore16(rtpPacket->sequenceNumber, queue->bufferFirstParitySequenceNumber));
-                queuePacket(queue, queueEntry, rtpPacket, StreamConfig.packetSize + dataOffset, false, true);
+                // Recovered shards were missing from the block, so they can't be duplicates
+                LC_ASSERT(isBefore16(rtpPacket->sequenceNumber, block->firstParitySequenceNumber));
+                queueEntry->packet = rtpPacket;
+                queueEntry->length = StreamConfig.packetSize + dataOffset;
+                queueEntry->isParity = false;
+                queueEntry->prev = NULL;
+                queueEntry->next = NULL;
+                queueEntry->presentationTimeMs = rtpPacket->timestamp / PTS_DIVISOR;
+                insertEntryIntoList(&block->entries, queueEntry);
             } else if (packets[i] != NULL) {
-                free(packets[i]);
+                freeVideoPacketBuffer(packets[i]);
             }
         }
     }
 
-cleanup:
-    reed_solomon_release(rs);
+    free(block->packets);
+    free(block->marks);
+    block->packets = NULL;
+    block->marks = NULL;
+
+    return ret;
+}
+
+static void RecoveryWorkerThreadProc(void* context) {
+    PRTPV_RECOVERY_WORKER worker = (PRTPV_RECOVERY_WORKER)context;
+    PRTPV_RECOVERY_POOL pool = worker->pool;
+
+    PltLockMutex(&pool->mutex);
+    for (;;) {
+        while (pool->jobHead == NULL && !pool->stopping) {
+            PltWaitForConditionVariable(&pool->jobCond, &pool->mutex);
+        }
+
+        if (pool->stopping) {
+            break;
+        }
+
+        PRTPV_FEC_BLOCK block = pool->jobHead;
+        pool->jobHead = block->next;
+        if (pool->jobHead == NULL) {
+            pool->jobTail = NULL;
+        }
+        PltUnlockMutex(&pool->mutex);
+
+        int ret = recoverFecBlock(block, getReedSolomonCodec(worker->rsCache, block->dataPackets, block->parityPackets));
+
+        PltLockMutex(&pool->mutex);
+        block->result = ret;
+        block->recovering = false;
+        PltSignalConditionVariable(&pool->doneCond);
+    }
+    PltUnlockMutex(&pool->mutex);
+}
+
+static void startRecoveryPool(PRTPV_RECOVERY_POOL pool) {
+    int i;
+
+    if (PltCreateMutex(&pool->mutex) < 0) {
+        return;
+    }
+    if (PltCreateConditionVariable(&pool->jobCond, &pool->mutex) < 0) {
+        PltDeleteMutex(&pool->mutex);
+        return;
+    }
+    if (PltCreateConditionVariable(&pool->doneCond, &pool->mutex) < 0) {
+        PltDeleteConditionVariable(&pool->jobCond);
+        PltDeleteMutex(&pool->mutex);
+        return;
+    }
+
+    pool->initialized = true;
+
+    // If we can't start any workers, all FEC recovery will just happen on the receive thread
+    for (i = 0; i < recoveryThreadCount; i++) {
+        pool->workers[i].pool = pool;
+        if (PltCreateThread("VideoFec", RecoveryWorkerThreadProc, &pool->workers[i], &pool->workers[i].thread) != 0) {
+            break;
+        }
+
+        pool->threadCount++;
+    }
+}
+
+static void stopRecoveryPool(PRTPV_RECOVERY_POOL pool) {
+    int i, j;
+
+    if (!pool->initialized) {
+        return;
+    }
+
+    // All FEC blocks must be collected before the pool is stopped
+    LC_ASSERT(pool->jobHead == NULL);
+
+    PltLockMutex(&pool->mutex);
+    pool->stopping = true;
+    for (i = 0; i < pool->threadCount; i++) {
+        PltSignalConditionVariable(&pool->jobCond);
+    }
+    PltUnlockMutex(&pool->mutex);
+
+    for (i = 0; i < pool->threadCount; i++) {
+        PltJoinThread(&pool->workers[i].thread);
+
+        for (j = 0; j < RTPV_RS_CACHE_SIZE; j++) {
+            reed_solomon_release(pool->workers[i].rsCache[j]);
+            pool->workers[i].rsCache[j] = NULL;
+        }
+    }
+
+    PltDeleteConditionVariable(&pool->doneCond);
+    PltDeleteConditionVariable(&pool->jobCond);
+    PltDeleteMutex(&pool->mutex);
+
+    pool->threadCount = 0;
+    pool->initialized = false;
+}
+
+static void queueRecoveryJob(PRTPV_RECOVERY_POOL pool, PRTPV_FEC_BLOCK block) {
+    block->next = NULL;
+    block->dispatched = true;
+
+    PltLockMutex(&pool->mutex);
+    block->recovering = true;
+    if (pool->jobTail == NULL) {
+        pool->jobHead = pool->jobTail = block;
+    }
+    else {
+        pool->jobTail->next = block;
+        pool->jobTail = block;
+    }
+    PltSignalConditionVariable(&pool->jobCond);
+    PltUnlockMutex(&pool->mutex);
+}
+
+// Waits for the recovery pool to finish all FEC blocks dispatched for the current frame
+static void waitForRecoveries(PRTP_VIDEO_QUEUE queue) {
+    PRTPV_RECOVERY_POOL pool = &queue->recoveryPool;
+    uint64_t startTimeUs = PltGetMicros();
+    int i;
+
+    PltLockMutex(&pool->mutex);
+    for (i = 0; i < RTPV_MAX_FEC_BLOCKS; i++) {
+        while (queue->recoveryBlocks[i].recovering) {
+            PltWaitForConditionVariable(&pool->doneCond, &pool->mutex);
+        }
+    }
+    PltUnlockMutex(&pool->mutex);
+
+    queue->recoveryWaitUs += PltGetMicros() - startTimeUs;
+}
 
-    if (packets != NULL)
-        free(packets);
+// Returns 0 if the frame is completely constructed or RTPV_RECOVERY_QUEUED
+// if the FEC block was handed off to the recovery pool
+static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
+    unsigned int totalPackets = queue->bufferDataPackets + queue->bufferParityPackets;
+    unsigned int neededPackets = queue->bufferDataPackets;
+    RTPV_FEC_BLOCK inlineBlock;
+    PRTPV_FEC_BLOCK block;
+    int ret;
 
-    if (marks != NULL)
-        free(marks);
+    LC_ASSERT(totalPackets == U16(queue->bufferHighestSequenceNumber - queue->bufferLowestSequenceNumber) + 1U);
     
+#ifdef FEC_VALIDATION_MODE
+    // We'll need an extra packet to run in FEC validation mode, because we will
+    // be "dropping" one below and recovering it using parity. However, some frames
+    // are so large that FEC is disabled entirely, so don't wait for parity on those.
+    if (queue->fecValidationMode) {
+        neededPackets += queue->fecPercentage ? 1 : 0;
+    }
+#endif
+
+    LC_ASSERT(totalPackets - neededPackets <= queue->bufferParityPackets);
+
+    if (queue->pendingFecBlockList.count < neededPackets) {
+        // If we've never received OOS data from this host, we can predict whether this frame will be recoverable
+        // based on the packets we've received (or not) so far. If the number of missing shards exceeds the total
+        // needed shards, there is no hope of recovering the data. The only way we could recover this frame is by
+        // receiving OOS data, which is unlikely because we've not seen any recently from this host.
+        if (!queue->reportedLostFrame && !queue->receivedOosData) {
+            // NB: We use totalPackets - neededPackets instead of just bufferParityPackets here because we require
+            // one extra parity shard for recovery if we're in FEC validation mode.
+            if (queue->missingPackets > totalPackets - neededPackets) {
+                notifyFrameLost(queue->currentFrameNumber, true);
+                queue->reportedLostFrame = true;
+            }
+            else {
+                // Assert that there are enough remaining packets to possibly recover this frame.
+                LC_ASSERT(neededPackets - queue->pendingFecBlockList.count <= U16(queue->bufferHighestSequenceNumber - queue->receivedHighestSequenceNumber));
+            }
+        }
+
+        // Not enough data to recover yet
+        return -1;
+    }
+
+    // If we make it here and reported a lost frame, we lied to the host. This can happen if we happen to get
+    // unlucky and this particular frame happens to be the one with OOS data, but it should almost never happen.
+    LC_ASSERT(queue->missingPackets <= queue->bufferParityPackets);
+    LC_ASSERT(!queue->reportedLostFrame || queue->receivedOosData);
+    if (queue->reportedLostFrame && !queue->receivedOosData) {
+        // If it turns out that we lied to the host, stop further speculative RFI requests for a while.
+        queue->receivedOosData = true;
+        queue->lastOosFramePresentationTimestamp = queue->pendingFecBlockList.head->presentationTimeMs;
+        Limelog("Leaving speculative RFI mode due to incorrect loss prediction of frame %u\n", queue->currentFrameNumber);
+    }
+
+#ifdef FEC_VALIDATION_MODE
+    // If FEC is disabled or unsupported for this frame, we must bail early here.
+    if ((!queue->fecValidationMode || queue->fecPercentage == 0 || AppVersionQuad[0] < 5) &&
+            queue->receivedDataPackets == queue->bufferDataPackets) {
+#else
+    if (queue->receivedDataPackets == queue->bufferDataPackets) {
+#endif
+        // We've received a full frame with no need for FEC.
+        return 0;
+    }
+
+    if (AppVersionQuad[0] < 5) {
+        // Our FEC recovery code doesn't work properly until Gen 5
+        Limelog("FEC recovery not supported on Gen %d servers\n",
+                AppVersionQuad[0]);
+        return -1;
+    }
+
+    // The earlier FEC blocks of a multi-FEC frame are recovered by the recovery pool
+    // while we keep receiving the rest of the frame. The last block is always done
+    // here, because the frame can't be submitted until it's recovered anyway.
+    bool recoverAsync = queue->recoveryPool.threadCount > 0 &&
+            queue->multiFecCurrentBlockNumber < queue->multiFecLastBlockNumber;
+    block = recoverAsync ? &queue->recoveryBlocks[queue->multiFecCurrentBlockNumber] : &inlineBlock;
+
+    ret = captureFecBlock(queue, block);
+    if (ret != 0) {
+        return ret;
+    }
+
+    // Report the final FEC status if we needed to perform a recovery
+    if (queue->bufferDataPackets != queue->receivedDataPackets) {
+        reportFinalFrameFecStatus(queue);
+    }
+
+    if (recoverAsync) {
+        queueRecoveryJob(&queue->recoveryPool, block);
+        queue->outstandingRecoveries++;
+        queue->asyncRecoveries++;
+        return RTPV_RECOVERY_QUEUED;
+    }
+
+    ret = recoverFecBlock(block, getReedSolomonCodec(queue->rsCache, queue->bufferDataPackets, queue->bufferParityPackets));
+
+    // Hand the FEC data back to the queue for staging
+    queue->pendingFecBlockList = block->entries;
+    if (ret != 0) {
+        // Recovered packets were added without updating the contiguous sequence
+        // number, so we can no longer use the fast path to detect duplicates.
+        queue->useFastQueuePath = false;
+    }
+
     return ret;
 }
 
-static void stageCompleteFecBlock(PRTP_VIDEO_QUEUE queue) {
-    unsigned int nextSeqNum = queue->bufferLowestSequenceNumber;
-
-    while (queue->pendingFecBlockList.count > 0) {
-        PRTPV_QUEUE_ENTRY entry = queue->pendingFecBlockList.head;
+static void stageCompleteFecBlock(PRTPV_QUEUE_LIST pendingList, PRTPV_QUEUE_LIST completedList,
+                                  unsigned int nextSeqNum, uint64_t firstRecvTimeUs) {
+    while (pendingList->count > 0) {
+        PRTPV_QUEUE_ENTRY entry = pendingList->head;
 
         unsigned int lowestRtpSequenceNumber = entry->packet->sequenceNumber;
 
@@ -481,27 +781,27 @@ static void stageCompleteFecBlock(PRTP_VIDEO_QUEUE queue) {
                 entry = parityEntry->next;
 
                 // Remove this entry
-                removeEntryFromList(&queue->pendingFecBlockList, parityEntry);
+                removeEntryFromList(pendingList, parityEntry);
 
                 // Free the entry and packet
-                free(parityEntry->packet);
+                freeVideoPacketBuffer(parityEntry->packet);
 
                 continue;
             }
 
             // Check for the next packet in sequence. This will be O(1) for non-reordered packet streams.
             if (entry->packet->sequenceNumber == nextSeqNum) {
-                removeEntryFromList(&queue->pendingFecBlockList, entry);
+                removeEntryFromList(pendingList, entry);
 
                 // To avoid having to sample the system time for each packet, we cheat
                 // and use the first packet's receive time for all packets. This ends up
                 // actually being better for the measurements that the depacketizer does,
                 // since it properly handles out of order packets.
-                LC_ASSERT(queue->bufferFirstRecvTimeMs != 0);
-                entry->receiveTimeMs = queue->bufferFirstRecvTimeMs;
+                LC_ASSERT(firstRecvTimeUs != 0);
+                entry->receiveTimeUs = firstRecvTimeUs;
 
                 // Move this packet to the completed FEC block list
-                insertEntryIntoList(&queue->completedFecBlockList, entry);
+                insertEntryIntoList(completedList, entry);
                 break;
             }
             else if (isBefore16(entry->packet->sequenceNumber, lowestRtpSequenceNumber)) {
@@ -522,6 +822,74 @@ static void stageCompleteFecBlock(PRTP_VIDEO_QUEUE queue) {
     }
 }
 
+// Stages the FEC blocks recovered by the pool and appends all blocks of the frame
+// to the completed FEC block list in order. Returns false if any recovery failed.
+static bool collectRecoveredFecBlocks(PRTP_VIDEO_QUEUE queue) {
+    bool recovered = true;
+    int i;
+
+    waitForRecoveries(queue);
+
+    for (i = 0; i < RTPV_MAX_FEC_BLOCKS; i++) {
+        PRTPV_FEC_BLOCK block = &queue->recoveryBlocks[i];
+
+        if (!block->dispatched) {
+            continue;
+        }
+
+        block->dispatched = false;
+        if (block->result == 0) {
+            stageCompleteFecBlock(&block->entries, &queue->stagedFecBlockLists[i],
+                                  block->lowestSequenceNumber, block->firstRecvTimeUs);
+        }
+        else {
+            recovered = false;
+            purgeListEntries(&block->entries);
+        }
+    }
+
+    for (i = 0; i < RTPV_MAX_FEC_BLOCKS; i++) {
+        PRTPV_QUEUE_LIST stagedList = &queue->stagedFecBlockLists[i];
+
+        if (!recovered) {
+            purgeListEntries(stagedList);
+            continue;
+        }
+
+        while (stagedList->head != NULL) {
+            PRTPV_QUEUE_ENTRY entry = stagedList->head;
+            removeEntryFromList(stagedList, entry);
+            insertEntryIntoList(&queue->completedFecBlockList, entry);
+        }
+    }
+
+    queue->outstandingRecoveries = 0;
+    return recovered;
+}
+
+// Discards all completed FEC data for the current frame, including
+// any FEC blocks that are still being recovered by the pool
+static void purgeCompletedFecBlocks(PRTP_VIDEO_QUEUE queue) {
+    int i;
+
+    purgeListEntries(&queue->completedFecBlockList);
+
+    if (queue->outstandingRecoveries != 0) {
+        waitForRecoveries(queue);
+
+        for (i = 0; i < RTPV_MAX_FEC_BLOCKS; i++) {
+            if (queue->recoveryBlocks[i].dispatched) {
+                queue->recoveryBlocks[i].dispatched = false;
+                purgeListEntries(&queue->recoveryBlocks[i].entries);
+            }
+
+            purgeListEntries(&queue->stagedFecBlockLists[i]);
+        }
+
+        queue->outstandingRecoveries = 0;
+    }
+}
+
 static void submitCompletedFrame(PRTP_VIDEO_QUEUE queue) {
     while (queue->completedFecBlockList.count > 0) {
         PRTPV_QUEUE_ENTRY entry = queue->completedFecBlockList.head;
@@ -610,7 +978,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
                 if (queue->currentFrameNumber == nvPacket->frameIndex) {
                     // Discard any unsubmitted buffers from the previous frame
                     purgeListEntries(&queue->pendingFecBlockList);
-                    purgeListEntries(&queue->completedFecBlockList);
+                    purgeCompletedFecBlocks(queue);
 
                     // Notify the host of the loss of this frame
                     if (!queue->reportedLostFrame) {
@@ -646,7 +1014,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
 
             // Discard any unsubmitted buffers from the previous frame
             purgeListEntries(&queue->pendingFecBlockList);
-            purgeListEntries(&queue->completedFecBlockList);
+            purgeCompletedFecBlocks(queue);
 
             // Notify the host of the loss of this frame
             if (!queue->reportedLostFrame) {
@@ -665,7 +1033,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
 
         // Discard any completed FEC blocks from the previous frame
         if (queue->currentFrameNumber != nvPacket->frameIndex) {
-            purgeListEntries(&queue->completedFecBlockList);
+            purgeCompletedFecBlocks(queue);
         }
 
         // If the frame numbers are not contiguous, the network dropped an entire frame.
@@ -689,8 +1057,12 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
         // Tell the control stream logic about this frame, even if we don't end up
         // being able to reconstruct a full frame from it.
         connectionSawFrame(queue->currentFrameNumber);
-        
-        queue->bufferFirstRecvTimeMs = PltGetMillis();
+
+        queue->bufferFirstRecvTimeUs = PltGetMicros();
+        if (fecCurrentBlockNumber == 0) {
+            FtRecordFrameStage(queue->currentFrameNumber, FRAME_TRACE_FIRST_PACKET, queue->bufferFirstRecvTimeUs);
+        }
+
         queue->bufferLowestSequenceNumber = U16(packet->sequenceNumber - fecIndex);
         queue->nextContiguousSequenceNumber = queue->bufferLowestSequenceNumber;
         queue->receivedDataPackets = 0;
@@ -763,13 +1135,31 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
             LC_ASSERT(queue->receivedParityPackets <= queue->bufferParityPackets);
         }
         
+        // Timestamp any packet that may complete this frame before we spend
+        // time on FEC recovery, so the frame trace can tell the two apart.
+        uint64_t packetTimeUs = 0;
+        if (queue->multiFecCurrentBlockNumber == queue->multiFecLastBlockNumber &&
+                queue->pendingFecBlockList.count >= queue->bufferDataPackets) {
+            packetTimeUs = PltGetMicros();
+        }
+
         // Try to submit this frame. If we haven't received enough packets,
         // this will fail and we'll keep waiting.
-        if (reconstructFrame(queue) == 0) {
-            // Stage the complete FEC block for use once reassembly is complete
-            stageCompleteFecBlock(queue);
-            
-            // stageCompleteFecBlock() should have consumed all pending FEC data
+        int ret = reconstructFrame(queue);
+        if (ret == 0) {
+            // Stage the complete FEC block for use once reassembly is complete. If an
+            // earlier block of this frame is still being recovered, this block is staged
+            // separately until we can put the frame back together in order.
+            stageCompleteFecBlock(&queue->pendingFecBlockList,
+                                  queue->outstandingRecoveries != 0 ?
+                                      &queue->stagedFecBlockLists[queue->multiFecCurrentBlockNumber] :
+                                      &queue->completedFecBlockList,
+                                  queue->bufferLowestSequenceNumber,
+                                  queue->bufferFirstRecvTimeUs);
+        }
+
+        if (ret == 0 || ret == RTPV_RECOVERY_QUEUED) {
+            // The pending FEC data should have been staged or handed to the recovery pool
             LC_ASSERT(queue->pendingFecBlockList.head == NULL);
             LC_ASSERT(queue->pendingFecBlockList.tail == NULL);
             LC_ASSERT(queue->pendingFecBlockList.count == 0);
@@ -781,8 +1171,25 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
                 queue->multiFecCurrentBlockNumber++;
             }
             else {
-                // Submit all FEC blocks to the depacketizer
-                submitCompletedFrame(queue);
+                FtRecordFrameStage(queue->currentFrameNumber, FRAME_TRACE_LAST_PACKET, packetTimeUs);
+                FtRecordFrameStage(queue->currentFrameNumber, FRAME_TRACE_FEC_COMPLETE, PltGetMicros());
+
+                // Wait for the recovery pool to finish any earlier FEC blocks of this frame
+                if (queue->outstandingRecoveries != 0 && !collectRecoveredFecBlocks(queue)) {
+                    Limelog("Unrecoverable frame %d: FEC recovery failed\n",
+                            queue->currentFrameNumber);
+
+                    // Discard the rest of the frame and notify the host of the loss
+                    purgeListEntries(&queue->completedFecBlockList);
+                    if (!queue->reportedLostFrame) {
+                        notifyFrameLost(queue->currentFrameNumber, false);
+                        queue->reportedLostFrame = true;
+                    }
+                }
+                else {
+                    // Submit all FEC blocks to the depacketizer
+                    submitCompletedFrame(queue);
+                }
 
                 // submitCompletedFrame() should have consumed all completed FEC data
                 LC_ASSERT(queue->completedFecBlockList.head == NULL);
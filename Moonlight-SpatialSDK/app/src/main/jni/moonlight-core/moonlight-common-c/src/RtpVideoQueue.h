@@ -2,11 +2,24 @@
 
 #include "Video.h"
 
+#include "rs.h"
+
+// Number of Reed-Solomon codecs (keyed by data and parity shard count)
+// that are kept around to avoid rebuilding them for each recovered frame
+#define RTPV_RS_CACHE_SIZE 8
+
+// Multi-FEC frames are split into at most 4 FEC blocks
+#define RTPV_MAX_FEC_BLOCKS 4
+
+// Number of threads that recover the earlier FEC blocks of a multi-FEC
+// frame while the receive thread continues to read the later blocks
+#define RTPV_FEC_RECOVERY_THREADS 2
+
 typedef struct _RTPV_QUEUE_ENTRY {
     struct _RTPV_QUEUE_ENTRY* next;
     struct _RTPV_QUEUE_ENTRY* prev;
     PRTP_PACKET packet;
-    uint64_t receiveTimeMs;
+    uint64_t receiveTimeUs;
     uint32_t presentationTimeMs;
     int length;
     bool isParity;
@@ -18,11 +31,63 @@ typedef struct _RTPV_QUEUE_LIST {
     uint32_t count;
 } RTPV_QUEUE_LIST, *PRTPV_QUEUE_LIST;
 
+// A complete FEC block that has been detached from the RTP queue for
+// recovery. Everything the recovery needs is copied in here, so it
+// can be reconstructed without touching the RTP_VIDEO_QUEUE.
+typedef struct _RTPV_FEC_BLOCK {
+    struct _RTPV_FEC_BLOCK* next;
+    RTPV_QUEUE_LIST entries;
+    unsigned char** packets;
+    unsigned char* marks;
+    uint64_t firstRecvTimeUs;
+    uint32_t frameNumber;
+    uint32_t lowestSequenceNumber;
+    uint32_t firstParitySequenceNumber;
+    uint32_t dataPackets;
+    uint32_t parityPackets;
+    uint32_t receivedDataPackets;
+    uint8_t multiFecBlockNumber;
+    uint8_t multiFecLastBlockNumber;
+    bool multiFecCapable;
+
+    // FEC validation mode state
+    unsigned int dropIndex;
+    PRTP_PACKET droppedPacket;
+    int droppedPacketLength;
+
+    // Set by the receive thread when the block is handed to the recovery pool
+    bool dispatched;
+
+    // Protected by the recovery pool mutex
+    bool recovering;
+    int result;
+} RTPV_FEC_BLOCK, *PRTPV_FEC_BLOCK;
+
+typedef struct _RTPV_RECOVERY_WORKER {
+    PLT_THREAD thread;
+    struct _RTPV_RECOVERY_POOL* pool;
+
+    // Reed-Solomon codecs are not thread-safe, so each worker has its own
+    reed_solomon* rsCache[RTPV_RS_CACHE_SIZE];
+} RTPV_RECOVERY_WORKER, *PRTPV_RECOVERY_WORKER;
+
+typedef struct _RTPV_RECOVERY_POOL {
+    PLT_MUTEX mutex;
+    PLT_COND jobCond;
+    PLT_COND doneCond;
+    PRTPV_FEC_BLOCK jobHead;
+    PRTPV_FEC_BLOCK jobTail;
+    bool initialized;
+    bool stopping;
+    int threadCount;
+    RTPV_RECOVERY_WORKER workers[RTPV_FEC_RECOVERY_THREADS];
+} RTPV_RECOVERY_POOL, *PRTPV_RECOVERY_POOL;
+
 typedef struct _RTP_VIDEO_QUEUE {
     RTPV_QUEUE_LIST pendingFecBlockList;
     RTPV_QUEUE_LIST completedFecBlockList;
 
-    uint64_t bufferFirstRecvTimeMs;
+    uint64_t bufferFirstRecvTimeUs;
     uint32_t bufferLowestSequenceNumber;
     uint32_t bufferHighestSequenceNumber;
     uint32_t bufferFirstParitySequenceNumber;
@@ -45,8 +110,30 @@ typedef struct _RTP_VIDEO_QUEUE {
 
     uint32_t lastOosFramePresentationTimestamp;
     bool receivedOosData;
+
+    // Most recently used first
+    reed_solomon* rsCache[RTPV_RS_CACHE_SIZE];
+
+    bool fecValidationMode;
+
+    // FEC blocks of the current frame being recovered by the pool, indexed
+    // by FEC block number. Blocks that complete after an earlier block was
+    // dispatched are staged separately to preserve the frame's packet order.
+    RTPV_RECOVERY_POOL recoveryPool;
+    RTPV_FEC_BLOCK recoveryBlocks[RTPV_MAX_FEC_BLOCKS];
+    RTPV_QUEUE_LIST stagedFecBlockLists[RTPV_MAX_FEC_BLOCKS];
+    uint32_t outstandingRecoveries;
+
+    // Recovery pool statistics
+    uint32_t asyncRecoveries;
+    uint64_t recoveryWaitUs;
 } RTP_VIDEO_QUEUE, *PRTP_VIDEO_QUEUE;
 
+// Each video packet buffer holds the (decrypted) RTP packet followed by
+// the RTPV_QUEUE_ENTRY used to track it through the RTP queue.
+#define VIDEO_PACKET_BUFFER_SIZE(packetSize) \
+    ((packetSize) + MAX_RTP_HEADER_SIZE + (int)sizeof(RTPV_QUEUE_ENTRY))
+
 #define RTPF_RET_QUEUED    0
 #define RTPF_RET_REJECTED  1
 
@@ -55,3 +142,7 @@ void RtpvCleanupQueue(PRTP_VIDEO_QUEUE queue);
 int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_QUEUE_ENTRY packetEntry);
 uint32_t RtpvGetCurrentFrameNumber(PRTP_VIDEO_QUEUE queue);
 void RtpvSubmitQueuedPackets(PRTP_VIDEO_QUEUE queue);
+
+// Sets the number of recovery pool threads for queues initialized afterwards,
+// up to RTPV_FEC_RECOVERY_THREADS. With 0, all FEC recovery is done inline.
+void RtpvSetRecoveryThreadCount(int threadCount);
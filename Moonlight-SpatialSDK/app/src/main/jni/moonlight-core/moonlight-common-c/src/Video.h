@@ -1,10 +1,10 @@
 #pragma once
 
-#include "LinkedBlockingQueue.h"
+#include "LockFreeQueue.h"
 
 typedef struct _QUEUED_DECODE_UNIT {
     DECODE_UNIT decodeUnit;
-    LINKED_BLOCKING_QUEUE_ENTRY entry;
+    void* frameBuffer;
 } QUEUED_DECODE_UNIT, *PQUEUED_DECODE_UNIT;
 
 #pragma pack(push, 1)
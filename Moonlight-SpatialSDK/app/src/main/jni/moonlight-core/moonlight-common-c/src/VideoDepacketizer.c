@@ -3,6 +3,16 @@
 // Uncomment to test 3 byte Annex B start sequences with GFE
 //#define FORCE_3_BYTE_START_SEQUENCES
 
+// Start sequence scanning can test for zero byte pairs 32 bytes at a time
+// when SSE2 or NEON is available at compile time.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANNEXB_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define ANNEXB_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 static PLENTRY nalChainHead;
 static PLENTRY nalChainTail;
 static int nalChainDataLength;
@@ -19,17 +29,61 @@ static uint16_t lastPacketPayloadLength;
 static bool strictIdrFrameWait;
 static uint64_t syntheticPtsBase;
 static uint16_t frameHostProcessingLatency;
-static uint64_t firstPacketReceiveTime;
+static uint64_t firstPacketReceiveTimeUs;
 static unsigned int firstPacketPresentationTime;
 static bool dropStatePending;
 static bool idrFrameProcessed;
 
+// Set when part of the current frame could not be stored
+static bool frameCorrupt;
+
 #define DR_CLEANUP -1000
 
 #define CONSECUTIVE_DROP_LIMIT 120
 static unsigned int consecutiveFrameDrops;
 
-static LINKED_BLOCKING_QUEUE decodeUnitQueue;
+static LOCK_FREE_QUEUE decodeUnitQueue;
+
+typedef struct _LENTRY_INTERNAL {
+    LENTRY entry;
+    void* allocPtr;
+} LENTRY_INTERNAL, *PLENTRY_INTERNAL;
+
+// Adjacent picture data shares an entry, so a frame only needs a few entries
+// for its parameter sets and the picture data between them.
+#define FRAME_BUFFER_MAX_ENTRIES 16
+
+// Frame buffers for CAPABILITY_CONTIGUOUS_DECODE_UNIT. The frame data follows
+// the header, and nalChainDataLength is the write offset for the current frame.
+// The NAL chain entries are stored in the header, so they need no allocation
+// of their own and are released along with the frame buffer.
+typedef struct _FRAME_BUFFER {
+    size_t capacity;
+    int entryCount;
+    LENTRY_INTERNAL entries[FRAME_BUFFER_MAX_ENTRIES];
+} FRAME_BUFFER, *PFRAME_BUFFER;
+
+#define FRAME_BUFFER_DATA(x) ((char*)((x) + 1))
+
+// Buffers released by the renderer are kept for reuse by later frames
+#define FRAME_BUFFER_POOL_SIZE 4
+
+static bool contiguousDecodeUnits;
+static PFRAME_BUFFER currentFrameBuffer;
+static size_t frameBufferSizeHint;
+static LOCK_FREE_QUEUE frameBufferPool;
+
+// Frame age limit state for the decode unit queue. The newest queued
+// presentation time and IDR frame number are published by the receive
+// thread. The statistics are only updated by the thread dequeuing frames,
+// except for overflowIdrSkips which is only updated by the receive thread.
+static int maxQueuedFrameAgeMs;
+static PLT_ATOMIC_INT newestQueuedPresentationTime;
+static PLT_ATOMIC_INT newestQueuedIdrFrameNumber;
+static VIDEO_QUEUE_STATS queueStats;
+static bool queueStatsValid;
+static bool skippingToIdrFrame;
+static int skipTargetFrameNumber;
 
 typedef struct _BUFFER_DESC {
     char* data;
@@ -37,11 +91,6 @@ typedef struct _BUFFER_DESC {
     unsigned int length;
 } BUFFER_DESC, *PBUFFER_DESC;
 
-typedef struct _LENTRY_INTERNAL {
-    LENTRY entry;
-    void* allocPtr;
-} LENTRY_INTERNAL, *PLENTRY_INTERNAL;
-
 #define H264_NAL_TYPE(x) ((x) & 0x1F)
 #define HEVC_NAL_TYPE(x) (((x) & 0x7E) >> 1)
 
@@ -57,9 +106,100 @@ typedef struct _LENTRY_INTERNAL {
 #define HEVC_NAL_TYPE_FILLER 38
 #define HEVC_NAL_TYPE_SEI 39
 
+// Codec-independent classes of Annex B NAL units
+#define NAL_CLASS_NONE      0 // Not at the start of a NAL unit
+#define NAL_CLASS_OTHER     1
+#define NAL_CLASS_AUD       2
+#define NAL_CLASS_SEI       3
+#define NAL_CLASS_FILLER    4
+#define NAL_CLASS_VPS       5
+#define NAL_CLASS_SPS       6
+#define NAL_CLASS_PPS       7
+#define NAL_CLASS_REF_SLICE 8 // Slice of an IDR or IRAP picture
+
+// Set up for the negotiated codec when the depacketizer is initialized.
+// The class table is indexed by the first byte of the NAL unit header.
+static bool annexBStream;
+static uint8_t nalHeaderClasses[256];
+static int idrFrameStartClass;
+
+static int getH264NalClass(int nalType) {
+    switch (nalType) {
+    case 5:
+        return NAL_CLASS_REF_SLICE;
+    case H264_NAL_TYPE_SEI:
+        return NAL_CLASS_SEI;
+    case H264_NAL_TYPE_SPS:
+        return NAL_CLASS_SPS;
+    case H264_NAL_TYPE_PPS:
+        return NAL_CLASS_PPS;
+    case H264_NAL_TYPE_AUD:
+        return NAL_CLASS_AUD;
+    case H264_NAL_TYPE_FILLER:
+        return NAL_CLASS_FILLER;
+    default:
+        return NAL_CLASS_OTHER;
+    }
+}
+
+static int getHevcNalClass(int nalType) {
+    switch (nalType) {
+    case 16:
+    case 17:
+    case 18:
+    case 19:
+    case 20:
+    case 21:
+        return NAL_CLASS_REF_SLICE;
+    case HEVC_NAL_TYPE_VPS:
+        return NAL_CLASS_VPS;
+    case HEVC_NAL_TYPE_SPS:
+        return NAL_CLASS_SPS;
+    case HEVC_NAL_TYPE_PPS:
+        return NAL_CLASS_PPS;
+    case HEVC_NAL_TYPE_AUD:
+        return NAL_CLASS_AUD;
+    case HEVC_NAL_TYPE_FILLER:
+        return NAL_CLASS_FILLER;
+    case HEVC_NAL_TYPE_SEI:
+        return NAL_CLASS_SEI;
+    default:
+        return NAL_CLASS_OTHER;
+    }
+}
+
+// Build the NAL classification table for the negotiated codec, so the
+// per-packet code doesn't need to check the codec on every NAL unit.
+static void initializeNalClasses(void) {
+    int i;
+
+    annexBStream = (NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265)) != 0;
+
+    for (i = 0; i < (int)sizeof(nalHeaderClasses); i++) {
+        if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
+            nalHeaderClasses[i] = (uint8_t)getH264NalClass(H264_NAL_TYPE(i));
+        }
+        else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
+            nalHeaderClasses[i] = (uint8_t)getHevcNalClass(HEVC_NAL_TYPE(i));
+        }
+        else {
+            // We don't parse other bitstreams
+            nalHeaderClasses[i] = NAL_CLASS_OTHER;
+        }
+    }
+
+    // IDR frames start with the first parameter set of the codec
+    idrFrameStartClass = (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) ? NAL_CLASS_VPS : NAL_CLASS_SPS;
+}
+
 // Init
 void initializeVideoDepacketizer(int pktSize) {
-    LbqInitializeLinkedBlockingQueue(&decodeUnitQueue, 15);
+    LfqInitializeQueue(&decodeUnitQueue, 15);
+    PltAtomicStore(&newestQueuedPresentationTime, 0);
+    PltAtomicStore(&newestQueuedIdrFrameNumber, 0);
+    memset(&queueStats, 0, sizeof(queueStats));
+    queueStatsValid = true;
+    skippingToIdrFrame = false;
 
     nextFrameNumber = 1;
     startFrameNumber = 0;
@@ -70,12 +210,97 @@ void initializeVideoDepacketizer(int pktSize) {
     decodingFrame = false;
     syntheticPtsBase = 0;
     frameHostProcessingLatency = 0;
-    firstPacketReceiveTime = 0;
+    firstPacketReceiveTimeUs = 0;
     firstPacketPresentationTime = 0;
     lastPacketPayloadLength = 0;
     dropStatePending = false;
     idrFrameProcessed = false;
+    frameCorrupt = false;
     strictIdrFrameWait = !isReferenceFrameInvalidationEnabled();
+    initializeNalClasses();
+
+    contiguousDecodeUnits = (VideoCallbacks.capabilities & CAPABILITY_CONTIGUOUS_DECODE_UNIT) != 0;
+    currentFrameBuffer = NULL;
+    frameBufferSizeHint = 0;
+    if (contiguousDecodeUnits) {
+        LfqInitializeQueue(&frameBufferPool, FRAME_BUFFER_POOL_SIZE);
+    }
+}
+
+static void releaseFrameBuffer(PFRAME_BUFFER frameBuffer) {
+    frameBuffer->entryCount = 0;
+    if (LfqOfferQueueItem(&frameBufferPool, frameBuffer) != LBQ_SUCCESS) {
+        free(frameBuffer);
+    }
+}
+
+// Ensures the current frame buffer can hold the specified number of bytes
+static bool reserveFrameBuffer(size_t length) {
+    PFRAME_BUFFER newFrameBuffer;
+    size_t newCapacity;
+    size_t offset;
+    int i;
+
+    if (currentFrameBuffer == NULL && LfqPollQueueElement(&frameBufferPool, (void**)&currentFrameBuffer) != LBQ_SUCCESS) {
+        currentFrameBuffer = NULL;
+    }
+
+    if (currentFrameBuffer != NULL && currentFrameBuffer->capacity >= length) {
+        return true;
+    }
+
+    // Grow geometrically in case the size hint from the FEC header was too small
+    newCapacity = frameBufferSizeHint;
+    if (currentFrameBuffer != NULL && newCapacity < currentFrameBuffer->capacity * 2) {
+        newCapacity = currentFrameBuffer->capacity * 2;
+    }
+    if (newCapacity < length) {
+        newCapacity = length;
+    }
+
+    newFrameBuffer = (PFRAME_BUFFER)realloc(currentFrameBuffer, sizeof(*newFrameBuffer) + newCapacity);
+    if (newFrameBuffer == NULL) {
+        return false;
+    }
+
+    if (currentFrameBuffer == NULL) {
+        newFrameBuffer->entryCount = 0;
+    }
+    newFrameBuffer->capacity = newCapacity;
+    currentFrameBuffer = newFrameBuffer;
+
+    // The entries moved along with the buffer and their data is laid out back to back,
+    // so the chain can be rebuilt in place
+    offset = 0;
+    for (i = 0; i < currentFrameBuffer->entryCount; i++) {
+        PLENTRY entry = &currentFrameBuffer->entries[i].entry;
+
+        entry->data = FRAME_BUFFER_DATA(currentFrameBuffer) + offset;
+        entry->next = i + 1 < currentFrameBuffer->entryCount ? &currentFrameBuffer->entries[i + 1].entry : NULL;
+        offset += entry->length;
+    }
+    if (currentFrameBuffer->entryCount != 0) {
+        nalChainHead = &currentFrameBuffer->entries[0].entry;
+        nalChainTail = &currentFrameBuffer->entries[currentFrameBuffer->entryCount - 1].entry;
+    }
+
+    return true;
+}
+
+static void destroyFrameBuffers(void) {
+    PFRAME_BUFFER frameBuffer;
+
+    if (!contiguousDecodeUnits) {
+        return;
+    }
+
+    free(currentFrameBuffer);
+    currentFrameBuffer = NULL;
+
+    while (LfqFlushQueueElement(&frameBufferPool, (void**)&frameBuffer) == LBQ_SUCCESS) {
+        free(frameBuffer);
+    }
+    LfqDestroyQueue(&frameBufferPool);
 }
 
 // Free the NAL chain
@@ -85,12 +310,17 @@ static void cleanupFrameState(void) {
     while (nalChainHead != NULL) {
         lastEntry = (PLENTRY_INTERNAL)nalChainHead;
         nalChainHead = lastEntry->entry.next;
-        free(lastEntry->allocPtr);
+        freeVideoPacketBuffer(lastEntry->allocPtr);
     }
 
     nalChainTail = NULL;
 
     nalChainDataLength = 0;
+
+    // The frame buffer is kept for the next frame
+    if (currentFrameBuffer != NULL) {
+        currentFrameBuffer->entryCount = 0;
+    }
 }
 
 // Cleanup frame state and set that we're waiting for an IDR Frame
@@ -128,64 +358,124 @@ static void dropFrameState(void) {
     cleanupFrameState();
 }
 
-// Cleanup the list of decode units
-static void freeDecodeUnitList(PLINKED_BLOCKING_QUEUE_ENTRY entry) {
-    PLINKED_BLOCKING_QUEUE_ENTRY nextEntry;
-
-    while (entry != NULL) {
-        nextEntry = entry->flink;
+// Cleanup the decode units remaining in the queue
+static void flushDecodeUnitQueue(void) {
+    PQUEUED_DECODE_UNIT qdu;
 
+    while (LfqFlushQueueElement(&decodeUnitQueue, (void**)&qdu) == LBQ_SUCCESS) {
         // Complete this with a failure status
-        LiCompleteVideoFrame(entry->data, DR_CLEANUP);
-
-        entry = nextEntry;
+        LiCompleteVideoFrame(qdu, DR_CLEANUP);
     }
 }
 
 void stopVideoDepacketizer(void) {
-    LbqSignalQueueShutdown(&decodeUnitQueue);
+    LfqSignalQueueShutdown(&decodeUnitQueue);
 }
 
 // Cleanup video depacketizer and free malloced memory
 void destroyVideoDepacketizer(void) {
-    freeDecodeUnitList(LbqDestroyLinkedBlockingQueue(&decodeUnitQueue));
+    queueStatsValid = false;
+    flushDecodeUnitQueue();
+    LfqDestroyQueue(&decodeUnitQueue);
     cleanupFrameState();
+    destroyFrameBuffers();
 }
 
+// Returns the length of the Annex B start sequence at the beginning of the data or 0 if there isn't one
 // NB: This function also ensures an additional byte for the NALU type exists after the start sequence
-static bool getAnnexBStartSequence(PBUFFER_DESC current, PBUFFER_DESC startSeq) {
-    // We must not get called for other codecs
-    LC_ASSERT(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265));
-
-    if (current->length <= 3) {
-        return false;
+unsigned int getAnnexBStartSequenceLength(const char* data, unsigned int length) {
+    if (length <= 3) {
+        return 0;
     }
 
-    if (current->data[current->offset] == 0 &&
-        current->data[current->offset + 1] == 0) {
-        if (current->data[current->offset + 2] == 0) {
-            if (current->length > 4 && current->data[current->offset + 3] == 1) {
+    if (data[0] == 0 && data[1] == 0) {
+        if (data[2] == 0) {
+            if (length > 4 && data[3] == 1) {
                 // Frame start
-                if (startSeq != NULL) {
-                    startSeq->data = current->data;
-                    startSeq->offset = current->offset;
-                    startSeq->length = 4;
-                }
-                return true;
+                return 4;
             }
         }
-        else if (current->data[current->offset + 2] == 1) {
+        else if (data[2] == 1) {
             // NAL start
-            if (startSeq != NULL) {
-                startSeq->data = current->data;
-                startSeq->offset = current->offset;
-                startSeq->length = 3;
+            return 3;
+        }
+    }
+
+    return 0;
+}
+
+// Returns the offset of the first Annex B start sequence in the data or the length if there isn't one
+unsigned int findAnnexBStartSequence(const char* data, unsigned int length) {
+    unsigned int i = 0;
+
+#if defined(ANNEXB_SIMD_SSE2) || defined(ANNEXB_SIMD_NEON)
+    // Every start sequence begins with a pair of zero bytes, which are rare in
+    // compressed slice data thanks to emulation prevention. We look for a zero
+    // byte followed by another zero byte 32 positions at a time and only do the
+    // full check on blocks that contain one. Each block reads one byte past its
+    // end to pair the last position with its successor.
+    while (i + 33 <= length) {
+        bool foundZeroPair;
+
+#if defined(ANNEXB_SIMD_SSE2)
+        __m128i zero = _mm_setzero_si128();
+        __m128i pairs0 = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[i]), zero),
+                                       _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[i + 1]), zero));
+        __m128i pairs1 = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[i + 16]), zero),
+                                       _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[i + 17]), zero));
+        foundZeroPair = _mm_movemask_epi8(_mm_or_si128(pairs0, pairs1)) != 0;
+#else
+        const uint8_t* bytes = (const uint8_t*)data;
+        uint8x16_t pairs0 = vandq_u8(vceqq_u8(vld1q_u8(&bytes[i]), vdupq_n_u8(0)),
+                                     vceqq_u8(vld1q_u8(&bytes[i + 1]), vdupq_n_u8(0)));
+        uint8x16_t pairs1 = vandq_u8(vceqq_u8(vld1q_u8(&bytes[i + 16]), vdupq_n_u8(0)),
+                                     vceqq_u8(vld1q_u8(&bytes[i + 17]), vdupq_n_u8(0)));
+        uint64x2_t pairs = vreinterpretq_u64_u8(vorrq_u8(pairs0, pairs1));
+        foundZeroPair = (vgetq_lane_u64(pairs, 0) | vgetq_lane_u64(pairs, 1)) != 0;
+#endif
+
+        if (foundZeroPair) {
+            unsigned int blockEnd = i + 32;
+
+            for (; i < blockEnd; i++) {
+                if (getAnnexBStartSequenceLength(&data[i], length - i) != 0) {
+                    return i;
+                }
             }
-            return true;
+        }
+        else {
+            i += 32;
+        }
+    }
+#endif
+
+    for (; i < length; i++) {
+        if (getAnnexBStartSequenceLength(&data[i], length - i) != 0) {
+            return i;
         }
     }
 
-    return false;
+    return length;
+}
+
+static bool getAnnexBStartSequence(PBUFFER_DESC current, PBUFFER_DESC startSeq) {
+    unsigned int startSeqLength;
+
+    // We must not get called for other codecs
+    LC_ASSERT(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265));
+
+    startSeqLength = getAnnexBStartSequenceLength(&current->data[current->offset], current->length);
+    if (startSeqLength == 0) {
+        return false;
+    }
+
+    if (startSeq != NULL) {
+        startSeq->data = current->data;
+        startSeq->offset = current->offset;
+        startSeq->length = startSeqLength;
+    }
+
+    return true;
 }
 
 void validateDecodeUnitForPlayback(PDECODE_UNIT decodeUnit) {
@@ -231,15 +521,106 @@ void validateDecodeUnitForPlayback(PDECODE_UNIT decodeUnit) {
     }
 }
 
+// Returns how far the frame trails the newest queued frame
+static int getQueuedFrameAge(PQUEUED_DECODE_UNIT qdu) {
+    int32_t age = (int32_t)((uint32_t)PltAtomicLoad(&newestQueuedPresentationTime) - qdu->decodeUnit.presentationTimeMs);
+
+    // The newest presentation time is published after the frame is queued
+    return age < 0 ? 0 : age;
+}
+
+static void recordDequeuedFrame(int age) {
+    int depth = LfqGetItemCount(&decodeUnitQueue);
+    int ageBucket = age / VIDEO_QUEUE_AGE_BUCKET_MS;
+
+    queueStats.framesDequeued++;
+    queueStats.depthHistogram[depth < VIDEO_QUEUE_DEPTH_BUCKETS ? depth : VIDEO_QUEUE_DEPTH_BUCKETS - 1]++;
+    queueStats.ageHistogram[ageBucket < VIDEO_QUEUE_AGE_BUCKETS ? ageBucket : VIDEO_QUEUE_AGE_BUCKETS - 1]++;
+}
+
+// Dequeues the next decode unit, skipping any that exceed the frame age limit
+static int takeDecodeUnit(PQUEUED_DECODE_UNIT* qdu, bool wait) {
+    for (;;) {
+        int idrFrameNumber;
+        int age;
+        int err;
+
+        if (wait) {
+            err = LfqWaitForQueueElement(&decodeUnitQueue, (void**)qdu);
+        }
+        else {
+            err = LfqPollQueueElement(&decodeUnitQueue, (void**)qdu);
+        }
+        if (err != LBQ_SUCCESS) {
+            return err;
+        }
+
+        // Once we've started skipping frames, the remaining frames before the IDR
+        // frame must be dropped too, because they may reference the skipped ones.
+        if (skippingToIdrFrame) {
+            if ((int32_t)((uint32_t)skipTargetFrameNumber - (uint32_t)(*qdu)->decodeUnit.frameNumber) > 0) {
+                queueStats.framesSkipped++;
+                LiCompleteVideoFrame(*qdu, DR_CLEANUP);
+                continue;
+            }
+
+            skippingToIdrFrame = false;
+        }
+
+        age = getQueuedFrameAge(*qdu);
+        if (maxQueuedFrameAgeMs == 0 || age <= maxQueuedFrameAgeMs) {
+            recordDequeuedFrame(age);
+            return LBQ_SUCCESS;
+        }
+
+        idrFrameNumber = PltAtomicLoad(&newestQueuedIdrFrameNumber);
+        if ((int32_t)((uint32_t)idrFrameNumber - (uint32_t)(*qdu)->decodeUnit.frameNumber) > 0) {
+            // A newer IDR frame is queued, so nothing after it can depend on the frames
+            // before it. We can drop everything up to that point without corrupting the stream.
+            skippingToIdrFrame = true;
+            skipTargetFrameNumber = idrFrameNumber;
+            queueStats.framesSkipped++;
+            LiCompleteVideoFrame(*qdu, DR_CLEANUP);
+        }
+        else if (idrFrameNumber == (*qdu)->decodeUnit.frameNumber) {
+            // This is the newest IDR frame we have, so it's the best place to resume
+            recordDequeuedFrame(age);
+            return LBQ_SUCCESS;
+        }
+        else {
+            // There's no safe point to skip ahead to, so start over with a new IDR frame
+            Limelog("Video frame %d exceeded the frame age limit (%d ms)\n",
+                    (*qdu)->decodeUnit.frameNumber, age);
+            queueStats.ageRefreshes++;
+            LiCompleteVideoFrame(*qdu, DR_CLEANUP);
+            requestDecoderRefresh();
+        }
+    }
+}
+
+void LiSetVideoFrameAgeLimit(int maxAgeMs) {
+    maxQueuedFrameAgeMs = maxAgeMs;
+}
+
+bool LiGetVideoQueueStats(PVIDEO_QUEUE_STATS stats) {
+    if (!queueStatsValid || (VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT)) {
+        return false;
+    }
+
+    memcpy(stats, &queueStats, sizeof(*stats));
+    return true;
+}
+
 bool LiWaitForNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeUnit) {
     PQUEUED_DECODE_UNIT qdu;
 
-    int err = LbqWaitForQueueElement(&decodeUnitQueue, (void**)&qdu);
+    int err = takeDecodeUnit(&qdu, true);
     if (err != LBQ_SUCCESS) {
         return false;
     }
 
     validateDecodeUnitForPlayback(&qdu->decodeUnit);
+    FtRecordFrameStage(qdu->decodeUnit.frameNumber, FRAME_TRACE_SUBMITTED, PltGetMicros());
 
     *frameHandle = qdu;
     *decodeUnit = &qdu->decodeUnit;
@@ -249,12 +630,13 @@ bool LiWaitForNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* deco
 bool LiPollNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeUnit) {
     PQUEUED_DECODE_UNIT qdu;
 
-    int err = LbqPollQueueElement(&decodeUnitQueue, (void**)&qdu);
+    int err = takeDecodeUnit(&qdu, false);
     if (err != LBQ_SUCCESS) {
         return false;
     }
 
     validateDecodeUnitForPlayback(&qdu->decodeUnit);
+    FtRecordFrameStage(qdu->decodeUnit.frameNumber, FRAME_TRACE_SUBMITTED, PltGetMicros());
 
     *frameHandle = qdu;
     *decodeUnit = &qdu->decodeUnit;
@@ -264,7 +646,7 @@ bool LiPollNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeU
 bool LiPeekNextVideoFrame(PDECODE_UNIT* decodeUnit) {
     PQUEUED_DECODE_UNIT qdu;
 
-    int err = LbqPeekQueueElement(&decodeUnitQueue, (void**)&qdu);
+    int err = LfqPeekQueueElement(&decodeUnitQueue, (void**)&qdu);
     if (err != LBQ_SUCCESS) {
         return false;
     }
@@ -276,7 +658,7 @@ bool LiPeekNextVideoFrame(PDECODE_UNIT* decodeUnit) {
 }
 
 void LiWakeWaitForVideoFrame(void) {
-    LbqSignalQueueUserWake(&decodeUnitQueue);
+    LfqSignalQueueUserWake(&decodeUnitQueue);
 }
 
 // Cleanup a decode unit by freeing the buffer chain and the holder
@@ -297,7 +679,12 @@ void LiCompleteVideoFrame(VIDEO_FRAME_HANDLE handle, int drStatus) {
     while (qdu->decodeUnit.bufferList != NULL) {
         lastEntry = (PLENTRY_INTERNAL)qdu->decodeUnit.bufferList;
         qdu->decodeUnit.bufferList = lastEntry->entry.next;
-        free(lastEntry->allocPtr);
+        freeVideoPacketBuffer(lastEntry->allocPtr);
+    }
+
+    if (qdu->frameBuffer != NULL) {
+        releaseFrameBuffer(qdu->frameBuffer);
+        qdu->frameBuffer = NULL;
     }
 
     // We will have stack-allocated entries iff we have a direct-submit decoder
@@ -306,117 +693,24 @@ void LiCompleteVideoFrame(VIDEO_FRAME_HANDLE handle, int drStatus) {
     }
 }
 
-static bool isSeqReferenceFrameStart(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
-
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
-    }
-
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == 5;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        switch (HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length])) {
-            case 16:
-            case 17:
-            case 18:
-            case 19:
-            case 20:
-            case 21:
-                return true;
-
-            default:
-                return false;
-        }
-    }
-    else {
-        LC_ASSERT(false);
-        return false;
-    }
-}
-
-static bool isAccessUnitDelimiter(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
-
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
-    }
+// Returns the NAL_CLASS_* of the NAL unit at the current position
+static int classifyNal(PBUFFER_DESC buffer) {
+    unsigned int startSeqLength;
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_AUD;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_AUD;
-    }
-    else {
-        LC_ASSERT(false);
-        return false;
-    }
-}
-
-static bool isSeiNal(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
-
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
-    }
-
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_SEI;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_SEI;
-    }
-    else {
-        LC_ASSERT(false);
-        return false;
-    }
-}
-
-#ifdef LC_DEBUG
-static bool isFillerDataNal(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
-
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
-    }
-
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_FILLER;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_FILLER;
-    }
-    else {
-        LC_ASSERT(false);
-        return false;
-    }
-}
-#endif
-
-static bool isPictureParameterSetNal(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
+    LC_ASSERT(annexBStream);
 
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
+    startSeqLength = getAnnexBStartSequenceLength(&buffer->data[buffer->offset], buffer->length);
+    if (startSeqLength == 0) {
+        return NAL_CLASS_NONE;
     }
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_PPS;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_PPS;
-    }
-    else {
-        LC_ASSERT(false);
-        return false;
-    }
+    return nalHeaderClasses[(uint8_t)buffer->data[buffer->offset + startSeqLength]];
 }
 
 // Advance the buffer descriptor to the start of the next NAL or end of buffer
 static void skipToNextNalOrEnd(PBUFFER_DESC buffer) {
     BUFFER_DESC startSeq;
+    unsigned int skipLength;
 
     // If we're starting on a NAL boundary, skip to the next one
     if (getAnnexBStartSequence(buffer, &startSeq)) {
@@ -424,16 +718,10 @@ static void skipToNextNalOrEnd(PBUFFER_DESC buffer) {
         buffer->length -= startSeq.length;
     }
 
-    // Loop until we find an Annex B start sequence (3 or 4 byte)
-    while (!getAnnexBStartSequence(buffer, NULL)) {
-        if (buffer->length == 0) {
-            // Reached the end of the buffer
-            return;
-        }
-
-        buffer->offset++;
-        buffer->length--;
-    }
+    // Advance to the next Annex B start sequence (3 or 4 byte) or the end of the buffer
+    skipLength = findAnnexBStartSequence(&buffer->data[buffer->offset], buffer->length);
+    buffer->offset += skipLength;
+    buffer->length -= skipLength;
 }
 
 // Advance the buffer descriptor to the start of the next NAL
@@ -444,25 +732,6 @@ static void skipToNextNal(PBUFFER_DESC buffer) {
     LC_ASSERT(buffer->length > 0);
 }
 
-static bool isIdrFrameStart(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
-
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
-    }
-
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_SPS;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_VPS;
-    }
-    else {
-        LC_ASSERT(false);
-        return false;
-    }
-}
-
 // Reassemble the frame with the given frame number
 static void reassembleFrame(int frameNumber) {
     if (nalChainHead != NULL) {
@@ -480,12 +749,17 @@ static void reassembleFrame(int frameNumber) {
         if (qdu != NULL) {
             qdu->decodeUnit.bufferList = nalChainHead;
             qdu->decodeUnit.fullLength = nalChainDataLength;
+            qdu->frameBuffer = currentFrameBuffer;
             qdu->decodeUnit.frameType = frameType;
             qdu->decodeUnit.frameNumber = frameNumber;
             qdu->decodeUnit.frameHostProcessingLatency = frameHostProcessingLatency;
-            qdu->decodeUnit.receiveTimeMs = firstPacketReceiveTime;
+            qdu->decodeUnit.receiveTimeUs = firstPacketReceiveTimeUs;
+            qdu->decodeUnit.receiveTimeMs = firstPacketReceiveTimeUs / 1000;
             qdu->decodeUnit.presentationTimeMs = firstPacketPresentationTime;
-            qdu->decodeUnit.enqueueTimeMs = LiGetMillis();
+            qdu->decodeUnit.enqueueTimeUs = PltGetMicros();
+            qdu->decodeUnit.enqueueTimeMs = qdu->decodeUnit.enqueueTimeUs / 1000;
+
+            FtRecordFrameStage(frameNumber, FRAME_TRACE_REASSEMBLED, qdu->decodeUnit.enqueueTimeUs);
 
             // These might be wrong for a few frames during a transition between SDR and HDR,
             // but the effects shouldn't very noticable since that's an infrequent operation.
@@ -501,9 +775,26 @@ static void reassembleFrame(int frameNumber) {
 
             nalChainHead = nalChainTail = NULL;
             nalChainDataLength = 0;
+            currentFrameBuffer = NULL;
 
             if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-                if (LbqOfferQueueItem(&decodeUnitQueue, qdu, &qdu->entry) == LBQ_BOUND_EXCEEDED) {
+                int err = LfqOfferQueueItem(&decodeUnitQueue, qdu);
+                if (err == LBQ_BOUND_EXCEEDED && qdu->decodeUnit.frameType == FRAME_TYPE_IDR) {
+                    // The frames ahead of an IDR frame can be dropped without corrupting
+                    // the stream, so we don't need to wait for another IDR frame.
+                    Limelog("Video decode unit queue overflow - skipping to IDR frame\n");
+                    queueStats.overflowIdrSkips++;
+                    flushDecodeUnitQueue();
+                    err = LfqOfferQueueItem(&decodeUnitQueue, qdu);
+                }
+
+                if (err == LBQ_SUCCESS) {
+                    PltAtomicStore(&newestQueuedPresentationTime, (int32_t)qdu->decodeUnit.presentationTimeMs);
+                    if (qdu->decodeUnit.frameType == FRAME_TYPE_IDR) {
+                        PltAtomicStore(&newestQueuedIdrFrameNumber, (int32_t)qdu->decodeUnit.frameNumber);
+                    }
+                }
+                else if (err == LBQ_BOUND_EXCEEDED) {
                     Limelog("Video decode unit queue overflow\n");
 
                     // RFI recovery is not supported here
@@ -512,13 +803,14 @@ static void reassembleFrame(int frameNumber) {
                     // Clear NAL state for the frame that we failed to enqueue
                     nalChainHead = qdu->decodeUnit.bufferList;
                     nalChainDataLength = qdu->decodeUnit.fullLength;
+                    currentFrameBuffer = qdu->frameBuffer;
                     dropFrameState();
 
                     // Free the DU we were going to queue
                     free(qdu);
 
                     // Free all frames in the decode unit queue
-                    freeDecodeUnitList(LbqFlushQueueItems(&decodeUnitQueue));
+                    flushDecodeUnitQueue();
 
                     // Request an IDR frame to recover
                     LiRequestIdrFrame();
@@ -528,6 +820,7 @@ static void reassembleFrame(int frameNumber) {
             else {
                 // Submit the frame to the decoder
                 validateDecodeUnitForPlayback(&qdu->decodeUnit);
+                FtRecordFrameStage(frameNumber, FRAME_TRACE_SUBMITTED, PltGetMicros());
                 LiCompleteVideoFrame(qdu, VideoCallbacks.submitDecodeUnit(&qdu->decodeUnit));
             }
 
@@ -543,63 +836,87 @@ static void reassembleFrame(int frameNumber) {
     }
 }
 
-static int getBufferFlags(char* data, int length) {
-    BUFFER_DESC buffer;
-    BUFFER_DESC candidate;
+static int getBufferType(int nalClass) {
+    switch (nalClass) {
+    case NAL_CLASS_SPS:
+        return BUFFER_TYPE_SPS;
 
-    // We only parse H.264 and HEVC bitstreams
-    if (!(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265))) {
-        return BUFFER_TYPE_PICDATA;
-    }
+    case NAL_CLASS_PPS:
+        return BUFFER_TYPE_PPS;
 
-    buffer.data = data;
-    buffer.length = (unsigned int)length;
-    buffer.offset = 0;
+    case NAL_CLASS_VPS:
+        return BUFFER_TYPE_VPS;
 
-    if (!getAnnexBStartSequence(&buffer, &candidate)) {
+    default:
         return BUFFER_TYPE_PICDATA;
     }
+}
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        switch (H264_NAL_TYPE(candidate.data[candidate.offset + candidate.length])) {
-        case H264_NAL_TYPE_SPS:
-            return BUFFER_TYPE_SPS;
+// Copies a fragment into the contiguous frame buffer. The packet buffer remains owned by the caller.
+static void queueContiguousFragment(char* data, int length, int nalClass) {
+    int bufferType = getBufferType(nalClass);
+    PLENTRY_INTERNAL entry;
 
-        case H264_NAL_TYPE_PPS:
-            return BUFFER_TYPE_PPS;
+    if (!reserveFrameBuffer((size_t)nalChainDataLength + length)) {
+        frameCorrupt = true;
+        return;
+    }
 
-        default:
-            return BUFFER_TYPE_PICDATA;
-        }
+    // Adjacent picture data can simply extend the previous entry
+    if (nalChainTail != NULL && bufferType == BUFFER_TYPE_PICDATA && nalChainTail->bufferType == BUFFER_TYPE_PICDATA) {
+        memcpy(&FRAME_BUFFER_DATA(currentFrameBuffer)[nalChainDataLength], data, length);
+        nalChainTail->length += length;
+        nalChainDataLength += length;
+        return;
+    }
+
+    if (currentFrameBuffer->entryCount == FRAME_BUFFER_MAX_ENTRIES) {
+        frameCorrupt = true;
+        return;
     }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        switch (HEVC_NAL_TYPE(candidate.data[candidate.offset + candidate.length])) {
-            case HEVC_NAL_TYPE_SPS:
-                return BUFFER_TYPE_SPS;
 
-            case HEVC_NAL_TYPE_PPS:
-                return BUFFER_TYPE_PPS;
+    // The entry is freed along with the frame buffer, so there's no allocation to free
+    entry = &currentFrameBuffer->entries[currentFrameBuffer->entryCount++];
+    entry->allocPtr = NULL;
+    entry->entry.next = NULL;
+    entry->entry.data = &FRAME_BUFFER_DATA(currentFrameBuffer)[nalChainDataLength];
+    entry->entry.length = length;
+    entry->entry.bufferType = bufferType;
+    memcpy(entry->entry.data, data, length);
 
-            case HEVC_NAL_TYPE_VPS:
-                return BUFFER_TYPE_VPS;
+    nalChainDataLength += length;
 
-            default:
-                return BUFFER_TYPE_PICDATA;
-        }
+    if (nalChainTail == NULL) {
+        LC_ASSERT(nalChainHead == NULL);
+        nalChainHead = nalChainTail = (PLENTRY)entry;
     }
     else {
-        LC_ASSERT(false);
-        return BUFFER_TYPE_PICDATA;
+        LC_ASSERT(nalChainHead != NULL);
+        nalChainTail->next = (PLENTRY)entry;
+        nalChainTail = nalChainTail->next;
     }
 }
 
 // As an optimization, we can cast the existing packet buffer to a PLENTRY and avoid
-// a malloc() and a memcpy() of the packet data.
-static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offset, int length) {
+// an allocation and a memcpy() of the packet data.
+static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offset, int length, int nalClass) {
     PLENTRY_INTERNAL entry;
 
+    if (contiguousDecodeUnits) {
+        queueContiguousFragment(&data[offset], length, nalClass);
+        return;
+    }
+
     if (existingEntry == NULL || *existingEntry == NULL) {
-        entry = (PLENTRY_INTERNAL)malloc(sizeof(*entry) + length);
+        // Fragments are always carved from a single packet, so they will
+        // always fit within a video packet buffer.
+        LC_ASSERT(sizeof(*entry) + length <= (size_t)VIDEO_PACKET_BUFFER_SIZE(StreamConfig.packetSize));
+        if (sizeof(*entry) + length <= (size_t)VIDEO_PACKET_BUFFER_SIZE(StreamConfig.packetSize)) {
+            entry = (PLENTRY_INTERNAL)allocVideoPacketBuffer();
+        }
+        else {
+            entry = NULL;
+        }
     }
     else {
         entry = *existingEntry;
@@ -627,7 +944,7 @@ static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offse
             *existingEntry = NULL;
         }
 
-        entry->entry.bufferType = getBufferFlags(entry->entry.data, entry->entry.length);
+        entry->entry.bufferType = getBufferType(nalClass);
 
         nalChainDataLength += entry->entry.length;
 
@@ -641,6 +958,9 @@ static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offse
             nalChainTail = nalChainTail->next;
         }
     }
+    else {
+        frameCorrupt = true;
+    }
 }
 
 // Process an RTP Payload using the slow path that handles multiple NALUs per packet
@@ -650,16 +970,20 @@ static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PLENTRY_INTERN
     LC_ASSERT(nalChainTail == NULL);
 
     while (currentPos->length != 0) {
+        int nalClass = classifyNal(currentPos);
+
         // Skip through any padding bytes
-        if (!getAnnexBStartSequence(currentPos, NULL)) {
+        if (nalClass == NAL_CLASS_NONE) {
             skipToNextNal(currentPos);
+            nalClass = classifyNal(currentPos);
         }
 
         // Skip any prepended AUD or SEI NALUs. We may have padding between
         // these on IDR frames, so the check in processRtpPayload() is not
         // completely sufficient to handle that case.
-        while (isAccessUnitDelimiter(currentPos) || isSeiNal(currentPos)) {
+        while (nalClass == NAL_CLASS_AUD || nalClass == NAL_CLASS_SEI) {
             skipToNextNal(currentPos);
+            nalClass = classifyNal(currentPos);
         }
 
         int start = currentPos->offset;
@@ -669,7 +993,7 @@ static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PLENTRY_INTERN
         start++;
 #endif
 
-        if (isSeqReferenceFrameStart(currentPos)) {
+        if (nalClass == NAL_CLASS_REF_SLICE) {
             // No longer waiting for an IDR frame
             waitingForIdrFrame = false;
             waitingForRefInvalFrame = false;
@@ -693,7 +1017,7 @@ static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PLENTRY_INTERN
             while (currentPos->length != 0) {
                 // Any NALUs we encounter on the way to the end of the packet must be
                 // reference frame slices or filler data.
-                LC_ASSERT_VT(isSeqReferenceFrameStart(currentPos) || isFillerDataNal(currentPos));
+                LC_ASSERT_VT(classifyNal(currentPos) == NAL_CLASS_REF_SLICE || classifyNal(currentPos) == NAL_CLASS_FILLER);
                 skipToNextNalOrEnd(currentPos);
             }
         }
@@ -701,7 +1025,7 @@ static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PLENTRY_INTERN
         // To minimize copies, we'll allocate for SPS, PPS, and VPS to allow
         // us to reuse the packet buffer for the picture data in the I-frame.
         queueFragment(containsPicData ? existingEntry : NULL,
-                      currentPos->data, start, currentPos->offset - start);
+                      currentPos->data, start, currentPos->offset - start, nalClass);
     }
 }
 
@@ -712,7 +1036,7 @@ void requestDecoderRefresh(void) {
     waitingForIdrFrame = true;
     
     // Flush the decode unit queue
-    freeDecodeUnitList(LbqFlushQueueItems(&decodeUnitQueue));
+    flushDecodeUnitQueue();
     
     // Request the receive thread drop its state
     // on the next call. We can't do it here because
@@ -736,7 +1060,7 @@ static bool isFirstPacket(uint8_t flags, uint8_t fecBlockNumber) {
 // Process an RTP Payload
 // The caller will free *existingEntry unless we NULL it
 static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
-                       uint64_t receiveTimeMs, unsigned int presentationTimeMs,
+                       uint64_t receiveTimeUs, unsigned int presentationTimeMs,
                        PLENTRY_INTERNAL* existingEntry) {
     BUFFER_DESC currentPos;
     uint32_t frameIndex;
@@ -745,6 +1069,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
     uint32_t streamPacketIndex;
     uint8_t fecCurrentBlockNumber;
     uint8_t fecLastBlockNumber;
+    int nalClass = NAL_CLASS_NONE;
 
     // Mask the top 8 bits from the SPI
     videoPacket->streamPacketIndex >>= 8;
@@ -818,21 +1143,29 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
 
         // We're now decoding a frame
         decodingFrame = true;
+        frameCorrupt = false;
         frameType = FRAME_TYPE_PFRAME;
-        firstPacketReceiveTime = receiveTimeMs;
+        firstPacketReceiveTimeUs = receiveTimeUs;
         
         // Some versions of Sunshine don't send a valid PTS, so we will
         // synthesize one using the receive time as the time base.
         if (!syntheticPtsBase) {
-            syntheticPtsBase = receiveTimeMs;
+            syntheticPtsBase = receiveTimeUs;
         }
         
         if (!presentationTimeMs && frameIndex > 0) {
-            firstPacketPresentationTime = (unsigned int)(receiveTimeMs - syntheticPtsBase);
+            firstPacketPresentationTime = (unsigned int)((receiveTimeUs - syntheticPtsBase) / 1000);
         }
         else {
             firstPacketPresentationTime = presentationTimeMs;
         }
+
+        // Size the frame buffer for the whole frame up front, assuming each FEC block
+        // has as many data shards as the first one.
+        if (contiguousDecodeUnits) {
+            frameBufferSizeHint = (size_t)((videoPacket->fecInfo & 0xFFC00000) >> 22) *
+                                  (fecLastBlockNumber + 1) * StreamConfig.packetSize;
+        }
     }
 
     lastPacketInStream = streamPacketIndex;
@@ -850,7 +1183,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
             case 2: // IDR frame
                 // For other codecs, we trust the frame header rather than parsing the bitstream
                 // to determine if a given frame is an IDR frame.
-                if (!(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265))) {
+                if (!annexBStream) {
                     waitingForIdrFrame = false;
                     waitingForNextSuccessfulFrame = false;
                     frameType = FRAME_TYPE_IDR;
@@ -894,7 +1227,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         // Codecs like H.264 and HEVC handle the FEC trailing zero padding just fine, but other
         // codecs need the exact length encoded separately.
         LC_ASSERT_VT(currentPos.length >= 6);
-        if (!(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265)) && currentPos.length >= 6) {
+        if (!annexBStream && currentPos.length >= 6) {
             BYTE_BUFFER bb;
             BbInitializeWrappedBuffer(&bb, currentPos.data, currentPos.offset + 4, 2, BYTE_ORDER_LITTLE);
             BbGet16(&bb, &lastPacketPayloadLength);
@@ -961,28 +1294,33 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         }
 
         // We only parse H.264 and HEVC at the NALU level
-        if (NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265)) {
+        if (annexBStream) {
+            nalClass = classifyNal(&currentPos);
+
             // The Annex B NALU start prefix must be next
-            if (!getAnnexBStartSequence(&currentPos, NULL)) {
+            if (nalClass == NAL_CLASS_NONE) {
                 // If we aren't starting on a start prefix, something went wrong.
                 LC_ASSERT_VT(false);
 
                 // For release builds, we will try to recover by searching for one.
                 // This mimics the way most decoders handle this situation.
                 skipToNextNal(&currentPos);
+                nalClass = classifyNal(&currentPos);
             }
 
             // If an AUD NAL is prepended to this frame data, remove it.
             // Other parts of this code are not prepared to deal with a
             // NAL of that type, so stripping it is the easiest option.
-            if (isAccessUnitDelimiter(&currentPos)) {
+            if (nalClass == NAL_CLASS_AUD) {
                 skipToNextNal(&currentPos);
+                nalClass = classifyNal(&currentPos);
             }
 
             // There may be one or more SEI NAL units prepended to the
             // frame data *after* the (optional) AUD.
-            while (isSeiNal(&currentPos)) {
+            while (nalClass == NAL_CLASS_SEI) {
                 skipToNextNal(&currentPos);
+                nalClass = classifyNal(&currentPos);
             }
         }
     }
@@ -991,16 +1329,22 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         frameHeaderSize = 0;
     }
 
-    if (NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265)) {
-        if (firstPacket && isIdrFrameStart(&currentPos)) {
+    if (annexBStream) {
+        // The first packet was already classified while skipping the prefix NALs
+        if (!firstPacket) {
+            nalClass = classifyNal(&currentPos);
+        }
+
+        if (firstPacket && nalClass == idrFrameStartClass) {
             // SPS and PPS prefix is padded between NALs, so we must decode it with the slow path
             processAvcHevcRtpPayloadSlow(&currentPos, existingEntry);
         }
         else {
             // Intel's H.264 Media Foundation encoder prepends a PPS to each P-frame.
             // Skip it to avoid confusing clients.
-            if (firstPacket && isPictureParameterSetNal(&currentPos)) {
+            if (firstPacket && nalClass == NAL_CLASS_PPS) {
                 skipToNextNal(&currentPos);
+                nalClass = classifyNal(&currentPos);
             }
 
 #ifdef FORCE_3_BYTE_START_SEQUENCES
@@ -1010,7 +1354,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
             }
 #endif
 
-            queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length);
+            queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length, nalClass);
         }
     }
     else {
@@ -1054,7 +1398,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         }
 
         // Other codecs are just passed through as is.
-        queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length);
+        queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length, NAL_CLASS_NONE);
     }
 
     if (lastPacket) {
@@ -1090,6 +1434,19 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
 
         LC_ASSERT(!waitingForNextSuccessfulFrame);
 
+        // If we couldn't store part of this frame, drop it like a frame lost on the network
+        if (frameCorrupt) {
+            Limelog("Dropping frame %d that could not be stored\n", frameIndex);
+            dropFrameState();
+            if (waitingForIdrFrame) {
+                LiRequestIdrFrame();
+            }
+            else {
+                connectionDetectedFrameLoss(startFrameNumber, frameIndex);
+            }
+            return;
+        }
+
         // Carry out any pending state drops. We can't just do this
         // arbitrarily in the middle of processing a frame because
         // may cause the depacketizer state to become corrupted. For
@@ -1150,7 +1507,7 @@ void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntryPtr) {
     RTPV_QUEUE_ENTRY queueEntry = *queueEntryPtr;
 
     LC_ASSERT(!queueEntry.isParity);
-    LC_ASSERT(queueEntry.receiveTimeMs != 0);
+    LC_ASSERT(queueEntry.receiveTimeUs != 0);
 
     dataOffset = sizeof(*queueEntry.packet);
     if (queueEntry.packet->header & FLAG_EXTENSION) {
@@ -1169,16 +1526,16 @@ void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntryPtr) {
 
     processRtpPayload((PNV_VIDEO_PACKET)(((char*)queueEntry.packet) + dataOffset),
                       queueEntry.length - dataOffset,
-                      queueEntry.receiveTimeMs,
+                      queueEntry.receiveTimeUs,
                       queueEntry.presentationTimeMs,
                       &existingEntry);
 
     if (existingEntry != NULL) {
         // processRtpPayload didn't want this packet, so just free it
-        free(existingEntry->allocPtr);
+        freeVideoPacketBuffer(existingEntry->allocPtr);
     }
 }
 
 int LiGetPendingVideoFrames(void) {
-    return LbqGetItemCount(&decodeUnitQueue);
+    return LfqGetItemCount(&decodeUnitQueue);
 }
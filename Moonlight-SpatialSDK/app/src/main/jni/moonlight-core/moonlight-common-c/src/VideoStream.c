@@ -17,9 +17,13 @@ static SOCKET firstFrameSocket = INVALID_SOCKET;
 
 static PPLT_CRYPTO_CONTEXT decryptionCtx;
 
+static PACKET_POOL packetPool;
+static bool packetPoolInitialized;
+
 static PLT_THREAD udpPingThread;
 static PLT_THREAD receiveThread;
 static PLT_THREAD decoderThread;
+static PLT_THREAD decryptThread;
 
 static bool receivedDataFromPeer;
 static uint64_t firstDataTimeMs;
@@ -39,11 +43,182 @@ static bool receivedFullFrame;
 // and subsequent packet/frame bursts that follow.
 #define RTP_RECV_PACKETS_BUFFERED 2048
 
+// This is the maximum number of video packets that will be
+// read from the socket with a single receive call on platforms
+// that support batched receive. Each slot has a preallocated
+// packet buffer, so this shouldn't be made too large.
+#define RTP_RECV_BATCH_SIZE 32
+
+// Video packet buffers are recycled through a pool rather than being
+// allocated for each packet received. The initial size covers a few
+// large frames in flight. The pool can grow past the maximum during
+// bursts, but it will shrink back down as those buffers are freed.
+#define PACKET_POOL_INITIAL_BUFFERS 512
+#define PACKET_POOL_MAX_BUFFERS 4096
+
+// When video decryption is pipelined, the receive thread only reads encrypted
+// packets from the socket into this ring of staging buffers. A separate decrypt
+// thread decrypts them and feeds the RTP queue, so AES-GCM on a slow CPU doesn't
+// limit how quickly we can drain the socket.
+#define DECRYPT_RING_SIZE 256
+
+typedef struct _DECRYPT_RING {
+    PLT_MUTEX mutex;
+    PLT_COND notEmptyCond;
+    PLT_COND notFullCond;
+    bool stopping;
+
+    char* buffers[DECRYPT_RING_SIZE];
+    int lengths[DECRYPT_RING_SIZE];
+
+    // The receive thread owns the slots from writeIndex up to readIndex + DECRYPT_RING_SIZE
+    // and the decrypt thread owns the slots from readIndex up to writeIndex. The indices
+    // themselves are protected by the mutex.
+    uint32_t writeIndex;
+    uint32_t readIndex;
+
+    // Protected by the mutex
+    uint32_t maxDepth;
+    uint64_t depthTotal;
+    uint64_t batchesQueued;
+    uint64_t packetsQueued;
+    uint64_t fullWaits;
+} DECRYPT_RING, *PDECRYPT_RING;
+
+static bool pipelinedDecryptionEnabled;
+static bool decryptRingInitialized;
+static DECRYPT_RING decryptRing;
+
+static int initializeDecryptRing(void) {
+    int receiveSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE + sizeof(ENC_VIDEO_HEADER);
+    int i;
+
+    memset(&decryptRing, 0, sizeof(decryptRing));
+
+    for (i = 0; i < DECRYPT_RING_SIZE; i++) {
+        decryptRing.buffers[i] = (char*)malloc(receiveSize);
+        if (decryptRing.buffers[i] == NULL) {
+            goto FreeBuffers;
+        }
+    }
+
+    if (PltCreateMutex(&decryptRing.mutex) < 0) {
+        goto FreeBuffers;
+    }
+    if (PltCreateConditionVariable(&decryptRing.notEmptyCond, &decryptRing.mutex) < 0) {
+        goto DeleteMutex;
+    }
+    if (PltCreateConditionVariable(&decryptRing.notFullCond, &decryptRing.mutex) < 0) {
+        goto DeleteNotEmptyCond;
+    }
+
+    return 0;
+
+DeleteNotEmptyCond:
+    PltDeleteConditionVariable(&decryptRing.notEmptyCond);
+DeleteMutex:
+    PltDeleteMutex(&decryptRing.mutex);
+FreeBuffers:
+    for (i = 0; i < DECRYPT_RING_SIZE; i++) {
+        free(decryptRing.buffers[i]);
+    }
+    return -1;
+}
+
+static void cleanupDecryptRing(void) {
+    int i;
+
+    if (decryptRing.packetsQueued != 0) {
+        Limelog("Video Decrypt: average ring depth %u (max %u), %u waits for a full ring\n",
+                (unsigned int)(decryptRing.depthTotal / decryptRing.batchesQueued),
+                decryptRing.maxDepth, (unsigned int)decryptRing.fullWaits);
+    }
+
+    PltDeleteConditionVariable(&decryptRing.notFullCond);
+    PltDeleteConditionVariable(&decryptRing.notEmptyCond);
+    PltDeleteMutex(&decryptRing.mutex);
+
+    for (i = 0; i < DECRYPT_RING_SIZE; i++) {
+        free(decryptRing.buffers[i]);
+    }
+}
+
+// Wakes up the receive and decrypt threads if they are waiting on the ring
+static void stopDecryptRing(void) {
+    if (!decryptRingInitialized) {
+        return;
+    }
+
+    PltLockMutex(&decryptRing.mutex);
+    decryptRing.stopping = true;
+    PltSignalConditionVariable(&decryptRing.notEmptyCond);
+    PltSignalConditionVariable(&decryptRing.notFullCond);
+    PltUnlockMutex(&decryptRing.mutex);
+}
+
+// Returns the number of free ring buffers (up to maxSlots) that the receive thread
+// may read packets into, waiting for the decrypt thread if the ring is full.
+// Returns 0 if the ring is stopping.
+static int reserveDecryptRingSlots(char** buffers, int maxSlots) {
+    uint32_t writeIndex;
+    int freeSlots;
+    int i;
+
+    PltLockMutex(&decryptRing.mutex);
+    if (decryptRing.writeIndex - decryptRing.readIndex == DECRYPT_RING_SIZE) {
+        decryptRing.fullWaits++;
+        while (decryptRing.writeIndex - decryptRing.readIndex == DECRYPT_RING_SIZE && !decryptRing.stopping) {
+            PltWaitForConditionVariable(&decryptRing.notFullCond, &decryptRing.mutex);
+        }
+    }
+    writeIndex = decryptRing.writeIndex;
+    freeSlots = decryptRing.stopping ? 0 : DECRYPT_RING_SIZE - (int)(decryptRing.writeIndex - decryptRing.readIndex);
+    PltUnlockMutex(&decryptRing.mutex);
+
+    if (freeSlots > maxSlots) {
+        freeSlots = maxSlots;
+    }
+
+    for (i = 0; i < freeSlots; i++) {
+        buffers[i] = decryptRing.buffers[(writeIndex + i) % DECRYPT_RING_SIZE];
+    }
+
+    return freeSlots;
+}
+
+// Hands packets received into the reserved ring buffers off to the decrypt thread
+static void commitDecryptRingSlots(int* lengths, int count) {
+    uint32_t depth;
+    int i;
+
+    PltLockMutex(&decryptRing.mutex);
+    for (i = 0; i < count; i++) {
+        decryptRing.lengths[(decryptRing.writeIndex + i) % DECRYPT_RING_SIZE] = lengths[i];
+    }
+    decryptRing.writeIndex += count;
+
+    depth = decryptRing.writeIndex - decryptRing.readIndex;
+    if (depth > decryptRing.maxDepth) {
+        decryptRing.maxDepth = depth;
+    }
+    decryptRing.depthTotal += depth;
+    decryptRing.batchesQueued++;
+    decryptRing.packetsQueued += count;
+
+    PltSignalConditionVariable(&decryptRing.notEmptyCond);
+    PltUnlockMutex(&decryptRing.mutex);
+}
+
 // Initialize the video stream
 void initializeVideoStream(void) {
+    packetPoolInitialized = PktPoolInitialize(&packetPool, VIDEO_PACKET_BUFFER_SIZE(StreamConfig.packetSize),
+                                              PACKET_POOL_INITIAL_BUFFERS, PACKET_POOL_MAX_BUFFERS) == 0;
     initializeVideoDepacketizer(StreamConfig.packetSize);
     RtpvInitializeQueue(&rtpQueue);
+    FtInitialize();
     decryptionCtx = PltCreateCryptoContext();
+    decryptRingInitialized = pipelinedDecryptionEnabled && (EncryptionFeaturesEnabled & SS_ENC_VIDEO) &&
+                             initializeDecryptRing() == 0;
     receivedDataFromPeer = false;
     firstDataTimeMs = 0;
     receivedFullFrame = false;
@@ -52,8 +227,56 @@ void initializeVideoStream(void) {
 // Clean up the video stream
 void destroyVideoStream(void) {
     PltDestroyCryptoContext(decryptionCtx);
+    if (decryptRingInitialized) {
+        decryptRingInitialized = false;
+        cleanupDecryptRing();
+    }
     destroyVideoDepacketizer();
     RtpvCleanupQueue(&rtpQueue);
+    if (packetPoolInitialized) {
+        packetPoolInitialized = false;
+        PktPoolCleanup(&packetPool);
+    }
+}
+
+// Video packet buffers must only be allocated on the thread that feeds the RTP queue.
+// That is the receive thread, or the decrypt thread if decryption is pipelined.
+void* allocVideoPacketBuffer(void) {
+    return PktPoolAlloc(&packetPool);
+}
+
+void freeVideoPacketBuffer(void* buffer) {
+    PktPoolFree(&packetPool, buffer);
+}
+
+void LiSetPipelinedVideoDecryption(bool enabled) {
+    pipelinedDecryptionEnabled = enabled;
+}
+
+bool LiGetVideoDecryptStats(PVIDEO_DECRYPT_STATS stats) {
+    if (!decryptRingInitialized) {
+        return false;
+    }
+
+    PltLockMutex(&decryptRing.mutex);
+    stats->currentDepth = decryptRing.writeIndex - decryptRing.readIndex;
+    stats->maxDepth = decryptRing.maxDepth;
+    stats->averageDepth = decryptRing.batchesQueued ? (uint32_t)(decryptRing.depthTotal / decryptRing.batchesQueued) : 0;
+    stats->packetsQueued = decryptRing.packetsQueued;
+    stats->fullWaits = decryptRing.fullWaits;
+    PltUnlockMutex(&decryptRing.mutex);
+
+    stats->ringSize = DECRYPT_RING_SIZE;
+    return true;
+}
+
+bool LiGetVideoPacketPoolStats(PPACKET_POOL_STATS stats) {
+    if (!packetPoolInitialized) {
+        return false;
+    }
+
+    PktPoolGetStats(&packetPool, &stats->hits, &stats->misses, &stats->totalBuffers);
+    return true;
 }
 
 // UDP Ping proc
@@ -86,23 +309,219 @@ static void VideoPingThreadProc(void* context) {
     }
 }
 
+// Decrypts a batch of received packets (if video encryption is enabled) into the packet
+// buffers and adds them to the RTP queue. Packet buffers that the RTP queue took ownership
+// of are set to NULL. The packet lengths are modified.
+static void queueReceivedPackets(char** packetBuffers, char** encryptedBuffers, int* packetLengths, int count) {
+    int decryptedSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
+    int i;
+
+    LC_ASSERT(count <= RTP_RECV_BATCH_SIZE);
+
+    // Decrypt the packets into the packet buffers if encryption is enabled
+    if (encryptedBuffers != NULL) {
+        PLT_CRYPTO_MESSAGE messages[RTP_RECV_BATCH_SIZE];
+        int messageIndexes[RTP_RECV_BATCH_SIZE];
+        int messageCount = 0;
+
+        for (i = 0; i < count; i++) {
+            PENC_VIDEO_HEADER encHeader = (PENC_VIDEO_HEADER)encryptedBuffers[i];
+
+            if (packetLengths[i] < (int)(sizeof(RTP_PACKET) + sizeof(ENC_VIDEO_HEADER))) {
+                // Runt packet
+                packetLengths[i] = 0;
+                continue;
+            }
+
+            // If this frame is below our current frame number, discard it before decryption
+            // to save CPU cycles decrypting FEC shards for a frame we already reassembled.
+            //
+            // Since this is happening _before_ decryption, this packet is not trusted yet.
+            // It's imperative that we do not mutate any state based on this packet until
+            // after it has been decrypted successfully!
+            //
+            // It's possible for an attacker to inject a fake packet that has any value of
+            // header fields they want, however this provides them no benefit because we will
+            // simply drop said packet here (if it's below the current frame number) or it
+            // will pass this check and be dropped during decryption (if contents is tampered)
+            // or after decryption in the RTP queue (if it's a replay of a previous authentic
+            // packet from the host).
+            //
+            // In short, an attacker spoofing this value via MITM or sending malicious values
+            // impersonating the host from off-link doesn't gain them anything. If they have
+            // a true MITM, they can DoS our connection by just dropping all our traffic, so
+            // tampering with packets to fail this check doesn't accomplish anything they
+            // couldn't already do. If they're not on-link, we just throw their malicious
+            // traffic away (as mentioned in the paragraph above) and continue accepting
+            // legitmate video traffic.
+            if (encHeader->frameNumber && LE32(encHeader->frameNumber) < RtpvGetCurrentFrameNumber(&rtpQueue)) {
+                packetLengths[i] = 0;
+                continue;
+            }
+
+            messages[messageCount].iv = encHeader->iv;
+            messages[messageCount].tag = encHeader->tag;
+            messages[messageCount].inputData = (unsigned char*)(encHeader + 1); // The ciphertext is after the header
+            messages[messageCount].inputDataLength = packetLengths[i] - sizeof(ENC_VIDEO_HEADER);
+            messages[messageCount].outputData = (unsigned char*)packetBuffers[i];
+            messages[messageCount].outputDataLength = decryptedSize;
+            messageIndexes[messageCount] = i;
+            messageCount++;
+        }
+
+        PltDecryptMessageBatch(decryptionCtx, ALGORITHM_AES_GCM,
+                               (unsigned char*)StreamConfig.remoteInputAesKey, sizeof(StreamConfig.remoteInputAesKey),
+                               sizeof(((PENC_VIDEO_HEADER)NULL)->iv), sizeof(((PENC_VIDEO_HEADER)NULL)->tag),
+                               messages, messageCount);
+
+        for (i = 0; i < messageCount; i++) {
+            if (messages[i].decrypted) {
+                packetLengths[messageIndexes[i]] = messages[i].outputDataLength;
+            }
+            else {
+                Limelog("Failed to decrypt video packet!\n");
+                packetLengths[messageIndexes[i]] = 0;
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        PRTP_PACKET packet;
+        char* buffer = packetBuffers[i];
+
+        if (packetLengths[i] < (int)sizeof(RTP_PACKET)) {
+            // Runt packet (or one that we already discarded above)
+            continue;
+        }
+
+        capturePacket(PACKET_CAPTURE_VIDEO, buffer, packetLengths[i]);
+
+        // Convert fields to host byte-order
+        packet = (PRTP_PACKET)&buffer[0];
+        packet->sequenceNumber = BE16(packet->sequenceNumber);
+        packet->timestamp = BE32(packet->timestamp);
+        packet->ssrc = BE32(packet->ssrc);
+
+        if (RtpvAddPacket(&rtpQueue, packet, packetLengths[i], (PRTPV_QUEUE_ENTRY)&buffer[decryptedSize]) == RTPF_RET_QUEUED) {
+            // The queue owns the buffer
+            packetBuffers[i] = NULL;
+        }
+    }
+}
+
+// Feeds a captured packet through the same path as the receive thread. The packet must be
+// decrypted with the RTP header in network byte order, as it was captured. This is only for
+// offline replay, so the video stream must be initialized but never started, and this must
+// only be called from a single thread.
+void replayVideoPacket(const void* data, int length) {
+    char* buffer;
+
+    // Replayed packets can't be larger than what the receive thread reads
+    if (length > StreamConfig.packetSize + MAX_RTP_HEADER_SIZE) {
+        return;
+    }
+
+    buffer = (char*)allocVideoPacketBuffer();
+    if (buffer == NULL) {
+        return;
+    }
+
+    memcpy(buffer, data, length);
+    queueReceivedPackets(&buffer, NULL, &length, 1);
+
+    if (buffer != NULL) {
+        freeVideoPacketBuffer(buffer);
+    }
+}
+
+// Decrypt thread proc
+static void VideoDecryptThreadProc(void* context) {
+    char* packetBuffers[RTP_RECV_BATCH_SIZE];
+    char* encryptedBuffers[RTP_RECV_BATCH_SIZE];
+    int packetLengths[RTP_RECV_BATCH_SIZE];
+    uint32_t readIndex, writeIndex;
+    int batchSize;
+    int i;
+
+    memset(packetBuffers, 0, sizeof(packetBuffers));
+
+    PltLockMutex(&decryptRing.mutex);
+    for (;;) {
+        while (decryptRing.readIndex == decryptRing.writeIndex && !decryptRing.stopping) {
+            PltWaitForConditionVariable(&decryptRing.notEmptyCond, &decryptRing.mutex);
+        }
+
+        if (decryptRing.stopping) {
+            break;
+        }
+
+        readIndex = decryptRing.readIndex;
+        writeIndex = decryptRing.writeIndex;
+        PltUnlockMutex(&decryptRing.mutex);
+
+        // The receive thread won't touch these slots until we release them below
+        while (readIndex != writeIndex) {
+            batchSize = (int)(writeIndex - readIndex);
+            if (batchSize > RTP_RECV_BATCH_SIZE) {
+                batchSize = RTP_RECV_BATCH_SIZE;
+            }
+
+            for (i = 0; i < batchSize; i++) {
+                uint32_t slot = (readIndex + i) % DECRYPT_RING_SIZE;
+
+                // Replace any packet buffers that the RTP queue took ownership of
+                if (packetBuffers[i] == NULL) {
+                    packetBuffers[i] = (char*)allocVideoPacketBuffer();
+                    if (packetBuffers[i] == NULL) {
+                        Limelog("Video Decrypt: malloc() failed\n");
+                        ListenerCallbacks.connectionTerminated(-1);
+                        goto Exit;
+                    }
+                }
+
+                encryptedBuffers[i] = decryptRing.buffers[slot];
+                packetLengths[i] = decryptRing.lengths[slot];
+            }
+
+            queueReceivedPackets(packetBuffers, encryptedBuffers, packetLengths, batchSize);
+            readIndex += batchSize;
+        }
+
+        PltLockMutex(&decryptRing.mutex);
+        decryptRing.readIndex = readIndex;
+        PltSignalConditionVariable(&decryptRing.notFullCond);
+    }
+    PltUnlockMutex(&decryptRing.mutex);
+
+Exit:
+    for (i = 0; i < RTP_RECV_BATCH_SIZE; i++) {
+        if (packetBuffers[i] != NULL) {
+            freeVideoPacketBuffer(packetBuffers[i]);
+        }
+    }
+}
+
 // Receive thread proc
 static void VideoReceiveThreadProc(void* context) {
     int err;
-    int bufferSize, receiveSize, decryptedSize, minSize;
-    char* buffer;
-    char* encryptedBuffer;
-    int queueStatus;
+    int receiveSize;
+    char* packetBuffers[RTP_RECV_BATCH_SIZE];
+    char* encryptedBuffers[RTP_RECV_BATCH_SIZE];
+    char* ringBuffers[RTP_RECV_BATCH_SIZE];
+    int packetLengths[RTP_RECV_BATCH_SIZE];
+    int batchSize;
     bool useSelect;
     int waitingForVideoMs;
     bool encrypted;
+    bool pipelined;
+    uint32_t receiveCalls, packetsReceived;
+    int i;
 
     encrypted = !!(EncryptionFeaturesEnabled & SS_ENC_VIDEO);
-    decryptedSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
-    minSize = sizeof(RTP_PACKET) + ((EncryptionFeaturesEnabled & SS_ENC_VIDEO) ? sizeof(ENC_VIDEO_HEADER) : 0);
-    receiveSize = decryptedSize + ((EncryptionFeaturesEnabled & SS_ENC_VIDEO) ? sizeof(ENC_VIDEO_HEADER) : 0);
-    bufferSize = decryptedSize + sizeof(RTPV_QUEUE_ENTRY);
-    buffer = NULL;
+    receiveSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE + (encrypted ? sizeof(ENC_VIDEO_HEADER) : 0);
+    memset(packetBuffers, 0, sizeof(packetBuffers));
+    memset(encryptedBuffers, 0, sizeof(encryptedBuffers));
+    receiveCalls = packetsReceived = 0;
 
     if (setNonFatalRecvTimeoutMs(rtpSocket, UDP_RECV_POLL_TIMEOUT_MS) < 0) {
         // SO_RCVTIMEO failed, so use select() to wait
@@ -113,38 +532,60 @@ static void VideoReceiveThreadProc(void* context) {
         useSelect = false;
     }
 
-    // Allocate a staging buffer to use for each received packet
-    if (encrypted) {
-        encryptedBuffer = (char*)malloc(receiveSize);
-        if (encryptedBuffer == NULL) {
-            Limelog("Video Receive: malloc() failed\n");
-            ListenerCallbacks.connectionTerminated(-1);
-            return;
-        }
+    // If decryption is pipelined, we receive straight into the decrypt ring and the
+    // decrypt thread owns the packet buffers. Otherwise, we decrypt inline ourselves.
+    pipelined = decryptRingInitialized &&
+                PltCreateThread("VideoDecrypt", VideoDecryptThreadProc, NULL, &decryptThread) == 0;
+    if (pipelined) {
+        Limelog("Video Receive: using pipelined decryption\n");
     }
-    else {
-        encryptedBuffer = NULL;
+
+    // Allocate staging buffers to receive encrypted packets into. Unlike the
+    // packet buffers, these are never handed off to the RTP queue.
+    if (encrypted && !pipelined) {
+        for (i = 0; i < RTP_RECV_BATCH_SIZE; i++) {
+            encryptedBuffers[i] = (char*)malloc(receiveSize);
+            if (encryptedBuffers[i] == NULL) {
+                Limelog("Video Receive: malloc() failed\n");
+                ListenerCallbacks.connectionTerminated(-1);
+                goto Exit;
+            }
+        }
     }
 
     waitingForVideoMs = 0;
     while (!PltIsThreadInterrupted(&receiveThread)) {
-        PRTP_PACKET packet;
-
-        if (buffer == NULL) {
-            buffer = (char*)malloc(bufferSize);
-            if (buffer == NULL) {
-                Limelog("Video Receive: malloc() failed\n");
-                ListenerCallbacks.connectionTerminated(-1);
+        if (pipelined) {
+            // Wait for free space in the decrypt ring
+            batchSize = reserveDecryptRingSlots(ringBuffers, RTP_RECV_BATCH_SIZE);
+            if (batchSize == 0) {
                 break;
             }
         }
+        else {
+            // Replace any packet buffers that the RTP queue took ownership of
+            for (i = 0; i < RTP_RECV_BATCH_SIZE; i++) {
+                if (packetBuffers[i] == NULL) {
+                    packetBuffers[i] = (char*)allocVideoPacketBuffer();
+                    if (packetBuffers[i] == NULL) {
+                        Limelog("Video Receive: malloc() failed\n");
+                        ListenerCallbacks.connectionTerminated(-1);
+                        goto Exit;
+                    }
+                }
+            }
 
-        err = recvUdpSocket(rtpSocket,
-                            encrypted ? encryptedBuffer : buffer,
-                            receiveSize,
-                            useSelect);
+            batchSize = RTP_RECV_BATCH_SIZE;
+        }
+
+        err = recvUdpSocketBatch(rtpSocket,
+                                 pipelined ? ringBuffers : (encrypted ? encryptedBuffers : packetBuffers),
+                                 packetLengths,
+                                 batchSize,
+                                 receiveSize,
+                                 useSelect);
         if (err < 0) {
-            Limelog("Video Receive: recvUdpSocket() failed: %d\n", (int)LastSocketError());
+            Limelog("Video Receive: recvUdpSocketBatch() failed: %d\n", (int)LastSocketError());
             ListenerCallbacks.connectionTerminated(LastSocketFail());
             break;
         }
@@ -164,6 +605,9 @@ static void VideoReceiveThreadProc(void* context) {
             continue;
         }
 
+        receiveCalls++;
+        packetsReceived += err;
+
         if (!receivedDataFromPeer) {
             receivedDataFromPeer = true;
             Limelog("Received first video packet after %d ms\n", waitingForVideoMs);
@@ -183,71 +627,33 @@ static void VideoReceiveThreadProc(void* context) {
         }
 #endif
 
-        if (err < minSize) {
-            // Runt packet
+        if (pipelined) {
+            // The decrypt thread takes it from here
+            commitDecryptRingSlots(packetLengths, err);
             continue;
         }
 
-        // Decrypt the packet into the buffer if encryption is enabled
-        if (encrypted) {
-            PENC_VIDEO_HEADER encHeader = (PENC_VIDEO_HEADER)encryptedBuffer;
-
-            // If this frame is below our current frame number, discard it before decryption
-            // to save CPU cycles decrypting FEC shards for a frame we already reassembled.
-            //
-            // Since this is happening _before_ decryption, this packet is not trusted yet.
-            // It's imperative that we do not mutate any state based on this packet until
-            // after it has been decrypted successfully!
-            //
-            // It's possible for an attacker to inject a fake packet that has any value of
-            // header fields they want, however this provides them no benefit because we will
-            // simply drop said packet here (if it's below the current frame number) or it
-            // will pass this check and be dropped during decryption (if contents is tampered)
-            // or after decryption in the RTP queue (if it's a replay of a previous authentic
-            // packet from the host).
-            //
-            // In short, an attacker spoofing this value via MITM or sending malicious values
-            // impersonating the host from off-link doesn't gain them anything. If they have
-            // a true MITM, they can DoS our connection by just dropping all our traffic, so
-            // tampering with packets to fail this check doesn't accomplish anything they
-            // couldn't already do. If they're not on-link, we just throw their malicious
-            // traffic away (as mentioned in the paragraph above) and continue accepting
-            // legitmate video traffic.
-            if (encHeader->frameNumber && LE32(encHeader->frameNumber) < RtpvGetCurrentFrameNumber(&rtpQueue)) {
-                continue;
-            }
-
-            if (!PltDecryptMessage(decryptionCtx, ALGORITHM_AES_GCM, 0,
-                                   (unsigned char*)StreamConfig.remoteInputAesKey, sizeof(StreamConfig.remoteInputAesKey),
-                                   encHeader->iv, sizeof(encHeader->iv),
-                                   encHeader->tag, sizeof(encHeader->tag),
-                                   ((unsigned char*)(encHeader + 1)), err - sizeof(ENC_VIDEO_HEADER), // The ciphertext is after the header
-                                   (unsigned char*)buffer, &err)) {
-                Limelog("Failed to decrypt video packet!\n");
-                continue;
-            }
-        }
-
-        // Convert fields to host byte-order
-        packet = (PRTP_PACKET)&buffer[0];
-        packet->sequenceNumber = BE16(packet->sequenceNumber);
-        packet->timestamp = BE32(packet->timestamp);
-        packet->ssrc = BE32(packet->ssrc);
-
-        queueStatus = RtpvAddPacket(&rtpQueue, packet, err, (PRTPV_QUEUE_ENTRY)&buffer[decryptedSize]);
+        queueReceivedPackets(packetBuffers, encrypted ? encryptedBuffers : NULL, packetLengths, err);
+    }
 
-        if (queueStatus == RTPF_RET_QUEUED) {
-            // The queue owns the buffer
-            buffer = NULL;
-        }
+    if (receiveCalls != 0) {
+        Limelog("Video Receive: %u packets in %u receive calls\n", packetsReceived, receiveCalls);
     }
 
-    if (buffer != NULL) {
-        free(buffer);
+Exit:
+    if (pipelined) {
+        stopDecryptRing();
+        PltJoinThread(&decryptThread);
     }
 
-    if (encryptedBuffer != NULL) {
-        free(encryptedBuffer);
+    for (i = 0; i < RTP_RECV_BATCH_SIZE; i++) {
+        if (packetBuffers[i] != NULL) {
+            freeVideoPacketBuffer(packetBuffers[i]);
+        }
+
+        if (encryptedBuffers[i] != NULL) {
+            free(encryptedBuffers[i]);
+        }
     }
 }
 
@@ -298,6 +704,9 @@ void stopVideoStream(void) {
         PltInterruptThread(&decoderThread);
     }
 
+    // Wake the receive thread if it's waiting for space in the decrypt ring
+    stopDecryptRing();
+
     if (firstFrameSocket != INVALID_SOCKET) {
         shutdownTcpSocket(firstFrameSocket);
     }
@@ -0,0 +1,144 @@
+// Throughput of findAnnexBStartSequence() against the byte at a time scan it
+// replaced. The input is a synthetic H.264 IDR access unit: parameter sets
+// followed by slices of random data with emulation prevention applied, and
+// zero padding at the end like some encoders add.
+// Usage: annexb_scan_bench [access unit KB] [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight-internal.h"
+
+#define SLICE_COUNT 4
+#define PADDING_SIZE 1024
+
+static unsigned int byteStartSequenceLength(const char* data, unsigned int length) {
+    if (length <= 3 || data[0] != 0 || data[1] != 0) {
+        return 0;
+    }
+    else if (data[2] == 1) {
+        return 3;
+    }
+    else if (data[2] == 0 && length > 4 && data[3] == 1) {
+        return 4;
+    }
+
+    return 0;
+}
+
+// The original skipToNextNalOrEnd() loop
+static unsigned int byteFind(const char* data, unsigned int length) {
+    unsigned int offset = 0;
+
+    while (offset < length && byteStartSequenceLength(&data[offset], length - offset) == 0) {
+        offset++;
+    }
+
+    return offset;
+}
+
+// Appends a NAL unit with emulation prevention, like an encoder would produce it
+static unsigned int appendNal(char* data, unsigned int offset, unsigned char header, unsigned int payloadLength) {
+    int zeros = 0;
+    unsigned int i;
+
+    memcpy(&data[offset], "\x00\x00\x00\x01", 4);
+    offset += 4;
+    data[offset++] = (char)header;
+
+    for (i = 0; i < payloadLength; i++) {
+        unsigned char value = (unsigned char)(rand() & 0xFF);
+
+        if (zeros == 2 && value <= 3) {
+            data[offset++] = 3;
+            zeros = 0;
+        }
+
+        data[offset++] = (char)value;
+        zeros = value == 0 ? zeros + 1 : 0;
+    }
+
+    return offset;
+}
+
+// Walks the access unit NAL by NAL like the depacketizer does
+static unsigned int countNals(const char* data, unsigned int length, bool vectorized) {
+    unsigned int offset = 0;
+    unsigned int nals = 0;
+
+    while (offset < length) {
+        unsigned int startSeqLength = getAnnexBStartSequenceLength(&data[offset], length - offset);
+
+        if (startSeqLength != 0) {
+            offset += startSeqLength;
+            nals++;
+        }
+
+        offset += vectorized ? findAnnexBStartSequence(&data[offset], length - offset) :
+                               byteFind(&data[offset], length - offset);
+    }
+
+    return nals;
+}
+
+int main(int argc, char** argv) {
+    int accessUnitKb = argc > 1 ? atoi(argv[1]) : 512;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    unsigned int sliceLength, length;
+    unsigned int expectedNals = 0;
+    char* data;
+    int mode;
+    int i;
+
+    if (accessUnitKb <= 0 || iterations <= 0) {
+        fprintf(stderr, "Usage: annexb_scan_bench [access unit KB] [iterations]\n");
+        return 1;
+    }
+
+    // Emulation prevention can add at most a byte for every 2 input bytes
+    sliceLength = (unsigned int)accessUnitKb * 1024 / SLICE_COUNT;
+    data = malloc((size_t)accessUnitKb * 1024 * 3 / 2 + 256 + PADDING_SIZE);
+    if (data == NULL) {
+        return 1;
+    }
+
+    srand(1);
+    length = appendNal(data, 0, 0x67, 24);
+    length = appendNal(data, length, 0x68, 8);
+    for (i = 0; i < SLICE_COUNT; i++) {
+        length = appendNal(data, length, 0x65, sliceLength);
+    }
+    memset(&data[length], 0, PADDING_SIZE);
+    length += PADDING_SIZE;
+
+    printf("%u byte access unit, %d iterations\n", length, iterations);
+    printf("%-12s %10s %12s\n", "scan", "NAL units", "GB/s");
+
+    for (mode = 0; mode < 2; mode++) {
+        bool vectorized = mode == 1;
+        unsigned int nals = 0;
+        uint64_t startUs, elapsedUs;
+
+        startUs = PltGetMicros();
+        for (i = 0; i < iterations; i++) {
+            nals = countNals(data, length, vectorized);
+        }
+        elapsedUs = PltGetMicros() - startUs;
+
+        if (mode == 0) {
+            expectedNals = nals;
+        }
+        else if (nals != expectedNals) {
+            printf("The scans found %u and %u NAL units\n", expectedNals, nals);
+            free(data);
+            return 1;
+        }
+
+        printf("%-12s %10u %12.2f\n", vectorized ? "vectorized" : "byte loop", nals,
+               elapsedUs ? (double)length * iterations / elapsedUs / 1000.0 : 0.0);
+    }
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Checks findAnnexBStartSequence() against the byte at a time scan that the
+// depacketizer used before it was vectorized. Random buffers biased toward
+// 00, 01 and 03 bytes are scanned at every alignment, along with start
+// sequences placed on each side of the 32 byte block boundaries and near
+// the end of the buffer.
+// Usage: annexb_scan_test [seed] [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight-internal.h"
+
+#define MAX_BUFFER_SIZE 512
+#define MAX_ALIGNMENT 32
+
+static unsigned int failures;
+
+// The original getAnnexBStartSequence() check
+static unsigned int referenceStartSequenceLength(const char* data, unsigned int length) {
+    if (length <= 3) {
+        return 0;
+    }
+
+    if (data[0] == 0 && data[1] == 0) {
+        if (data[2] == 0) {
+            if (length > 4 && data[3] == 1) {
+                return 4;
+            }
+        }
+        else if (data[2] == 1) {
+            return 3;
+        }
+    }
+
+    return 0;
+}
+
+// The original skipToNextNalOrEnd() loop
+static unsigned int referenceFind(const char* data, unsigned int length) {
+    unsigned int offset = 0;
+
+    while (referenceStartSequenceLength(&data[offset], length - offset) == 0) {
+        if (offset == length) {
+            break;
+        }
+        offset++;
+    }
+
+    return offset;
+}
+
+static void checkBuffer(const char* data, unsigned int length, const char* description) {
+    unsigned int expected = referenceFind(data, length);
+    unsigned int actual = findAnnexBStartSequence(data, length);
+    unsigned int i;
+
+    if (actual != expected) {
+        if (failures++ < 10) {
+            printf("%s: %u byte buffer, found a start sequence at %u instead of %u\n",
+                   description, length, actual, expected);
+        }
+    }
+
+    for (i = 0; i < length; i++) {
+        if (getAnnexBStartSequenceLength(&data[i], length - i) != referenceStartSequenceLength(&data[i], length - i)) {
+            if (failures++ < 10) {
+                printf("%s: %u byte buffer, wrong start sequence length at %u\n", description, length, i);
+            }
+            break;
+        }
+    }
+}
+
+static char randomByte(void) {
+    // Mostly slice data, with enough zeros to form start sequences and emulation prevention
+    switch (rand() % 8) {
+    case 0:
+    case 1:
+        return 0;
+    case 2:
+        return 1;
+    case 3:
+        return 3;
+    default:
+        return (char)(rand() & 0xFF);
+    }
+}
+
+static void testRandomBuffers(int iterations) {
+    static char storage[MAX_BUFFER_SIZE + MAX_ALIGNMENT];
+    int iter;
+
+    for (iter = 0; iter < iterations; iter++) {
+        unsigned int alignment = rand() % MAX_ALIGNMENT;
+        unsigned int length = rand() % (MAX_BUFFER_SIZE + 1);
+        char* data = &storage[alignment];
+        unsigned int i;
+
+        // Some buffers are sparse, so there are long runs without a zero pair
+        if (rand() % 2) {
+            for (i = 0; i < length; i++) {
+                data[i] = randomByte();
+            }
+        }
+        else {
+            for (i = 0; i < length; i++) {
+                data[i] = (char)(rand() % 255 + 1);
+            }
+            for (i = rand() % 4; i > 0 && length != 0; i--) {
+                data[rand() % length] = 0;
+            }
+        }
+
+        checkBuffer(data, length, "random");
+    }
+}
+
+// A single start sequence at each position of buffers around the block sizes
+static void testPlacedStartSequences(void) {
+    static const char startSequences[][4] = { { 0, 0, 1 }, { 0, 0, 0, 1 } };
+    static char storage[MAX_BUFFER_SIZE + MAX_ALIGNMENT];
+    unsigned int length, position, alignment;
+    int seq;
+
+    for (length = 0; length <= 100; length++) {
+        for (alignment = 0; alignment < 4; alignment++) {
+            char* data = &storage[alignment];
+
+            for (seq = 0; seq < 2; seq++) {
+                unsigned int seqLength = seq == 0 ? 3 : 4;
+
+                for (position = 0; position + seqLength <= length; position++) {
+                    memset(data, 0x55, length);
+                    memcpy(&data[position], startSequences[seq], seqLength);
+                    checkBuffer(data, length, "placed");
+
+                    // A lone zero pair just before it must not be mistaken for one
+                    if (position >= 3) {
+                        data[position - 3] = 0;
+                        data[position - 2] = 0;
+                        checkBuffer(data, length, "placed after zero pair");
+                    }
+                }
+            }
+
+            // Runs of zeros without a 01 byte are never a start sequence
+            memset(data, 0, length);
+            checkBuffer(data, length, "zeros");
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned int seed = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 0) : 1;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200000;
+
+    srand(seed);
+    testPlacedStartSequences();
+    testRandomBuffers(iterations);
+
+    if (failures != 0) {
+        printf("%u mismatches with seed %u\n", failures, seed);
+        return 1;
+    }
+
+    return 0;
+}
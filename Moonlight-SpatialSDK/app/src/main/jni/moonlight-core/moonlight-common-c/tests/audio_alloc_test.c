@@ -0,0 +1,391 @@
+// Checks that audio packet handling doesn't touch the heap once it is warmed up.
+// Encoded FEC blocks with random loss and reordering are fed through the FEC
+// queue on its own, with RtpaAddPacket() and RtpaGetQueuedPacket(), and then
+// through the receive thread's path with replayAudioPacket(), which takes its
+// packet buffers from the audio packet pool. A malloc() hook counts every
+// allocation made after the warmup, and the pool must not take any misses.
+// Usage: audio_alloc_test [seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight-internal.h"
+
+#define WARMUP_BLOCKS 200
+#define TEST_BLOCKS 3000
+#define SHARD_SIZE 200
+#define PACKET_DURATION_MS 5
+
+// The client expects the Opus TOC byte to stay the same for the whole stream
+#define OPUS_TOC_BYTE 0xFC
+
+// RTP payload types of audio data and FEC shards, as in RtpAudioQueue.c
+#define RTP_PAYLOAD_TYPE_AUDIO 97
+#define RTP_PAYLOAD_TYPE_FEC 127
+
+#if defined(__GLIBC__)
+#define HAVE_MALLOC_HOOK 1
+
+// glibc exports its allocator under these names, so the hooks can forward to it
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static volatile int countingAllocations;
+static volatile long allocationCount;
+
+void* malloc(size_t size) {
+    if (countingAllocations) {
+        allocationCount++;
+    }
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (countingAllocations) {
+        allocationCount++;
+    }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (countingAllocations) {
+        allocationCount++;
+    }
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+typedef enum {
+    // Packets go straight into an RTP_AUDIO_QUEUE
+    FEED_RTP_QUEUE,
+
+    // Packets go through replayAudioPacket() like received datagrams
+    FEED_AUDIO_STREAM,
+} FEED_MODE;
+
+typedef struct _TEST_RESULTS {
+    long packetsSent;
+    long packetsDelivered;
+    long packetsConcealed;
+    long packetsOutOfOrder;
+    long heapAllocations;
+    uint64_t poolMissesAfterWarmup;
+} TEST_RESULTS, *PTEST_RESULTS;
+
+// Big enough for any packet RtpaGetQueuedPacket() can return
+static char packetBuffer[RTPA_MAX_PACKET_SIZE];
+
+// The audio stream's decodeAndPlaySample() callback only gets the payload,
+// so its checks go through these
+static PTEST_RESULTS streamResults;
+static uint16_t streamExpectedSeq;
+
+// The payload starts with the TOC byte and the sequence number, so each packet can
+// be identified from its payload alone
+static uint8_t expectedData(int sequenceNumber, int offset) {
+    switch (offset) {
+    case 0:
+        return OPUS_TOC_BYTE;
+    case 1:
+        return (uint8_t)(sequenceNumber >> 8);
+    case 2:
+        return (uint8_t)sequenceNumber;
+    default:
+        return (uint8_t)(sequenceNumber * 7 + offset);
+    }
+}
+
+static void checkDelivered(PTEST_RESULTS results, const uint8_t* payload, int length, uint16_t* expectedSeq) {
+    uint16_t sequenceNumber = (uint16_t)((payload[1] << 8) | payload[2]);
+    int i;
+
+    // The queue may skip packets while it synchronizes with the first FEC block
+    if (length != SHARD_SIZE || (results->packetsDelivered != 0 && sequenceNumber != *expectedSeq)) {
+        results->packetsOutOfOrder++;
+    }
+    else {
+        for (i = 0; i < SHARD_SIZE; i++) {
+            if (payload[i] != expectedData(sequenceNumber, i)) {
+                results->packetsOutOfOrder++;
+                break;
+            }
+        }
+    }
+
+    *expectedSeq = sequenceNumber + 1;
+    results->packetsDelivered++;
+}
+
+static void streamDecodeAndPlaySample(char* sampleData, int sampleLength) {
+    if (sampleData == NULL) {
+        // Lost packets are concealed
+        streamResults->packetsConcealed++;
+        streamExpectedSeq++;
+    }
+    else {
+        checkDelivered(streamResults, (const uint8_t*)sampleData, sampleLength, &streamExpectedSeq);
+    }
+}
+
+static void addToRtpQueue(PRTP_AUDIO_QUEUE queue, PTEST_RESULTS results, uint16_t length, uint16_t* expectedSeq) {
+    PRTP_PACKET packet = (PRTP_PACKET)packetBuffer;
+    int status;
+
+    status = RtpaAddPacket(queue, packet, length);
+    if (RTPQ_HANDLE_NOW(status)) {
+        checkDelivered(results, (const uint8_t*)(packet + 1), length - (int)sizeof(*packet), expectedSeq);
+    }
+    else if (RTPQ_PACKET_READY(status)) {
+        uint16_t queuedLength;
+
+        while (RtpaGetQueuedPacket(queue, packet, sizeof(packetBuffer), &queuedLength)) {
+            if (queuedLength == 0) {
+                // Lost packets are returned empty for concealment
+                results->packetsConcealed++;
+                (*expectedSeq)++;
+            }
+            else {
+                checkDelivered(results, (const uint8_t*)(packet + 1), queuedLength - (int)sizeof(*packet), expectedSeq);
+            }
+        }
+    }
+}
+
+// The receive thread gets the RTP header in network byte order
+static void replayPacket(uint16_t length) {
+    PRTP_PACKET packet = (PRTP_PACKET)packetBuffer;
+
+    packet->sequenceNumber = BE16(packet->sequenceNumber);
+    packet->timestamp = BE32(packet->timestamp);
+    packet->ssrc = BE32(packet->ssrc);
+    replayAudioPacket(packetBuffer, length);
+}
+
+// Builds the data and FEC packets of a block with the same layout the host uses
+static void buildBlock(PRTP_AUDIO_QUEUE queue, int blockIndex,
+                       uint8_t packets[RTPA_TOTAL_SHARDS][sizeof(RTP_PACKET) + sizeof(AUDIO_FEC_HEADER) + SHARD_SIZE],
+                       uint16_t lengths[RTPA_TOTAL_SHARDS]) {
+    uint8_t data[RTPA_DATA_SHARDS][SHARD_SIZE];
+    uint8_t parity[RTPA_FEC_SHARDS][SHARD_SIZE];
+    unsigned char* shards[RTPA_TOTAL_SHARDS];
+    uint16_t baseSeq = (uint16_t)(blockIndex * RTPA_DATA_SHARDS);
+    int i, j;
+
+    for (i = 0; i < RTPA_DATA_SHARDS; i++) {
+        for (j = 0; j < SHARD_SIZE; j++) {
+            data[i][j] = expectedData(baseSeq + i, j);
+        }
+        shards[i] = data[i];
+    }
+    for (i = 0; i < RTPA_FEC_SHARDS; i++) {
+        shards[RTPA_DATA_SHARDS + i] = parity[i];
+    }
+    reed_solomon_encode(queue->rs, shards, RTPA_TOTAL_SHARDS, SHARD_SIZE);
+
+    for (i = 0; i < RTPA_TOTAL_SHARDS; i++) {
+        PRTP_PACKET rtp = (PRTP_PACKET)packets[i];
+
+        memset(rtp, 0, sizeof(*rtp));
+        rtp->header = 0x80;
+
+        if (i < RTPA_DATA_SHARDS) {
+            rtp->packetType = RTP_PAYLOAD_TYPE_AUDIO;
+            rtp->sequenceNumber = (uint16_t)(baseSeq + i);
+            rtp->timestamp = (uint32_t)(baseSeq + i) * PACKET_DURATION_MS;
+            memcpy(rtp + 1, data[i], SHARD_SIZE);
+            lengths[i] = sizeof(*rtp) + SHARD_SIZE;
+        }
+        else {
+            PAUDIO_FEC_HEADER fecHeader = (PAUDIO_FEC_HEADER)(rtp + 1);
+
+            rtp->packetType = RTP_PAYLOAD_TYPE_FEC;
+            rtp->sequenceNumber = (uint16_t)(blockIndex * RTPA_FEC_SHARDS + i - RTPA_DATA_SHARDS);
+            fecHeader->fecShardIndex = (uint8_t)(i - RTPA_DATA_SHARDS);
+            fecHeader->payloadType = RTP_PAYLOAD_TYPE_AUDIO;
+            fecHeader->baseSequenceNumber = BE16(baseSeq);
+            fecHeader->baseTimestamp = BE32((uint32_t)baseSeq * PACKET_DURATION_MS);
+            fecHeader->ssrc = 0;
+            memcpy(fecHeader + 1, parity[i - RTPA_DATA_SHARDS], SHARD_SIZE);
+            lengths[i] = sizeof(*rtp) + sizeof(*fecHeader) + SHARD_SIZE;
+        }
+    }
+}
+
+static void runStream(PRTP_AUDIO_QUEUE queue, FEED_MODE mode, PTEST_RESULTS results) {
+    uint16_t expectedSeq = 0;
+    int blockIndex;
+
+    streamResults = results;
+    streamExpectedSeq = 0;
+
+    for (blockIndex = 1; blockIndex <= WARMUP_BLOCKS + TEST_BLOCKS; blockIndex++) {
+        uint8_t packets[RTPA_TOTAL_SHARDS][sizeof(RTP_PACKET) + sizeof(AUDIO_FEC_HEADER) + SHARD_SIZE];
+        uint16_t lengths[RTPA_TOTAL_SHARDS];
+        int order[RTPA_TOTAL_SHARDS];
+        int drops[3];
+        int i, k;
+
+        if (blockIndex == WARMUP_BLOCKS + 1) {
+            if (mode == FEED_AUDIO_STREAM) {
+                PACKET_POOL_STATS poolStats;
+
+                if (LiGetAudioPacketPoolStats(&poolStats)) {
+                    results->poolMissesAfterWarmup = poolStats.misses;
+                }
+            }
+
+#ifdef HAVE_MALLOC_HOOK
+            allocationCount = 0;
+            countingAllocations = 1;
+#endif
+        }
+
+        buildBlock(queue, blockIndex, packets, lengths);
+
+        // Swap two data shards in a quarter of the blocks
+        for (i = 0; i < RTPA_TOTAL_SHARDS; i++) {
+            order[i] = i;
+        }
+        if (rand() % 4 == 0) {
+            int a = rand() % RTPA_DATA_SHARDS;
+            int b = rand() % RTPA_DATA_SHARDS;
+            int tmp = order[a];
+
+            order[a] = order[b];
+            order[b] = tmp;
+        }
+
+        // Lose a data shard in a third of the blocks and occasionally more shards
+        // than FEC can recover, so both recovery and concealment are covered
+        drops[0] = rand() % 3 == 0 ? rand() % RTPA_DATA_SHARDS : -1;
+        drops[1] = rand() % 20 == 0 ? (drops[0] + 1) % RTPA_TOTAL_SHARDS : -1;
+        drops[2] = rand() % 40 == 0 ? (drops[0] + 2) % RTPA_TOTAL_SHARDS : -1;
+
+        for (k = 0; k < RTPA_TOTAL_SHARDS; k++) {
+            int shard = order[k];
+
+            if (shard == drops[0] || shard == drops[1] || shard == drops[2]) {
+                continue;
+            }
+
+            memcpy(packetBuffer, packets[shard], lengths[shard]);
+            results->packetsSent++;
+
+            if (mode == FEED_AUDIO_STREAM) {
+                replayPacket(lengths[shard]);
+            }
+            else {
+                addToRtpQueue(queue, results, lengths[shard], &expectedSeq);
+            }
+        }
+    }
+
+#ifdef HAVE_MALLOC_HOOK
+    countingAllocations = 0;
+    results->heapAllocations = allocationCount;
+#endif
+}
+
+// Returns non-zero if the stream wasn't delivered intact
+static int checkResults(const char* name, PTEST_RESULTS results) {
+    int err = 0;
+
+    printf("%s: %ld packets sent, %ld delivered, %ld concealed, %ld out of order\n", name,
+           results->packetsSent, results->packetsDelivered, results->packetsConcealed, results->packetsOutOfOrder);
+
+    if (results->packetsOutOfOrder != 0 || results->packetsDelivered == 0) {
+        printf("%s: packets were delivered out of order or corrupted\n", name);
+        err = 1;
+    }
+
+#ifdef HAVE_MALLOC_HOOK
+    printf("%s: %ld heap allocations after %d warmup blocks\n", name, results->heapAllocations, WARMUP_BLOCKS);
+    if (results->heapAllocations != 0) {
+        err = 1;
+    }
+#endif
+
+    return err;
+}
+
+// Sends the stream through the audio stream's receive path, as a client with
+// direct submit would see it
+static int runAudioStream(PRTP_AUDIO_QUEUE fecQueue) {
+    PACKET_POOL_STATS poolStats;
+    TEST_RESULTS results;
+    int err = 0;
+
+    LiInitializeAudioCallbacks(&AudioCallbacks);
+    AudioCallbacks.decodeAndPlaySample = streamDecodeAndPlaySample;
+    AudioCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+
+    if (initializeAudioStream() != 0 || prepareAudioReplay() != 0) {
+        printf("Failed to initialize the audio stream\n");
+        return 1;
+    }
+
+    memset(&results, 0, sizeof(results));
+    runStream(fecQueue, FEED_AUDIO_STREAM, &results);
+    err |= checkResults("Audio stream", &results);
+
+    if (LiGetAudioPacketPoolStats(&poolStats)) {
+        printf("Audio packet pool: %d buffers, %llu hits, %llu misses (%llu after warmup)\n",
+               poolStats.totalBuffers, (unsigned long long)poolStats.hits, (unsigned long long)poolStats.misses,
+               (unsigned long long)(poolStats.misses - results.poolMissesAfterWarmup));
+        if (poolStats.misses != results.poolMissesAfterWarmup) {
+            printf("The audio packet pool ran out of buffers\n");
+            err = 1;
+        }
+    }
+    else {
+        printf("The audio packet pool wasn't initialized\n");
+        err = 1;
+    }
+
+    destroyAudioStream();
+    return err;
+}
+
+int main(int argc, char** argv) {
+    unsigned int seed = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 0) : 1;
+    RTP_AUDIO_QUEUE queue;
+    TEST_RESULTS results;
+    int err = 0;
+
+    // Sunshine with audio FEC
+    AppVersionQuad[0] = 7;
+    AppVersionQuad[1] = 1;
+    AppVersionQuad[2] = 431;
+    AudioPacketDuration = PACKET_DURATION_MS;
+
+    RtpaInitializeQueue(&queue);
+    if (RtpaAllocateBlockArena(&queue, PACKET_DURATION_MS) != 0) {
+        printf("Failed to allocate the FEC block arena\n");
+        return 1;
+    }
+
+#ifndef HAVE_MALLOC_HOOK
+    printf("No malloc() hook on this platform, heap allocations not checked\n");
+#endif
+
+    srand(seed);
+    memset(&results, 0, sizeof(results));
+    runStream(&queue, FEED_RTP_QUEUE, &results);
+    err |= checkResults("FEC queue", &results);
+
+    printf("FEC block arena: %u blocks, %u misses\n", queue.arenaBlockCount, queue.arenaMisses);
+    if (queue.arenaMisses != 0) {
+        printf("The FEC block arena ran out of blocks\n");
+        err = 1;
+    }
+
+    // The same stream again through the receive thread's path. The FEC queue
+    // above is only used to encode the FEC shards.
+    srand(seed);
+    err |= runAudioStream(&queue);
+
+    RtpaCleanupQueue(&queue);
+    return err;
+}
@@ -0,0 +1,245 @@
+// Video packet decryption throughput of PltDecryptMessage() against
+// PltDecryptMessageBatch(). A set of AES-GCM packets is encrypted up front
+// and then decrypted repeatedly, one message per call or a batch per call.
+// The plaintext of both paths is checked, and a packet with a corrupted tag
+// must only fail on its own.
+// Usage: crypto_batch_bench [packets] [batch size] [packet size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight-internal.h"
+
+#define IV_SIZE 12
+#define TAG_SIZE 16
+
+// Distinct packets that are decrypted over and over
+#define PACKET_SET_SIZE 1024
+
+typedef struct _TEST_PACKET {
+    unsigned char iv[IV_SIZE];
+    unsigned char tag[TAG_SIZE];
+    unsigned char* plaintext;
+    unsigned char* ciphertext;
+    unsigned char* output;
+} TEST_PACKET, *PTEST_PACKET;
+
+static unsigned char key[16];
+
+static int encryptPackets(PTEST_PACKET packets, int packetSize) {
+    PPLT_CRYPTO_CONTEXT ctx = PltCreateCryptoContext();
+    int i, j;
+
+    for (i = 0; i < PACKET_SET_SIZE; i++) {
+        int ciphertextLength = packetSize;
+
+        packets[i].plaintext = malloc(packetSize);
+        packets[i].ciphertext = malloc(packetSize);
+        packets[i].output = malloc(packetSize);
+        if (packets[i].plaintext == NULL || packets[i].ciphertext == NULL || packets[i].output == NULL) {
+            PltDestroyCryptoContext(ctx);
+            return -1;
+        }
+
+        for (j = 0; j < packetSize; j++) {
+            packets[i].plaintext[j] = (unsigned char)(i * 31 + j);
+        }
+
+        // Each packet gets its own IV like the host's video packets
+        memset(packets[i].iv, 0, sizeof(packets[i].iv));
+        memcpy(packets[i].iv, &i, sizeof(i));
+
+        if (!PltEncryptMessage(ctx, ALGORITHM_AES_GCM, 0, key, sizeof(key),
+                               packets[i].iv, IV_SIZE, packets[i].tag, TAG_SIZE,
+                               packets[i].plaintext, packetSize,
+                               packets[i].ciphertext, &ciphertextLength) ||
+                ciphertextLength != packetSize) {
+            PltDestroyCryptoContext(ctx);
+            return -1;
+        }
+    }
+
+    PltDestroyCryptoContext(ctx);
+    return 0;
+}
+
+static int checkOutput(PTEST_PACKET packets, int packetSize, const char* mode) {
+    int i;
+
+    for (i = 0; i < PACKET_SET_SIZE; i++) {
+        if (memcmp(packets[i].output, packets[i].plaintext, packetSize) != 0) {
+            printf("%s: packet %d was not decrypted correctly\n", mode, i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int decryptSingle(PPLT_CRYPTO_CONTEXT ctx, PTEST_PACKET packets, int first, int count, int packetSize) {
+    int decrypted = 0;
+    int i;
+
+    for (i = first; i < first + count; i++) {
+        int outputLength = packetSize;
+
+        if (PltDecryptMessage(ctx, ALGORITHM_AES_GCM, 0, key, sizeof(key),
+                              packets[i].iv, IV_SIZE, packets[i].tag, TAG_SIZE,
+                              packets[i].ciphertext, packetSize,
+                              packets[i].output, &outputLength)) {
+            decrypted++;
+        }
+    }
+
+    return decrypted;
+}
+
+static int decryptBatch(PPLT_CRYPTO_CONTEXT ctx, PTEST_PACKET packets, int first, int count, int packetSize,
+                        PPLT_CRYPTO_MESSAGE messages) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        messages[i].iv = packets[first + i].iv;
+        messages[i].tag = packets[first + i].tag;
+        messages[i].inputData = packets[first + i].ciphertext;
+        messages[i].inputDataLength = packetSize;
+        messages[i].outputData = packets[first + i].output;
+        messages[i].outputDataLength = packetSize;
+    }
+
+    return PltDecryptMessageBatch(ctx, ALGORITHM_AES_GCM, key, sizeof(key), IV_SIZE, TAG_SIZE, messages, count);
+}
+
+// Decrypts the packet set over and over until packetCount packets have been decrypted
+static int runMode(bool batched, PTEST_PACKET packets, int packetCount, int batchSize, int packetSize,
+                   PPLT_CRYPTO_MESSAGE messages, uint64_t* elapsedUs) {
+    PPLT_CRYPTO_CONTEXT ctx = PltCreateCryptoContext();
+    uint64_t startUs;
+    int decrypted = 0;
+    int done = 0;
+
+    startUs = PltGetMicros();
+    while (done < packetCount) {
+        int first = done % PACKET_SET_SIZE;
+        int count = batchSize;
+
+        if (count > PACKET_SET_SIZE - first) {
+            count = PACKET_SET_SIZE - first;
+        }
+        if (count > packetCount - done) {
+            count = packetCount - done;
+        }
+
+        if (batched) {
+            decrypted += decryptBatch(ctx, packets, first, count, packetSize, messages);
+        }
+        else {
+            decrypted += decryptSingle(ctx, packets, first, count, packetSize);
+        }
+        done += count;
+    }
+    *elapsedUs = PltGetMicros() - startUs;
+
+    PltDestroyCryptoContext(ctx);
+    return decrypted;
+}
+
+// A batch with one bad tag must still decrypt every other packet
+static int checkCorruptTag(PTEST_PACKET packets, int batchSize, int packetSize, PPLT_CRYPTO_MESSAGE messages) {
+    PPLT_CRYPTO_CONTEXT ctx = PltCreateCryptoContext();
+    int corrupted = batchSize / 2;
+    int decrypted;
+    int i;
+
+    packets[corrupted].tag[0] ^= 0x01;
+    decrypted = decryptBatch(ctx, packets, 0, batchSize, packetSize, messages);
+    packets[corrupted].tag[0] ^= 0x01;
+    PltDestroyCryptoContext(ctx);
+
+    if (decrypted != batchSize - 1 || messages[corrupted].decrypted) {
+        printf("Corrupt tag: %d of %d packets decrypted\n", decrypted, batchSize);
+        return -1;
+    }
+
+    for (i = 0; i < batchSize; i++) {
+        if (i != corrupted && memcmp(packets[i].output, packets[i].plaintext, packetSize) != 0) {
+            printf("Corrupt tag: packet %d was not decrypted correctly\n", i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int packetCount = argc > 1 ? atoi(argv[1]) : 1000000;
+    int batchSize = argc > 2 ? atoi(argv[2]) : 32;
+    int packetSize = argc > 3 ? atoi(argv[3]) : 1392;
+    PTEST_PACKET packets;
+    PPLT_CRYPTO_MESSAGE messages;
+    int err = 0;
+    int mode;
+    int i;
+
+    if (packetCount <= 0 || batchSize <= 0 || batchSize > PACKET_SET_SIZE || packetSize <= 0) {
+        fprintf(stderr, "Usage: crypto_batch_bench [packets] [batch size] [packet size]\n");
+        return 1;
+    }
+
+    for (i = 0; i < (int)sizeof(key); i++) {
+        key[i] = (unsigned char)(0x10 + i);
+    }
+
+    packets = calloc(PACKET_SET_SIZE, sizeof(*packets));
+    messages = calloc(batchSize, sizeof(*messages));
+    if (packets == NULL || messages == NULL || encryptPackets(packets, packetSize) != 0) {
+        fprintf(stderr, "Failed to encrypt the test packets\n");
+        return 1;
+    }
+
+    printf("%d packets of %d bytes, %d per batch\n", packetCount, packetSize, batchSize);
+    printf("%-8s %12s %12s %12s\n", "mode", "kpackets/s", "MB/s", "ns/packet");
+
+    for (mode = 0; mode < 2 && err == 0; mode++) {
+        bool batched = mode == 1;
+        uint64_t elapsedUs;
+        int decrypted;
+
+        for (i = 0; i < PACKET_SET_SIZE; i++) {
+            memset(packets[i].output, 0, packetSize);
+        }
+
+        decrypted = runMode(batched, packets, packetCount, batchSize, packetSize, messages, &elapsedUs);
+        if (decrypted != packetCount) {
+            printf("%s: %d of %d packets decrypted\n", batched ? "batch" : "single", decrypted, packetCount);
+            err = 1;
+            break;
+        }
+        if (packetCount >= PACKET_SET_SIZE && checkOutput(packets, packetSize, batched ? "batch" : "single") != 0) {
+            err = 1;
+            break;
+        }
+
+        if (elapsedUs == 0) {
+            elapsedUs = 1;
+        }
+        printf("%-8s %12.1f %12.1f %12.1f\n", batched ? "batch" : "single",
+               packetCount * 1000.0 / elapsedUs,
+               (double)packetCount * packetSize / elapsedUs,
+               elapsedUs * 1000.0 / packetCount);
+    }
+
+    if (err == 0 && checkCorruptTag(packets, batchSize, packetSize, messages) != 0) {
+        err = 1;
+    }
+
+    for (i = 0; i < PACKET_SET_SIZE; i++) {
+        free(packets[i].plaintext);
+        free(packets[i].ciphertext);
+        free(packets[i].output);
+    }
+    free(packets);
+    free(messages);
+    return err;
+}
@@ -0,0 +1,134 @@
+// Checks the percentiles reported by LiGetFrameTraceStats() against a trace
+// with a known distribution. More frames than the trace history holds are
+// recorded, so only the most recent ones must be counted, and the decoder
+// stages are only reported for some of the frames.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight-internal.h"
+
+#define TRACED_FRAMES 1000
+#define FRAME_INTERVAL_US 8333
+
+// Frames still in the history after the trace wraps around
+#define FIRST_KEPT_FRAME (TRACED_FRAMES - FRAME_TRACE_HISTORY)
+
+// Index of a percentile in the sorted samples, as computed by the trace
+#define PERCENTILE_INDEX(count, percentile) ((uint32_t)(((count) - 1) * (percentile) / 100))
+
+static int failures;
+
+static void checkValue(const char* name, int stage, uint32_t actual, uint32_t expected) {
+    if (actual != expected) {
+        printf("Stage %d %s: %u (expected %u)\n", stage, name, actual, expected);
+        failures++;
+    }
+}
+
+// Each stage takes 1000 us per stage index plus a variable part. The variable part
+// walks through 0..FRAME_TRACE_HISTORY-1, so the history holds each value exactly once.
+static uint32_t stageDeltaUs(int stage, uint32_t variableUs) {
+    return stage * 1000 + variableUs;
+}
+
+// The decoder stages are only reported for even frames
+static bool frameHasStage(uint32_t frameNumber, int stage) {
+    return stage < FRAME_TRACE_INPUT_ACQUIRED || (frameNumber % 2) == 0;
+}
+
+static void traceFrame(uint32_t frameNumber) {
+    uint64_t timeUs = 1000000 + (uint64_t)frameNumber * FRAME_INTERVAL_US;
+    uint32_t variableUs = frameNumber % FRAME_TRACE_HISTORY;
+    int stage;
+
+    FtRecordFrameStage(frameNumber, FRAME_TRACE_FIRST_PACKET, timeUs);
+    for (stage = 1; stage < FRAME_TRACE_STAGE_COUNT; stage++) {
+        if (frameHasStage(frameNumber, stage)) {
+            timeUs += stageDeltaUs(stage, variableUs);
+            FtRecordFrameStage(frameNumber, stage, timeUs);
+        }
+    }
+}
+
+static void checkStats(PFRAME_TRACE_STATS stats) {
+    int stage;
+
+    for (stage = 0; stage < FRAME_TRACE_STAGE_COUNT; stage++) {
+        // The even frames have even variable parts and the others have all of them
+        uint32_t count = frameHasStage(1, stage) ? FRAME_TRACE_HISTORY : FRAME_TRACE_HISTORY / 2;
+        uint32_t step = frameHasStage(1, stage) ? 1 : 2;
+        uint32_t p50 = PERCENTILE_INDEX(count, 50) * step;
+        uint32_t p99 = PERCENTILE_INDEX(count, 99) * step;
+        uint32_t fixedTotalUs = 0;
+        int i;
+
+        checkValue("frame count", stage, stats->frameCount[stage], count);
+
+        if (stage == FRAME_TRACE_FIRST_PACKET) {
+            checkValue("stage p50", stage, stats->stageP50Us[stage], 0);
+            checkValue("stage p99", stage, stats->stageP99Us[stage], 0);
+            checkValue("total p50", stage, stats->totalP50Us[stage], 0);
+            checkValue("total p99", stage, stats->totalP99Us[stage], 0);
+            continue;
+        }
+
+        // The total includes every earlier stage, and each adds the variable part once
+        for (i = 1; i <= stage; i++) {
+            fixedTotalUs += stageDeltaUs(i, 0);
+        }
+
+        checkValue("stage p50", stage, stats->stageP50Us[stage], stageDeltaUs(stage, p50));
+        checkValue("stage p99", stage, stats->stageP99Us[stage], stageDeltaUs(stage, p99));
+        checkValue("total p50", stage, stats->totalP50Us[stage], fixedTotalUs + stage * p50);
+        checkValue("total p99", stage, stats->totalP99Us[stage], fixedTotalUs + stage * p99);
+    }
+}
+
+int main(int argc, char** argv) {
+    FRAME_TRACE_STATS stats;
+    uint32_t frameNumber;
+    int stage;
+
+    FtInitialize();
+    if (LiGetFrameTraceStats(&stats)) {
+        printf("Stats were returned before any frame was traced\n");
+        failures++;
+    }
+
+    for (frameNumber = 0; frameNumber < TRACED_FRAMES; frameNumber++) {
+        traceFrame(frameNumber);
+    }
+
+    // A late stage for a frame that has left the history lands in a slot that now
+    // belongs to a newer frame, so it must be ignored rather than skewing that frame
+    FtRecordFrameStage(FIRST_KEPT_FRAME - 1, FRAME_TRACE_OUTPUT_RELEASED, UINT64_MAX / 2);
+
+    if (!LiGetFrameTraceStats(&stats)) {
+        printf("No stats were returned for %d traced frames\n", TRACED_FRAMES);
+        return 1;
+    }
+    checkStats(&stats);
+
+    printf("%-8s %8s %10s %10s %10s %10s\n", "stage", "frames", "stage p50", "stage p99", "total p50", "total p99");
+    for (stage = 0; stage < FRAME_TRACE_STAGE_COUNT; stage++) {
+        printf("%-8d %8u %10u %10u %10u %10u\n", stage, stats.frameCount[stage],
+               stats.stageP50Us[stage], stats.stageP99Us[stage],
+               stats.totalP50Us[stage], stats.totalP99Us[stage]);
+    }
+
+    // Reinitializing for a new stream must discard the old frames
+    FtInitialize();
+    if (LiGetFrameTraceStats(&stats)) {
+        printf("Stats were returned after the trace was reinitialized\n");
+        failures++;
+    }
+
+    if (failures != 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+// Throughput of the lock-free queue against the linked blocking queue it
+// replaced. Each queue is measured with an uncontended offer and poll on one
+// thread, and with one or more producer threads handing elements to a
+// consumer thread that waits on the queue, like the decode unit queue.
+// Usage: queue_bench [elements] [producers]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight-internal.h"
+
+#define QUEUE_BOUND 32
+#define MAX_PRODUCERS 8
+
+typedef struct _BENCH_QUEUE {
+    bool lockFree;
+    LOCK_FREE_QUEUE lfq;
+    LINKED_BLOCKING_QUEUE lbq;
+
+    // LBQ needs an entry per queued element, so each element is its own entry
+    PLINKED_BLOCKING_QUEUE_ENTRY entries;
+} BENCH_QUEUE, *PBENCH_QUEUE;
+
+typedef struct _PRODUCER_CONTEXT {
+    PBENCH_QUEUE queue;
+    int first;
+    int count;
+    int fullCount;
+} PRODUCER_CONTEXT, *PPRODUCER_CONTEXT;
+
+static int initializeQueue(PBENCH_QUEUE queue, bool lockFree, int elementCount) {
+    memset(queue, 0, sizeof(*queue));
+    queue->lockFree = lockFree;
+
+    if (lockFree) {
+        return LfqInitializeQueue(&queue->lfq, QUEUE_BOUND);
+    }
+
+    queue->entries = malloc(sizeof(*queue->entries) * (size_t)elementCount);
+    if (queue->entries == NULL) {
+        return -1;
+    }
+
+    return LbqInitializeLinkedBlockingQueue(&queue->lbq, QUEUE_BOUND);
+}
+
+static void destroyQueue(PBENCH_QUEUE queue) {
+    if (queue->lockFree) {
+        LfqDestroyQueue(&queue->lfq);
+    }
+    else {
+        LbqDestroyLinkedBlockingQueue(&queue->lbq);
+        free(queue->entries);
+    }
+}
+
+static int offerElement(PBENCH_QUEUE queue, int element) {
+    void* data = (void*)(uintptr_t)(element + 1);
+
+    if (queue->lockFree) {
+        return LfqOfferQueueItem(&queue->lfq, data);
+    }
+    else {
+        return LbqOfferQueueItem(&queue->lbq, data, &queue->entries[element]);
+    }
+}
+
+static int pollElement(PBENCH_QUEUE queue, void** data) {
+    return queue->lockFree ? LfqPollQueueElement(&queue->lfq, data) : LbqPollQueueElement(&queue->lbq, data);
+}
+
+static int waitForElement(PBENCH_QUEUE queue, void** data) {
+    return queue->lockFree ? LfqWaitForQueueElement(&queue->lfq, data) : LbqWaitForQueueElement(&queue->lbq, data);
+}
+
+static void signalDrain(PBENCH_QUEUE queue) {
+    if (queue->lockFree) {
+        LfqSignalQueueDrain(&queue->lfq);
+    }
+    else {
+        LbqSignalQueueDrain(&queue->lbq);
+    }
+}
+
+// Returns ns per offer and poll pair
+static double runUncontended(bool lockFree, int elementCount) {
+    BENCH_QUEUE queue;
+    uint64_t startUs, elapsedUs;
+    void* data;
+    int i;
+
+    if (initializeQueue(&queue, lockFree, elementCount) != 0) {
+        return -1;
+    }
+
+    startUs = PltGetMicros();
+    for (i = 0; i < elementCount; i++) {
+        if (offerElement(&queue, i) != LBQ_SUCCESS || pollElement(&queue, &data) != LBQ_SUCCESS) {
+            destroyQueue(&queue);
+            return -1;
+        }
+    }
+    elapsedUs = PltGetMicros() - startUs;
+
+    destroyQueue(&queue);
+    return elapsedUs * 1000.0 / elementCount;
+}
+
+static void ProducerThreadProc(void* context) {
+    PPRODUCER_CONTEXT producer = (PPRODUCER_CONTEXT)context;
+    int i;
+
+    for (i = producer->first; i < producer->first + producer->count; i++) {
+        while (offerElement(producer->queue, i) == LBQ_BOUND_EXCEEDED) {
+            producer->fullCount++;
+            PltSleepMs(0);
+        }
+    }
+}
+
+// Returns ns per element handed from the producers to the consumer
+static double runHandoff(bool lockFree, int elementCount, int producerCount, int* fullCount) {
+    BENCH_QUEUE queue;
+    PRODUCER_CONTEXT producers[MAX_PRODUCERS];
+    PLT_THREAD threads[MAX_PRODUCERS];
+    uint64_t startUs, elapsedUs;
+    void* data;
+    int received = 0;
+    int i;
+
+    if (initializeQueue(&queue, lockFree, elementCount) != 0) {
+        return -1;
+    }
+
+    startUs = PltGetMicros();
+    for (i = 0; i < producerCount; i++) {
+        producers[i].queue = &queue;
+        producers[i].first = i * (elementCount / producerCount);
+        producers[i].count = i == producerCount - 1 ? elementCount - producers[i].first : elementCount / producerCount;
+        producers[i].fullCount = 0;
+        if (PltCreateThread("Producer", ProducerThreadProc, &producers[i], &threads[i]) != 0) {
+            producerCount = i;
+            break;
+        }
+    }
+
+    while (received < elementCount && waitForElement(&queue, &data) == LBQ_SUCCESS) {
+        received++;
+    }
+    elapsedUs = PltGetMicros() - startUs;
+
+    *fullCount = 0;
+    for (i = 0; i < producerCount; i++) {
+        PltJoinThread(&threads[i]);
+        *fullCount += producers[i].fullCount;
+    }
+
+    signalDrain(&queue);
+    destroyQueue(&queue);
+    return received == elementCount ? elapsedUs * 1000.0 / elementCount : -1;
+}
+
+int main(int argc, char** argv) {
+    int elementCount = argc > 1 ? atoi(argv[1]) : 1000000;
+    int maxProducers = argc > 2 ? atoi(argv[2]) : 3;
+    int mode;
+
+    if (elementCount <= 0 || maxProducers <= 0 || maxProducers > MAX_PRODUCERS) {
+        fprintf(stderr, "Usage: queue_bench [elements] [producers]\n");
+        return 1;
+    }
+
+    printf("%d elements, queue bound %d\n", elementCount, QUEUE_BOUND);
+    printf("%-10s %-14s %12s %12s\n", "queue", "mode", "ns/element", "full waits");
+
+    for (mode = 0; mode < 2; mode++) {
+        bool lockFree = mode == 1;
+        const char* name = lockFree ? "lock-free" : "LBQ";
+        double ns;
+        int producers;
+
+        ns = runUncontended(lockFree, elementCount);
+        if (ns < 0) {
+            fprintf(stderr, "%s: uncontended run failed\n", name);
+            return 1;
+        }
+        printf("%-10s %-14s %12.1f %12s\n", name, "uncontended", ns, "-");
+
+        for (producers = 1; producers <= maxProducers; producers++) {
+            char modeName[32];
+            int fullCount;
+
+            ns = runHandoff(lockFree, elementCount, producers, &fullCount);
+            if (ns < 0) {
+                fprintf(stderr, "%s: handoff with %d producers failed\n", name, producers);
+                return 1;
+            }
+
+            snprintf(modeName, sizeof(modeName), "%d producer%s", producers, producers == 1 ? "" : "s");
+            printf("%-10s %-14s %12.1f %12d\n", name, modeName, ns, fullCount);
+        }
+    }
+
+    return 0;
+}
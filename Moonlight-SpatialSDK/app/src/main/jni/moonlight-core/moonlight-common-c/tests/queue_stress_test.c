@@ -0,0 +1,294 @@
+// Stress test for the lock-free queue. Several producers offer numbered
+// elements into a small queue while a consumer waits on it, so the ring
+// wraps and fills constantly. Every element must come out exactly once and
+// in the order its producer offered it. The same is checked while a
+// producer flushes the queue under a waiting consumer, as the receive
+// thread does on overflow, and the shutdown, drain and user wake signals
+// must release a parked consumer.
+// Usage: queue_stress_test [elements per producer]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight-internal.h"
+
+#define PRODUCER_COUNT 3
+#define QUEUE_BOUND 32
+
+// Elements are the producer number and a sequence number starting at 1
+#define ELEMENT(producer, seq) ((void*)(uintptr_t)(((uintptr_t)(producer) << 24) | (uintptr_t)(seq)))
+#define ELEMENT_PRODUCER(element) ((int)((uintptr_t)(element) >> 24))
+#define ELEMENT_SEQ(element) ((int)((uintptr_t)(element) & 0xFFFFFF))
+
+typedef struct _PRODUCER_CONTEXT {
+    PLOCK_FREE_QUEUE queue;
+    int producer;
+    int elementCount;
+    bool flush;
+    int flushCount;
+    int fullCount;
+} PRODUCER_CONTEXT, *PPRODUCER_CONTEXT;
+
+typedef struct _CONSUMER_CONTEXT {
+    PLOCK_FREE_QUEUE queue;
+    int elementCount;
+    uint8_t* received[PRODUCER_COUNT];
+    int lastSeq[PRODUCER_COUNT];
+    int receivedCount;
+    int outOfOrder;
+    int invalid;
+    int result;
+} CONSUMER_CONTEXT, *PCONSUMER_CONTEXT;
+
+// Elements removed by flushes, indexed by the producer that offered them
+static uint8_t* flushedElements[PRODUCER_COUNT];
+
+static int failures;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("Check failed at line %d: %s\n", __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static void ProducerThreadProc(void* context) {
+    PPRODUCER_CONTEXT producer = (PPRODUCER_CONTEXT)context;
+    int seq;
+
+    for (seq = 1; seq <= producer->elementCount; seq++) {
+        int err;
+
+        while ((err = LfqOfferQueueItem(producer->queue, ELEMENT(producer->producer, seq))) == LBQ_BOUND_EXCEEDED) {
+            producer->fullCount++;
+
+            if (producer->flush) {
+                void* data;
+
+                // Flush the whole queue like the receive thread does on overflow
+                while (LfqFlushQueueElement(producer->queue, &data) == LBQ_SUCCESS) {
+                    int flushedProducer = ELEMENT_PRODUCER(data);
+                    int flushedSeq = ELEMENT_SEQ(data);
+
+                    // Each element is only ever taken by one thread
+                    if (flushedProducer < PRODUCER_COUNT && flushedSeq >= 1 && flushedSeq <= producer->elementCount) {
+                        flushedElements[flushedProducer][flushedSeq]++;
+                    }
+                    producer->flushCount++;
+                }
+            }
+            else {
+                PltSleepMs(0);
+            }
+        }
+
+        if (err != LBQ_SUCCESS) {
+            printf("Producer %d: offer failed with %d\n", producer->producer, err);
+            failures++;
+            return;
+        }
+    }
+}
+
+static void ConsumerThreadProc(void* context) {
+    PCONSUMER_CONTEXT consumer = (PCONSUMER_CONTEXT)context;
+    void* data;
+    int err;
+
+    while ((err = LfqWaitForQueueElement(consumer->queue, &data)) == LBQ_SUCCESS) {
+        int producer = ELEMENT_PRODUCER(data);
+        int seq = ELEMENT_SEQ(data);
+
+        if (producer >= PRODUCER_COUNT || seq < 1 || seq > consumer->elementCount) {
+            consumer->invalid++;
+            continue;
+        }
+
+        // Flushes may skip elements, but a producer's elements never go backwards
+        if (seq <= consumer->lastSeq[producer]) {
+            consumer->outOfOrder++;
+        }
+        consumer->lastSeq[producer] = seq;
+        consumer->received[producer][seq]++;
+        consumer->receivedCount++;
+    }
+
+    consumer->result = err;
+}
+
+// Runs the producers against one consumer until they are done and the queue is drained
+static void runProducers(int producerCount, int elementCount, bool flush) {
+    LOCK_FREE_QUEUE queue;
+    PRODUCER_CONTEXT producers[PRODUCER_COUNT];
+    CONSUMER_CONTEXT consumer;
+    PLT_THREAD producerThreads[PRODUCER_COUNT];
+    PLT_THREAD consumerThread;
+    int flushCount = 0, fullCount = 0;
+    int i, seq;
+
+    CHECK(LfqInitializeQueue(&queue, QUEUE_BOUND) == 0);
+
+    memset(&consumer, 0, sizeof(consumer));
+    consumer.queue = &queue;
+    consumer.elementCount = elementCount;
+    for (i = 0; i < PRODUCER_COUNT; i++) {
+        consumer.received[i] = calloc(elementCount + 1, 1);
+        flushedElements[i] = calloc(elementCount + 1, 1);
+    }
+
+    memset(producers, 0, sizeof(producers));
+    for (i = 0; i < producerCount; i++) {
+        producers[i].queue = &queue;
+        producers[i].producer = i;
+        producers[i].elementCount = elementCount;
+        producers[i].flush = flush;
+    }
+
+    CHECK(PltCreateThread("Consumer", ConsumerThreadProc, &consumer, &consumerThread) == 0);
+    for (i = 0; i < producerCount; i++) {
+        CHECK(PltCreateThread("Producer", ProducerThreadProc, &producers[i], &producerThreads[i]) == 0);
+    }
+    for (i = 0; i < producerCount; i++) {
+        PltJoinThread(&producerThreads[i]);
+    }
+
+    // The consumer takes whatever is left and then stops
+    LfqSignalQueueDrain(&queue);
+    PltJoinThread(&consumerThread);
+    CHECK(consumer.result == LBQ_INTERRUPTED);
+    CHECK(LfqGetItemCount(&queue) == 0);
+
+    // Every element was taken exactly once, by the consumer or a flush
+    for (i = 0; i < producerCount; i++) {
+        int lost = 0, duplicated = 0;
+
+        for (seq = 1; seq <= elementCount; seq++) {
+            int taken = consumer.received[i][seq] + flushedElements[i][seq];
+
+            if (taken == 0) {
+                lost++;
+            }
+            else if (taken > 1) {
+                duplicated++;
+            }
+        }
+
+        if (lost != 0 || duplicated != 0) {
+            printf("Producer %d: %d elements lost, %d duplicated\n", i, lost, duplicated);
+            failures++;
+        }
+
+        flushCount += producers[i].flushCount;
+        fullCount += producers[i].fullCount;
+    }
+    CHECK(consumer.outOfOrder == 0);
+    CHECK(consumer.invalid == 0);
+
+    printf("%d producers%s: %d received, %d flushed, queue full %d times\n",
+           producerCount, flush ? " flushing" : "", consumer.receivedCount, flushCount, fullCount);
+
+    for (i = 0; i < PRODUCER_COUNT; i++) {
+        free(consumer.received[i]);
+        free(flushedElements[i]);
+        flushedElements[i] = NULL;
+    }
+    LfqDestroyQueue(&queue);
+}
+
+typedef struct _WAITER_CONTEXT {
+    PLOCK_FREE_QUEUE queue;
+    PLT_ATOMIC_INT started;
+    int result;
+} WAITER_CONTEXT, *PWAITER_CONTEXT;
+
+static void WaiterThreadProc(void* context) {
+    PWAITER_CONTEXT waiter = (PWAITER_CONTEXT)context;
+    void* data;
+
+    PltAtomicStore(&waiter->started, 1);
+    waiter->result = LfqWaitForQueueElement(waiter->queue, &data);
+}
+
+// Starts a consumer on an empty queue, gives it time to park and sends it a signal
+static int waitForSignal(PLOCK_FREE_QUEUE queue, void (*signal)(PLOCK_FREE_QUEUE)) {
+    WAITER_CONTEXT waiter;
+    PLT_THREAD thread;
+
+    memset(&waiter, 0, sizeof(waiter));
+    waiter.queue = queue;
+    waiter.result = -1;
+    if (PltCreateThread("Waiter", WaiterThreadProc, &waiter, &thread) != 0) {
+        return -1;
+    }
+
+    while (!PltAtomicLoad(&waiter.started)) {
+        PltSleepMs(1);
+    }
+    PltSleepMs(20);
+
+    signal(queue);
+    PltJoinThread(&thread);
+    return waiter.result;
+}
+
+static void testSignals(void) {
+    LOCK_FREE_QUEUE queue;
+    void* data;
+    int i;
+
+    CHECK(LfqInitializeQueue(&queue, QUEUE_BOUND) == 0);
+
+    // A user wake releases the waiter once and doesn't stop the queue
+    CHECK(waitForSignal(&queue, LfqSignalQueueUserWake) == LBQ_USER_WAKE);
+    CHECK(LfqOfferQueueItem(&queue, ELEMENT(0, 1)) == LBQ_SUCCESS);
+    CHECK(LfqPollQueueElement(&queue, &data) == LBQ_SUCCESS && data == ELEMENT(0, 1));
+    CHECK(LfqPollQueueElement(&queue, &data) == LBQ_NO_ELEMENT);
+
+    // Shutdown releases the waiter and refuses new elements
+    CHECK(waitForSignal(&queue, LfqSignalQueueShutdown) == LBQ_INTERRUPTED);
+    CHECK(LfqOfferQueueItem(&queue, ELEMENT(0, 2)) == LBQ_INTERRUPTED);
+    LfqDestroyQueue(&queue);
+
+    // Draining hands out what's queued before interrupting
+    CHECK(LfqInitializeQueue(&queue, QUEUE_BOUND) == 0);
+    CHECK(LfqOfferQueueItem(&queue, ELEMENT(0, 1)) == LBQ_SUCCESS);
+    LfqSignalQueueDrain(&queue);
+    CHECK(LfqOfferQueueItem(&queue, ELEMENT(0, 2)) == LBQ_INTERRUPTED);
+    CHECK(LfqWaitForQueueElement(&queue, &data) == LBQ_SUCCESS && data == ELEMENT(0, 1));
+    CHECK(LfqWaitForQueueElement(&queue, &data) == LBQ_INTERRUPTED);
+    LfqDestroyQueue(&queue);
+
+    // The bound holds even though the ring is rounded up to a power of two
+    CHECK(LfqInitializeQueue(&queue, 5) == 0);
+    for (i = 1; i <= 5; i++) {
+        CHECK(LfqOfferQueueItem(&queue, ELEMENT(0, i)) == LBQ_SUCCESS);
+    }
+    CHECK(LfqOfferQueueItem(&queue, ELEMENT(0, 6)) == LBQ_BOUND_EXCEEDED);
+    CHECK(LfqGetItemCount(&queue) == 5);
+    while (LfqFlushQueueElement(&queue, &data) == LBQ_SUCCESS);
+    LfqDestroyQueue(&queue);
+}
+
+int main(int argc, char** argv) {
+    int elementCount = argc > 1 ? atoi(argv[1]) : 100000;
+
+    if (elementCount <= 0 || elementCount > 0xFFFFFF) {
+        fprintf(stderr, "Usage: queue_stress_test [elements per producer]\n");
+        return 1;
+    }
+
+    runProducers(1, elementCount, false);
+    runProducers(PRODUCER_COUNT, elementCount, false);
+    runProducers(1, elementCount, true);
+    runProducers(PRODUCER_COUNT, elementCount, true);
+    testSignals();
+
+    if (failures != 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Loopback receive throughput of recvUdpSocket() against recvUdpSocketBatch().
+// A sender thread blasts video-sized datagrams at a loopback socket while the
+// main thread receives them, and the receiving thread's CPU time is measured.
+// Usage: recv_batch_bench [packets] [packet size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Limelight-internal.h"
+
+#define RECV_BUFFER_SIZE (4 * 1024 * 1024)
+#define RECV_TIMEOUT_MS 100
+
+typedef struct _SENDER_CONTEXT {
+    SOCKET socket;
+    struct sockaddr_storage destination;
+    SOCKADDR_LEN destinationLength;
+    int packetCount;
+    int packetSize;
+} SENDER_CONTEXT, *PSENDER_CONTEXT;
+
+typedef struct _RECV_RESULT {
+    int packets;
+    int calls;
+    uint64_t elapsedUs;
+    uint64_t cpuUs;
+} RECV_RESULT, *PRECV_RESULT;
+
+static uint64_t getThreadCpuMicros(void) {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+}
+
+static void SenderThreadProc(void* context) {
+    PSENDER_CONTEXT sender = (PSENDER_CONTEXT)context;
+    char* packet = calloc(1, sender->packetSize);
+    int i;
+
+    for (i = 0; i < sender->packetCount; i++) {
+        // Number the packets like RTP so they aren't all identical
+        memcpy(packet, &i, sizeof(i));
+        sendto(sender->socket, packet, sender->packetSize, 0,
+               (struct sockaddr*)&sender->destination, sender->destinationLength);
+    }
+
+    free(packet);
+}
+
+// Receives until the socket has been idle for the receive timeout
+static int runReceiver(SOCKET s, PSENDER_CONTEXT sender, bool batched, PRECV_RESULT result) {
+    char* buffers[UDP_RECV_BATCH_MAX];
+    int lengths[UDP_RECV_BATCH_MAX];
+    int bufferSize = sender->packetSize + 16;
+    PLT_THREAD senderThread;
+    uint64_t startUs = 0, lastUs = 0, startCpuUs = 0;
+    int i;
+
+    for (i = 0; i < UDP_RECV_BATCH_MAX; i++) {
+        buffers[i] = malloc(bufferSize);
+    }
+
+    memset(result, 0, sizeof(*result));
+    if (PltCreateThread("Sender", SenderThreadProc, sender, &senderThread) != 0) {
+        return -1;
+    }
+
+    for (;;) {
+        int err;
+
+        if (batched) {
+            err = recvUdpSocketBatch(s, buffers, lengths, UDP_RECV_BATCH_MAX, bufferSize, false);
+        }
+        else {
+            err = recvUdpSocket(s, buffers[0], bufferSize, false);
+            if (err > 0) {
+                err = 1;
+            }
+        }
+
+        if (err <= 0) {
+            // A timeout after the first packet means the sender is done
+            if (err < 0 || result->packets != 0) {
+                break;
+            }
+            continue;
+        }
+
+        if (result->packets == 0) {
+            startUs = PltGetMicros();
+            startCpuUs = getThreadCpuMicros();
+        }
+
+        result->packets += err;
+        result->calls++;
+        lastUs = PltGetMicros();
+        result->cpuUs = getThreadCpuMicros() - startCpuUs;
+    }
+
+    result->elapsedUs = lastUs - startUs;
+
+    PltJoinThread(&senderThread);
+    for (i = 0; i < UDP_RECV_BATCH_MAX; i++) {
+        free(buffers[i]);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int packetCount = argc > 1 ? atoi(argv[1]) : 500000;
+    int packetSize = argc > 2 ? atoi(argv[2]) : 1400;
+    struct sockaddr_storage localAddr;
+    struct sockaddr_in* sin = (struct sockaddr_in*)&localAddr;
+    SENDER_CONTEXT sender;
+    SOCKET recvSocket;
+    int mode;
+
+    if (packetCount <= 0 || packetSize <= 0) {
+        fprintf(stderr, "Usage: recv_batch_bench [packets] [packet size]\n");
+        return 1;
+    }
+
+    if (initializePlatformSockets() != 0) {
+        return 1;
+    }
+
+    memset(&localAddr, 0, sizeof(localAddr));
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    recvSocket = bindUdpSocket(AF_INET, &localAddr, sizeof(*sin), RECV_BUFFER_SIZE, SOCK_QOS_TYPE_BEST_EFFORT);
+    if (recvSocket == INVALID_SOCKET) {
+        fprintf(stderr, "Failed to bind the receive socket\n");
+        return 1;
+    }
+    setNonFatalRecvTimeoutMs(recvSocket, RECV_TIMEOUT_MS);
+
+    memset(&sender, 0, sizeof(sender));
+    sender.destinationLength = sizeof(sender.destination);
+    getsockname(recvSocket, (struct sockaddr*)&sender.destination, &sender.destinationLength);
+    sender.packetCount = packetCount;
+    sender.packetSize = packetSize;
+    sender.socket = createSocket(AF_INET, SOCK_DGRAM, IPPROTO_UDP, false);
+    if (sender.socket == INVALID_SOCKET) {
+        fprintf(stderr, "Failed to create the send socket\n");
+        return 1;
+    }
+
+    printf("%d packets of %d bytes over loopback\n", packetCount, packetSize);
+    printf("%-8s %10s %8s %10s %14s %14s\n", "mode", "received", "lost", "kpps", "CPU us/packet", "packets/call");
+
+    for (mode = 0; mode < 2; mode++) {
+        bool batched = mode == 1;
+        RECV_RESULT result;
+
+        if (runReceiver(recvSocket, &sender, batched, &result) != 0 || result.packets == 0) {
+            fprintf(stderr, "Nothing was received\n");
+            return 1;
+        }
+
+        printf("%-8s %10d %7.1f%% %10.1f %14.3f %14.1f\n",
+               batched ? "batch" : "single", result.packets,
+               100.0 * (packetCount - result.packets) / packetCount,
+               result.elapsedUs ? result.packets * 1000.0 / result.elapsedUs : 0,
+               (double)result.cpuUs / result.packets,
+               (double)result.packets / result.calls);
+    }
+
+    closeSocket(sender.socket);
+    closeSocket(recvSocket);
+    cleanupPlatformSockets();
+    return 0;
+}
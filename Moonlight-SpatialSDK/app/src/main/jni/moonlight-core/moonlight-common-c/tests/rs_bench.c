@@ -0,0 +1,91 @@
+// Reed-Solomon throughput for each GF(2^8) kernel this CPU supports.
+// Usage: rs_bench [data shards] [parity shards] [block size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight.h"
+#include "rs.h"
+
+#define BENCH_DURATION_US 500000
+
+static const char* kernelNames[] = { "scalar", "SSSE3", "AVX2", "NEON" };
+
+int main(int argc, char** argv) {
+    int dataShards = argc > 1 ? atoi(argv[1]) : 100;
+    int parityShards = argc > 2 ? atoi(argv[2]) : 20;
+    int blockSize = argc > 3 ? atoi(argv[3]) : 1400;
+    int totalShards = dataShards + parityShards;
+    unsigned char** shards;
+    unsigned char* marks;
+    double scalarMBps = 0;
+    reed_solomon* rs;
+    size_t k;
+    int i, j;
+
+    if (dataShards <= 0 || parityShards <= 0 || totalShards > DATA_SHARDS_MAX || blockSize <= 0) {
+        fprintf(stderr, "Invalid shard configuration\n");
+        return 1;
+    }
+
+    reed_solomon_init();
+
+    shards = malloc(sizeof(*shards) * totalShards);
+    for (i = 0; i < totalShards; i++) {
+        shards[i] = malloc(blockSize);
+        for (j = 0; j < blockSize; j++) {
+            shards[i][j] = (unsigned char)rand();
+        }
+    }
+    marks = calloc(totalShards, 1);
+
+    rs = reed_solomon_new(dataShards, parityShards);
+
+    printf("%d data + %d parity shards of %d bytes\n", dataShards, parityShards, blockSize);
+    printf("%-8s %12s %12s %10s\n", "kernel", "encode MB/s", "recover MB/s", "speedup");
+
+    for (k = 0; k < sizeof(kernelNames) / sizeof(kernelNames[0]); k++) {
+        uint64_t startUs, elapsedUs;
+        int encodes = 0, recoveries = 0;
+        double encodeMBps, recoverMBps;
+
+        if (reed_solomon_select_kernel(kernelNames[k]) != 0) {
+            continue;
+        }
+
+        startUs = LiGetMicros();
+        do {
+            reed_solomon_encode(rs, shards, totalShards, blockSize);
+            encodes++;
+        } while ((elapsedUs = LiGetMicros() - startUs) < BENCH_DURATION_US);
+        encodeMBps = (double)encodes * dataShards * blockSize / elapsedUs;
+
+        // Worst case recovery: as many data shards lost as there is parity
+        startUs = LiGetMicros();
+        do {
+            memset(marks, 0, totalShards);
+            for (i = 0; i < parityShards; i++) {
+                marks[(i * 7) % dataShards] = 1;
+            }
+            reed_solomon_reconstruct(rs, shards, marks, totalShards, blockSize);
+            recoveries++;
+        } while ((elapsedUs = LiGetMicros() - startUs) < BENCH_DURATION_US);
+        recoverMBps = (double)recoveries * dataShards * blockSize / elapsedUs;
+
+        if (scalarMBps == 0) {
+            scalarMBps = recoverMBps;
+        }
+
+        printf("%-8s %12.1f %12.1f %9.1fx\n", kernelNames[k], encodeMBps, recoverMBps, recoverMBps / scalarMBps);
+    }
+
+    reed_solomon_release(rs);
+    for (i = 0; i < totalShards; i++) {
+        free(shards[i]);
+    }
+    free(shards);
+    free(marks);
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Per-frame FEC recovery cost with and without codec and decode matrix caching
+// over the shard counts seen in practice. Usage: rs_cache_bench [block size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Limelight.h"
+#include "rs.h"
+
+#define FRAMES_PER_RUN 200
+
+// Loss of a few shards per frame, as on a marginal Wi-Fi link
+#define LOST_SHARDS 2
+
+static const int dataShardCounts[] = { 10, 25, 50, 100, 200, 235 };
+
+typedef enum {
+    // reed_solomon_new() and release per frame, as before the cache existed
+    MODE_UNCACHED,
+    // Codec reused, but the erasure pattern changes every frame
+    MODE_CACHED_CODEC,
+    // Codec reused and the same erasure pattern repeats
+    MODE_CACHED_PATTERN,
+} BENCH_MODE;
+
+static double runFrames(BENCH_MODE mode, int dataShards, int parityShards, unsigned char** shards, int blockSize) {
+    unsigned char marks[DATA_SHARDS_MAX];
+    reed_solomon* rs = NULL;
+    uint64_t startUs;
+    int frame, i;
+
+    if (mode != MODE_UNCACHED) {
+        rs = reed_solomon_new(dataShards, parityShards);
+    }
+
+    srand(1);
+    startUs = LiGetMicros();
+    for (frame = 0; frame < FRAMES_PER_RUN; frame++) {
+        memset(marks, 0, sizeof(marks));
+        for (i = 0; i < LOST_SHARDS; i++) {
+            marks[mode == MODE_CACHED_PATTERN ? i * 3 : rand() % dataShards] = 1;
+        }
+
+        if (mode == MODE_UNCACHED) {
+            rs = reed_solomon_new(dataShards, parityShards);
+        }
+
+        reed_solomon_reconstruct(rs, shards, marks, dataShards + parityShards, blockSize);
+
+        if (mode == MODE_UNCACHED) {
+            reed_solomon_release(rs);
+        }
+    }
+
+    if (mode != MODE_UNCACHED) {
+        reed_solomon_release(rs);
+    }
+
+    return (double)(LiGetMicros() - startUs) / FRAMES_PER_RUN;
+}
+
+int main(int argc, char** argv) {
+    int blockSize = argc > 1 ? atoi(argv[1]) : 1024;
+    unsigned char** shards;
+    size_t k;
+    int i;
+
+    if (blockSize <= 0) {
+        fprintf(stderr, "Invalid block size\n");
+        return 1;
+    }
+
+    reed_solomon_init();
+
+    shards = malloc(sizeof(*shards) * DATA_SHARDS_MAX);
+    for (i = 0; i < DATA_SHARDS_MAX; i++) {
+        shards[i] = calloc(1, blockSize);
+    }
+
+    printf("Recovering %d lost shards per frame, %d byte blocks, %s kernel\n",
+           LOST_SHARDS, blockSize, reed_solomon_kernel_name());
+    printf("%-14s %12s %12s %12s\n", "shards", "uncached us", "codec us", "pattern us");
+
+    for (k = 0; k < sizeof(dataShardCounts) / sizeof(dataShardCounts[0]); k++) {
+        int dataShards = dataShardCounts[k];
+        int parityShards = (dataShards + 4) / 5;
+        char label[32];
+
+        if (dataShards + parityShards > DATA_SHARDS_MAX) {
+            parityShards = DATA_SHARDS_MAX - dataShards;
+        }
+
+        snprintf(label, sizeof(label), "%d+%d", dataShards, parityShards);
+        printf("%-14s %12.1f %12.1f %12.1f\n", label,
+               runFrames(MODE_UNCACHED, dataShards, parityShards, shards, blockSize),
+               runFrames(MODE_CACHED_CODEC, dataShards, parityShards, shards, blockSize),
+               runFrames(MODE_CACHED_PATTERN, dataShards, parityShards, shards, blockSize));
+    }
+
+    for (i = 0; i < DATA_SHARDS_MAX; i++) {
+        free(shards[i]);
+    }
+    free(shards);
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Checks every GF(2^8) kernel this CPU supports against the scalar
+// reference, both for parity generation and for reconstruction of
+// random erasure patterns.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rs.h"
+
+#define ITERATIONS 150
+#define MAX_BLOCK_SIZE 1500
+
+static const char* kernelNames[] = { "SSSE3", "AVX2", "NEON" };
+
+static unsigned char** allocShards(int count, int blockSize) {
+    unsigned char** shards = malloc(sizeof(*shards) * count);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        shards[i] = malloc(blockSize);
+    }
+
+    return shards;
+}
+
+static void freeShards(unsigned char** shards, int count) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        free(shards[i]);
+    }
+    free(shards);
+}
+
+static int testKernel(const char* name, unsigned int seed) {
+    int iter;
+
+    srand(seed);
+
+    for (iter = 0; iter < ITERATIONS; iter++) {
+        // Cover the range of shard counts the video stream uses, including the
+        // 255 shard limit, and block sizes that leave unaligned tails
+        int dataShards = 1 + rand() % 200;
+        int parityShards = 1 + rand() % (DATA_SHARDS_MAX - dataShards < 64 ? DATA_SHARDS_MAX - dataShards : 64);
+        int totalShards = dataShards + parityShards;
+        int blockSize = 1 + rand() % MAX_BLOCK_SIZE;
+        unsigned char** reference = allocShards(totalShards, blockSize);
+        unsigned char** shards = allocShards(totalShards, blockSize);
+        unsigned char marks[DATA_SHARDS_MAX];
+        reed_solomon* rs;
+        int erasures;
+        int i, j;
+
+        for (i = 0; i < dataShards; i++) {
+            for (j = 0; j < blockSize; j++) {
+                reference[i][j] = (unsigned char)rand();
+            }
+            memcpy(shards[i], reference[i], blockSize);
+        }
+
+        rs = reed_solomon_new(dataShards, parityShards);
+        if (rs == NULL) {
+            fprintf(stderr, "reed_solomon_new(%d, %d) failed\n", dataShards, parityShards);
+            return -1;
+        }
+
+        // Parity from the reference kernel
+        reed_solomon_select_kernel("scalar");
+        reed_solomon_encode(rs, reference, totalShards, blockSize);
+
+        // Parity from the kernel under test
+        reed_solomon_select_kernel(name);
+        reed_solomon_encode(rs, shards, totalShards, blockSize);
+        for (i = dataShards; i < totalShards; i++) {
+            if (memcmp(shards[i], reference[i], blockSize) != 0) {
+                fprintf(stderr, "%s: parity shard %d differs (%d+%d shards of %d bytes)\n",
+                        name, i, dataShards, parityShards, blockSize);
+                return -1;
+            }
+        }
+
+        // Erase up to parityShards shards anywhere in the block
+        memset(marks, 0, sizeof(marks));
+        erasures = rand() % (parityShards + 1);
+        for (i = 0; i < erasures; i++) {
+            int shard = rand() % totalShards;
+            marks[shard] = 1;
+            memset(shards[shard], 0xAA, blockSize);
+        }
+
+        if (reed_solomon_reconstruct(rs, shards, marks, totalShards, blockSize) != 0) {
+            fprintf(stderr, "%s: reconstruction failed (%d+%d shards, %d erased)\n",
+                    name, dataShards, parityShards, erasures);
+            return -1;
+        }
+
+        for (i = 0; i < dataShards; i++) {
+            if (memcmp(shards[i], reference[i], blockSize) != 0) {
+                fprintf(stderr, "%s: data shard %d reconstructed incorrectly (%d+%d shards of %d bytes)\n",
+                        name, i, dataShards, parityShards, blockSize);
+                return -1;
+            }
+        }
+
+        reed_solomon_release(rs);
+        freeShards(reference, totalShards);
+        freeShards(shards, totalShards);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned int seed = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 0) : 1;
+    int tested = 0;
+    size_t i;
+
+    reed_solomon_init();
+    printf("Default kernel: %s\n", reed_solomon_kernel_name());
+
+    // The scalar kernel is checked against itself to cover reconstruction
+    if (testKernel("scalar", seed) != 0) {
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(kernelNames) / sizeof(kernelNames[0]); i++) {
+        if (reed_solomon_select_kernel(kernelNames[i]) != 0) {
+            printf("%s: not supported, skipped\n", kernelNames[i]);
+            continue;
+        }
+
+        if (testKernel(kernelNames[i], seed) != 0) {
+            return 1;
+        }
+
+        printf("%s: %d iterations match the scalar kernel\n", kernelNames[i], ITERATIONS);
+        tested++;
+    }
+
+    printf("%d SIMD kernel(s) tested\n", tested);
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include "PacketCapture.h"
+
+static const char captureMagic[4] = { 'L', 'C', 'A', 'P' };
+
+void CapGetConnectionInfo(PCAPTURE_FILE_INFO info) {
+    memcpy(info->appVersionQuad, AppVersionQuad, sizeof(info->appVersionQuad));
+    info->videoFormat = NegotiatedVideoFormat;
+    info->width = StreamConfig.width;
+    info->height = StreamConfig.height;
+    info->fps = StreamConfig.fps;
+    info->packetSize = StreamConfig.packetSize;
+    info->audioConfiguration = StreamConfig.audioConfiguration;
+    info->audioPacketDuration = AudioPacketDuration;
+}
+
+int CapOpenWriter(PCAPTURE_WRITER writer, const char* path) {
+    memset(writer, 0, sizeof(*writer));
+
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        return -1;
+    }
+
+    if (PltCreateMutex(&writer->mutex) < 0) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int CapCloseWriter(PCAPTURE_WRITER writer) {
+    if (writer->file == NULL) {
+        return -1;
+    }
+
+    if (fclose(writer->file) != 0) {
+        writer->failed = true;
+    }
+    writer->file = NULL;
+
+    PltDeleteMutex(&writer->mutex);
+    return writer->failed ? -1 : 0;
+}
+
+// Called with the mutex held
+static void writeInfoLocked(PCAPTURE_WRITER writer, PCAPTURE_FILE_INFO info) {
+    char header[CAPTURE_FILE_HEADER_SIZE];
+    BYTE_BUFFER bb;
+    int i;
+
+    BbInitializeWrappedBuffer(&bb, header, 0, sizeof(header), BYTE_ORDER_LITTLE);
+    for (i = 0; i < 4; i++) {
+        BbPut8(&bb, (uint8_t)captureMagic[i]);
+    }
+    BbPut32(&bb, CAPTURE_FILE_VERSION);
+    for (i = 0; i < 4; i++) {
+        BbPut32(&bb, (uint32_t)info->appVersionQuad[i]);
+    }
+    BbPut32(&bb, (uint32_t)info->videoFormat);
+    BbPut32(&bb, (uint32_t)info->width);
+    BbPut32(&bb, (uint32_t)info->height);
+    BbPut32(&bb, (uint32_t)info->fps);
+    BbPut32(&bb, (uint32_t)info->packetSize);
+    BbPut32(&bb, (uint32_t)info->audioConfiguration);
+    BbPut32(&bb, (uint32_t)info->audioPacketDuration);
+    LC_ASSERT(bb.position == sizeof(header));
+
+    if (fwrite(header, sizeof(header), 1, writer->file) != 1) {
+        writer->failed = true;
+    }
+    writer->headerWritten = true;
+}
+
+void CapWriteInfo(PCAPTURE_WRITER writer, PCAPTURE_FILE_INFO info) {
+    PltLockMutex(&writer->mutex);
+    if (!writer->headerWritten) {
+        writeInfoLocked(writer, info);
+    }
+    PltUnlockMutex(&writer->mutex);
+}
+
+// Called with the mutex held
+static void writePacketLocked(PCAPTURE_WRITER writer, int stream, uint64_t receiveTimeUs, const void* packet, int length) {
+    char header[CAPTURE_RECORD_HEADER_SIZE];
+    BYTE_BUFFER bb;
+
+    LC_ASSERT(writer->headerWritten);
+
+    if (length <= 0 || length > CAPTURE_MAX_PACKET_SIZE) {
+        return;
+    }
+
+    BbInitializeWrappedBuffer(&bb, header, 0, sizeof(header), BYTE_ORDER_LITTLE);
+    BbPut8(&bb, (uint8_t)stream);
+    BbPut8(&bb, 0);
+    BbPut8(&bb, 0);
+    BbPut8(&bb, 0);
+    BbPut32(&bb, (uint32_t)length);
+    BbPut64(&bb, receiveTimeUs);
+
+    if (fwrite(header, sizeof(header), 1, writer->file) != 1 ||
+            fwrite(packet, length, 1, writer->file) != 1) {
+        writer->failed = true;
+    }
+    writer->packetCount++;
+}
+
+void CapWritePacket(PCAPTURE_WRITER writer, int stream, uint64_t receiveTimeUs, const void* packet, int length) {
+    PltLockMutex(&writer->mutex);
+    writePacketLocked(writer, stream, receiveTimeUs, packet, length);
+    PltUnlockMutex(&writer->mutex);
+}
+
+void CapPacketCaptureCallback(int stream, uint64_t receiveTimeUs, const void* packet, int length, void* context) {
+    PCAPTURE_WRITER writer = (PCAPTURE_WRITER)context;
+
+    PltLockMutex(&writer->mutex);
+
+    // The connection parameters are all negotiated by the time the first packet arrives
+    if (!writer->headerWritten) {
+        CAPTURE_FILE_INFO info;
+
+        CapGetConnectionInfo(&info);
+        writeInfoLocked(writer, &info);
+    }
+
+    writePacketLocked(writer, stream, receiveTimeUs, packet, length);
+    PltUnlockMutex(&writer->mutex);
+}
+
+int CapOpenReader(PCAPTURE_READER reader, const char* path) {
+    char header[CAPTURE_FILE_HEADER_SIZE];
+    BYTE_BUFFER bb;
+    uint32_t value;
+    uint8_t magic;
+    int i;
+
+    memset(reader, 0, sizeof(*reader));
+
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        return -1;
+    }
+
+    if (fread(header, sizeof(header), 1, reader->file) != 1) {
+        goto Invalid;
+    }
+
+    BbInitializeWrappedBuffer(&bb, header, 0, sizeof(header), BYTE_ORDER_LITTLE);
+    for (i = 0; i < 4; i++) {
+        BbGet8(&bb, &magic);
+        if (magic != (uint8_t)captureMagic[i]) {
+            goto Invalid;
+        }
+    }
+
+    BbGet32(&bb, &value);
+    if (value != CAPTURE_FILE_VERSION) {
+        goto Invalid;
+    }
+
+    for (i = 0; i < 4; i++) {
+        BbGet32(&bb, &value);
+        reader->info.appVersionQuad[i] = (int)value;
+    }
+    BbGet32(&bb, &value);
+    reader->info.videoFormat = (int)value;
+    BbGet32(&bb, &value);
+    reader->info.width = (int)value;
+    BbGet32(&bb, &value);
+    reader->info.height = (int)value;
+    BbGet32(&bb, &value);
+    reader->info.fps = (int)value;
+    BbGet32(&bb, &value);
+    reader->info.packetSize = (int)value;
+    BbGet32(&bb, &value);
+    reader->info.audioConfiguration = (int)value;
+    BbGet32(&bb, &value);
+    reader->info.audioPacketDuration = (int)value;
+
+    if (reader->info.packetSize <= 0 || reader->info.packetSize > CAPTURE_MAX_PACKET_SIZE ||
+            reader->info.audioPacketDuration <= 0) {
+        goto Invalid;
+    }
+
+    return 0;
+
+Invalid:
+    fclose(reader->file);
+    reader->file = NULL;
+    return -1;
+}
+
+void CapCloseReader(PCAPTURE_READER reader) {
+    if (reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
+
+int CapReadPacket(PCAPTURE_READER reader, int* stream, uint64_t* receiveTimeUs, void* packet) {
+    char header[CAPTURE_RECORD_HEADER_SIZE];
+    BYTE_BUFFER bb;
+    uint8_t streamId;
+    uint32_t length;
+    size_t bytesRead;
+
+    bytesRead = fread(header, 1, sizeof(header), reader->file);
+    if (bytesRead == 0 && feof(reader->file)) {
+        return 0;
+    }
+    else if (bytesRead != sizeof(header)) {
+        return -1;
+    }
+
+    BbInitializeWrappedBuffer(&bb, header, 0, sizeof(header), BYTE_ORDER_LITTLE);
+    BbGet8(&bb, &streamId);
+    BbAdvanceBuffer(&bb, 3);
+    BbGet32(&bb, &length);
+    BbGet64(&bb, receiveTimeUs);
+
+    if ((streamId != PACKET_CAPTURE_VIDEO && streamId != PACKET_CAPTURE_AUDIO) ||
+            length == 0 || length > CAPTURE_MAX_PACKET_SIZE) {
+        return -1;
+    }
+
+    if (fread(packet, length, 1, reader->file) != 1) {
+        return -1;
+    }
+
+    *stream = streamId;
+    return (int)length;
+}
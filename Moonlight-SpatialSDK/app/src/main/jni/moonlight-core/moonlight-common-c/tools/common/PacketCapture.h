@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Limelight-internal.h"
+
+#include <stdio.h>
+
+// Capture files hold the RTP packets reported by the packet capture callback along with
+// the stream parameters needed to replay them. All fields are little-endian.
+//
+// File header:
+//   char     magic[4]              "LCAP"
+//   uint32_t version               CAPTURE_FILE_VERSION
+//   int32_t  appVersionQuad[4]
+//   int32_t  videoFormat           VIDEO_FORMAT_* value that was negotiated
+//   int32_t  width, height, fps
+//   int32_t  packetSize            StreamConfig.packetSize
+//   int32_t  audioConfiguration
+//   int32_t  audioPacketDuration   In milliseconds
+//
+// Followed by one record per packet:
+//   uint8_t  stream                PACKET_CAPTURE_VIDEO or PACKET_CAPTURE_AUDIO
+//   uint8_t  reserved[3]
+//   uint32_t length
+//   uint64_t receiveTimeUs
+//   uint8_t  packet[length]        As captured, with the RTP header in network byte order
+
+#define CAPTURE_FILE_VERSION 1
+#define CAPTURE_FILE_HEADER_SIZE 52
+#define CAPTURE_RECORD_HEADER_SIZE 16
+
+// Large enough for any video or audio packet
+#define CAPTURE_MAX_PACKET_SIZE 65536
+
+typedef struct _CAPTURE_FILE_INFO {
+    int appVersionQuad[4];
+    int videoFormat;
+    int width;
+    int height;
+    int fps;
+    int packetSize;
+    int audioConfiguration;
+    int audioPacketDuration;
+} CAPTURE_FILE_INFO, *PCAPTURE_FILE_INFO;
+
+typedef struct _CAPTURE_WRITER {
+    FILE* file;
+    PLT_MUTEX mutex;
+    bool headerWritten;
+    bool failed;
+    uint32_t packetCount;
+} CAPTURE_WRITER, *PCAPTURE_WRITER;
+
+typedef struct _CAPTURE_READER {
+    FILE* file;
+    CAPTURE_FILE_INFO info;
+} CAPTURE_READER, *PCAPTURE_READER;
+
+// Fills in the capture info from the parameters of the active connection
+void CapGetConnectionInfo(PCAPTURE_FILE_INFO info);
+
+int CapOpenWriter(PCAPTURE_WRITER writer, const char* path);
+
+// Returns -1 if any write to the file failed
+int CapCloseWriter(PCAPTURE_WRITER writer);
+
+// The info must be written before any packets. This is safe to call from any thread.
+void CapWriteInfo(PCAPTURE_WRITER writer, PCAPTURE_FILE_INFO info);
+void CapWritePacket(PCAPTURE_WRITER writer, int stream, uint64_t receiveTimeUs, const void* packet, int length);
+
+// PacketCaptureCallback that writes to the CAPTURE_WRITER passed as the context. The capture
+// info is taken from the connection when the first packet arrives.
+void CapPacketCaptureCallback(int stream, uint64_t receiveTimeUs, const void* packet, int length, void* context);
+
+int CapOpenReader(PCAPTURE_READER reader, const char* path);
+void CapCloseReader(PCAPTURE_READER reader);
+
+// Returns the packet length, 0 at the end of the file or -1 if the file is corrupt.
+// The buffer must hold CAPTURE_MAX_PACKET_SIZE bytes.
+int CapReadPacket(PCAPTURE_READER reader, int* stream, uint64_t* receiveTimeUs, void* packet);
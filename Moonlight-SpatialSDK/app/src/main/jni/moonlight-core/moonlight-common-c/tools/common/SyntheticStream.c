@@ -0,0 +1,415 @@
+#include "SyntheticStream.h"
+
+// Same layout as the 8 byte frame header used by GFE 7.1.350+ and Sunshine
+#define FRAME_HEADER_SIZE 8
+#define HOST_FRAME_TYPE_P 1
+#define HOST_FRAME_TYPE_IDR 2
+
+#define H264_NAL_SPS 0x67
+#define H264_NAL_PPS 0x68
+#define H264_NAL_IDR 0x65
+#define H264_NAL_SLICE 0x41
+#define H264_NAL_AUD 0x09
+#define H264_NAL_SEI 0x06
+
+// HEVC NAL unit types, which are shifted into a 2 byte header
+#define HEVC_NAL_TRAIL_R 1
+#define HEVC_NAL_IDR_W_RADL 19
+#define HEVC_NAL_VPS 32
+#define HEVC_NAL_SPS 33
+#define HEVC_NAL_PPS 34
+#define HEVC_NAL_AUD 35
+#define HEVC_NAL_SEI 39
+
+// Sizes of the prefix NAL units, including the start sequence
+#define AUD_NAL_SIZE 8
+#define SEI_NAL_SIZE 24
+
+#define RTP_PAYLOAD_TYPE_AUDIO 97
+#define RTP_PAYLOAD_TYPE_FEC 127
+
+// Opus TOC byte, which the client expects to stay constant for the stream
+#define OPUS_TOC_BYTE 0xFC
+
+// 64-bit FNV-1a
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+void SynInitializeConfig(PSYNTHETIC_STREAM_CONFIG config) {
+    memset(config, 0, sizeof(*config));
+    config->packetSize = 1392;
+    config->fps = 60;
+    config->minFrameSize = 8 * 1024;
+    config->maxFrameSize = 32 * 1024;
+    config->idrInterval = 60;
+    config->fecPercentage = 20;
+    config->multiFec = true;
+    config->audioPacketDuration = 5;
+    config->audioPayloadSize = 120;
+    config->seed = 1;
+    config->videoFormat = VIDEO_FORMAT_H264;
+}
+
+// xorshift32, so the streams are the same on every platform
+static uint32_t nextRandom(PSYNTHETIC_STREAM stream) {
+    uint32_t x = stream->randomState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    stream->randomState = x;
+    return x;
+}
+
+// Random data without zero bytes can't contain an Annex B start sequence
+static void fillRandomData(PSYNTHETIC_STREAM stream, unsigned char* data, int length) {
+    int i;
+
+    for (i = 0; i < length; i++) {
+        data[i] = (unsigned char)(1 + nextRandom(stream) % 255);
+    }
+}
+
+static int getParityShards(int dataShards, int fecPercentage) {
+    return (dataShards * fecPercentage + 99) / 100;
+}
+
+// Largest number of data shards in an FEC block that leaves room for the parity
+static int getMaxDataShardsPerBlock(int fecPercentage) {
+    int dataShards = SYN_MAX_DATA_SHARDS_PER_BLOCK;
+
+    while (dataShards + getParityShards(dataShards, fecPercentage) > DATA_SHARDS_MAX) {
+        dataShards--;
+    }
+
+    return dataShards;
+}
+
+int SynInitializeStream(PSYNTHETIC_STREAM stream, PSYNTHETIC_STREAM_CONFIG config) {
+    int blockSize = config->packetSize + MAX_RTP_HEADER_SIZE;
+    int i;
+
+    memset(stream, 0, sizeof(*stream));
+    stream->config = *config;
+    stream->frameNumber = 1;
+    stream->randomState = config->seed != 0 ? config->seed : 1;
+
+    if (config->packetSize <= (int)sizeof(NV_VIDEO_PACKET) + FRAME_HEADER_SIZE ||
+            config->minFrameSize <= 0 || config->maxFrameSize < config->minFrameSize ||
+            config->fps <= 0 || config->idrInterval <= 0 ||
+            (config->videoFormat != VIDEO_FORMAT_H264 && config->videoFormat != VIDEO_FORMAT_H265) ||
+            config->fecPercentage < 0 || config->fecPercentage > 255 ||
+            config->audioPacketDuration <= 0 || config->audioPayloadSize <= 1 ||
+            config->audioPayloadSize > (int)(RTPA_MAX_SHARD_SIZE - sizeof(AUDIO_FEC_HEADER))) {
+        return -1;
+    }
+
+    // IDR frames are 4 times as large as the largest P-frame
+    stream->frameData = malloc(FRAME_HEADER_SIZE + 4 * (size_t)config->maxFrameSize);
+    stream->shardData = malloc((size_t)DATA_SHARDS_MAX * blockSize);
+    if (stream->frameData == NULL || stream->shardData == NULL) {
+        SynCleanupStream(stream);
+        return -1;
+    }
+
+    for (i = 0; i < DATA_SHARDS_MAX; i++) {
+        stream->shards[i] = &stream->shardData[i * blockSize];
+    }
+
+    for (i = 0; i < RTPA_TOTAL_SHARDS; i++) {
+        stream->audioShards[i] = malloc(config->audioPayloadSize);
+        if (stream->audioShards[i] == NULL) {
+            SynCleanupStream(stream);
+            return -1;
+        }
+    }
+
+    reed_solomon_init();
+    stream->audioRs = reed_solomon_new(RTPA_DATA_SHARDS, RTPA_FEC_SHARDS);
+    if (stream->audioRs == NULL) {
+        SynCleanupStream(stream);
+        return -1;
+    }
+
+    // The host uses a different audio parity matrix than our RS implementation
+    // generates. This is the same one that RtpaInitializeQueue() substitutes.
+    const unsigned char parity[] = { 0x77, 0x40, 0x38, 0x0e, 0xc7, 0xa7, 0x0d, 0x6c };
+    memcpy(&stream->audioRs->m[16], parity, sizeof(parity));
+    memcpy(stream->audioRs->parity, parity, sizeof(parity));
+
+    return 0;
+}
+
+void SynCleanupStream(PSYNTHETIC_STREAM stream) {
+    int i;
+
+    free(stream->frameData);
+    free(stream->shardData);
+    for (i = 0; i < RTPA_TOTAL_SHARDS; i++) {
+        free(stream->audioShards[i]);
+    }
+    if (stream->audioRs != NULL) {
+        reed_solomon_release(stream->audioRs);
+    }
+
+    memset(stream, 0, sizeof(*stream));
+}
+
+uint64_t SynGetFrameTimeUs(PSYNTHETIC_STREAM stream, uint32_t frameNumber) {
+    return (uint64_t)(frameNumber - 1) * 1000000 / stream->config.fps;
+}
+
+void SynRequestIdrFrame(PSYNTHETIC_STREAM stream) {
+    stream->idrFrameRequested = true;
+}
+
+const char* SynGetFrameAnnexB(PSYNTHETIC_STREAM stream, int* length) {
+    *length = stream->frameDataSize - stream->annexBOffset;
+    return &stream->frameData[stream->annexBOffset];
+}
+
+uint64_t SynHashFrameData(const void* data, int length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    int i;
+
+    while (length > 0 && bytes[length - 1] == 0) {
+        length--;
+    }
+
+    for (i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// The NAL type is the whole header byte for H.264 and the NAL unit type for HEVC
+static int appendNal(PSYNTHETIC_STREAM stream, int offset, uint8_t nalType, int length) {
+    unsigned char* data = (unsigned char*)&stream->frameData[offset];
+    int headerLength;
+
+    data[0] = 0x00;
+    data[1] = 0x00;
+    data[2] = 0x00;
+    data[3] = 0x01;
+    if (stream->config.videoFormat == VIDEO_FORMAT_H265) {
+        data[4] = (unsigned char)(nalType << 1);
+        data[5] = 0x01;
+        headerLength = 6;
+    }
+    else {
+        data[4] = nalType;
+        headerLength = 5;
+    }
+    fillRandomData(stream, &data[headerLength], length - headerLength);
+
+    return offset + length;
+}
+
+// Builds the frame header and Annex B data of the next frame
+static void buildFrameData(PSYNTHETIC_STREAM stream, bool idrFrame, int maxDataShards) {
+    int payloadPerPacket = stream->config.packetSize - (int)sizeof(NV_VIDEO_PACKET);
+    int range = stream->config.maxFrameSize - stream->config.minFrameSize + 1;
+    bool hevc = stream->config.videoFormat == VIDEO_FORMAT_H265;
+    int annexBSize = stream->config.minFrameSize + (int)(nextRandom(stream) % range);
+    int lastPayloadLength;
+    int offset;
+
+    if (idrFrame) {
+        annexBSize *= 4;
+    }
+
+    // Frames can't span more data shards than the FEC blocks can hold
+    if (FRAME_HEADER_SIZE + annexBSize > maxDataShards * payloadPerPacket) {
+        annexBSize = maxDataShards * payloadPerPacket - FRAME_HEADER_SIZE;
+    }
+
+    stream->frameDataSize = FRAME_HEADER_SIZE + annexBSize;
+    lastPayloadLength = stream->frameDataSize % payloadPerPacket;
+    if (lastPayloadLength == 0) {
+        lastPayloadLength = payloadPerPacket;
+    }
+
+    stream->frameData[0] = 0x01;
+    stream->frameData[1] = 0;
+    stream->frameData[2] = 0;
+    stream->frameData[3] = idrFrame ? HOST_FRAME_TYPE_IDR : HOST_FRAME_TYPE_P;
+    stream->frameData[4] = (char)(lastPayloadLength & 0xFF);
+    stream->frameData[5] = (char)(lastPayloadLength >> 8);
+    stream->frameData[6] = 0;
+    stream->frameData[7] = 0;
+
+    offset = FRAME_HEADER_SIZE;
+    if (stream->config.prefixNals) {
+        offset = appendNal(stream, offset, hevc ? HEVC_NAL_AUD : H264_NAL_AUD, AUD_NAL_SIZE);
+        offset = appendNal(stream, offset, hevc ? HEVC_NAL_SEI : H264_NAL_SEI, SEI_NAL_SIZE);
+    }
+    stream->annexBOffset = offset;
+
+    if (idrFrame) {
+        if (hevc) {
+            offset = appendNal(stream, offset, HEVC_NAL_VPS, 24);
+        }
+        offset = appendNal(stream, offset, hevc ? HEVC_NAL_SPS : H264_NAL_SPS, 24);
+        offset = appendNal(stream, offset, hevc ? HEVC_NAL_PPS : H264_NAL_PPS, 12);
+        appendNal(stream, offset, hevc ? HEVC_NAL_IDR_W_RADL : H264_NAL_IDR, stream->frameDataSize - offset);
+    }
+    else {
+        appendNal(stream, offset, hevc ? HEVC_NAL_TRAIL_R : H264_NAL_SLICE, stream->frameDataSize - offset);
+    }
+}
+
+uint32_t SynGenerateVideoFrame(PSYNTHETIC_STREAM stream, SyntheticPacketCallback callback, void* context) {
+    int blockSize = stream->config.packetSize + MAX_RTP_HEADER_SIZE;
+    int payloadPerPacket = stream->config.packetSize - (int)sizeof(NV_VIDEO_PACKET);
+    int maxDataShardsPerBlock = getMaxDataShardsPerBlock(stream->config.fecPercentage);
+    int maxBlocks = stream->config.multiFec ? SYN_MAX_FEC_BLOCKS : 1;
+    uint32_t frameNumber = stream->frameNumber++;
+    uint64_t frameTimeUs = SynGetFrameTimeUs(stream, frameNumber);
+    int totalDataShards, blockCount, shardsPerBlock;
+    int frameOffset;
+    int block;
+
+    stream->idrFrame = stream->idrFrameRequested || (frameNumber - 1) % stream->config.idrInterval == 0;
+    stream->idrFrameRequested = false;
+    buildFrameData(stream, stream->idrFrame, maxDataShardsPerBlock * maxBlocks);
+
+    totalDataShards = (stream->frameDataSize + payloadPerPacket - 1) / payloadPerPacket;
+    blockCount = (totalDataShards + maxDataShardsPerBlock - 1) / maxDataShardsPerBlock;
+    shardsPerBlock = (totalDataShards + blockCount - 1) / blockCount;
+
+    frameOffset = 0;
+    for (block = 0; block < blockCount; block++) {
+        int dataShards = block == blockCount - 1 ? totalDataShards - block * shardsPerBlock : shardsPerBlock;
+        int parityShards = getParityShards(dataShards, stream->config.fecPercentage);
+        int lastPacketLength = 0;
+        int i;
+
+        memset(stream->shardData, 0, (size_t)(dataShards + parityShards) * blockSize);
+
+        // The data shards are encoded with their flags and stream packet index, but
+        // without the rest of the header which is filled in for each packet below
+        for (i = 0; i < dataShards; i++) {
+            PNV_VIDEO_PACKET nvPacket = (PNV_VIDEO_PACKET)&stream->shards[i][MAX_RTP_HEADER_SIZE];
+            int length = stream->frameDataSize - frameOffset;
+
+            if (length > payloadPerPacket) {
+                length = payloadPerPacket;
+            }
+
+            nvPacket->streamPacketIndex = LE32(stream->streamPacketIndex << 8);
+            stream->streamPacketIndex++;
+
+            nvPacket->flags = FLAG_CONTAINS_PIC_DATA;
+            if (i == 0) {
+                nvPacket->flags |= FLAG_SOF;
+            }
+            if (i == dataShards - 1) {
+                nvPacket->flags |= FLAG_EOF;
+                lastPacketLength = MAX_RTP_HEADER_SIZE + (int)sizeof(*nvPacket) + length;
+            }
+
+            memcpy(nvPacket + 1, &stream->frameData[frameOffset], length);
+            frameOffset += length;
+        }
+
+        if (parityShards != 0) {
+            reed_solomon* rs = reed_solomon_new(dataShards, parityShards);
+            if (rs == NULL) {
+                return frameNumber;
+            }
+
+            reed_solomon_encode(rs, stream->shards, dataShards + parityShards, blockSize);
+            reed_solomon_release(rs);
+        }
+
+        for (i = 0; i < dataShards + parityShards; i++) {
+            PRTP_PACKET rtp = (PRTP_PACKET)stream->shards[i];
+            PNV_VIDEO_PACKET nvPacket = (PNV_VIDEO_PACKET)&stream->shards[i][MAX_RTP_HEADER_SIZE];
+
+            rtp->header = 0x80 | FLAG_EXTENSION;
+            rtp->packetType = 0;
+            rtp->sequenceNumber = BE16((uint16_t)(stream->videoSequenceNumber + i));
+            rtp->timestamp = BE32((uint32_t)(frameTimeUs / 1000 * 90));
+            rtp->ssrc = 0;
+
+            nvPacket->frameIndex = LE32(frameNumber);
+            nvPacket->multiFecFlags = 0x10;
+            nvPacket->multiFecBlocks = (uint8_t)((((blockCount - 1) << 2) | block) << 4);
+            nvPacket->fecInfo = LE32((uint32_t)dataShards << 22 | (uint32_t)i << 12 |
+                                     (uint32_t)stream->config.fecPercentage << 4);
+
+            callback(SYN_STREAM_VIDEO, frameTimeUs, rtp,
+                     i == dataShards - 1 ? lastPacketLength : blockSize,
+                     context);
+        }
+
+        stream->videoSequenceNumber += (uint16_t)(dataShards + parityShards);
+    }
+
+    return frameNumber;
+}
+
+static void sendAudioPacket(PSYNTHETIC_STREAM stream, uint8_t packetType, uint16_t sequenceNumber, uint32_t timestamp,
+                            const void* header, int headerLength, const unsigned char* payload,
+                            SyntheticPacketCallback callback, void* context) {
+    char packet[RTPA_MAX_PACKET_SIZE];
+    PRTP_PACKET rtp = (PRTP_PACKET)packet;
+    int length = (int)sizeof(*rtp);
+
+    rtp->header = 0x80;
+    rtp->packetType = packetType;
+    rtp->sequenceNumber = BE16(sequenceNumber);
+    rtp->timestamp = BE32(timestamp);
+    rtp->ssrc = 0;
+
+    if (headerLength != 0) {
+        memcpy(&packet[length], header, headerLength);
+        length += headerLength;
+    }
+    memcpy(&packet[length], payload, stream->config.audioPayloadSize);
+    length += stream->config.audioPayloadSize;
+
+    callback(SYN_STREAM_AUDIO, stream->nextAudioTimeUs, packet, length, context);
+}
+
+void SynGenerateAudio(PSYNTHETIC_STREAM stream, uint64_t untilUs, SyntheticPacketCallback callback, void* context) {
+    uint32_t duration = (uint32_t)stream->config.audioPacketDuration;
+
+    while (stream->nextAudioTimeUs < untilUs) {
+        uint16_t sequenceNumber = stream->audioSequenceNumber++;
+        unsigned char* payload = stream->audioShards[sequenceNumber % RTPA_DATA_SHARDS];
+        uint32_t timestamp = sequenceNumber * duration;
+
+        payload[0] = OPUS_TOC_BYTE;
+        fillRandomData(stream, &payload[1], stream->config.audioPayloadSize - 1);
+        sendAudioPacket(stream, RTP_PAYLOAD_TYPE_AUDIO, sequenceNumber, timestamp,
+                        NULL, 0, payload, callback, context);
+
+        // Each block of data shards is followed by its parity
+        if (sequenceNumber % RTPA_DATA_SHARDS == RTPA_DATA_SHARDS - 1) {
+            uint16_t baseSequenceNumber = (uint16_t)(sequenceNumber - (RTPA_DATA_SHARDS - 1));
+            int i;
+
+            reed_solomon_encode(stream->audioRs, stream->audioShards, RTPA_TOTAL_SHARDS, stream->config.audioPayloadSize);
+
+            for (i = 0; i < RTPA_FEC_SHARDS; i++) {
+                AUDIO_FEC_HEADER fecHeader;
+
+                fecHeader.fecShardIndex = (uint8_t)i;
+                fecHeader.payloadType = RTP_PAYLOAD_TYPE_AUDIO;
+                fecHeader.baseSequenceNumber = BE16(baseSequenceNumber);
+                fecHeader.baseTimestamp = BE32(baseSequenceNumber * duration);
+                fecHeader.ssrc = 0;
+
+                sendAudioPacket(stream, RTP_PAYLOAD_TYPE_FEC, (uint16_t)(baseSequenceNumber + i), timestamp,
+                                &fecHeader, sizeof(fecHeader), stream->audioShards[RTPA_DATA_SHARDS + i],
+                                callback, context);
+            }
+        }
+
+        stream->nextAudioTimeUs += duration * 1000;
+    }
+}
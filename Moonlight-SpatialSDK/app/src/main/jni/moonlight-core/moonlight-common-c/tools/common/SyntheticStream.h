@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Limelight-internal.h"
+
+// Generates the RTP video and audio packets that a host would send for a made-up
+// H.264 or HEVC stream. Video frames are split into FEC blocks with Reed-Solomon parity
+// exactly like the host does it, so the packets exercise the RTP queues, FEC
+// recovery and the depacketizer just like real traffic. The frame contents are
+// deterministic for a given seed.
+
+// Streams passed to SyntheticPacketCallback (same values as the packet capture)
+#define SYN_STREAM_VIDEO PACKET_CAPTURE_VIDEO
+#define SYN_STREAM_AUDIO PACKET_CAPTURE_AUDIO
+
+// Host-side limit of data shards in each FEC block of a frame
+#define SYN_MAX_DATA_SHARDS_PER_BLOCK 200
+
+// Multi-FEC frames have at most 4 FEC blocks
+#define SYN_MAX_FEC_BLOCKS 4
+
+typedef struct _SYNTHETIC_STREAM_CONFIG {
+    // Size of the NV_VIDEO_PACKET header and video data in each packet
+    int packetSize;
+    int fps;
+
+    // Size of the Annex B data in each frame. IDR frames are 4 times as large.
+    int minFrameSize;
+    int maxFrameSize;
+
+    // Frames from one IDR frame to the next
+    int idrInterval;
+
+    int fecPercentage;
+
+    // Split frames into up to SYN_MAX_FEC_BLOCKS FEC blocks like GFE 7.1.431+ and Sunshine
+    bool multiFec;
+
+    // Audio packet duration in milliseconds and Opus payload size in bytes
+    int audioPacketDuration;
+    int audioPayloadSize;
+
+    // VIDEO_FORMAT_H264 or VIDEO_FORMAT_H265
+    int videoFormat;
+
+    // Start each frame with an AUD and an SEI NAL unit like some encoders do.
+    // The client strips them, so they aren't part of SynGetFrameAnnexB().
+    bool prefixNals;
+
+    uint32_t seed;
+} SYNTHETIC_STREAM_CONFIG, *PSYNTHETIC_STREAM_CONFIG;
+
+// The packet is only valid for the duration of the callback
+typedef void(*SyntheticPacketCallback)(int stream, uint64_t timeUs, const void* packet, int length, void* context);
+
+typedef struct _SYNTHETIC_STREAM {
+    SYNTHETIC_STREAM_CONFIG config;
+
+    uint32_t frameNumber;
+    bool idrFrameRequested;
+
+    // Whether the last video frame was an IDR frame
+    bool idrFrame;
+
+    uint16_t videoSequenceNumber;
+    uint32_t streamPacketIndex;
+    uint32_t randomState;
+
+    // Annex B data of the current frame, prefixed with the frame header
+    char* frameData;
+    int frameDataSize;
+
+    // Offset of the Annex B data that the client passes on to the decoder
+    int annexBOffset;
+
+    // Shards of the current FEC block
+    unsigned char* shardData;
+    unsigned char* shards[DATA_SHARDS_MAX];
+
+    uint16_t audioSequenceNumber;
+    uint64_t nextAudioTimeUs;
+    unsigned char* audioShards[RTPA_TOTAL_SHARDS];
+    reed_solomon* audioRs;
+} SYNTHETIC_STREAM, *PSYNTHETIC_STREAM;
+
+void SynInitializeConfig(PSYNTHETIC_STREAM_CONFIG config);
+int SynInitializeStream(PSYNTHETIC_STREAM stream, PSYNTHETIC_STREAM_CONFIG config);
+void SynCleanupStream(PSYNTHETIC_STREAM stream);
+
+// Emits every packet of the next video frame, including FEC parity.
+// Returns the frame number.
+uint32_t SynGenerateVideoFrame(PSYNTHETIC_STREAM stream, SyntheticPacketCallback callback, void* context);
+
+// Makes the next video frame an IDR frame, like a host does when the client requests one
+void SynRequestIdrFrame(PSYNTHETIC_STREAM stream);
+
+// Returns the Annex B data of the last video frame, as the client will decode it
+const char* SynGetFrameAnnexB(PSYNTHETIC_STREAM stream, int* length);
+
+// Hash of the Annex B data of a frame. Trailing zero bytes aren't included, since frames
+// recovered by FEC may be padded with zeros that decoders ignore.
+uint64_t SynHashFrameData(const void* data, int length);
+
+// Emits the audio packets due before the given stream time, including FEC parity
+void SynGenerateAudio(PSYNTHETIC_STREAM stream, uint64_t untilUs, SyntheticPacketCallback callback, void* context);
+
+// Stream time of the given video frame
+uint64_t SynGetFrameTimeUs(PSYNTHETIC_STREAM stream, uint32_t frameNumber);
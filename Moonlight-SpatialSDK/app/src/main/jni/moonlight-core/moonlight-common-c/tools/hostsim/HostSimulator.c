@@ -0,0 +1,933 @@
+#include "HostSimulator.h"
+#include "Rtsp.h"
+
+#include <ctype.h>
+
+#define RTSP_MAX_MESSAGE_SIZE 32768
+#define RTSP_RECEIVE_TIMEOUT_MS 5000
+#define RTSP_SESSION_ID "DEADBEEFCAFE;timeout = 90"
+
+// How long the stream thread waits for the client to ping the video and audio ports
+#define PING_TIMEOUT_MS 10000
+
+// Control stream message types for the encrypted control protocol
+#define CTRL_TYPE_REQUEST_IDR_FRAME 0x0302
+#define CTRL_TYPE_INVALIDATE_REF_FRAMES 0x0301
+#define CTRL_TYPE_LOSS_STATS 0x0201
+#define CTRL_TYPE_INPUT_DATA 0x0206
+#define CTRL_TYPE_TERMINATION 0x0109
+
+// NVST_DISCONN_SERVER_TERMINATED_CLOSED, which the client treats as a graceful termination
+#define TERMINATION_REASON_CLOSED 0x80030023
+
+#define CTRL_ENCRYPTED_HEADER_TYPE 0x0001
+#define CTRL_ENCRYPTED_HEADER_SIZE 8
+#define CTRL_V2_HEADER_SIZE 4
+#define CTRL_TAG_SIZE 16
+
+void HsInitializeConfig(PHOST_SIMULATOR_CONFIG config) {
+    memset(config, 0, sizeof(*config));
+    SynInitializeConfig(&config->stream);
+    config->frameCount = 300;
+}
+
+static void getLoopbackAddress(struct sockaddr_storage* addr, SOCKADDR_LEN* addrLen) {
+    struct sockaddr_in* sin = (struct sockaddr_in*)addr;
+
+    memset(addr, 0, sizeof(*addr));
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin->sin_port = 0;
+    *addrLen = sizeof(*sin);
+}
+
+static uint16_t getSocketPort(SOCKET s) {
+    struct sockaddr_storage addr;
+    SOCKADDR_LEN addrLen = sizeof(addr);
+
+    if (getsockname(s, (struct sockaddr*)&addr, &addrLen) == SOCKET_ERROR) {
+        return 0;
+    }
+
+    return ntohs(((struct sockaddr_in*)&addr)->sin_port);
+}
+
+static bool startsWithIgnoreCase(const char* string, const char* prefix) {
+    while (*prefix != 0) {
+        if (tolower((unsigned char)*string) != tolower((unsigned char)*prefix)) {
+            return false;
+        }
+        string++;
+        prefix++;
+    }
+
+    return true;
+}
+
+// Returns the total length of the request once all of it has been received, or 0 if
+// more data is needed
+static int getCompleteRequestLength(const char* buffer, int length) {
+    const char* headerEnd;
+    const char* line;
+    int contentLength = 0;
+
+    headerEnd = strstr(buffer, "\r\n\r\n");
+    if (headerEnd == NULL) {
+        return 0;
+    }
+
+    // The header names are case-insensitive
+    for (line = strstr(buffer, "\r\n"); line != NULL && line < headerEnd; line = strstr(line + 2, "\r\n")) {
+        if (startsWithIgnoreCase(line + 2, "Content-length:")) {
+            contentLength = atoi(line + 2 + strlen("Content-length:"));
+        }
+    }
+
+    if (contentLength < 0 || (headerEnd - buffer) + 4 + contentLength > RTSP_MAX_MESSAGE_SIZE - 1) {
+        return -1;
+    }
+
+    return length >= (headerEnd - buffer) + 4 + contentLength ? (int)(headerEnd - buffer) + 4 + contentLength : 0;
+}
+
+static int receiveRtspRequest(SOCKET s, char* buffer) {
+    int length = 0;
+
+    for (;;) {
+        struct pollfd pfd;
+        int requestLength;
+        int err;
+
+        pfd.fd = s;
+        pfd.events = POLLIN;
+        if (pollSockets(&pfd, 1, RTSP_RECEIVE_TIMEOUT_MS) <= 0) {
+            return -1;
+        }
+
+        err = recv(s, &buffer[length], RTSP_MAX_MESSAGE_SIZE - 1 - length, 0);
+        if (err <= 0) {
+            // The client closes the connection without a request when it tests the port
+            return -1;
+        }
+
+        length += err;
+        buffer[length] = 0;
+
+        requestLength = getCompleteRequestLength(buffer, length);
+        if (requestLength != 0) {
+            return requestLength;
+        }
+        else if (length == RTSP_MAX_MESSAGE_SIZE - 1) {
+            return -1;
+        }
+    }
+}
+
+static bool sendAll(SOCKET s, const char* data, int length) {
+    while (length > 0) {
+        int err = send(s, data, length, 0);
+        if (err <= 0) {
+            return false;
+        }
+
+        data += err;
+        length -= err;
+    }
+
+    return true;
+}
+
+static bool getSdpAttribute(const char* sdp, const char* name, long* value) {
+    char prefix[64];
+    const char* attribute;
+
+    snprintf(prefix, sizeof(prefix), "a=%s:", name);
+    attribute = strstr(sdp, prefix);
+    if (attribute == NULL) {
+        return false;
+    }
+
+    *value = strtol(attribute + strlen(prefix), NULL, 10);
+    return true;
+}
+
+// Takes the stream parameters from the client's SDP like a host does
+static bool handleAnnounce(PHOST_SIMULATOR host, PRTSP_MESSAGE request) {
+    long value;
+
+    if (request->payload == NULL) {
+        return false;
+    }
+
+    if (!getSdpAttribute(request->payload, "x-nv-video[0].packetSize", &value) || value <= 0) {
+        return false;
+    }
+    host->packetSize = (int)value;
+
+    if (!getSdpAttribute(request->payload, "x-nv-video[0].maxFPS", &value) || value <= 0) {
+        return false;
+    }
+    host->fps = (int)value;
+
+    if (!getSdpAttribute(request->payload, "x-nv-aqos.packetDuration", &value) || value <= 0) {
+        return false;
+    }
+    host->audioPacketDuration = (int)value;
+
+    if (getSdpAttribute(request->payload, "x-ss-general.encryptionEnabled", &value)) {
+        host->encryptionEnabled = (uint32_t)value;
+    }
+
+    return true;
+}
+
+static void handleRtspConnection(PHOST_SIMULATOR host, SOCKET s) {
+    char* buffer;
+    char headers[512];
+    char sdp[512];
+    const char* payload = "";
+    const char* status = "200 OK";
+    RTSP_MESSAGE request;
+    char* command;
+    char* target;
+    char* sequenceNumber;
+    int length;
+
+    buffer = malloc(RTSP_MAX_MESSAGE_SIZE);
+    if (buffer == NULL) {
+        return;
+    }
+
+    length = receiveRtspRequest(s, buffer);
+    if (length <= 0 || parseRtspMessage(&request, buffer, length) != RTSP_ERROR_SUCCESS) {
+        free(buffer);
+        return;
+    }
+
+    host->stats.rtspRequests++;
+    command = request.message.request.command;
+    target = request.message.request.target;
+    sequenceNumber = getOptionContent(request.options, "CSeq");
+    headers[0] = 0;
+
+    if (!strcmp(command, "OPTIONS") || !strcmp(command, "PLAY")) {
+        if (!strcmp(command, "PLAY")) {
+            PltAtomicStore(&host->playing, 1);
+        }
+    }
+    else if (!strcmp(command, "DESCRIBE")) {
+        uint32_t encryptionSupported = SS_ENC_CONTROL_V2;
+
+        if (host->config.videoEncryptionSupported) {
+            encryptionSupported |= SS_ENC_VIDEO;
+        }
+
+        snprintf(sdp, sizeof(sdp),
+                 "v=0\r\n"
+                 "o=- 0 0 IN IP4 127.0.0.1\r\n"
+                 "s=Host Simulator\r\n"
+                 "a=x-ss-general.featureFlags:0\r\n"
+                 "a=x-ss-general.encryptionSupported:%u\r\n"
+                 "a=x-ss-general.encryptionRequested:0\r\n"
+                 "m=video 0 RTP/AVP 96\r\n"
+                 "a=rtpmap:96 H264/90000\r\n",
+                 encryptionSupported);
+        payload = sdp;
+        snprintf(headers, sizeof(headers), "Content-Type: application/sdp\r\n");
+    }
+    else if (!strcmp(command, "SETUP")) {
+        uint16_t port;
+
+        if (strstr(target, "audio") != NULL) {
+            port = host->audioPort;
+        }
+        else if (strstr(target, "video") != NULL) {
+            port = host->videoPort;
+        }
+        else {
+            port = host->controlPort;
+        }
+
+        snprintf(headers, sizeof(headers),
+                 "Session: " RTSP_SESSION_ID "\r\n"
+                 "Transport: server_port=%u\r\n",
+                 port);
+    }
+    else if (!strcmp(command, "ANNOUNCE")) {
+        if (!handleAnnounce(host, &request)) {
+            status = "400 Bad Request";
+        }
+    }
+    else {
+        status = "404 Not Found";
+    }
+
+    // The response is closed by the connection closing, so it doesn't need a content length
+    length = snprintf(buffer, RTSP_MAX_MESSAGE_SIZE,
+                      "RTSP/1.0 %s\r\n"
+                      "CSeq: %s\r\n"
+                      "%s"
+                      "\r\n"
+                      "%s",
+                      status, sequenceNumber != NULL ? sequenceNumber : "0", headers, payload);
+    freeMessage(&request);
+
+    if (length > 0 && length < RTSP_MAX_MESSAGE_SIZE) {
+        sendAll(s, buffer, length);
+    }
+
+    free(buffer);
+}
+
+static void RtspThreadProc(void* context) {
+    PHOST_SIMULATOR host = (PHOST_SIMULATOR)context;
+
+    while (!PltIsThreadInterrupted(&host->rtspThread)) {
+        struct pollfd pfd;
+        SOCKET s;
+
+        pfd.fd = host->rtspSocket;
+        pfd.events = POLLIN;
+        if (pollSockets(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        s = accept(host->rtspSocket, NULL, NULL);
+        if (s == INVALID_SOCKET) {
+            continue;
+        }
+
+        handleRtspConnection(host, s);
+        closeSocket(s);
+    }
+}
+
+static void getControlIv(PHOST_SIMULATOR host, uint32_t sequenceNumber, char source, unsigned char* iv, int* ivLength) {
+    memset(iv, 0, 16);
+
+    if (host->encryptionEnabled & SS_ENC_CONTROL_V2) {
+        iv[0] = (unsigned char)(sequenceNumber >> 0);
+        iv[1] = (unsigned char)(sequenceNumber >> 8);
+        iv[2] = (unsigned char)(sequenceNumber >> 16);
+        iv[3] = (unsigned char)(sequenceNumber >> 24);
+        iv[10] = (unsigned char)source;
+        iv[11] = (unsigned char)'C';
+        *ivLength = 12;
+    }
+    else {
+        iv[0] = (unsigned char)sequenceNumber;
+        *ivLength = 16;
+    }
+}
+
+// Keeps the controller and relative mouse packets within an input message
+static void recordInput(PHOST_SIMULATOR host, PBYTE_BUFFER bb, uint64_t receiveTimeUs) {
+    const char* packet;
+    NV_INPUT_HEADER header;
+    PRECEIVED_INPUT input;
+    uint16_t length;
+    uint32_t magic;
+
+    // The input packet follows the message length
+    if (!BbGet16(bb, &length) || length < sizeof(header) || length > bb->length - bb->position) {
+        return;
+    }
+
+    packet = &bb->buffer[bb->position];
+    memcpy(&header, packet, sizeof(header));
+    magic = LE32(header.magic);
+    if (magic != MULTI_CONTROLLER_MAGIC && magic != MULTI_CONTROLLER_MAGIC_GEN5 &&
+            magic != MOUSE_MOVE_REL_MAGIC && magic != MOUSE_MOVE_REL_MAGIC_GEN5) {
+        return;
+    }
+
+    if (host->receivedInputCount == host->receivedInputCapacity) {
+        int newCapacity = host->receivedInputCapacity ? host->receivedInputCapacity * 2 : 1024;
+        PRECEIVED_INPUT newInput = realloc(host->receivedInput, sizeof(*host->receivedInput) * newCapacity);
+        if (newInput == NULL) {
+            return;
+        }
+
+        host->receivedInput = newInput;
+        host->receivedInputCapacity = newCapacity;
+    }
+
+    input = &host->receivedInput[host->receivedInputCount];
+    memset(input, 0, sizeof(*input));
+    input->receiveTimeUs = receiveTimeUs;
+    input->magic = magic;
+
+    if (magic == MOUSE_MOVE_REL_MAGIC || magic == MOUSE_MOVE_REL_MAGIC_GEN5) {
+        NV_REL_MOUSE_MOVE_PACKET mouse;
+
+        if (length < sizeof(mouse)) {
+            return;
+        }
+        memcpy(&mouse, packet, sizeof(mouse));
+        input->deltaX = (short)BE16(mouse.deltaX);
+        input->deltaY = (short)BE16(mouse.deltaY);
+    }
+    else {
+        NV_MULTI_CONTROLLER_PACKET controller;
+
+        if (length < sizeof(controller)) {
+            return;
+        }
+        memcpy(&controller, packet, sizeof(controller));
+        input->controllerNumber = (short)LE16(controller.controllerNumber);
+        input->leftStickX = (short)LE16(controller.leftStickX);
+    }
+
+    host->receivedInputCount++;
+}
+
+static void handleControlMessage(PHOST_SIMULATOR host, unsigned char* data, int length) {
+    unsigned char plaintext[1024];
+    unsigned char iv[16];
+    int plaintextLength;
+    int ivLength;
+    BYTE_BUFFER bb;
+    uint16_t headerType, encryptedLength, type;
+    uint32_t sequenceNumber;
+    uint64_t receiveTimeUs = PltGetMicros();
+
+    host->stats.controlMessages++;
+
+    if (length < CTRL_ENCRYPTED_HEADER_SIZE + CTRL_TAG_SIZE + CTRL_V2_HEADER_SIZE) {
+        host->stats.controlDecryptFailures++;
+        return;
+    }
+
+    BbInitializeWrappedBuffer(&bb, (char*)data, 0, length, BYTE_ORDER_LITTLE);
+    BbGet16(&bb, &headerType);
+    BbGet16(&bb, &encryptedLength);
+    BbGet32(&bb, &sequenceNumber);
+
+    plaintextLength = length - CTRL_ENCRYPTED_HEADER_SIZE - CTRL_TAG_SIZE;
+    if (headerType != CTRL_ENCRYPTED_HEADER_TYPE || encryptedLength != length - 4 ||
+            plaintextLength > (int)sizeof(plaintext)) {
+        host->stats.controlDecryptFailures++;
+        return;
+    }
+
+    getControlIv(host, sequenceNumber, 'C', iv, &ivLength);
+    if (!PltDecryptMessage(host->controlDecryptionContext, ALGORITHM_AES_GCM, 0,
+                           (unsigned char*)host->config.aesKey, sizeof(host->config.aesKey),
+                           iv, ivLength,
+                           &data[CTRL_ENCRYPTED_HEADER_SIZE], CTRL_TAG_SIZE,
+                           &data[CTRL_ENCRYPTED_HEADER_SIZE + CTRL_TAG_SIZE], plaintextLength,
+                           plaintext, &plaintextLength)) {
+        host->stats.controlDecryptFailures++;
+        return;
+    }
+
+    BbInitializeWrappedBuffer(&bb, (char*)plaintext, 0, plaintextLength, BYTE_ORDER_LITTLE);
+    BbGet16(&bb, &type);
+
+    switch (type) {
+    case CTRL_TYPE_REQUEST_IDR_FRAME:
+        host->stats.idrRequests++;
+        PltAtomicStore(&host->idrFrameRequested, 1);
+        break;
+    case CTRL_TYPE_INVALIDATE_REF_FRAMES:
+        // We can't invalidate reference frames, so send an IDR frame instead
+        host->stats.refInvalidationRequests++;
+        PltAtomicStore(&host->idrFrameRequested, 1);
+        break;
+    case CTRL_TYPE_LOSS_STATS:
+        host->stats.lossStatsMessages++;
+        break;
+    case CTRL_TYPE_INPUT_DATA:
+        host->stats.inputMessages++;
+        recordInput(host, &bb, receiveTimeUs);
+        break;
+    default:
+        break;
+    }
+}
+
+static bool sendTermination(PHOST_SIMULATOR host) {
+    unsigned char plaintext[CTRL_V2_HEADER_SIZE + 4];
+    unsigned char iv[16];
+    ENetPacket* packet;
+    BYTE_BUFFER bb;
+    int ciphertextLength;
+    int ivLength;
+
+    BbInitializeWrappedBuffer(&bb, (char*)plaintext, 0, sizeof(plaintext), BYTE_ORDER_LITTLE);
+    BbPut16(&bb, CTRL_TYPE_TERMINATION);
+    BbPut16(&bb, 4);
+
+    // The reason is the only big-endian field in the message
+    bb.byteOrder = BYTE_ORDER_BIG;
+    BbPut32(&bb, TERMINATION_REASON_CLOSED);
+
+    packet = enet_packet_create(NULL, CTRL_ENCRYPTED_HEADER_SIZE + CTRL_TAG_SIZE + sizeof(plaintext),
+                                ENET_PACKET_FLAG_RELIABLE);
+    if (packet == NULL) {
+        return false;
+    }
+
+    BbInitializeWrappedBuffer(&bb, (char*)packet->data, 0, CTRL_ENCRYPTED_HEADER_SIZE, BYTE_ORDER_LITTLE);
+    BbPut16(&bb, CTRL_ENCRYPTED_HEADER_TYPE);
+    BbPut16(&bb, (uint16_t)(packet->dataLength - 4));
+    BbPut32(&bb, host->controlSequenceNumber);
+
+    getControlIv(host, host->controlSequenceNumber++, 'H', iv, &ivLength);
+    ciphertextLength = sizeof(plaintext);
+    if (!PltEncryptMessage(host->controlEncryptionContext, ALGORITHM_AES_GCM, 0,
+                           (unsigned char*)host->config.aesKey, sizeof(host->config.aesKey),
+                           iv, ivLength,
+                           &packet->data[CTRL_ENCRYPTED_HEADER_SIZE], CTRL_TAG_SIZE,
+                           plaintext, sizeof(plaintext),
+                           &packet->data[CTRL_ENCRYPTED_HEADER_SIZE + CTRL_TAG_SIZE], &ciphertextLength) ||
+            enet_peer_send(host->controlPeer, CTRL_CHANNEL_GENERIC, packet) < 0) {
+        enet_packet_destroy(packet);
+        return false;
+    }
+
+    enet_host_flush(host->enetHost);
+    return true;
+}
+
+static void ControlThreadProc(void* context) {
+    PHOST_SIMULATOR host = (PHOST_SIMULATOR)context;
+
+    while (!PltIsThreadInterrupted(&host->controlThread)) {
+        ENetEvent event;
+
+        if (enet_host_service(host->enetHost, &event, 10) > 0) {
+            switch (event.type) {
+            case ENET_EVENT_TYPE_CONNECT:
+                if (host->controlPeer == NULL) {
+                    host->controlPeer = event.peer;
+                }
+                else {
+                    enet_peer_disconnect_now(event.peer, 0);
+                }
+                break;
+            case ENET_EVENT_TYPE_RECEIVE:
+                if (event.peer == host->controlPeer) {
+                    handleControlMessage(host, event.packet->data, (int)event.packet->dataLength);
+                }
+                enet_packet_destroy(event.packet);
+                break;
+            case ENET_EVENT_TYPE_DISCONNECT:
+                if (event.peer == host->controlPeer) {
+                    host->controlPeer = NULL;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Tell the client that the session is over once everything has been sent
+        if (host->controlPeer != NULL && !host->stats.terminationSent && PltAtomicLoad(&host->streamFinished)) {
+            host->stats.terminationSent = sendTermination(host);
+        }
+    }
+
+    if (host->controlPeer != NULL) {
+        enet_peer_disconnect_now(host->controlPeer, 0);
+        host->controlPeer = NULL;
+    }
+}
+
+static uint32_t nextRandom(uint32_t* state) {
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+static bool randomLoss(PHOST_SIMULATOR host) {
+    if (host->config.videoLossPercent <= 0) {
+        return false;
+    }
+
+    return (nextRandom(&host->lossRandomState) % 1000000) < (uint32_t)(host->config.videoLossPercent * 10000);
+}
+
+// Converts between stream time and the host's audio clock, which drifts from the client's
+static uint64_t audioClockToRealTimeUs(PHOST_SIMULATOR host, uint64_t streamTimeUs) {
+    return (uint64_t)(streamTimeUs * 100.0 / (100.0 + host->config.audioClockDriftPercent));
+}
+
+static uint64_t realTimeToAudioClockUs(PHOST_SIMULATOR host, uint64_t realTimeUs) {
+    return (uint64_t)(realTimeUs * (100.0 + host->config.audioClockDriftPercent) / 100.0);
+}
+
+static void sendAudioPacket(PHOST_SIMULATOR host, const void* packet, int length) {
+    sendto(host->audioSocket, (const char*)packet, length, 0,
+           (struct sockaddr*)&host->audioClientAddr, host->audioClientAddrLen);
+    host->stats.audioPacketsSent++;
+}
+
+// Sends the pending audio packets that are due and returns when the next one is
+static uint64_t sendDueAudio(PHOST_SIMULATOR host, uint64_t nowUs) {
+    while (host->pendingAudioCount != 0) {
+        PPENDING_AUDIO_PACKET pending = &host->pendingAudio[host->pendingAudioHead];
+
+        if (pending->sendTimeUs > nowUs) {
+            return pending->sendTimeUs;
+        }
+
+        sendAudioPacket(host, pending->data, pending->length);
+        host->pendingAudioHead = (host->pendingAudioHead + 1) % HS_MAX_PENDING_AUDIO_PACKETS;
+        host->pendingAudioCount--;
+    }
+
+    return UINT64_MAX;
+}
+
+// Queues an audio packet to be sent when the host's audio clock reaches its stream time,
+// plus the random jitter. Packets stay in order like they would on a single network path.
+static void queueAudioPacket(PHOST_SIMULATOR host, uint64_t timeUs, const void* packet, int length) {
+    PPENDING_AUDIO_PACKET pending;
+    uint64_t sendTimeUs;
+
+    if (host->pendingAudioCount == HS_MAX_PENDING_AUDIO_PACKETS) {
+        sendDueAudio(host, host->pendingAudio[host->pendingAudioHead].sendTimeUs);
+    }
+
+    sendTimeUs = host->streamStartUs + audioClockToRealTimeUs(host, timeUs);
+    if (host->config.audioJitterMs > 0) {
+        sendTimeUs += nextRandom(&host->jitterRandomState) % ((uint32_t)host->config.audioJitterMs * 1000 + 1);
+    }
+    if (sendTimeUs < host->lastAudioSendTimeUs) {
+        sendTimeUs = host->lastAudioSendTimeUs;
+    }
+    host->lastAudioSendTimeUs = sendTimeUs;
+
+    pending = &host->pendingAudio[(host->pendingAudioHead + host->pendingAudioCount) % HS_MAX_PENDING_AUDIO_PACKETS];
+    pending->sendTimeUs = sendTimeUs;
+    pending->length = length;
+    memcpy(pending->data, packet, length);
+    host->pendingAudioCount++;
+}
+
+// Sleeps until the given time, sending audio as it becomes due
+static void waitForTime(PHOST_SIMULATOR host, uint64_t timeUs) {
+    uint64_t nowUs;
+
+    while ((nowUs = PltGetMicros()) < timeUs && !PltIsThreadInterrupted(&host->streamThread)) {
+        uint64_t wakeUs = sendDueAudio(host, nowUs);
+
+        if (wakeUs > timeUs) {
+            wakeUs = timeUs;
+        }
+        if (wakeUs > nowUs) {
+            PltSleepMs((int)((wakeUs - nowUs + 999) / 1000));
+        }
+    }
+
+    sendDueAudio(host, nowUs);
+}
+
+static void sendStreamPacket(int stream, uint64_t timeUs, const void* packet, int length, void* context) {
+    PHOST_SIMULATOR host = (PHOST_SIMULATOR)context;
+
+    if (stream == SYN_STREAM_AUDIO) {
+        queueAudioPacket(host, timeUs, packet, length);
+        return;
+    }
+
+    if (randomLoss(host)) {
+        host->stats.videoPacketsDropped++;
+        return;
+    }
+
+    if (host->encryptionEnabled & SS_ENC_VIDEO) {
+        PENC_VIDEO_HEADER encHeader = (PENC_VIDEO_HEADER)host->encryptedPacket;
+        int ciphertextLength = length;
+        int i;
+
+        // Each packet needs a unique IV
+        memset(encHeader->iv, 0, sizeof(encHeader->iv));
+        for (i = 0; i < 8; i++) {
+            encHeader->iv[i] = (uint8_t)(host->videoIvCounter >> (i * 8));
+        }
+        encHeader->iv[11] = 'V';
+        host->videoIvCounter++;
+
+        encHeader->frameNumber = LE32(host->currentFrameNumber);
+
+        if (!PltEncryptMessage(host->videoCryptoContext, ALGORITHM_AES_GCM, 0,
+                               (unsigned char*)host->config.aesKey, sizeof(host->config.aesKey),
+                               encHeader->iv, sizeof(encHeader->iv),
+                               encHeader->tag, sizeof(encHeader->tag),
+                               (unsigned char*)packet, length,
+                               (unsigned char*)(encHeader + 1), &ciphertextLength)) {
+            return;
+        }
+
+        packet = encHeader;
+        length = (int)sizeof(*encHeader) + ciphertextLength;
+    }
+
+    sendto(host->videoSocket, (const char*)packet, length, 0,
+           (struct sockaddr*)&host->videoClientAddr, host->videoClientAddrLen);
+    host->stats.videoPacketsSent++;
+}
+
+// Waits for the client's first ping to learn where to send the stream
+static bool waitForPing(PHOST_SIMULATOR host, SOCKET s, struct sockaddr_storage* addr, SOCKADDR_LEN* addrLen) {
+    uint64_t startMs = PltGetMillis();
+    char buffer[64];
+
+    while (!PltIsThreadInterrupted(&host->streamThread) && PltGetMillis() - startMs < PING_TIMEOUT_MS) {
+        struct pollfd pfd;
+
+        pfd.fd = s;
+        pfd.events = POLLIN;
+        if (pollSockets(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        *addrLen = sizeof(*addr);
+        if (recvfrom(s, buffer, sizeof(buffer), 0, (struct sockaddr*)addr, addrLen) > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void StreamThreadProc(void* context) {
+    PHOST_SIMULATOR host = (PHOST_SIMULATOR)context;
+    SYNTHETIC_STREAM_CONFIG config;
+    int i;
+
+    while (!PltAtomicLoad(&host->playing)) {
+        if (PltIsThreadInterrupted(&host->streamThread)) {
+            return;
+        }
+        PltSleepMs(10);
+    }
+
+    // Use the parameters the client asked for in the ANNOUNCE
+    config = host->config.stream;
+    config.packetSize = host->packetSize;
+    config.fps = host->fps;
+    config.audioPacketDuration = host->audioPacketDuration;
+    if (SynInitializeStream(&host->stream, &config) != 0) {
+        Limelog("Host simulator: unsupported stream parameters\n");
+        return;
+    }
+
+    host->stats.videoEncrypted = !!(host->encryptionEnabled & SS_ENC_VIDEO);
+    host->pendingAudio = malloc(sizeof(*host->pendingAudio) * HS_MAX_PENDING_AUDIO_PACKETS);
+    if (host->pendingAudio == NULL) {
+        return;
+    }
+
+    if (host->stats.videoEncrypted) {
+        host->encryptedPacket = malloc(sizeof(ENC_VIDEO_HEADER) + config.packetSize + MAX_RTP_HEADER_SIZE);
+        if (host->encryptedPacket == NULL) {
+            return;
+        }
+    }
+
+    if (!waitForPing(host, host->videoSocket, &host->videoClientAddr, &host->videoClientAddrLen) ||
+            !waitForPing(host, host->audioSocket, &host->audioClientAddr, &host->audioClientAddrLen)) {
+        Limelog("Host simulator: no pings received from the client\n");
+        return;
+    }
+
+    // Send each frame at the frame rate. Audio is generated along with the frames, but it is
+    // sent on the host's audio clock in between them.
+    host->streamStartUs = PltGetMicros();
+    for (i = 0; i < host->config.frameCount && !PltIsThreadInterrupted(&host->streamThread); i++) {
+        uint64_t frameTimeUs = SynGetFrameTimeUs(&host->stream, host->stream.frameNumber);
+        const char* annexB;
+        int annexBLength;
+
+        waitForTime(host, host->streamStartUs + frameTimeUs);
+
+        if (PltAtomicCompareExchange(&host->idrFrameRequested, 1, 0)) {
+            SynRequestIdrFrame(&host->stream);
+        }
+
+        host->currentFrameNumber = host->stream.frameNumber;
+        SynGenerateVideoFrame(&host->stream, sendStreamPacket, host);
+
+        annexB = SynGetFrameAnnexB(&host->stream, &annexBLength);
+        host->sentFrames[i].frameNumber = host->currentFrameNumber;
+        host->sentFrames[i].idrFrame = host->stream.idrFrame;
+        host->sentFrames[i].hash = SynHashFrameData(annexB, annexBLength);
+        host->stats.framesSent++;
+        if (host->stream.idrFrame) {
+            host->stats.idrFramesSent++;
+        }
+
+        // Generate the audio that will be due before the next frame is sent
+        SynGenerateAudio(&host->stream,
+                         realTimeToAudioClockUs(host, SynGetFrameTimeUs(&host->stream, host->stream.frameNumber)) + 1,
+                         sendStreamPacket, host);
+    }
+
+    PltAtomicStore(&host->streamFinished, 1);
+}
+
+int HsStartHost(PHOST_SIMULATOR host, PHOST_SIMULATOR_CONFIG config) {
+    struct sockaddr_storage addr;
+    SOCKADDR_LEN addrLen;
+    ENetAddress enetAddress;
+    int err;
+
+    memset(host, 0, sizeof(*host));
+    host->config = *config;
+    host->rtspSocket = host->videoSocket = host->audioSocket = INVALID_SOCKET;
+    host->lossRandomState = config->stream.seed != 0 ? config->stream.seed : 1;
+    host->jitterRandomState = (host->lossRandomState * 2654435761u) | 1;
+
+    if (config->frameCount <= 0 || config->audioJitterMs < 0 || config->audioClockDriftPercent <= -100) {
+        return -1;
+    }
+
+    err = initializePlatformSockets();
+    if (err != 0) {
+        return err;
+    }
+
+    if (enet_initialize() != 0) {
+        cleanupPlatformSockets();
+        return -1;
+    }
+
+    host->sentFrames = calloc(config->frameCount, sizeof(*host->sentFrames));
+    host->videoCryptoContext = PltCreateCryptoContext();
+    host->controlEncryptionContext = PltCreateCryptoContext();
+    host->controlDecryptionContext = PltCreateCryptoContext();
+    if (host->sentFrames == NULL || host->videoCryptoContext == NULL ||
+            host->controlEncryptionContext == NULL || host->controlDecryptionContext == NULL) {
+        err = -1;
+        goto Fail;
+    }
+
+    getLoopbackAddress(&addr, &addrLen);
+
+    host->rtspSocket = createSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, false);
+    if (host->rtspSocket == INVALID_SOCKET ||
+            bind(host->rtspSocket, (struct sockaddr*)&addr, addrLen) == SOCKET_ERROR ||
+            listen(host->rtspSocket, 4) == SOCKET_ERROR) {
+        err = LastSocketFail();
+        goto Fail;
+    }
+
+    host->videoSocket = bindUdpSocket(AF_INET, &addr, addrLen, 0, SOCK_QOS_TYPE_BEST_EFFORT);
+    host->audioSocket = bindUdpSocket(AF_INET, &addr, addrLen, 0, SOCK_QOS_TYPE_BEST_EFFORT);
+    if (host->videoSocket == INVALID_SOCKET || host->audioSocket == INVALID_SOCKET) {
+        err = LastSocketFail();
+        goto Fail;
+    }
+
+    enet_address_set_address(&enetAddress, (struct sockaddr*)&addr, addrLen);
+    enet_address_set_port(&enetAddress, 0);
+    host->enetHost = enet_host_create(AF_INET, &enetAddress, 1, CTRL_CHANNEL_COUNT, 0, 0);
+    if (host->enetHost == NULL || enet_socket_get_address(host->enetHost->socket, &enetAddress) < 0) {
+        err = -1;
+        goto Fail;
+    }
+
+    host->rtspPort = getSocketPort(host->rtspSocket);
+    host->videoPort = getSocketPort(host->videoSocket);
+    host->audioPort = getSocketPort(host->audioSocket);
+    host->controlPort = ntohs(((struct sockaddr_in*)&enetAddress.address)->sin_port);
+    if (host->rtspPort == 0 || host->videoPort == 0 || host->audioPort == 0 || host->controlPort == 0) {
+        err = -1;
+        goto Fail;
+    }
+
+    err = PltCreateThread("HostRtsp", RtspThreadProc, host, &host->rtspThread);
+    if (err != 0) {
+        goto Fail;
+    }
+
+    err = PltCreateThread("HostControl", ControlThreadProc, host, &host->controlThread);
+    if (err != 0) {
+        PltInterruptThread(&host->rtspThread);
+        PltJoinThread(&host->rtspThread);
+        goto Fail;
+    }
+
+    err = PltCreateThread("HostStream", StreamThreadProc, host, &host->streamThread);
+    if (err != 0) {
+        PltInterruptThread(&host->rtspThread);
+        PltInterruptThread(&host->controlThread);
+        PltJoinThread(&host->rtspThread);
+        PltJoinThread(&host->controlThread);
+        goto Fail;
+    }
+
+    host->threadsStarted = true;
+    return 0;
+
+Fail:
+    HsStopHost(host);
+    HsCleanupHost(host);
+    return err != 0 ? err : -1;
+}
+
+void HsStopHost(PHOST_SIMULATOR host) {
+    if (host->threadsStarted) {
+        PltInterruptThread(&host->rtspThread);
+        PltInterruptThread(&host->controlThread);
+        PltInterruptThread(&host->streamThread);
+        PltJoinThread(&host->rtspThread);
+        PltJoinThread(&host->controlThread);
+        PltJoinThread(&host->streamThread);
+        host->threadsStarted = false;
+    }
+
+    if (host->enetHost != NULL) {
+        enet_host_destroy(host->enetHost);
+        host->enetHost = NULL;
+    }
+    if (host->rtspSocket != INVALID_SOCKET) {
+        closeSocket(host->rtspSocket);
+        host->rtspSocket = INVALID_SOCKET;
+    }
+    if (host->videoSocket != INVALID_SOCKET) {
+        closeSocket(host->videoSocket);
+        host->videoSocket = INVALID_SOCKET;
+    }
+    if (host->audioSocket != INVALID_SOCKET) {
+        closeSocket(host->audioSocket);
+        host->audioSocket = INVALID_SOCKET;
+    }
+}
+
+void HsCleanupHost(PHOST_SIMULATOR host) {
+    SynCleanupStream(&host->stream);
+
+    free(host->sentFrames);
+    host->sentFrames = NULL;
+    free(host->encryptedPacket);
+    host->encryptedPacket = NULL;
+    free(host->pendingAudio);
+    host->pendingAudio = NULL;
+    free(host->receivedInput);
+    host->receivedInput = NULL;
+
+    if (host->videoCryptoContext != NULL) {
+        PltDestroyCryptoContext(host->videoCryptoContext);
+        host->videoCryptoContext = NULL;
+    }
+    if (host->controlEncryptionContext != NULL) {
+        PltDestroyCryptoContext(host->controlEncryptionContext);
+        host->controlEncryptionContext = NULL;
+    }
+    if (host->controlDecryptionContext != NULL) {
+        PltDestroyCryptoContext(host->controlDecryptionContext);
+        host->controlDecryptionContext = NULL;
+    }
+
+    enet_deinitialize();
+    cleanupPlatformSockets();
+}
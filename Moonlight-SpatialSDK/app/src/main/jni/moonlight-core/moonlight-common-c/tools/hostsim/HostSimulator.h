@@ -0,0 +1,161 @@
+#pragma once
+
+#include "SyntheticStream.h"
+
+// Simulates a Sunshine host on the loopback interface, so a client can run the whole
+// connection sequence with LiStartConnection() without a real host or a network:
+//
+// - RTSP over TCP: OPTIONS, DESCRIBE, SETUP (audio, video and control), ANNOUNCE and PLAY
+// - ENet control stream: decrypts and counts client messages, honors IDR frame requests,
+//   records controller and mouse input and sends a graceful termination once all frames
+//   have been sent
+// - RTP video with NV_VIDEO_PACKET headers and Reed-Solomon FEC, optionally encrypted
+//   with AES-GCM, and RTP audio with FEC
+//
+// The stream itself comes from the synthetic stream generator. The packet size, frame rate,
+// audio packet duration and encryption are taken from the client's ANNOUNCE like a real host.
+
+// Sunshine with the encrypted control stream and multi-FEC
+#define HOST_SIMULATOR_APP_VERSION "7.1.431.-1"
+#define HOST_SIMULATOR_GFE_VERSION "3.23.0.74"
+
+typedef struct _HOST_SIMULATOR_CONFIG {
+    SYNTHETIC_STREAM_CONFIG stream;
+
+    // Frames to send before terminating the session
+    int frameCount;
+
+    // Whether to offer video encryption to the client
+    bool videoEncryptionSupported;
+
+    // Percentage of video packets to drop before sending
+    double videoLossPercent;
+
+    // Each audio packet is held back by a random delay of up to this many milliseconds
+    int audioJitterMs;
+
+    // How much faster the host's audio clock runs than the client's, in percent.
+    // Negative values make it run slower.
+    double audioClockDriftPercent;
+
+    // Must match the remote input key given to the client
+    char aesKey[16];
+} HOST_SIMULATOR_CONFIG, *PHOST_SIMULATOR_CONFIG;
+
+typedef struct _HOST_SIMULATOR_STATS {
+    uint32_t rtspRequests;
+
+    uint32_t framesSent;
+    uint32_t idrFramesSent;
+    uint32_t videoPacketsSent;
+    uint32_t videoPacketsDropped;
+    uint32_t audioPacketsSent;
+    bool videoEncrypted;
+
+    uint32_t controlMessages;
+    uint32_t controlDecryptFailures;
+    uint32_t idrRequests;
+    uint32_t refInvalidationRequests;
+    uint32_t lossStatsMessages;
+    uint32_t inputMessages;
+    bool terminationSent;
+} HOST_SIMULATOR_STATS, *PHOST_SIMULATOR_STATS;
+
+typedef struct _SENT_FRAME {
+    uint32_t frameNumber;
+    bool idrFrame;
+    uint64_t hash;
+} SENT_FRAME, *PSENT_FRAME;
+
+// A controller or relative mouse packet received on the control stream. Only the
+// fields a client can use to tell its events apart are kept.
+typedef struct _RECEIVED_INPUT {
+    uint64_t receiveTimeUs;
+    uint32_t magic;
+    short controllerNumber;
+    short leftStickX;
+    short deltaX;
+    short deltaY;
+} RECEIVED_INPUT, *PRECEIVED_INPUT;
+
+typedef struct _PENDING_AUDIO_PACKET {
+    uint64_t sendTimeUs;
+    int length;
+    char data[RTPA_MAX_PACKET_SIZE];
+} PENDING_AUDIO_PACKET, *PPENDING_AUDIO_PACKET;
+
+// Enough for the audio of a frame at the lowest frame rate plus the largest jitter
+#define HS_MAX_PENDING_AUDIO_PACKETS 512
+
+typedef struct _HOST_SIMULATOR {
+    HOST_SIMULATOR_CONFIG config;
+    HOST_SIMULATOR_STATS stats;
+
+    // Hashes of the Annex B data of every frame sent
+    PSENT_FRAME sentFrames;
+
+    uint16_t rtspPort;
+    uint16_t videoPort;
+    uint16_t audioPort;
+    uint16_t controlPort;
+
+    SOCKET rtspSocket;
+    SOCKET videoSocket;
+    SOCKET audioSocket;
+    ENetHost* enetHost;
+    ENetPeer* controlPeer;
+
+    PLT_THREAD rtspThread;
+    PLT_THREAD controlThread;
+    PLT_THREAD streamThread;
+    bool threadsStarted;
+
+    // Stream parameters from the client's ANNOUNCE. They are written by the RTSP
+    // thread before playing is set and only read by other threads after that.
+    int packetSize;
+    int fps;
+    int audioPacketDuration;
+    uint32_t encryptionEnabled;
+
+    PLT_ATOMIC_INT playing;
+    PLT_ATOMIC_INT idrFrameRequested;
+    PLT_ATOMIC_INT streamFinished;
+
+    // Used by the stream thread
+    SYNTHETIC_STREAM stream;
+    struct sockaddr_storage videoClientAddr;
+    struct sockaddr_storage audioClientAddr;
+    SOCKADDR_LEN videoClientAddrLen;
+    SOCKADDR_LEN audioClientAddrLen;
+    uint32_t currentFrameNumber;
+    uint64_t videoIvCounter;
+    uint32_t lossRandomState;
+    uint32_t jitterRandomState;
+    uint64_t streamStartUs;
+    char* encryptedPacket;
+    PPLT_CRYPTO_CONTEXT videoCryptoContext;
+
+    // Audio packets waiting for their send time on the host's audio clock, in order
+    PPENDING_AUDIO_PACKET pendingAudio;
+    int pendingAudioHead;
+    int pendingAudioCount;
+    uint64_t lastAudioSendTimeUs;
+
+    // Used by the control thread. The received input remains valid until HsCleanupHost().
+    PRECEIVED_INPUT receivedInput;
+    int receivedInputCount;
+    int receivedInputCapacity;
+    uint32_t controlSequenceNumber;
+    PPLT_CRYPTO_CONTEXT controlEncryptionContext;
+    PPLT_CRYPTO_CONTEXT controlDecryptionContext;
+} HOST_SIMULATOR, *PHOST_SIMULATOR;
+
+void HsInitializeConfig(PHOST_SIMULATOR_CONFIG config);
+
+// Starts listening for RTSP on an ephemeral loopback port, which is stored in host->rtspPort
+int HsStartHost(PHOST_SIMULATOR host, PHOST_SIMULATOR_CONFIG config);
+
+// Stops all threads. The stats and sent frames remain valid until HsCleanupHost(). The host
+// threads are counted as platform threads, so this must be called before LiStopConnection().
+void HsStopHost(PHOST_SIMULATOR host);
+void HsCleanupHost(PHOST_SIMULATOR host);
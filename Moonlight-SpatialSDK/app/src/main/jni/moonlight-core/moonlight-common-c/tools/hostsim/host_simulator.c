@@ -0,0 +1,632 @@
+// Runs a complete streaming session against the simulated host on the loopback interface.
+// LiStartConnection() goes through the RTSP handshake, the ENet control stream and the video
+// and audio streams exactly like it would with a real host. The decoded frames are checked
+// against the frames the host sent and the session must end with the host's graceful
+// termination.
+//
+// Usage: host_simulator [options]
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostSimulator.h"
+#include "PacketCapture.h"
+
+// Time allowed for the connection to start and stop on top of the stream duration
+#define SESSION_TIMEOUT_MARGIN_MS 20000
+
+// Drift corrections beyond what the clock drift needs, such as the ones that follow
+// changes in the measured jitter, and how far the audio latency may be from the target
+#define JITTER_BUFFER_CORRECTION_SLACK 10
+#define JITTER_BUFFER_LATENCY_TOLERANCE_MS 20
+
+// Input is sent from two controllers and the mouse. Each event is numbered by its
+// left stick X value or by the mouse's total movement, so it has to fit in a short.
+#define INPUT_CONTROLLERS 2
+#define INPUT_DEVICES (INPUT_CONTROLLERS + 1)
+#define MAX_INPUT_EVENTS 32767
+
+typedef struct _DECODED_FRAME {
+    uint32_t frameNumber;
+    bool idrFrame;
+    uint64_t hash;
+} DECODED_FRAME, *PDECODED_FRAME;
+
+typedef struct _CLIENT_OPTIONS {
+    int fps;
+    int packetSize;
+    bool encryptVideo;
+    bool pipelinedDecryption;
+    bool verbose;
+    const char* capturePath;
+    int jitterBufferMinMs;
+    int jitterBufferMaxMs;
+    int inputRate;
+} CLIENT_OPTIONS, *PCLIENT_OPTIONS;
+
+static bool verbose;
+
+// Written by the video receive thread, which calls submitDecodeUnit directly
+static PDECODED_FRAME decodedFrames;
+static int decodedFrameCount;
+static int decodedFrameCapacity;
+static char* frameScratch;
+static int frameScratchSize;
+
+// Written by the audio receive thread
+static uint32_t audioSamples;
+static uint32_t concealedAudioSamples;
+
+// LiStartConnection() nudges the mouse back and forth to wake up the host, so input is
+// only sent once those moves are out of the way. It stops a little before the stream ends,
+// so the last events are sent before the host terminates the session.
+#define INPUT_START_DELAY_MS 100
+#define INPUT_STOP_MARGIN_MS 200
+
+// The 99th percentile input latency has to stay within a few batching intervals
+#define INPUT_LATENCY_LIMIT_US 20000
+
+// Written by the main thread. The enqueue times are indexed by event number and device.
+static uint64_t inputEnqueueUs[MAX_INPUT_EVENTS + 1][INPUT_DEVICES];
+static int inputEventCount;
+
+static PLT_ATOMIC_INT connectionTerminated;
+static PLT_ATOMIC_INT terminationErrorCode;
+
+static int clientSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
+    PDECODED_FRAME frame;
+    PLENTRY entry;
+    int length;
+
+    if (decodeUnit->fullLength > frameScratchSize) {
+        char* newScratch = realloc(frameScratch, decodeUnit->fullLength);
+        if (newScratch == NULL) {
+            return DR_NEED_IDR;
+        }
+
+        frameScratch = newScratch;
+        frameScratchSize = decodeUnit->fullLength;
+    }
+
+    if (decodedFrameCount == decodedFrameCapacity) {
+        int newCapacity = decodedFrameCapacity ? decodedFrameCapacity * 2 : 1024;
+        PDECODED_FRAME newFrames = realloc(decodedFrames, sizeof(*decodedFrames) * newCapacity);
+        if (newFrames == NULL) {
+            return DR_NEED_IDR;
+        }
+
+        decodedFrames = newFrames;
+        decodedFrameCapacity = newCapacity;
+    }
+
+    length = 0;
+    for (entry = decodeUnit->bufferList; entry != NULL; entry = entry->next) {
+        memcpy(&frameScratch[length], entry->data, entry->length);
+        length += entry->length;
+    }
+
+    frame = &decodedFrames[decodedFrameCount++];
+    frame->frameNumber = (uint32_t)decodeUnit->frameNumber;
+    frame->idrFrame = decodeUnit->frameType == FRAME_TYPE_IDR;
+    frame->hash = SynHashFrameData(frameScratch, length);
+
+    return DR_OK;
+}
+
+static void clientDecodeAndPlaySample(char* sampleData, int sampleLength) {
+    if (sampleData == NULL) {
+        concealedAudioSamples++;
+    }
+    else {
+        audioSamples++;
+    }
+}
+
+static void clientConnectionTerminated(int errorCode) {
+    PltAtomicStore(&terminationErrorCode, errorCode);
+    PltAtomicStore(&connectionTerminated, 1);
+}
+
+static void clientStageFailed(int stage, int errorCode) {
+    fprintf(stderr, "Stage %s failed: %d\n", LiGetStageName(stage), errorCode);
+}
+
+static void clientLogMessage(const char* format, ...) {
+    va_list va;
+
+    if (!verbose) {
+        return;
+    }
+
+    va_start(va, format);
+    vfprintf(stderr, format, va);
+    va_end(va);
+}
+
+static int compareSentFrames(const void* a, const void* b) {
+    uint32_t frameA = ((const SENT_FRAME*)a)->frameNumber;
+    uint32_t frameB = ((const SENT_FRAME*)b)->frameNumber;
+
+    return frameA < frameB ? -1 : (frameA > frameB ? 1 : 0);
+}
+
+// Every decoded frame must be identical to the frame the host sent with that number
+static int verifyFrames(PHOST_SIMULATOR host) {
+    int mismatches = 0;
+    int i;
+
+    for (i = 0; i < decodedFrameCount; i++) {
+        SENT_FRAME key;
+        PSENT_FRAME sent;
+
+        key.frameNumber = decodedFrames[i].frameNumber;
+        sent = bsearch(&key, host->sentFrames, host->stats.framesSent, sizeof(*host->sentFrames), compareSentFrames);
+        if (sent == NULL) {
+            printf("Verify: frame %u was never sent\n", decodedFrames[i].frameNumber);
+            mismatches++;
+        }
+        else if (sent->hash != decodedFrames[i].hash || sent->idrFrame != decodedFrames[i].idrFrame) {
+            printf("Verify: frame %u differs from the frame that was sent\n", decodedFrames[i].frameNumber);
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+// Late audio has to stay rare, the queue must never overflow, the latency has to stay near
+// the target and the drift corrections have to make up for most of the difference between
+// the host's and the client's audio clocks
+static int verifyJitterBuffer(PHOST_SIMULATOR_CONFIG hostConfig, PAUDIO_JITTER_BUFFER_STATS stats) {
+    int expectedCorrections = (int)(hostConfig->audioClockDriftPercent * audioSamples / 100);
+    int corrections = (int)stats->framesDropped - (int)stats->framesInserted;
+    int failures = 0;
+
+    // A host that is behind the client needs concealed packets inserted instead
+    if (expectedCorrections < 0) {
+        expectedCorrections = -expectedCorrections;
+        corrections = -corrections;
+    }
+
+    if (stats->lateFrames > audioSamples / 100 + 2) {
+        printf("Verify: %u of %u audio packets were late\n", stats->lateFrames, audioSamples);
+        failures++;
+    }
+    if (stats->restarts != 0) {
+        printf("Verify: audio playout restarted %u times\n", stats->restarts);
+        failures++;
+    }
+    if (stats->queueOverflows != 0) {
+        printf("Verify: the audio packet queue overflowed %u times\n", stats->queueOverflows);
+        failures++;
+    }
+    if ((expectedCorrections != 0 && corrections < expectedCorrections / 2) ||
+            corrections < -JITTER_BUFFER_CORRECTION_SLACK ||
+            corrections > expectedCorrections + JITTER_BUFFER_CORRECTION_SLACK) {
+        printf("Verify: %d drift corrections for about %d packets of drift\n", corrections, expectedCorrections);
+        failures++;
+    }
+    if (stats->currentLatencyMs < stats->targetLatencyMs - JITTER_BUFFER_LATENCY_TOLERANCE_MS ||
+            stats->currentLatencyMs > stats->targetLatencyMs + JITTER_BUFFER_LATENCY_TOLERANCE_MS) {
+        printf("Verify: audio latency of %d ms for a target of %d ms\n", stats->currentLatencyMs, stats->targetLatencyMs);
+        failures++;
+    }
+
+    return failures;
+}
+
+// Queues the next event of each input device
+static void sendInputEvents(void) {
+    short eventNumber = (short)++inputEventCount;
+    int i;
+
+    for (i = 0; i < INPUT_CONTROLLERS; i++) {
+        inputEnqueueUs[eventNumber][i] = PltGetMicros();
+        LiSendMultiControllerEvent((short)i, (1 << INPUT_CONTROLLERS) - 1, 0, 0, 0, eventNumber, 0, 0, 0);
+    }
+
+    inputEnqueueUs[eventNumber][INPUT_CONTROLLERS] = PltGetMicros();
+    LiSendMouseMoveEvent(1, 0);
+}
+
+static int compareLatencies(const void* a, const void* b) {
+    uint32_t latencyA = *(const uint32_t*)a;
+    uint32_t latencyB = *(const uint32_t*)b;
+
+    return latencyA < latencyB ? -1 : (latencyA > latencyB ? 1 : 0);
+}
+
+// Prints the latency percentiles and returns the 99th percentile
+static uint32_t printLatencies(const char* device, uint32_t* latencies, int count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    qsort(latencies, count, sizeof(*latencies), compareLatencies);
+    printf("Client: %s enqueue to host (us): p50 %u p99 %u max %u over %d packets\n", device,
+           latencies[count / 2], latencies[count * 99 / 100], latencies[count - 1], count);
+    return latencies[count * 99 / 100];
+}
+
+// Matches the input the host received to the events the client queued. Controller packets
+// carry their newest event, and relative mouse packets add up to the events they include.
+// Every event has to arrive, in order.
+static int verifyInput(PHOST_SIMULATOR host) {
+    uint32_t* latencies[INPUT_DEVICES];
+    int latencyCounts[INPUT_DEVICES];
+    int lastEvents[INPUT_DEVICES];
+    int failures = 0;
+    int i;
+
+    for (i = 0; i < INPUT_DEVICES; i++) {
+        latencies[i] = malloc(sizeof(*latencies[i]) * (host->receivedInputCount + 1));
+        latencyCounts[i] = 0;
+        lastEvents[i] = 0;
+    }
+
+    for (i = 0; i < host->receivedInputCount; i++) {
+        PRECEIVED_INPUT input = &host->receivedInput[i];
+        int device, event;
+
+        if (input->magic == MOUSE_MOVE_REL_MAGIC || input->magic == MOUSE_MOVE_REL_MAGIC_GEN5) {
+            // Our mouse moves are horizontal, unlike the ones from LiStartConnection()
+            if (input->deltaY != 0) {
+                continue;
+            }
+
+            device = INPUT_CONTROLLERS;
+            event = lastEvents[device] + input->deltaX;
+        }
+        else {
+            device = input->controllerNumber;
+            event = input->leftStickX;
+        }
+
+        if (device < 0 || device >= INPUT_DEVICES || event < lastEvents[device] || event > inputEventCount) {
+            printf("Verify: unexpected input packet %d (device %d, event %d)\n", i, device, event);
+            failures++;
+            continue;
+        }
+
+        lastEvents[device] = event;
+        if (latencies[device] != NULL && event != 0) {
+            latencies[device][latencyCounts[device]++] = (uint32_t)(input->receiveTimeUs - inputEnqueueUs[event][device]);
+        }
+    }
+
+    for (i = 0; i < INPUT_DEVICES; i++) {
+        char name[32];
+
+        if (i < INPUT_CONTROLLERS) {
+            snprintf(name, sizeof(name), "controller %d", i);
+        }
+        else {
+            snprintf(name, sizeof(name), "mouse");
+        }
+
+        if (printLatencies(name, latencies[i], latencyCounts[i]) > INPUT_LATENCY_LIMIT_US) {
+            printf("Verify: %s input took more than %d us\n", name, INPUT_LATENCY_LIMIT_US);
+            failures++;
+        }
+
+        if (lastEvents[i] != inputEventCount) {
+            printf("Verify: device %d got %d of %d input events\n", i, lastEvents[i], inputEventCount);
+            failures++;
+        }
+
+        free(latencies[i]);
+    }
+
+    return failures;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: host_simulator [options]\n"
+            "\n"
+            "  --frames <n>              Frames the host sends before terminating (default 300)\n"
+            "  --fps <n>                 Frame rate the client asks for (default 60)\n"
+            "  --packet-size <bytes>     Video packet size the client asks for (default 1392)\n"
+            "  --encrypt                 Encrypt the video stream\n"
+            "  --pipelined               Decrypt video on a separate thread\n"
+            "  --loss <percent>          Drop video packets on the host\n"
+            "  --fec <percent>           Video FEC percentage\n"
+            "  --frame-size <min>:<max>  Annex B bytes per P-frame\n"
+            "  --idr-interval <frames>   Frames between IDR frames\n"
+            "  --seed <n>                Seed for the stream contents and the packet loss\n"
+            "  --audio-jitter <ms>       Delay each audio packet on the host by up to this much\n"
+            "  --audio-drift <percent>   Run the host's audio clock faster or slower than the client's\n"
+            "  --jitter-buffer <ms>:<ms> Play audio through the jitter buffer with this latency range\n"
+            "  --input-rate <hz>         Send input from two controllers and the mouse at this rate\n"
+            "  --capture <file>          Capture the received packets for capture_replay\n"
+            "  --verbose                 Print the library log\n");
+}
+
+static int parseOptions(int argc, char** argv, PHOST_SIMULATOR_CONFIG hostConfig, PCLIENT_OPTIONS options) {
+    int i;
+
+    HsInitializeConfig(hostConfig);
+    memset(options, 0, sizeof(*options));
+    options->fps = 60;
+    options->packetSize = 1392;
+
+    for (i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(arg, "--encrypt")) {
+            options->encryptVideo = true;
+            continue;
+        }
+        else if (!strcmp(arg, "--pipelined")) {
+            options->pipelinedDecryption = true;
+            continue;
+        }
+        else if (!strcmp(arg, "--verbose")) {
+            options->verbose = true;
+            continue;
+        }
+
+        // Everything else takes a value
+        if (value == NULL) {
+            return -1;
+        }
+        i++;
+
+        if (!strcmp(arg, "--frames")) {
+            hostConfig->frameCount = atoi(value);
+        }
+        else if (!strcmp(arg, "--fps")) {
+            options->fps = atoi(value);
+        }
+        else if (!strcmp(arg, "--packet-size")) {
+            options->packetSize = atoi(value);
+        }
+        else if (!strcmp(arg, "--loss")) {
+            hostConfig->videoLossPercent = atof(value);
+        }
+        else if (!strcmp(arg, "--fec")) {
+            hostConfig->stream.fecPercentage = atoi(value);
+        }
+        else if (!strcmp(arg, "--frame-size")) {
+            if (sscanf(value, "%d:%d", &hostConfig->stream.minFrameSize, &hostConfig->stream.maxFrameSize) != 2) {
+                return -1;
+            }
+        }
+        else if (!strcmp(arg, "--idr-interval")) {
+            hostConfig->stream.idrInterval = atoi(value);
+        }
+        else if (!strcmp(arg, "--seed")) {
+            hostConfig->stream.seed = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (!strcmp(arg, "--audio-jitter")) {
+            hostConfig->audioJitterMs = atoi(value);
+        }
+        else if (!strcmp(arg, "--audio-drift")) {
+            hostConfig->audioClockDriftPercent = atof(value);
+        }
+        else if (!strcmp(arg, "--jitter-buffer")) {
+            if (sscanf(value, "%d:%d", &options->jitterBufferMinMs, &options->jitterBufferMaxMs) != 2 ||
+                    options->jitterBufferMaxMs <= 0) {
+                return -1;
+            }
+        }
+        else if (!strcmp(arg, "--input-rate")) {
+            options->inputRate = atoi(value);
+        }
+        else if (!strcmp(arg, "--capture")) {
+            options->capturePath = value;
+        }
+        else {
+            return -1;
+        }
+    }
+
+    // Encrypted packets have to stay a multiple of the AES block size
+    if (hostConfig->frameCount <= 0 || options->fps <= 0 || options->inputRate < 0 ||
+            options->packetSize <= 0 || options->packetSize % 16 != 0) {
+        return -1;
+    }
+
+    hostConfig->videoEncryptionSupported = options->encryptVideo;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    HOST_SIMULATOR_CONFIG hostConfig;
+    CLIENT_OPTIONS options;
+    HOST_SIMULATOR host;
+    SERVER_INFORMATION serverInfo;
+    STREAM_CONFIGURATION streamConfig;
+    DECODER_RENDERER_CALLBACKS drCallbacks;
+    AUDIO_RENDERER_CALLBACKS arCallbacks;
+    CONNECTION_LISTENER_CALLBACKS clCallbacks;
+    CAPTURE_WRITER captureWriter;
+    VIDEO_DECRYPT_STATS decryptStats;
+    FRAME_TRACE_STATS traceStats;
+    AUDIO_JITTER_BUFFER_STATS jitterStats;
+    bool haveDecryptStats;
+    bool haveJitterStats;
+    char rtspSessionUrl[64];
+    uint64_t startMs, timeoutMs;
+    uint64_t nextInputUs, inputEndUs;
+    int mismatches;
+    int inputFailures;
+    int err;
+    int i;
+
+    if (parseOptions(argc, argv, &hostConfig, &options) != 0) {
+        usage();
+        return 2;
+    }
+
+    verbose = options.verbose;
+
+    // The host and client share the remote input key like they would after pairing
+    for (i = 0; i < (int)sizeof(hostConfig.aesKey); i++) {
+        hostConfig.aesKey[i] = (char)(0x10 + i);
+    }
+
+    err = HsStartHost(&host, &hostConfig);
+    if (err != 0) {
+        fprintf(stderr, "Failed to start the host simulator: %d\n", err);
+        return 1;
+    }
+
+    if (options.capturePath != NULL) {
+        if (CapOpenWriter(&captureWriter, options.capturePath) != 0) {
+            fprintf(stderr, "Unable to create %s\n", options.capturePath);
+            HsStopHost(&host);
+            HsCleanupHost(&host);
+            return 1;
+        }
+
+        LiSetPacketCaptureCallback(CapPacketCaptureCallback, &captureWriter);
+    }
+
+    LiInitializeServerInformation(&serverInfo);
+    snprintf(rtspSessionUrl, sizeof(rtspSessionUrl), "rtsp://127.0.0.1:%u", host.rtspPort);
+    serverInfo.address = "127.0.0.1";
+    serverInfo.serverInfoAppVersion = HOST_SIMULATOR_APP_VERSION;
+    serverInfo.serverInfoGfeVersion = HOST_SIMULATOR_GFE_VERSION;
+    serverInfo.rtspSessionUrl = rtspSessionUrl;
+    serverInfo.serverCodecModeSupport = SCM_H264;
+
+    LiInitializeStreamConfiguration(&streamConfig);
+    streamConfig.width = 1920;
+    streamConfig.height = 1080;
+    streamConfig.fps = options.fps;
+    streamConfig.bitrate = 20000;
+    streamConfig.packetSize = options.packetSize;
+    streamConfig.streamingRemotely = STREAM_CFG_LOCAL;
+    streamConfig.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+    streamConfig.supportedVideoFormats = VIDEO_FORMAT_H264;
+    streamConfig.encryptionFlags = options.encryptVideo ? ENCFLG_VIDEO : ENCFLG_NONE;
+    memcpy(streamConfig.remoteInputAesKey, hostConfig.aesKey, sizeof(streamConfig.remoteInputAesKey));
+    memset(streamConfig.remoteInputAesIv, 0, sizeof(streamConfig.remoteInputAesIv));
+
+    LiInitializeVideoCallbacks(&drCallbacks);
+    drCallbacks.submitDecodeUnit = clientSubmitDecodeUnit;
+    drCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+
+    LiInitializeAudioCallbacks(&arCallbacks);
+    arCallbacks.decodeAndPlaySample = clientDecodeAndPlaySample;
+
+    // The jitter buffer runs on the decoder thread, so it needs a renderer without direct submit
+    if (options.jitterBufferMaxMs > 0) {
+        LiSetAudioJitterBufferLatency(options.jitterBufferMinMs, options.jitterBufferMaxMs);
+    }
+    else {
+        arCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+    }
+
+    LiInitializeConnectionCallbacks(&clCallbacks);
+    clCallbacks.stageFailed = clientStageFailed;
+    clCallbacks.connectionTerminated = clientConnectionTerminated;
+    clCallbacks.logMessage = clientLogMessage;
+
+    LiSetPipelinedVideoDecryption(options.pipelinedDecryption);
+
+    startMs = PltGetMillis();
+    err = LiStartConnection(&serverInfo, &streamConfig, &clCallbacks, &drCallbacks, &arCallbacks,
+                            NULL, 0, NULL, 0);
+    if (err != 0) {
+        fprintf(stderr, "LiStartConnection() failed: %d\n", err);
+        HsStopHost(&host);
+        HsCleanupHost(&host);
+        return 1;
+    }
+
+    printf("Connection started in %llu ms\n", (unsigned long long)(PltGetMillis() - startMs));
+
+    // Stream until the host terminates the session
+    timeoutMs = (uint64_t)hostConfig.frameCount * 1000 / options.fps + SESSION_TIMEOUT_MARGIN_MS;
+    nextInputUs = PltGetMicros() + INPUT_START_DELAY_MS * 1000;
+    inputEndUs = PltGetMicros() + ((uint64_t)hostConfig.frameCount * 1000 / options.fps - INPUT_STOP_MARGIN_MS) * 1000;
+    while (!PltAtomicLoad(&connectionTerminated) && PltGetMillis() - startMs < timeoutMs) {
+        if (options.inputRate == 0 || PltGetMicros() >= inputEndUs || PltAtomicLoad(&host.streamFinished)) {
+            PltSleepMs(10);
+            continue;
+        }
+
+        while (PltGetMicros() >= nextInputUs && inputEventCount < MAX_INPUT_EVENTS) {
+            sendInputEvents();
+            nextInputUs += 1000000 / options.inputRate;
+        }
+        PltSleepMs(1);
+    }
+
+    // The decrypt ring is gone once the connection is stopped
+    haveDecryptStats = LiGetVideoDecryptStats(&decryptStats);
+    haveJitterStats = LiGetAudioJitterBufferStats(&jitterStats);
+
+    // The host threads are platform threads too, so they have to be gone before
+    // LiStopConnection() checks that every thread has exited
+    HsStopHost(&host);
+    LiStopConnection();
+
+    if (options.capturePath != NULL) {
+        LiSetPacketCaptureCallback(NULL, NULL);
+        if (CapCloseWriter(&captureWriter) != 0) {
+            fprintf(stderr, "Failed to write %s\n", options.capturePath);
+        }
+    }
+
+    printf("Host: %u RTSP requests, %u frames sent (%u IDR), %u video packets sent%s, %u dropped, %u audio packets sent\n",
+           host.stats.rtspRequests, host.stats.framesSent, host.stats.idrFramesSent,
+           host.stats.videoPacketsSent, host.stats.videoEncrypted ? " encrypted" : "",
+           host.stats.videoPacketsDropped, host.stats.audioPacketsSent);
+    printf("Host: %u control messages (%u undecryptable), %u IDR requests, %u RFI requests, %u loss stats, %u input\n",
+           host.stats.controlMessages, host.stats.controlDecryptFailures, host.stats.idrRequests,
+           host.stats.refInvalidationRequests, host.stats.lossStatsMessages, host.stats.inputMessages);
+    printf("Client: %d frames decoded, %u audio packets decoded, %u concealed\n",
+           decodedFrameCount, audioSamples, concealedAudioSamples);
+
+    if (LiGetFrameTraceStats(&traceStats)) {
+        printf("Client: first packet to submitted (us): p50 %u p99 %u over the last %u frames\n",
+               traceStats.totalP50Us[FRAME_TRACE_SUBMITTED], traceStats.totalP99Us[FRAME_TRACE_SUBMITTED],
+               traceStats.frameCount[FRAME_TRACE_SUBMITTED]);
+    }
+    if (haveDecryptStats) {
+        printf("Client: decrypt ring of %d, %llu packets queued, depth max %u average %u, %llu full waits\n",
+               decryptStats.ringSize, (unsigned long long)decryptStats.packetsQueued,
+               decryptStats.maxDepth, decryptStats.averageDepth, (unsigned long long)decryptStats.fullWaits);
+    }
+
+    if (haveJitterStats) {
+        printf("Client: audio jitter buffer at %d ms for a target of %d ms, %d us arrival jitter\n",
+               jitterStats.currentLatencyMs, jitterStats.targetLatencyMs, jitterStats.arrivalJitterUs);
+        printf("Client: %u audio packets dropped and %u inserted for drift, %u late, %u restarts, %u queue overflows\n",
+               jitterStats.framesDropped, jitterStats.framesInserted, jitterStats.lateFrames, jitterStats.restarts,
+               jitterStats.queueOverflows);
+    }
+
+    inputFailures = options.inputRate > 0 ? verifyInput(&host) : 0;
+
+    mismatches = verifyFrames(&host);
+    printf("Verify: %d of %d decoded frames match, %u frames lost\n",
+           decodedFrameCount - mismatches, decodedFrameCount, host.stats.framesSent - decodedFrameCount);
+
+    err = 0;
+    if (!PltAtomicLoad(&connectionTerminated)) {
+        printf("The host never terminated the session\n");
+        err = 1;
+    }
+    else if (PltAtomicLoad(&terminationErrorCode) != ML_ERROR_GRACEFUL_TERMINATION) {
+        printf("The session terminated with error %d\n", (int)PltAtomicLoad(&terminationErrorCode));
+        err = 1;
+    }
+    if (decodedFrameCount == 0 || mismatches != 0 || inputFailures != 0 || host.stats.controlDecryptFailures != 0) {
+        err = 1;
+    }
+    if (options.jitterBufferMaxMs > 0 && (!haveJitterStats || verifyJitterBuffer(&hostConfig, &jitterStats) != 0)) {
+        err = 1;
+    }
+
+    HsCleanupHost(&host);
+    free(decodedFrames);
+    free(frameScratch);
+    return err;
+}
@@ -0,0 +1,996 @@
+// Replays a packet capture through the video and audio RTP queues, FEC recovery and the
+// depacketizer, without a host or a decoder. Packet loss, reordering, duplication and the
+// packet timing can be varied to reproduce network conditions offline, and frames can be
+// pulled from the decode unit queue by a simulated slow decoder. Each decode unit
+// is hashed, so runs can be compared, and the time spent on each packet and in each stage
+// of the frame trace is reported.
+//
+// Usage: capture_replay [options] <capture file>
+//        capture_replay [options] --synthetic <frames>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PacketCapture.h"
+#include "SyntheticStream.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// Default number of packets that a reordered packet may be delayed by
+#define DEFAULT_REORDER_DEPTH 8
+
+// Frames between stalls of the simulated decoder
+#define DECODER_STALL_INTERVAL 60
+
+typedef struct _REPLAY_PACKET {
+    int stream;
+    int length;
+    uint64_t timeUs;
+    char* data;
+} REPLAY_PACKET, *PREPLAY_PACKET;
+
+typedef struct _SCHEDULED_PACKET {
+    int packetIndex;
+    uint64_t timeUs;
+} SCHEDULED_PACKET, *PSCHEDULED_PACKET;
+
+typedef struct _DECODED_FRAME {
+    uint32_t frameNumber;
+    int frameType;
+    int length;
+    uint64_t hash;
+} DECODED_FRAME, *PDECODED_FRAME;
+
+typedef struct _REPLAY_OPTIONS {
+    double lossPercent;
+    double reorderPercent;
+    double duplicatePercent;
+    int reorderDepth;
+
+    // 0 replays as fast as possible, otherwise the capture timing is sped up by this factor
+    double timingScale;
+
+    uint32_t seed;
+    bool verify;
+    bool printFrames;
+
+    // Contiguous decode units for the replay under test. The clean replay
+    // always gets chained ones, so --verify compares the two layouts.
+    bool contiguous;
+
+    // FEC validation mode for builds that have it compiled in, or -1 to keep the default
+    int fecValidation;
+
+    // FEC recovery pool threads, or -1 to keep the default
+    int recoveryThreads;
+
+    // If decodeTimeUs is set, the replay under test pulls frames from the decode unit
+    // queue into a simulated decoder that takes this long per frame in capture time,
+    // plus a stall every DECODER_STALL_INTERVAL frames
+    uint32_t decodeTimeUs;
+    uint32_t decoderStallUs;
+    int frameAgeLimitMs;
+
+    const char* inputPath;
+    const char* writePath;
+    int syntheticFrames;
+    SYNTHETIC_STREAM_CONFIG synthetic;
+} REPLAY_OPTIONS, *PREPLAY_OPTIONS;
+
+typedef struct _REPLAY_RESULT {
+    PDECODED_FRAME frames;
+    int frameCount;
+    int frameCapacity;
+    int idrFrames;
+    uint64_t videoBytes;
+    uint64_t videoDigest;
+    uint64_t bufferEntries;
+    int layoutErrors;
+
+    uint32_t audioPackets;
+    uint32_t concealedAudioPackets;
+    uint64_t audioDigest;
+
+    uint32_t* videoPacketUs;
+    uint32_t* audioPacketUs;
+    int videoPacketsFed;
+    int audioPacketsFed;
+    uint64_t elapsedUs;
+
+    bool haveTraceStats;
+    FRAME_TRACE_STATS traceStats;
+
+    bool haveQueueStats;
+    VIDEO_QUEUE_STATS queueStats;
+} REPLAY_RESULT, *PREPLAY_RESULT;
+
+static PREPLAY_PACKET packets;
+static int packetCount;
+static int packetCapacity;
+static CAPTURE_FILE_INFO captureInfo;
+
+// Decode units and audio samples are recorded here by the renderer callbacks
+static PREPLAY_RESULT currentResult;
+static char* frameScratch;
+static int frameScratchSize;
+
+static uint32_t randomState;
+
+// Hash of the Annex B data of each synthetic frame, indexed by frame number - 1
+static uint64_t* syntheticFrameHashes;
+static int syntheticFrameCount;
+
+static uint32_t nextRandom(void) {
+    uint32_t x = randomState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    randomState = x;
+    return x;
+}
+
+static bool randomChance(double percent) {
+    return percent > 0 && (nextRandom() % 1000000) < (uint32_t)(percent * 10000);
+}
+
+static uint64_t hashData(uint64_t hash, const void* data, int length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    int i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static bool addPacket(int stream, uint64_t timeUs, const void* data, int length) {
+    if (packetCount == packetCapacity) {
+        int newCapacity = packetCapacity ? packetCapacity * 2 : 4096;
+        PREPLAY_PACKET newPackets = realloc(packets, sizeof(*packets) * newCapacity);
+        if (newPackets == NULL) {
+            return false;
+        }
+
+        packets = newPackets;
+        packetCapacity = newCapacity;
+    }
+
+    packets[packetCount].data = malloc(length);
+    if (packets[packetCount].data == NULL) {
+        return false;
+    }
+
+    memcpy(packets[packetCount].data, data, length);
+    packets[packetCount].stream = stream;
+    packets[packetCount].length = length;
+    packets[packetCount].timeUs = timeUs;
+    packetCount++;
+    return true;
+}
+
+static void addSyntheticPacket(int stream, uint64_t timeUs, const void* packet, int length, void* context) {
+    if (!addPacket(stream, timeUs, packet, length)) {
+        *(bool*)context = false;
+    }
+}
+
+static int loadSyntheticStream(PREPLAY_OPTIONS options) {
+    SYNTHETIC_STREAM stream;
+    bool ok = true;
+    int i;
+
+    if (SynInitializeStream(&stream, &options->synthetic) != 0) {
+        fprintf(stderr, "Invalid synthetic stream configuration\n");
+        return -1;
+    }
+
+    syntheticFrameHashes = malloc(sizeof(*syntheticFrameHashes) * options->syntheticFrames);
+    if (syntheticFrameHashes == NULL) {
+        SynCleanupStream(&stream);
+        return -1;
+    }
+
+    for (i = 0; i < options->syntheticFrames && ok; i++) {
+        uint32_t frameNumber = SynGenerateVideoFrame(&stream, addSyntheticPacket, &ok);
+        const char* annexB;
+        int annexBLength;
+
+        annexB = SynGetFrameAnnexB(&stream, &annexBLength);
+        syntheticFrameHashes[i] = SynHashFrameData(annexB, annexBLength);
+        syntheticFrameCount++;
+
+        // Interleave the audio that would have been sent along with this frame
+        SynGenerateAudio(&stream, SynGetFrameTimeUs(&stream, frameNumber + 1), addSyntheticPacket, &ok);
+    }
+
+    SynCleanupStream(&stream);
+
+    if (!ok) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    // Sunshine 7.1.431 with multi-FEC, which is the layout the generator uses
+    memset(&captureInfo, 0, sizeof(captureInfo));
+    captureInfo.appVersionQuad[0] = 7;
+    captureInfo.appVersionQuad[1] = 1;
+    captureInfo.appVersionQuad[2] = options->synthetic.multiFec ? 431 : 415;
+    captureInfo.appVersionQuad[3] = -1;
+    captureInfo.videoFormat = options->synthetic.videoFormat;
+    captureInfo.width = 1920;
+    captureInfo.height = 1080;
+    captureInfo.fps = options->synthetic.fps;
+    captureInfo.packetSize = options->synthetic.packetSize;
+    captureInfo.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+    captureInfo.audioPacketDuration = options->synthetic.audioPacketDuration;
+    return 0;
+}
+
+static int loadCaptureFile(const char* path) {
+    CAPTURE_READER reader;
+    char* buffer;
+    uint64_t timeUs;
+    int stream;
+    int length;
+
+    if (CapOpenReader(&reader, path) != 0) {
+        fprintf(stderr, "%s is not a readable capture file\n", path);
+        return -1;
+    }
+
+    captureInfo = reader.info;
+
+    buffer = malloc(CAPTURE_MAX_PACKET_SIZE);
+    if (buffer == NULL) {
+        CapCloseReader(&reader);
+        return -1;
+    }
+
+    while ((length = CapReadPacket(&reader, &stream, &timeUs, buffer)) > 0) {
+        if (!addPacket(stream, timeUs, buffer, length)) {
+            length = -1;
+            break;
+        }
+    }
+
+    free(buffer);
+    CapCloseReader(&reader);
+
+    if (length < 0) {
+        fprintf(stderr, "%s is truncated or corrupt\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int writeCaptureFile(const char* path) {
+    CAPTURE_WRITER writer;
+    int i;
+
+    if (CapOpenWriter(&writer, path) != 0) {
+        fprintf(stderr, "Unable to create %s\n", path);
+        return -1;
+    }
+
+    CapWriteInfo(&writer, &captureInfo);
+    for (i = 0; i < packetCount; i++) {
+        CapWritePacket(&writer, packets[i].stream, packets[i].timeUs, packets[i].data, packets[i].length);
+    }
+
+    if (CapCloseWriter(&writer) != 0) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static PDECODED_FRAME addDecodedFrame(PREPLAY_RESULT result) {
+    if (result->frameCount == result->frameCapacity) {
+        int newCapacity = result->frameCapacity ? result->frameCapacity * 2 : 1024;
+        PDECODED_FRAME newFrames = realloc(result->frames, sizeof(*result->frames) * newCapacity);
+        if (newFrames == NULL) {
+            return NULL;
+        }
+
+        result->frames = newFrames;
+        result->frameCapacity = newCapacity;
+    }
+
+    return &result->frames[result->frameCount++];
+}
+
+static int replaySubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
+    PDECODED_FRAME frame;
+    PLENTRY entry;
+    int length;
+
+    if (decodeUnit->fullLength > frameScratchSize) {
+        char* newScratch = realloc(frameScratch, decodeUnit->fullLength);
+        if (newScratch == NULL) {
+            return DR_NEED_IDR;
+        }
+
+        frameScratch = newScratch;
+        frameScratchSize = decodeUnit->fullLength;
+    }
+
+    length = 0;
+    for (entry = decodeUnit->bufferList; entry != NULL; entry = entry->next) {
+        // Contiguous decode units must be laid out back to back from the first entry
+        if ((VideoCallbacks.capabilities & CAPABILITY_CONTIGUOUS_DECODE_UNIT) &&
+                entry->data != decodeUnit->bufferList->data + length) {
+            currentResult->layoutErrors++;
+        }
+
+        memcpy(&frameScratch[length], entry->data, entry->length);
+        length += entry->length;
+        currentResult->bufferEntries++;
+    }
+
+    frame = addDecodedFrame(currentResult);
+    if (frame == NULL) {
+        return DR_NEED_IDR;
+    }
+
+    frame->frameNumber = (uint32_t)decodeUnit->frameNumber;
+    frame->frameType = decodeUnit->frameType;
+    frame->length = length;
+    frame->hash = SynHashFrameData(frameScratch, length);
+
+    currentResult->videoBytes += length;
+    currentResult->videoDigest = hashData(currentResult->videoDigest, &frame->hash, sizeof(frame->hash));
+    if (decodeUnit->frameType == FRAME_TYPE_IDR) {
+        currentResult->idrFrames++;
+    }
+
+    return DR_OK;
+}
+
+static void replayDecodeAndPlaySample(char* sampleData, int sampleLength) {
+    if (sampleData == NULL) {
+        // Packet loss concealment
+        currentResult->concealedAudioPackets++;
+        currentResult->audioDigest = hashData(currentResult->audioDigest, "PLC", 3);
+        return;
+    }
+
+    currentResult->audioPackets++;
+    currentResult->audioDigest = hashData(currentResult->audioDigest, sampleData, sampleLength);
+}
+
+static void setupReplayCallbacks(PREPLAY_OPTIONS options) {
+    static DECODER_RENDERER_CALLBACKS drCallbacks;
+    static AUDIO_RENDERER_CALLBACKS arCallbacks;
+    static CONNECTION_LISTENER_CALLBACKS clCallbacks;
+    PDECODER_RENDERER_CALLBACKS drCallbacksPtr = &drCallbacks;
+    PAUDIO_RENDERER_CALLBACKS arCallbacksPtr = &arCallbacks;
+    PCONNECTION_LISTENER_CALLBACKS clCallbacksPtr = &clCallbacks;
+
+    LiInitializeVideoCallbacks(&drCallbacks);
+    drCallbacks.submitDecodeUnit = replaySubmitDecodeUnit;
+    drCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+
+    LiInitializeAudioCallbacks(&arCallbacks);
+    arCallbacks.decodeAndPlaySample = replayDecodeAndPlaySample;
+    arCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+
+    LiInitializeConnectionCallbacks(&clCallbacks);
+
+    fixupMissingCallbacks(&drCallbacksPtr, &arCallbacksPtr, &clCallbacksPtr);
+    VideoCallbacks = *drCallbacksPtr;
+    AudioCallbacks = *arCallbacksPtr;
+    ListenerCallbacks = *clCallbacksPtr;
+
+    // Set up the connection parameters as if they had been negotiated with the host.
+    // Video is captured after decryption and audio decryption happens after the RTP
+    // queue, so the replay runs without encryption.
+    memcpy(AppVersionQuad, captureInfo.appVersionQuad, sizeof(AppVersionQuad));
+    NegotiatedVideoFormat = captureInfo.videoFormat;
+    LiInitializeStreamConfiguration(&StreamConfig);
+    StreamConfig.width = captureInfo.width;
+    StreamConfig.height = captureInfo.height;
+    StreamConfig.fps = captureInfo.fps;
+    StreamConfig.packetSize = captureInfo.packetSize;
+    StreamConfig.audioConfiguration = captureInfo.audioConfiguration;
+    AudioPacketDuration = captureInfo.audioPacketDuration;
+    EncryptionFeaturesEnabled = 0;
+    AudioEncryptionEnabled = false;
+}
+
+// Builds the order that packets are fed in, with the requested impairments applied.
+// Each slot keeps the timestamp of the packet that was originally there, so a
+// reordered packet is fed late rather than at the time it was captured.
+static int buildSchedule(PREPLAY_OPTIONS options, bool impaired, PSCHEDULED_PACKET schedule) {
+    int count = 0;
+    int i;
+
+    randomState = options->seed != 0 ? options->seed : 1;
+
+    for (i = 0; i < packetCount; i++) {
+        if (impaired && randomChance(options->lossPercent)) {
+            continue;
+        }
+
+        schedule[count].packetIndex = i;
+        schedule[count].timeUs = packets[i].timeUs;
+        count++;
+
+        if (impaired && randomChance(options->duplicatePercent)) {
+            schedule[count] = schedule[count - 1];
+            count++;
+        }
+    }
+
+    if (impaired && options->reorderDepth > 0) {
+        for (i = 0; i < count; i++) {
+            if (randomChance(options->reorderPercent)) {
+                int j = i + 1 + (int)(nextRandom() % options->reorderDepth);
+                if (j < count) {
+                    int packetIndex = schedule[i].packetIndex;
+                    schedule[i].packetIndex = schedule[j].packetIndex;
+                    schedule[j].packetIndex = packetIndex;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+static void waitForPacketTime(PREPLAY_OPTIONS options, uint64_t startUs, uint64_t firstPacketUs, uint64_t packetUs) {
+    uint64_t targetUs, nowUs;
+
+    if (options->timingScale <= 0 || packetUs <= firstPacketUs) {
+        return;
+    }
+
+    targetUs = startUs + (uint64_t)((packetUs - firstPacketUs) / options->timingScale);
+    while ((nowUs = PltGetMicros()) < targetUs) {
+        // Sleep for most of the wait and spin for the rest
+        if (targetUs - nowUs > 2000) {
+            PltSleepMs((int)((targetUs - nowUs) / 1000) - 1);
+        }
+    }
+}
+
+// Feeds queued frames to the simulated decoder until it is busy past nowUs
+static void runQueuedDecoder(PREPLAY_OPTIONS options, uint64_t nowUs, uint64_t* decoderFreeUs, int* decodedFrames) {
+    VIDEO_FRAME_HANDLE handle;
+    PDECODE_UNIT decodeUnit;
+
+    while (*decoderFreeUs <= nowUs && LiPollNextVideoFrame(&handle, &decodeUnit)) {
+        LiCompleteVideoFrame(handle, replaySubmitDecodeUnit(decodeUnit));
+
+        // An idle decoder starts on the frame as soon as it's queued
+        if (*decoderFreeUs < nowUs) {
+            *decoderFreeUs = nowUs;
+        }
+        *decoderFreeUs += options->decodeTimeUs;
+        if (++*decodedFrames % DECODER_STALL_INTERVAL == 0) {
+            *decoderFreeUs += options->decoderStallUs;
+        }
+    }
+}
+
+static bool hasImpairments(PREPLAY_OPTIONS options) {
+    return options->lossPercent > 0 || options->reorderPercent > 0 || options->duplicatePercent > 0;
+}
+
+// Runs the clean reference replay or the replay under test
+static int runReplay(PREPLAY_OPTIONS options, bool reference, PREPLAY_RESULT result) {
+    PSCHEDULED_PACKET schedule;
+    uint64_t startUs;
+    uint64_t decoderFreeUs = 0;
+    int queuedFrames = 0;
+    bool useDecoderQueue;
+    int count;
+    int i;
+
+    memset(result, 0, sizeof(*result));
+    result->videoDigest = FNV_OFFSET_BASIS;
+    result->audioDigest = FNV_OFFSET_BASIS;
+
+    // Duplicates can at most double the number of packets
+    schedule = malloc(sizeof(*schedule) * ((size_t)packetCount * 2 + 1));
+    result->videoPacketUs = malloc(sizeof(uint32_t) * ((size_t)packetCount * 2 + 1));
+    result->audioPacketUs = malloc(sizeof(uint32_t) * ((size_t)packetCount * 2 + 1));
+    if (schedule == NULL || result->videoPacketUs == NULL || result->audioPacketUs == NULL) {
+        free(schedule);
+        return -1;
+    }
+
+    count = buildSchedule(options, !reference && hasImpairments(options), schedule);
+
+    // The clean replay is always submitted directly, so it has every frame to compare against
+    useDecoderQueue = options->decodeTimeUs != 0 && !reference;
+    VideoCallbacks.capabilities &= ~(CAPABILITY_DIRECT_SUBMIT | CAPABILITY_CONTIGUOUS_DECODE_UNIT);
+    if (!useDecoderQueue) {
+        VideoCallbacks.capabilities |= CAPABILITY_DIRECT_SUBMIT;
+    }
+    if (options->contiguous && !reference) {
+        VideoCallbacks.capabilities |= CAPABILITY_CONTIGUOUS_DECODE_UNIT;
+    }
+
+    currentResult = result;
+    resetControlStreamFrameStats();
+    initializeVideoStream();
+    if (initializeAudioStream() != 0 || prepareAudioReplay() != 0) {
+        destroyVideoStream();
+        free(schedule);
+        return -1;
+    }
+
+    startUs = PltGetMicros();
+    for (i = 0; i < count; i++) {
+        PREPLAY_PACKET packet = &packets[schedule[i].packetIndex];
+        uint64_t packetStartUs;
+
+        waitForPacketTime(options, startUs, schedule[0].timeUs, schedule[i].timeUs);
+
+        packetStartUs = PltGetMicros();
+        if (packet->stream == PACKET_CAPTURE_VIDEO) {
+            replayVideoPacket(packet->data, packet->length);
+            result->videoPacketUs[result->videoPacketsFed++] = (uint32_t)(PltGetMicros() - packetStartUs);
+        }
+        else {
+            replayAudioPacket(packet->data, packet->length);
+            result->audioPacketUs[result->audioPacketsFed++] = (uint32_t)(PltGetMicros() - packetStartUs);
+        }
+
+        if (useDecoderQueue) {
+            runQueuedDecoder(options, schedule[i].timeUs, &decoderFreeUs, &queuedFrames);
+        }
+    }
+
+    // Let the decoder finish whatever is still queued
+    if (useDecoderQueue) {
+        runQueuedDecoder(options, UINT64_MAX, &decoderFreeUs, &queuedFrames);
+    }
+    result->elapsedUs = PltGetMicros() - startUs;
+
+    result->haveTraceStats = LiGetFrameTraceStats(&result->traceStats);
+    result->haveQueueStats = useDecoderQueue && LiGetVideoQueueStats(&result->queueStats);
+
+    destroyAudioStream();
+    destroyVideoStream();
+    currentResult = NULL;
+
+    free(schedule);
+    return 0;
+}
+
+static void freeResult(PREPLAY_RESULT result) {
+    free(result->frames);
+    free(result->videoPacketUs);
+    free(result->audioPacketUs);
+}
+
+static int compareTimes(const void* a, const void* b) {
+    uint32_t timeA = *(const uint32_t*)a;
+    uint32_t timeB = *(const uint32_t*)b;
+
+    return timeA < timeB ? -1 : (timeA > timeB ? 1 : 0);
+}
+
+static void printPacketTimes(const char* name, uint32_t* times, int count) {
+    uint64_t totalUs = 0;
+    int i;
+
+    if (count == 0) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        totalUs += times[i];
+    }
+
+    qsort(times, count, sizeof(*times), compareTimes);
+    printf("%s packet time (us): mean %.2f p50 %u p99 %u max %u\n", name,
+           (double)totalUs / count, times[(count - 1) / 2], times[(uint64_t)(count - 1) * 99 / 100], times[count - 1]);
+}
+
+static void printTraceStats(PFRAME_TRACE_STATS stats) {
+    static const char* stageNames[FRAME_TRACE_STAGE_COUNT] = {
+        "first packet", "last packet", "FEC complete", "reassembled",
+        "submitted", "input acquired", "queued", "output released"
+    };
+    int stage;
+
+    printf("Frame trace (us): %-16s %8s %10s %10s %10s %10s\n", "stage", "frames", "p50", "p99", "total p50", "total p99");
+    for (stage = 0; stage < FRAME_TRACE_STAGE_COUNT; stage++) {
+        if (stats->frameCount[stage] == 0) {
+            continue;
+        }
+
+        printf("                  %-16s %8u %10u %10u %10u %10u\n", stageNames[stage],
+               stats->frameCount[stage], stats->stageP50Us[stage], stats->stageP99Us[stage],
+               stats->totalP50Us[stage], stats->totalP99Us[stage]);
+    }
+}
+
+static void printQueueStats(PVIDEO_QUEUE_STATS stats) {
+    int maxDepth = 0, maxAgeBucket = 0;
+    int i;
+
+    for (i = 0; i < VIDEO_QUEUE_DEPTH_BUCKETS; i++) {
+        if (stats->depthHistogram[i] != 0) {
+            maxDepth = i;
+        }
+    }
+    for (i = 0; i < VIDEO_QUEUE_AGE_BUCKETS; i++) {
+        if (stats->ageHistogram[i] != 0) {
+            maxAgeBucket = i;
+        }
+    }
+
+    printf("Decode unit queue: %u frames dequeued, %u skipped, %u age refreshes, %u overflow IDR skips\n",
+           stats->framesDequeued, stats->framesSkipped, stats->ageRefreshes, stats->overflowIdrSkips);
+    printf("Decode unit queue: max depth %d%s, max age %d-%d ms\n",
+           maxDepth, maxDepth == VIDEO_QUEUE_DEPTH_BUCKETS - 1 ? "+" : "",
+           maxAgeBucket * VIDEO_QUEUE_AGE_BUCKET_MS, (maxAgeBucket + 1) * VIDEO_QUEUE_AGE_BUCKET_MS - 1);
+}
+
+static void printResult(PREPLAY_OPTIONS options, PREPLAY_RESULT result, const char* name) {
+    int i;
+
+    if (options->printFrames) {
+        for (i = 0; i < result->frameCount; i++) {
+            printf("frame %u %s %d bytes %016llx\n", result->frames[i].frameNumber,
+                   result->frames[i].frameType == FRAME_TYPE_IDR ? "IDR" : "P",
+                   result->frames[i].length, (unsigned long long)result->frames[i].hash);
+        }
+    }
+
+    printf("%s: fed %d video and %d audio packets in %.3f s\n", name,
+           result->videoPacketsFed, result->audioPacketsFed, result->elapsedUs / 1000000.0);
+    printf("Video: %d frames decoded (%d IDR), %llu bytes, digest %016llx\n",
+           result->frameCount, result->idrFrames,
+           (unsigned long long)result->videoBytes, (unsigned long long)result->videoDigest);
+    if (result->frameCount != 0) {
+        printf("Video: %.2f buffers per decode unit, %d not laid out contiguously\n",
+               (double)result->bufferEntries / result->frameCount, result->layoutErrors);
+    }
+    printf("Audio: %u packets decoded, %u concealed, digest %016llx\n",
+           result->audioPackets, result->concealedAudioPackets, (unsigned long long)result->audioDigest);
+    printPacketTimes("Video", result->videoPacketUs, result->videoPacketsFed);
+    printPacketTimes("Audio", result->audioPacketUs, result->audioPacketsFed);
+    if (result->haveTraceStats) {
+        printTraceStats(&result->traceStats);
+    }
+    if (result->haveQueueStats) {
+        printQueueStats(&result->queueStats);
+    }
+}
+
+// Every frame decoded from the impaired replay must match the same frame from the clean replay
+static int verifyResult(PREPLAY_RESULT reference, PREPLAY_RESULT result) {
+    int mismatches = 0;
+    int i, j;
+
+    if (reference->frameCount == 0) {
+        printf("Verify: the clean replay didn't decode any frames\n");
+        return -1;
+    }
+
+    j = 0;
+    for (i = 0; i < result->frameCount; i++) {
+        PDECODED_FRAME frame = &result->frames[i];
+
+        // Frames are decoded in order, so we can walk both lists together
+        while (j < reference->frameCount && isBefore32(reference->frames[j].frameNumber, frame->frameNumber)) {
+            j++;
+        }
+
+        if (j == reference->frameCount || reference->frames[j].frameNumber != frame->frameNumber) {
+            printf("Verify: frame %u wasn't decoded by the clean replay\n", frame->frameNumber);
+            mismatches++;
+        }
+        else if (reference->frames[j].hash != frame->hash) {
+            printf("Verify: frame %u differs from the clean replay (%d vs %d bytes)\n",
+                   frame->frameNumber, frame->length, reference->frames[j].length);
+            mismatches++;
+        }
+    }
+
+    printf("Verify: %d of %d frames match the clean replay, %d frames lost\n",
+           result->frameCount - mismatches, result->frameCount, reference->frameCount - result->frameCount);
+    return mismatches == 0 ? 0 : -1;
+}
+
+// Every frame decoded from the clean replay of a synthetic stream must match the generated frame
+static int verifySyntheticFrames(PREPLAY_RESULT reference) {
+    int mismatches = 0;
+    int i;
+
+    for (i = 0; i < reference->frameCount; i++) {
+        PDECODED_FRAME frame = &reference->frames[i];
+
+        if (frame->frameNumber == 0 || frame->frameNumber > (uint32_t)syntheticFrameCount) {
+            printf("Verify: frame %u wasn't generated\n", frame->frameNumber);
+            mismatches++;
+        }
+        else if (syntheticFrameHashes[frame->frameNumber - 1] != frame->hash) {
+            printf("Verify: frame %u differs from the generated frame\n", frame->frameNumber);
+            mismatches++;
+        }
+    }
+
+    // Nothing is dropped from the clean replay, so every frame must have been decoded
+    printf("Verify: %d of %d frames of the clean replay match the generated stream, %d frames lost\n",
+           reference->frameCount - mismatches, reference->frameCount, syntheticFrameCount - reference->frameCount);
+    return mismatches == 0 && reference->frameCount == syntheticFrameCount ? 0 : -1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: capture_replay [options] <capture file>\n"
+            "       capture_replay [options] --synthetic <frames>\n"
+            "\n"
+            "Impairments:\n"
+            "  --loss <percent>          Drop packets at random\n"
+            "  --reorder <percent>       Delay packets behind later ones at random\n"
+            "  --reorder-depth <packets> Maximum delay of a reordered packet (default %d)\n"
+            "  --duplicate <percent>     Duplicate packets at random\n"
+            "  --timing <mode>           asap (default), realtime, or a speed-up factor\n"
+            "  --seed <n>                Seed for the impairments and synthetic stream\n"
+            "\n"
+            "Output:\n"
+            "  --verify                  Check decoded frames against a clean replay and\n"
+            "                            the generated frames of a synthetic stream\n"
+            "  --frames                  Print the hash of each decode unit\n"
+            "  --contiguous              Request contiguous decode units\n"
+            "  --recovery-threads <n>    FEC recovery pool threads, 0 to recover on the\n"
+            "                            receive thread (default %d)\n"
+            "  --fec-validation <on|off> Drop and recover an extra shard per FEC block\n"
+            "                            (debug and FEC_VALIDATION builds only)\n"
+            "  --write <file>            Save the input packets as a capture file\n"
+            "\n"
+            "Decoder:\n"
+            "  --decode-time <ms>        Pull frames from the decode unit queue into a decoder\n"
+            "                            that takes this long per frame\n"
+            "  --decoder-stall <ms>      Stall the decoder every %d frames\n"
+            "  --frame-age-limit <ms>    Skip queued frames older than this\n"
+            "\n"
+            "Synthetic stream:\n"
+            "  --packet-size <bytes>     Video packet size\n"
+            "  --frame-size <min>:<max>  Annex B bytes per P-frame\n"
+            "  --fec <percent>           Video FEC percentage\n"
+            "  --idr-interval <frames>   Frames between IDR frames\n"
+            "  --single-fec              Don't split frames into multiple FEC blocks\n"
+            "  --hevc                    Generate HEVC instead of H.264\n"
+            "  --prefix-nals             Start each frame with an AUD and an SEI NAL unit\n",
+            DEFAULT_REORDER_DEPTH, RTPV_FEC_RECOVERY_THREADS, DECODER_STALL_INTERVAL);
+}
+
+static int parseOptions(int argc, char** argv, PREPLAY_OPTIONS options) {
+    int i;
+
+    memset(options, 0, sizeof(*options));
+    options->reorderDepth = DEFAULT_REORDER_DEPTH;
+    options->seed = 1;
+    options->fecValidation = -1;
+    options->recoveryThreads = -1;
+    SynInitializeConfig(&options->synthetic);
+
+    for (i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(arg, "--verify")) {
+            options->verify = true;
+            continue;
+        }
+        else if (!strcmp(arg, "--frames")) {
+            options->printFrames = true;
+            continue;
+        }
+        else if (!strcmp(arg, "--contiguous")) {
+            options->contiguous = true;
+            continue;
+        }
+        else if (!strcmp(arg, "--single-fec")) {
+            options->synthetic.multiFec = false;
+            continue;
+        }
+        else if (!strcmp(arg, "--hevc")) {
+            options->synthetic.videoFormat = VIDEO_FORMAT_H265;
+            continue;
+        }
+        else if (!strcmp(arg, "--prefix-nals")) {
+            options->synthetic.prefixNals = true;
+            continue;
+        }
+        else if (arg[0] != '-' || arg[1] != '-') {
+            if (options->inputPath != NULL) {
+                return -1;
+            }
+            options->inputPath = arg;
+            continue;
+        }
+
+        // Everything else takes a value
+        if (value == NULL) {
+            return -1;
+        }
+        i++;
+
+        if (!strcmp(arg, "--loss")) {
+            options->lossPercent = atof(value);
+        }
+        else if (!strcmp(arg, "--reorder")) {
+            options->reorderPercent = atof(value);
+        }
+        else if (!strcmp(arg, "--reorder-depth")) {
+            options->reorderDepth = atoi(value);
+        }
+        else if (!strcmp(arg, "--duplicate")) {
+            options->duplicatePercent = atof(value);
+        }
+        else if (!strcmp(arg, "--timing")) {
+            if (!strcmp(value, "asap")) {
+                options->timingScale = 0;
+            }
+            else if (!strcmp(value, "realtime")) {
+                options->timingScale = 1;
+            }
+            else {
+                options->timingScale = atof(value);
+                if (options->timingScale <= 0) {
+                    return -1;
+                }
+            }
+        }
+        else if (!strcmp(arg, "--seed")) {
+            options->seed = (uint32_t)strtoul(value, NULL, 0);
+            options->synthetic.seed = options->seed;
+        }
+        else if (!strcmp(arg, "--write")) {
+            options->writePath = value;
+        }
+        else if (!strcmp(arg, "--synthetic")) {
+            options->syntheticFrames = atoi(value);
+            if (options->syntheticFrames <= 0) {
+                return -1;
+            }
+        }
+        else if (!strcmp(arg, "--packet-size")) {
+            options->synthetic.packetSize = atoi(value);
+        }
+        else if (!strcmp(arg, "--frame-size")) {
+            if (sscanf(value, "%d:%d", &options->synthetic.minFrameSize, &options->synthetic.maxFrameSize) != 2) {
+                return -1;
+            }
+        }
+        else if (!strcmp(arg, "--fec")) {
+            options->synthetic.fecPercentage = atoi(value);
+        }
+        else if (!strcmp(arg, "--idr-interval")) {
+            options->synthetic.idrInterval = atoi(value);
+        }
+        else if (!strcmp(arg, "--fec-validation")) {
+            if (!strcmp(value, "on")) {
+                options->fecValidation = 1;
+            }
+            else if (!strcmp(value, "off")) {
+                options->fecValidation = 0;
+            }
+            else {
+                return -1;
+            }
+        }
+        else if (!strcmp(arg, "--decode-time")) {
+            options->decodeTimeUs = (uint32_t)(atof(value) * 1000);
+        }
+        else if (!strcmp(arg, "--decoder-stall")) {
+            options->decoderStallUs = (uint32_t)(atof(value) * 1000);
+        }
+        else if (!strcmp(arg, "--frame-age-limit")) {
+            options->frameAgeLimitMs = atoi(value);
+        }
+        else if (!strcmp(arg, "--recovery-threads")) {
+            options->recoveryThreads = atoi(value);
+            if (options->recoveryThreads < 0 || options->recoveryThreads > RTPV_FEC_RECOVERY_THREADS) {
+                return -1;
+            }
+        }
+        else {
+            return -1;
+        }
+    }
+
+    if ((options->inputPath == NULL) == (options->syntheticFrames == 0)) {
+        return -1;
+    }
+
+    // The decoder settings only apply to the decode unit queue
+    if (options->decodeTimeUs == 0 && (options->decoderStallUs != 0 || options->frameAgeLimitMs != 0)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    REPLAY_OPTIONS options;
+    REPLAY_RESULT reference, result;
+    bool impaired;
+    int ret = 0;
+
+    if (parseOptions(argc, argv, &options) != 0) {
+        usage();
+        return 2;
+    }
+
+    if (options.syntheticFrames != 0) {
+        ret = loadSyntheticStream(&options);
+    }
+    else {
+        ret = loadCaptureFile(options.inputPath);
+    }
+    if (ret != 0) {
+        return 1;
+    }
+
+    if (options.writePath != NULL && writeCaptureFile(options.writePath) != 0) {
+        return 1;
+    }
+
+    setupReplayCallbacks(&options);
+
+    if (options.fecValidation >= 0 && !LiSetFecValidationMode(options.fecValidation != 0)) {
+        fprintf(stderr, "FEC validation mode is not compiled into this build\n");
+        return 1;
+    }
+
+    LiSetVideoFrameAgeLimit(options.frameAgeLimitMs);
+    if (options.recoveryThreads >= 0) {
+        RtpvSetRecoveryThreadCount(options.recoveryThreads);
+    }
+
+    // The RTP queues and depacketizer report frames and losses to the control stream,
+    // which only queues them up for the host since it is never started
+    if (initializeControlStream() != 0) {
+        return 1;
+    }
+
+    impaired = hasImpairments(&options);
+
+    if (options.verify) {
+        if (runReplay(&options, true, &reference) != 0) {
+            return 1;
+        }
+
+        printResult(&options, &reference, "Clean replay");
+        if (syntheticFrameHashes != NULL && verifySyntheticFrames(&reference) != 0) {
+            ret = -1;
+        }
+        printf("\n");
+    }
+
+    if (runReplay(&options, false, &result) != 0) {
+        return 1;
+    }
+
+    printResult(&options, &result, impaired ? "Impaired replay" : "Replay");
+
+    if (options.verify) {
+        if (verifyResult(&reference, &result) != 0) {
+            ret = -1;
+        }
+        freeResult(&reference);
+    }
+    if (result.layoutErrors != 0) {
+        ret = -1;
+    }
+
+    freeResult(&result);
+    free(syntheticFrameHashes);
+    return ret == 0 ? 0 : 1;
+}
@@ -168,6 +168,22 @@ Java_com_limelight_nvstream_jni_MoonBridge_getPendingVideoFrames(JNIEnv *env, jc
     return LiGetPendingVideoFrames();
 }
 
+JNIEXPORT void JNICALL
+Java_com_limelight_nvstream_jni_MoonBridge_setAudioJitterBufferLatency(JNIEnv *env, jclass clazz, jint minTargetMs, jint maxTargetMs) {
+    LiSetAudioJitterBufferLatency(minTargetMs, maxTargetMs);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_limelight_nvstream_jni_MoonBridge_getAudioJitterBufferTargetLatency(JNIEnv *env, jclass clazz) {
+    AUDIO_JITTER_BUFFER_STATS stats;
+
+    if (!LiGetAudioJitterBufferStats(&stats)) {
+        return 0;
+    }
+
+    return stats.targetLatencyMs;
+}
+
 JNIEXPORT jint JNICALL
 Java_com_limelight_nvstream_jni_MoonBridge_testClientConnectivity(JNIEnv *env, jclass clazz, jstring testServerHostName, jint referencePort, jint testFlags) {
     int ret;
@@ -0,0 +1,183 @@
+#include "native_audio.h"
+#include "audio_sink.h"
+#include "parallel_opus.h"
+
+#include "async_log.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "NativeAudio"
+#define LOGI(...) ALOGI(LOG_TAG, __VA_ARGS__)
+#define LOGW(...) ALOGW(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) ALOGE(LOG_TAG, __VA_ARGS__)
+
+// How much decoded audio the ring can hold. Anything beyond this is
+// dropped rather than adding latency.
+#define RING_BUFFER_MS 40
+
+#define WAV_PATH_MAX 256
+
+// Requested by Java before the stream starts
+static volatile int g_sinkType = AUDIO_SINK_JAVA;
+static char g_wavPath[WAV_PATH_MAX];
+static volatile int g_decoderThreads = 1;
+
+static audio_sink_t* g_sink = NULL;
+static parallel_opus_decoder_t* g_decoder = NULL;
+static int16_t* g_pcmBuffer = NULL;
+static int g_samplesPerFrame = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void record_time(uint64_t ns, uint64_t* total, uint32_t* max) {
+    *total += ns;
+    if (ns > *max) {
+        *max = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    }
+}
+
+static void log_sink_stats(const audio_sink_t* sink) {
+    const audio_sink_stats_t* stats = &sink->stats;
+    uint32_t packets = stats->packetsQueued + stats->packetsDropped;
+
+    if (packets == 0) {
+        return;
+    }
+
+    LOGI("%s sink: %u packets queued, %u dropped, %u pulls, %u underrun frames",
+         sink->ops->name, stats->packetsQueued, stats->packetsDropped, stats->pulls, stats->underrunFrames);
+    LOGI("Decode avg %.1f us (max %.1f us), enqueue avg %.2f us (max %.2f us)",
+         stats->totalDecodeNs / 1000.0 / packets, stats->maxDecodeNs / 1000.0,
+         stats->totalEnqueueNs / 1000.0 / packets, stats->maxEnqueueNs / 1000.0);
+}
+
+JNIEXPORT void JNICALL
+Java_com_limelight_nvstream_jni_MoonBridge_nativeAudioSetSink(JNIEnv* env, jclass clazz, jint sinkType, jstring path) {
+    (void)clazz;
+
+    if (sinkType < 0 || sinkType >= AUDIO_SINK_COUNT) {
+        LOGW("Ignoring unknown audio sink type: %d", sinkType);
+        return;
+    }
+
+    g_wavPath[0] = 0;
+    if (path != NULL) {
+        const char* pathChars = (*env)->GetStringUTFChars(env, path, NULL);
+        if (pathChars != NULL) {
+            strncpy(g_wavPath, pathChars, sizeof(g_wavPath) - 1);
+            g_wavPath[sizeof(g_wavPath) - 1] = 0;
+            (*env)->ReleaseStringUTFChars(env, path, pathChars);
+        }
+    }
+
+    g_sinkType = sinkType;
+    LOGI("Audio sink set to %s", audio_sink_type_name(sinkType));
+}
+
+JNIEXPORT void JNICALL
+Java_com_limelight_nvstream_jni_MoonBridge_nativeAudioSetDecoderThreads(JNIEnv* env, jclass clazz, jint threads) {
+    (void)env;
+    (void)clazz;
+
+    g_decoderThreads = threads > 1 ? threads : 1;
+    LOGI("Audio decoder threads set to %d", g_decoderThreads);
+}
+
+int nativeAudioGetDecoderThreads(void) {
+    return g_decoderThreads;
+}
+
+bool nativeAudioIsEnabled(void) {
+    return g_sinkType != AUDIO_SINK_JAVA;
+}
+
+int nativeAudioInit(int audioConfiguration, POPUS_MULTISTREAM_CONFIGURATION opusConfig) {
+    (void)audioConfiguration;
+
+    g_decoder = parallel_opus_decoder_create(opusConfig, g_decoderThreads);
+    if (g_decoder == NULL) {
+        LOGE("Failed to create Opus decoder");
+        return -1;
+    }
+
+    g_samplesPerFrame = opusConfig->samplesPerFrame;
+    g_pcmBuffer = malloc(sizeof(int16_t) * opusConfig->channelCount * opusConfig->samplesPerFrame);
+    if (g_pcmBuffer == NULL) {
+        nativeAudioCleanup();
+        return -1;
+    }
+
+    g_sink = audio_sink_create(g_sinkType, opusConfig->sampleRate, opusConfig->channelCount,
+                               opusConfig->samplesPerFrame, RING_BUFFER_MS,
+                               g_wavPath[0] != 0 ? g_wavPath : NULL);
+    if (g_sink == NULL) {
+        LOGE("Failed to create %s audio sink", audio_sink_type_name(g_sinkType));
+        nativeAudioCleanup();
+        return -1;
+    }
+
+    return 0;
+}
+
+void nativeAudioStart(void) {
+    if (g_sink != NULL && audio_sink_start(g_sink) != 0) {
+        LOGE("Failed to start %s audio sink", g_sink->ops->name);
+    }
+}
+
+void nativeAudioStop(void) {
+    if (g_sink != NULL) {
+        audio_sink_stop(g_sink);
+    }
+}
+
+void nativeAudioCleanup(void) {
+    if (g_sink != NULL) {
+        log_sink_stats(g_sink);
+        audio_sink_destroy(g_sink);
+        g_sink = NULL;
+    }
+
+    if (g_decoder != NULL) {
+        parallel_opus_decoder_destroy(g_decoder);
+        g_decoder = NULL;
+    }
+
+    free(g_pcmBuffer);
+    g_pcmBuffer = NULL;
+}
+
+bool nativeAudioGetSinkStats(audio_sink_stats_t* stats) {
+    if (g_sink == NULL) {
+        return false;
+    }
+
+    *stats = g_sink->stats;
+    return true;
+}
+
+void nativeAudioDecodeAndPlaySample(char* sampleData, int sampleLength) {
+    audio_sink_stats_t* stats = &g_sink->stats;
+    uint64_t startNs = now_ns();
+    uint64_t decodedNs;
+
+    int decodeLen = parallel_opus_decoder_decode(g_decoder,
+                                                 (const unsigned char*)sampleData,
+                                                 sampleLength,
+                                                 g_pcmBuffer,
+                                                 g_samplesPerFrame);
+    decodedNs = now_ns();
+    record_time(decodedNs - startNs, &stats->totalDecodeNs, &stats->maxDecodeNs);
+
+    if (decodeLen > 0) {
+        audio_sink_write(g_sink, g_pcmBuffer, decodeLen);
+        record_time(now_ns() - decodedNs, &stats->totalEnqueueNs, &stats->maxEnqueueNs);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <jni.h>
+#include <stdbool.h>
+
+#include <Limelight.h>
+
+#include "audio_sink.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void Java_com_limelight_nvstream_jni_MoonBridge_nativeAudioSetSink(JNIEnv* env, jclass clazz, jint sinkType, jstring path);
+void Java_com_limelight_nvstream_jni_MoonBridge_nativeAudioSetDecoderThreads(JNIEnv* env, jclass clazz, jint threads);
+
+// The number of threads to decode surround audio with, for both native and Java playback
+int nativeAudioGetDecoderThreads(void);
+
+// Returns true if audio should be decoded and played natively instead of going up to Java
+bool nativeAudioIsEnabled(void);
+
+// These mirror the audio renderer callbacks for the native sink
+int nativeAudioInit(int audioConfiguration, POPUS_MULTISTREAM_CONFIGURATION opusConfig);
+void nativeAudioStart(void);
+void nativeAudioStop(void);
+void nativeAudioCleanup(void);
+void nativeAudioDecodeAndPlaySample(char* sampleData, int sampleLength);
+
+// Copies the stats of the native sink, including the decode and enqueue timing.
+// Returns false if there is no sink. The playback side updates some of them
+// until nativeAudioStop().
+bool nativeAudioGetSinkStats(audio_sink_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #include "native_decoder.h"
+#include "output_pacer.h"
 
-#include <android/log.h>
+#include "async_log.h"
 #include <android/native_window_jni.h>
 #include <media/NdkMediaCodec.h>
 #include <media/NdkMediaFormat.h>
@@ -16,8 +17,10 @@
 #include <Limelight.h>
 
 #define LOG_TAG "NativeDecoder"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGD(...) ALOGD(LOG_TAG, __VA_ARGS__)
+#define LOGI(...) ALOGI(LOG_TAG, __VA_ARGS__)
+#define LOGW(...) ALOGW(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) ALOGE(LOG_TAG, __VA_ARGS__)
 
 // Fallbacks for older NDKs that don't expose color enums
 #ifndef AMEDIAFORMAT_COLOR_RANGE_FULL
@@ -69,6 +72,25 @@ static bool g_lastHdrEnabled = false;
 static char g_decoderName[256] = {0};
 static bool g_isQtiDecoder = false;
 
+// Set while the native decoder is configured, so the JNI bridge can hand it
+// decode units directly instead of copying them up to Java and back down
+static volatile bool g_nativeSubmitActive = false;
+
+// Requested output pacing policy. The pacer itself is only touched by the output thread.
+static volatile int g_pacingPolicy = PACING_POLICY_IMMEDIATE;
+static output_pacer_t g_pacer;
+
+// Maps the PTS of recently queued frames back to their frame numbers, so the
+// output thread can report released frames to the frame trace. Entries are
+// written by the submit thread and read by the output thread without locking.
+#define PTS_FRAME_MAP_SIZE 64
+typedef struct {
+    int64_t ptsUs;
+    uint32_t frameNumber;
+} pts_frame_entry_t;
+static volatile pts_frame_entry_t g_ptsFrameMap[PTS_FRAME_MAP_SIZE];
+static uint32_t g_ptsFrameMapNext = 0;
+
 // Phase 4: Decoder state tracking for error handling and recovery
 typedef enum {
     DECODER_STATE_UNINITIALIZED,
@@ -166,11 +188,11 @@ static void detect_decoder_info(const char* mime) {
     g_decoderName[sizeof(g_decoderName) - 1] = '\0';
     
     if (g_isQtiDecoder) {
-        LOGE("Detected Qualcomm device (hardware: %s, platform: %s) - assuming QTI decoder", 
+        LOGI("Detected Qualcomm device (hardware: %s, platform: %s) - assuming QTI decoder", 
              hardware[0] != '\0' ? hardware : "unknown",
              board_platform[0] != '\0' ? board_platform : "unknown");
     } else {
-        LOGE("Non-Qualcomm device detected (hardware: %s, platform: %s) - assuming non-QTI decoder",
+        LOGI("Non-Qualcomm device detected (hardware: %s, platform: %s) - assuming non-QTI decoder",
              hardware[0] != '\0' ? hardware : "unknown",
              board_platform[0] != '\0' ? board_platform : "unknown");
     }
@@ -190,41 +212,41 @@ static void log_color_format_details(const char* prefix, AMediaFormat* format) {
     uint8_t* hdrStaticInfo = NULL;
 
     if (AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_COLOR_RANGE, &colorRange)) {
-        LOGE("%s: COLOR_RANGE=%d (%s)", prefix, colorRange, color_range_to_string(colorRange));
+        LOGD("%s: COLOR_RANGE=%d (%s)", prefix, colorRange, color_range_to_string(colorRange));
     } else {
-        LOGE("%s: COLOR_RANGE=not set", prefix);
+        LOGD("%s: COLOR_RANGE=not set", prefix);
     }
 
     if (AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_COLOR_STANDARD, &colorStandard)) {
-        LOGE("%s: COLOR_STANDARD=%d (%s)", prefix, colorStandard, color_standard_to_string(colorStandard));
+        LOGD("%s: COLOR_STANDARD=%d (%s)", prefix, colorStandard, color_standard_to_string(colorStandard));
     } else {
-        LOGE("%s: COLOR_STANDARD=not set", prefix);
+        LOGD("%s: COLOR_STANDARD=not set", prefix);
     }
 
     if (AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_COLOR_TRANSFER, &colorTransfer)) {
-        LOGE("%s: COLOR_TRANSFER=%d (%s)", prefix, colorTransfer, color_transfer_to_string(colorTransfer));
+        LOGD("%s: COLOR_TRANSFER=%d (%s)", prefix, colorTransfer, color_transfer_to_string(colorTransfer));
     } else {
-        LOGE("%s: COLOR_TRANSFER=not set", prefix);
+        LOGD("%s: COLOR_TRANSFER=not set", prefix);
     }
 
     if (AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_COLOR_FORMAT, &colorFormat)) {
-        LOGE("%s: COLOR_FORMAT=%d (0x%x)", prefix, colorFormat, colorFormat);
+        LOGD("%s: COLOR_FORMAT=%d (0x%x)", prefix, colorFormat, colorFormat);
     } else {
-        LOGE("%s: COLOR_FORMAT=not set", prefix);
+        LOGD("%s: COLOR_FORMAT=not set", prefix);
     }
 
     void* hdrStaticInfoVoid = NULL;
     if (AMediaFormat_getBuffer(format, AMEDIAFORMAT_KEY_HDR_STATIC_INFO, &hdrStaticInfoVoid, &hdrStaticInfoSize)) {
         hdrStaticInfo = (uint8_t*)hdrStaticInfoVoid;
-        LOGE("%s: HDR_STATIC_INFO present, size=%zu", prefix, hdrStaticInfoSize);
+        LOGD("%s: HDR_STATIC_INFO present, size=%zu", prefix, hdrStaticInfoSize);
         if (hdrStaticInfoSize > 0 && hdrStaticInfo != NULL) {
-            LOGE("%s: HDR_STATIC_INFO bytes: ", prefix);
+            LOGD("%s: HDR_STATIC_INFO bytes: ", prefix);
             for (size_t i = 0; i < hdrStaticInfoSize && i < 32; i++) {
-                LOGE("%s:   [%zu]=0x%02x", prefix, i, hdrStaticInfo[i]);
+                LOGD("%s:   [%zu]=0x%02x", prefix, i, hdrStaticInfo[i]);
             }
         }
     } else {
-        LOGE("%s: HDR_STATIC_INFO=not set", prefix);
+        LOGD("%s: HDR_STATIC_INFO=not set", prefix);
     }
 }
 
@@ -241,11 +263,11 @@ static bool attempt_flush_recovery() {
         return false;
     }
     
-    LOGE("Attempting flush recovery (decoder: %s, state: %d)", 
+    LOGW("Attempting flush recovery (decoder: %s, state: %d)", 
          g_decoderName[0] != '\0' ? g_decoderName : "unknown", g_decoderState);
     media_status_t status = AMediaCodec_flush(g_codec);
     if (status == AMEDIA_OK) {
-        LOGE("Flush recovery successful");
+        LOGI("Flush recovery successful");
         g_decoderState = DECODER_STATE_STARTED; // Reset to started after flush
         g_errorRecoveryAttempts = 0; // Reset recovery attempts on success
         return true;
@@ -261,7 +283,7 @@ static bool attempt_restart_recovery() {
         return false;
     }
     
-    LOGE("Attempting restart recovery (decoder: %s, attempts: %d/%d)", 
+    LOGW("Attempting restart recovery (decoder: %s, attempts: %d/%d)", 
          g_decoderName[0] != '\0' ? g_decoderName : "unknown", 
          g_errorRecoveryAttempts + 1, MAX_RECOVERY_ATTEMPTS);
     
@@ -279,7 +301,7 @@ static bool attempt_restart_recovery() {
             g_started = true;
             g_decoderState = DECODER_STATE_STARTED;
             g_errorRecoveryAttempts = 0; // Reset on success
-            LOGE("Restart recovery successful");
+            LOGI("Restart recovery successful");
             return true;
         } else {
             LOGE("Phase 4: Restart recovery failed at start, status=%d (decoder: %s)", 
@@ -324,19 +346,97 @@ static void release_window() {
     }
 }
 
+static void remember_frame_pts(int64_t ptsUs, uint32_t frameNumber) {
+    volatile pts_frame_entry_t* entry = &g_ptsFrameMap[g_ptsFrameMapNext++ % PTS_FRAME_MAP_SIZE];
+    entry->ptsUs = 0;
+    entry->frameNumber = frameNumber;
+    entry->ptsUs = ptsUs;
+}
+
+static void trace_released_frame(int64_t ptsUs) {
+    for (int i = 0; i < PTS_FRAME_MAP_SIZE; i++) {
+        if (g_ptsFrameMap[i].ptsUs == ptsUs) {
+            LiTraceVideoFrame(g_ptsFrameMap[i].frameNumber, FRAME_TRACE_OUTPUT_RELEASED);
+            return;
+        }
+    }
+}
+
+static int64_t pacer_now_ns(void* context) {
+    (void)context;
+
+    // Presentation timestamps and timed releases both use CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void pacer_render(void* context, size_t index, int64_t ptsUs, int64_t renderTimeNs) {
+    (void)context;
+
+    if (renderTimeNs != 0) {
+        AMediaCodec_releaseOutputBufferAtTime(g_codec, index, renderTimeNs);
+    } else {
+        AMediaCodec_releaseOutputBuffer(g_codec, index, true);
+    }
+
+    if (ptsUs > 0) {
+        trace_released_frame(ptsUs);
+    }
+}
+
+static void pacer_drop(void* context, size_t index, int64_t ptsUs) {
+    (void)context;
+    (void)ptsUs;
+
+    AMediaCodec_releaseOutputBuffer(g_codec, index, false);
+}
+
+static void log_pacing_stats(const output_pacer_t* pacer) {
+    for (int i = 0; i < PACING_POLICY_COUNT; i++) {
+        const pacing_stats_t* stats = &pacer->stats[i];
+        if (stats->framesRendered == 0 && stats->framesDropped == 0) {
+            continue;
+        }
+
+        LOGI("Output pacing (%s): %u rendered, %u dropped, display latency avg %.2f ms, max %.2f ms",
+             output_pacer_policy_name((pacing_policy_t)i), stats->framesRendered, stats->framesDropped,
+             stats->framesRendered != 0 ? (double)stats->totalLatencyUs / stats->framesRendered / 1000.0 : 0.0,
+             stats->maxLatencyUs / 1000.0);
+    }
+}
+
 static void* output_loop(void* context) {
     (void)context;
 
+    pacer_ops_t ops = {
+        .now_ns = pacer_now_ns,
+        .render = pacer_render,
+        .drop = pacer_drop,
+        .context = NULL,
+    };
+    output_pacer_init(&g_pacer, (pacing_policy_t)g_pacingPolicy, g_fps, &ops);
+
     AMediaCodecBufferInfo info;
     while (g_outputRunning) {
-        ssize_t idx = AMediaCodec_dequeueOutputBuffer(g_codec, &info, 10000);
+        output_pacer_set_policy(&g_pacer, (pacing_policy_t)g_pacingPolicy);
+
+        // Don't block while the pacer is holding a frame, so it's rendered
+        // as soon as the decoder has nothing newer for us
+        int64_t timeoutUs = output_pacer_has_pending(&g_pacer) ? 0 : 10000;
+        ssize_t idx = AMediaCodec_dequeueOutputBuffer(g_codec, &info, timeoutUs);
         if (idx >= 0) {
-            AMediaCodec_releaseOutputBuffer(g_codec, idx, true);
+            output_pacer_on_output(&g_pacer, (size_t)idx, info.presentationTimeUs);
+        } else if (idx == AMEDIACODEC_INFO_TRY_AGAIN_LATER) {
+            output_pacer_flush(&g_pacer);
         } else if (idx == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
             continue;
         }
     }
 
+    output_pacer_discard(&g_pacer);
+    log_pacing_stats(&g_pacer);
+
     return NULL;
 }
 
@@ -348,78 +448,50 @@ static void* output_loop(void* context) {
 JNIEXPORT void JNICALL
 Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetSurface(JNIEnv* env, jclass clazz, jobject surface) {
     (void)clazz;
-    // Use both LOGE and __android_log_print directly to ensure visibility
-    __android_log_print(ANDROID_LOG_ERROR, "NativeDecoder", "=== nativeDecoderSetSurface called ===");
-    __android_log_print(ANDROID_LOG_ERROR, "NativeDecoder", "  Surface: %s", surface != NULL ? "provided" : "NULL");
-    LOGE("=== nativeDecoderSetSurface called ===");
-    LOGE("  Surface: %s", surface != NULL ? "provided" : "NULL");
+    LOGD("=== nativeDecoderSetSurface called ===");
+    LOGD("  Surface: %s", surface != NULL ? "provided" : "NULL");
     release_window();
     if (surface != NULL) {
         g_window = ANativeWindow_fromSurface(env, surface);
         if (g_window != NULL) {
             if (g_dataspace >= 0) {
                 ANativeWindow_setBuffersDataSpace(g_window, g_dataspace);
-                LOGE("  Applied dataspace to window: 0x%x", g_dataspace);
-                LOGE("  Window dataspace set successfully (will be updated in setup if HDR state differs)");
+                LOGD("  Applied dataspace to window: 0x%x", g_dataspace);
+                LOGD("  Window dataspace set successfully (will be updated in setup if HDR state differs)");
             } else {
                 // Hint the target dataspace to full-range BT.601 to match Sunshine's SDR Rec.601 JPEG signaling
                 ANativeWindow_setBuffersDataSpace(g_window, HAL_DATASPACE_V0_JFIF);
-                LOGE("  No dataspace provided, using fallback: HAL_DATASPACE_V0_JFIF (0x%x)", HAL_DATASPACE_V0_JFIF);
+                LOGD("  No dataspace provided, using fallback: HAL_DATASPACE_V0_JFIF (0x%x)", HAL_DATASPACE_V0_JFIF);
             }
         } else {
             LOGE("  ERROR: ANativeWindow_fromSurface returned NULL");
         }
     }
-    LOGE("=== nativeDecoderSetSurface completed ===");
+    LOGD("=== nativeDecoderSetSurface completed ===");
 }
 
 JNIEXPORT void JNICALL
 Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetColorConfig(JNIEnv* env, jclass clazz, jint colorRange, jint colorStandard, jint colorTransfer, jint dataspace) {
     (void)env;
     (void)clazz;
-    // #region agent log
-    FILE* logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile) {
-        fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"A\",\"location\":\"native_decoder.c:229\",\"message\":\"nativeDecoderSetColorConfig entry\",\"data\":{\"colorRange\":%d,\"colorStandard\":%d,\"colorTransfer\":%d,\"dataspace\":%d,\"dataspaceHex\":\"0x%x\"},\"timestamp\":%lld}\n",
-                colorRange, colorStandard, colorTransfer, dataspace, dataspace, (long long)time(NULL) * 1000);
-        fclose(logFile);
-    }
-    // #endregion
-    LOGE("=== nativeDecoderSetColorConfig called ===");
-    LOGE("  Input params: range=%d, standard=%d, transfer=%d, dataspace=0x%x",
+    LOGD("=== nativeDecoderSetColorConfig called ===");
+    LOGD("  Input params: range=%d, standard=%d, transfer=%d, dataspace=0x%x",
          colorRange, colorStandard, colorTransfer, dataspace);
-    LOGE("  Range: %d (%s)", colorRange, color_range_to_string(colorRange));
-    LOGE("  Standard: %d (%s)", colorStandard, color_standard_to_string(colorStandard));
-    LOGE("  Transfer: %d (%s)", colorTransfer, color_transfer_to_string(colorTransfer));
-    LOGE("  Dataspace: 0x%x", dataspace);
+    LOGD("  Range: %d (%s)", colorRange, color_range_to_string(colorRange));
+    LOGD("  Standard: %d (%s)", colorStandard, color_standard_to_string(colorStandard));
+    LOGD("  Transfer: %d (%s)", colorTransfer, color_transfer_to_string(colorTransfer));
+    LOGD("  Dataspace: 0x%x", dataspace);
     g_colorRange = colorRange;
     g_colorStandard = colorStandard;
     g_colorTransfer = colorTransfer;
     g_dataspace = dataspace;
-    // #region agent log
-    logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile) {
-        fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"A\",\"location\":\"native_decoder.c:243\",\"message\":\"nativeDecoderSetColorConfig exit\",\"data\":{\"g_colorRange\":%d,\"g_colorStandard\":%d,\"g_colorTransfer\":%d,\"g_dataspace\":%d},\"timestamp\":%lld}\n",
-                g_colorRange, g_colorStandard, g_colorTransfer, g_dataspace, (long long)time(NULL) * 1000);
-        fclose(logFile);
-    }
-    // #endregion
-    LOGE("=== nativeDecoderSetColorConfig completed ===");
+    LOGD("=== nativeDecoderSetColorConfig completed ===");
 }
 
 JNIEXPORT jint JNICALL
 Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclass clazz, jint videoFormat, jint width, jint height, jint fps) {
     (void)clazz;
-    // Force log visibility - use direct __android_log_print
-    __android_log_print(ANDROID_LOG_ERROR, "NativeDecoder", "=== NATIVE_DECODER_SETUP_CALLED === format=0x%x %dx%d fps=%d", videoFormat, width, height, fps);
-    // #region agent log
-    FILE* logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile) {
-        fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"A\",\"location\":\"native_decoder.c:265\",\"message\":\"nativeDecoderSetup entry\",\"data\":{\"g_hdrEnabled\":%s,\"g_hdrStaticInfoLen\":%zu,\"g_colorRange\":%d,\"g_colorStandard\":%d,\"g_colorTransfer\":%d,\"g_dataspace\":%d},\"timestamp\":%lld}\n",
-                g_hdrEnabled ? "true" : "false", g_hdrStaticInfoLen, g_colorRange, g_colorStandard, g_colorTransfer, g_dataspace, (long long)time(NULL) * 1000);
-        fclose(logFile);
-    }
-    // #endregion
+    LOGD("=== nativeDecoderSetup called === format=0x%x %dx%d fps=%d", videoFormat, width, height, fps);
 
     release_codec();
 
@@ -428,12 +500,13 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
     g_height = height;
     g_fps = fps;
     g_lastPtsUs = 0;
+    memset((void*)g_ptsFrameMap, 0, sizeof(g_ptsFrameMap));
 
     // Early HDR inference: Check if format includes 10-bit mask (VIDEO_FORMAT_MASK_10BIT = 0x2200)
     // If format suggests HDR but HDR mode is not enabled, infer HDR from format negotiation
     bool isHdrFormat = (videoFormat & 0x2200) != 0;
     if (isHdrFormat && !g_hdrEnabled) {
-        LOGE("Early HDR inference: Format includes 10-bit mask (0x%x), enabling HDR mode", videoFormat);
+        LOGI("Early HDR inference: Format includes 10-bit mask (0x%x), enabling HDR mode", videoFormat);
         g_hdrEnabled = true;
         // Note: HDR static info may not be available yet, but format negotiation indicates HDR
     }
@@ -458,13 +531,13 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
 
     const char* mime = mime_from_format(videoFormat);
     
-    LOGE("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_START ===");
-    LOGE("Video format: 0x%x, MIME: %s", videoFormat, mime);
-    LOGE("Resolution: %dx%d, FPS: %d", width, height, fps);
-    LOGE("HDR enabled: %d, HDR static info length: %zu", g_hdrEnabled, g_hdrStaticInfoLen);
+    LOGD("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_START ===");
+    LOGD("Video format: 0x%x, MIME: %s", videoFormat, mime);
+    LOGD("Resolution: %dx%d, FPS: %d", width, height, fps);
+    LOGD("HDR enabled: %d, HDR static info length: %zu", g_hdrEnabled, g_hdrStaticInfoLen);
     
     // Log current color configuration state
-    LOGE("Color config state - Range: %d (%s), Standard: %d (%s), Transfer: %d (%s), Dataspace: 0x%x",
+    LOGD("Color config state - Range: %d (%s), Standard: %d (%s), Transfer: %d (%s), Dataspace: 0x%x",
          g_colorRange, color_range_to_string(g_colorRange),
          g_colorStandard, color_standard_to_string(g_colorStandard),
          g_colorTransfer, color_transfer_to_string(g_colorTransfer),
@@ -479,14 +552,14 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
             // HDR dataspace (BT2020_PQ) was set but HDR is not enabled - use SRGB instead
             effectiveDataspace = HAL_DATASPACE_V0_SRGB;
             ANativeWindow_setBuffersDataSpace(g_window, effectiveDataspace);
-            LOGE("Window dataspace: HDR dataspace (0x%x) was set but HDR not enabled, updated to SRGB (0x%x)", g_dataspace, effectiveDataspace);
+            LOGD("Window dataspace: HDR dataspace (0x%x) was set but HDR not enabled, updated to SRGB (0x%x)", g_dataspace, effectiveDataspace);
         } else if (g_dataspace >= 0) {
-            LOGE("Window dataspace: 0x%x (set via ANativeWindow_setBuffersDataSpace)", g_dataspace);
+            LOGD("Window dataspace: 0x%x (set via ANativeWindow_setBuffersDataSpace)", g_dataspace);
         } else {
             // No dataspace was set, use SRGB for SDR
             effectiveDataspace = HAL_DATASPACE_V0_SRGB;
             ANativeWindow_setBuffersDataSpace(g_window, effectiveDataspace);
-            LOGE("Window dataspace: No dataspace provided, using SRGB (0x%x) for SDR", effectiveDataspace);
+            LOGD("Window dataspace: No dataspace provided, using SRGB (0x%x) for SDR", effectiveDataspace);
         }
     }
 
@@ -504,7 +577,7 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
                     g_decoderName[sizeof(g_decoderName) - 1] = '\0';
                     decoderName = g_decoderName;
                     (*env)->ReleaseStringUTFChars(env, jDecoderName, nameStr);
-                    LOGE("Selected decoder via Java: %s", decoderName);
+                    LOGI("Selected decoder via Java: %s", decoderName);
                 }
                 (*env)->DeleteLocalRef(env, jDecoderName);
             }
@@ -516,17 +589,17 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
     if (decoderName != NULL && strlen(decoderName) > 0) {
         g_codec = AMediaCodec_createCodecByName(decoderName);
         if (g_codec == NULL) {
-            LOGE("Failed to create decoder by name '%s', falling back to createDecoderByType", decoderName);
+            LOGW("Failed to create decoder by name '%s', falling back to createDecoderByType", decoderName);
             g_codec = AMediaCodec_createDecoderByType(mime);
         }
     } else {
-        LOGE("Decoder selection via Java failed, using createDecoderByType");
+        LOGW("Decoder selection via Java failed, using createDecoderByType");
         g_codec = AMediaCodec_createDecoderByType(mime);
     }
     
     if (g_codec == NULL) {
         LOGE("nativeDecoderSetup failed: decoder creation returned null (MIME: %s)", mime);
-        LOGE("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_END (FAILED) ===");
+        LOGD("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_END (FAILED) ===");
         g_decoderState = DECODER_STATE_ERROR;
         return -1;
     }
@@ -542,7 +615,7 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
         // Fallback to device-based detection if decoder name not available
         detect_decoder_info(mime);
     }
-    LOGE("Decoder created for MIME: %s, name: %s, isQTI: %s", mime, g_decoderName[0] != '\0' ? g_decoderName : "unknown", g_isQtiDecoder ? "yes" : "no");
+    LOGI("Decoder created for MIME: %s, name: %s, isQTI: %s", mime, g_decoderName[0] != '\0' ? g_decoderName : "unknown", g_isQtiDecoder ? "yes" : "no");
 
     g_format = AMediaFormat_new();
     AMediaFormat_setString(g_format, AMEDIAFORMAT_KEY_MIME, mime);
@@ -565,7 +638,7 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
                 if (supportsLowLatency) {
                     // Android 11+ official low latency option
                     AMediaFormat_setInt32(g_format, "low-latency", 1);
-                    LOGE("Set low-latency=1 (Android 11+ official option)");
+                    LOGD("Set low-latency=1 (Android 11+ official option)");
                 }
             }
             
@@ -586,20 +659,20 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
                     // Qualcomm low latency options
                     AMediaFormat_setInt32(g_format, "vendor.qti-ext-dec-picture-order.enable", 1);
                     AMediaFormat_setInt32(g_format, "vendor.qti-ext-dec-low-latency.enable", 1);
-                    LOGE("Set QTI low latency options");
+                    LOGD("Set QTI low latency options");
                 } else if (strncmp(decoderName, "c2.hisi", 7) == 0 || strncmp(decoderName, "omx.hisi", 8) == 0) {
                     // HiSilicon (Kirin) low latency options
                     AMediaFormat_setInt32(g_format, "vendor.hisi-ext-low-latency-video-dec.video-scene-for-low-latency-req", 1);
                     AMediaFormat_setInt32(g_format, "vendor.hisi-ext-low-latency-video-dec.video-scene-for-low-latency-rdy", -1);
-                    LOGE("Set HiSilicon low latency options");
+                    LOGD("Set HiSilicon low latency options");
                 } else if (strncmp(decoderName, "c2.exynos", 9) == 0 || strncmp(decoderName, "omx.Exynos", 10) == 0 || strncmp(decoderName, "omx.rtc", 7) == 0) {
                     // Exynos low latency option
                     AMediaFormat_setInt32(g_format, "vendor.rtc-ext-dec-low-latency.enable", 1);
-                    LOGE("Set Exynos low latency option");
+                    LOGD("Set Exynos low latency option");
                 } else if (strncmp(decoderName, "c2.amlogic", 10) == 0 || strncmp(decoderName, "omx.amlogic", 11) == 0) {
                     // Amlogic low latency option
                     AMediaFormat_setInt32(g_format, "vendor.low-latency.enable", 1);
-                    LOGE("Set Amlogic low latency option");
+                    LOGD("Set Amlogic low latency option");
                 }
             }
             
@@ -609,7 +682,7 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
                 jboolean supportsMaxOpRate = (*env)->CallStaticBooleanMethod(env, clazz, supportsMaxOpRateMethod, jDecoderName);
                 if (supportsMaxOpRate) {
                     AMediaFormat_setInt32(g_format, "operating-rate", 32767); // Short.MAX_VALUE
-                    LOGE("Set operating-rate=32767 for Qualcomm decoder");
+                    LOGD("Set operating-rate=32767 for Qualcomm decoder");
                 }
             }
             
@@ -621,7 +694,7 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
                     // Set max width/height for adaptive playback
                     AMediaFormat_setInt32(g_format, "max-width", width);
                     AMediaFormat_setInt32(g_format, "max-height", height);
-                    LOGE("Set adaptive playback (max-width=%d, max-height=%d)", width, height);
+                    LOGD("Set adaptive playback (max-width=%d, max-height=%d)", width, height);
                 }
             }
             
@@ -630,24 +703,8 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
         }
     }
     
-    // #region agent log
-    FILE* logFile1 = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile1) {
-        fprintf(logFile1, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"B\",\"location\":\"native_decoder.c:314\",\"message\":\"Before setting color params in MediaFormat\",\"data\":{\"g_hdrEnabled\":%s,\"g_hdrStaticInfoLen\":%zu,\"g_colorRange\":%d,\"g_colorStandard\":%d,\"g_colorTransfer\":%d,\"g_dataspace\":%d,\"g_dataspaceHex\":\"0x%x\"},\"timestamp\":%lld}\n",
-                g_hdrEnabled ? "true" : "false", g_hdrStaticInfoLen, g_colorRange, g_colorStandard, g_colorTransfer, g_dataspace, g_dataspace, (long long)time(NULL) * 1000);
-        fclose(logFile1);
-    }
-    // #endregion
     // Log color parameters being set in format
-    LOGE("Setting color parameters in MediaFormat:");
-    // #region agent log
-    FILE* logFile2 = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile2) {
-        fprintf(logFile2, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"C\",\"location\":\"native_decoder.c:341\",\"message\":\"HDR check before setting color params\",\"data\":{\"g_hdrEnabled\":%s,\"g_hdrStaticInfoLen\":%zu,\"willUseHdrBranch\":%s},\"timestamp\":%lld}\n",
-                g_hdrEnabled ? "true" : "false", g_hdrStaticInfoLen, (g_hdrEnabled && g_hdrStaticInfoLen > 0) ? "true" : "false", (long long)time(NULL) * 1000);
-        fclose(logFile2);
-    }
-    // #endregion
+    LOGD("Setting color parameters in MediaFormat:");
     
     // Android 7.0 (API 24) adds color options to MediaFormat.
     // QTI decoders don't recognize MediaFormat color keys; skip them for QTI decoders.
@@ -668,12 +725,12 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
     bool shouldSetColorKeys = (deviceApiLevel >= 24) && !g_isQtiDecoder;
     
     if (shouldSetColorKeys) {
-        LOGE("  Setting color keys (Android N+, non-QTI decoder, API %d)", deviceApiLevel);
+        LOGD("  Setting color keys (Android N+, non-QTI decoder, API %d)", deviceApiLevel);
     } else {
         if (deviceApiLevel < 24) {
-            LOGE("  Skipping color keys (Android < N, API %d)", deviceApiLevel);
+            LOGD("  Skipping color keys (Android < N, API %d)", deviceApiLevel);
         } else if (g_isQtiDecoder) {
-            LOGE("  Skipping color keys (QTI decoder: %s)", g_decoderName);
+            LOGD("  Skipping color keys (QTI decoder: %s)", g_decoderName);
         }
     }
     
@@ -689,13 +746,13 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
         if (g_hdrStaticInfoLen > 0) {
             AMediaFormat_setBuffer(g_format, AMEDIAFORMAT_KEY_HDR_STATIC_INFO, g_hdrStaticInfo, g_hdrStaticInfoLen);
         }
-        LOGE("  HDR mode: COLOR_RANGE=%s, COLOR_STANDARD and COLOR_TRANSFER not set (decoder will detect transitions)",
+        LOGD("  HDR mode: COLOR_RANGE=%s, COLOR_STANDARD and COLOR_TRANSFER not set (decoder will detect transitions)",
              shouldSetColorKeys ? "FULL (set)" : "not set (QTI/old Android)");
-        LOGE("  HDR_STATIC_INFO: %zu bytes", g_hdrStaticInfoLen);
+        LOGD("  HDR_STATIC_INFO: %zu bytes", g_hdrStaticInfoLen);
         if (g_hdrStaticInfoLen > 0) {
-            LOGE("  HDR_STATIC_INFO content:");
+            LOGD("  HDR_STATIC_INFO content:");
             for (size_t i = 0; i < g_hdrStaticInfoLen && i < 32; i++) {
-                LOGE("    [%zu]=0x%02x", i, g_hdrStaticInfo[i]);
+                LOGD("    [%zu]=0x%02x", i, g_hdrStaticInfo[i]);
             }
         }
     } else {
@@ -708,14 +765,6 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
         int sdrColorStandard = AMEDIAFORMAT_COLOR_STANDARD_BT709; // Always BT709 for SDR
         int sdrColorTransfer = AMEDIAFORMAT_COLOR_TRANSFER_SRGB; // Use SRGB transfer for SDR display
         
-        // #region agent log
-        logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-        if (logFile) {
-            fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"C\",\"location\":\"native_decoder.c:356\",\"message\":\"Using SDR branch - overriding to SDR values\",\"data\":{\"originalColorRange\":%d,\"originalColorStandard\":%d,\"originalColorTransfer\":%d,\"sdrColorRange\":%d,\"sdrColorStandard\":%d,\"sdrColorTransfer\":%d},\"timestamp\":%lld}\n",
-                    g_colorRange, g_colorStandard, g_colorTransfer, sdrColorRange, sdrColorStandard, sdrColorTransfer, (long long)time(NULL) * 1000);
-            fclose(logFile);
-        }
-        // #endregion
         
         if (shouldSetColorKeys) {
             AMediaFormat_setInt32(g_format, AMEDIAFORMAT_KEY_COLOR_RANGE, sdrColorRange);
@@ -727,29 +776,17 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
         // Some decoders may include a default empty HDR_STATIC_INFO in output format,
         // but that's a decoder behavior we can't control. The important thing is we're
         // not setting it in the input format, and we're using correct SDR color values.
-        LOGE("  SDR mode: COLOR_RANGE=%s, COLOR_STANDARD=%s, COLOR_TRANSFER=%s",
+        LOGD("  SDR mode: COLOR_RANGE=%s, COLOR_STANDARD=%s, COLOR_TRANSFER=%s",
              shouldSetColorKeys ? (color_range_to_string(sdrColorRange)) : "not set (QTI/old Android)",
              shouldSetColorKeys ? (color_standard_to_string(sdrColorStandard)) : "not set (QTI/old Android)",
              shouldSetColorKeys ? (color_transfer_to_string(sdrColorTransfer)) : "not set (QTI/old Android)");
     }
-    // #region agent log
-    logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile) {
-        int32_t setColorRange = -1, setColorStandard = -1, setColorTransfer = -1;
-        AMediaFormat_getInt32(g_format, AMEDIAFORMAT_KEY_COLOR_RANGE, &setColorRange);
-        AMediaFormat_getInt32(g_format, AMEDIAFORMAT_KEY_COLOR_STANDARD, &setColorStandard);
-        AMediaFormat_getInt32(g_format, AMEDIAFORMAT_KEY_COLOR_TRANSFER, &setColorTransfer);
-        fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"B\",\"location\":\"native_decoder.c:337\",\"message\":\"After setting color params in MediaFormat\",\"data\":{\"setColorRange\":%d,\"setColorStandard\":%d,\"setColorTransfer\":%d},\"timestamp\":%lld}\n",
-                setColorRange, setColorStandard, setColorTransfer, (long long)time(NULL) * 1000);
-        fclose(logFile);
-    }
-    // #endregion
 
     media_status_t status = AMediaCodec_configure(g_codec, g_format, g_window, NULL, 0);
     if (status != AMEDIA_OK) {
         LOGE("nativeDecoderSetup failed: AMediaCodec_configure status=%d (decoder: %s, MIME: %s)", 
              status, g_decoderName[0] != '\0' ? g_decoderName : "unknown", mime);
-        LOGE("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_END (FAILED) ===");
+        LOGD("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_END (FAILED) ===");
         g_decoderState = DECODER_STATE_ERROR;
         release_codec();
         return -1;
@@ -770,60 +807,45 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env, jclas
             effectiveDataspace = HAL_DATASPACE_V0_SRGB;
         }
         ANativeWindow_setBuffersDataSpace(g_window, effectiveDataspace);
-        LOGE("Re-applied dataspace to window after decoder configure: 0x%x", effectiveDataspace);
+        LOGD("Re-applied dataspace to window after decoder configure: 0x%x", effectiveDataspace);
     }
 
     // Log negotiated formats with detailed color information
-    LOGE("--- Negotiated Input Format (after configure) ---");
+    LOGD("--- Negotiated Input Format (after configure) ---");
     AMediaFormat* inFmt = AMediaCodec_getInputFormat(g_codec);
     if (inFmt) {
         const char* dump = AMediaFormat_toString(inFmt);
-        LOGE("Input format string: %s", dump ? dump : "(null)");
+        LOGD("Input format string: %s", dump ? dump : "(null)");
         log_color_format_details("Input format", inFmt);
         AMediaFormat_delete(inFmt);
     } else {
-        LOGE("Input format: NULL");
+        LOGD("Input format: NULL");
     }
 
-    LOGE("--- Negotiated Output Format (after configure) ---");
+    LOGD("--- Negotiated Output Format (after configure) ---");
     AMediaFormat* outFmt = AMediaCodec_getOutputFormat(g_codec);
     if (outFmt) {
         const char* dump = AMediaFormat_toString(outFmt);
-        LOGE("Output format string: %s", dump ? dump : "(null)");
+        LOGD("Output format string: %s", dump ? dump : "(null)");
         log_color_format_details("Output format", outFmt);
-        // #region agent log
-        int32_t outColorFormat = -1;
-        int32_t outColorRange = -1;
-        int32_t outColorStandard = -1;
-        int32_t outColorTransfer = -1;
-        AMediaFormat_getInt32(outFmt, AMEDIAFORMAT_KEY_COLOR_FORMAT, &outColorFormat);
-        AMediaFormat_getInt32(outFmt, AMEDIAFORMAT_KEY_COLOR_RANGE, &outColorRange);
-        AMediaFormat_getInt32(outFmt, AMEDIAFORMAT_KEY_COLOR_STANDARD, &outColorStandard);
-        AMediaFormat_getInt32(outFmt, AMEDIAFORMAT_KEY_COLOR_TRANSFER, &outColorTransfer);
-        logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-        if (logFile) {
-            fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"E\",\"location\":\"native_decoder.c:398\",\"message\":\"Output format color values\",\"data\":{\"colorFormat\":%d,\"colorFormatHex\":\"0x%x\",\"colorRange\":%d,\"colorStandard\":%d,\"colorTransfer\":%d},\"timestamp\":%lld}\n",
-                    outColorFormat, outColorFormat, outColorRange, outColorStandard, outColorTransfer, (long long)time(NULL) * 1000);
-            fclose(logFile);
-        }
-        // #endregion
         AMediaFormat_delete(outFmt);
     } else {
-        LOGE("Output format: NULL");
+        LOGD("Output format: NULL");
     }
 
     // Log configured format details
-    LOGE("--- Configured Format (what we set) ---");
+    LOGD("--- Configured Format (what we set) ---");
     log_color_format_details("Configured format", g_format);
 
-    LOGE("nativeDecoderSetup complete - mime=%s size=%dx%d fps=%d hdr=%d hdrStatic=%zu",
+    LOGI("nativeDecoderSetup complete - mime=%s size=%dx%d fps=%d hdr=%d hdrStatic=%zu",
          mime, width, height, fps, g_hdrEnabled, g_hdrStaticInfoLen);
-    LOGE("Decoder setup summary - decoder: %s, state: %d, isQTI: %s, configured: %s",
+    LOGD("Decoder setup summary - decoder: %s, state: %d, isQTI: %s, configured: %s",
          g_decoderName[0] != '\0' ? g_decoderName : "unknown", 
          g_decoderState,
          g_isQtiDecoder ? "yes" : "no",
          g_codec_configured ? "yes" : "no");
-    LOGE("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_END ===");
+    LOGD("=== NATIVE_DECODER_SETUP_COLOR_DEBUG_END ===");
+    g_nativeSubmitActive = true;
     return 0;
 }
 
@@ -847,7 +869,7 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderStart(JNIEnv* env, jclas
     g_started = true;
     g_outputRunning = true;
     g_decoderState = DECODER_STATE_STARTED;
-    LOGE("Decoder started successfully (decoder: %s)", g_decoderName[0] != '\0' ? g_decoderName : "unknown");
+    LOGI("Decoder started successfully (decoder: %s)", g_decoderName[0] != '\0' ? g_decoderName : "unknown");
     pthread_create(&g_outputThread, NULL, output_loop, NULL);
 }
 
@@ -869,24 +891,30 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderCleanup(JNIEnv* env, jcl
     (void)env;
     (void)clazz;
 
+    g_nativeSubmitActive = false;
     release_codec();
     release_window();
 }
 
+JNIEXPORT void JNICALL
+Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetPacingPolicy(JNIEnv* env, jclass clazz, jint policy) {
+    (void)env;
+    (void)clazz;
+
+    if (policy < 0 || policy >= PACING_POLICY_COUNT) {
+        LOGE("nativeDecoderSetPacingPolicy: invalid policy %d", policy);
+        return;
+    }
+
+    LOGI("Output pacing policy: %s", output_pacer_policy_name((pacing_policy_t)policy));
+    g_pacingPolicy = policy;
+}
+
 JNIEXPORT void JNICALL
 Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetHdrMode(JNIEnv* env, jclass clazz, jboolean enabled, jbyteArray hdrMetadata) {
     (void)clazz;
-    // #region agent log
-    FILE* logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile) {
-        jsize metadataLen = (hdrMetadata != NULL) ? (*env)->GetArrayLength(env, hdrMetadata) : 0;
-        fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"A\",\"location\":\"native_decoder.c:423\",\"message\":\"nativeDecoderSetHdrMode entry\",\"data\":{\"enabled\":%s,\"hdrMetadataLen\":%d},\"timestamp\":%lld}\n",
-                (enabled == JNI_TRUE) ? "true" : "false", (int)metadataLen, (long long)time(NULL) * 1000);
-        fclose(logFile);
-    }
-    // #endregion
-    LOGE("=== nativeDecoderSetHdrMode called ===");
-    LOGE("  HDR enabled: %s", (enabled == JNI_TRUE) ? "true" : "false");
+    LOGD("=== nativeDecoderSetHdrMode called ===");
+    LOGD("  HDR enabled: %s", (enabled == JNI_TRUE) ? "true" : "false");
     
     bool newHdrEnabled = enabled == JNI_TRUE;
     bool hdrStateChanged = (g_lastHdrEnabled != newHdrEnabled);
@@ -896,52 +924,39 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetHdrMode(JNIEnv* env,
 
     if (g_hdrEnabled && hdrMetadata != NULL) {
         jsize len = (*env)->GetArrayLength(env, hdrMetadata);
-        LOGE("  HDR metadata array length: %d", len);
+        LOGD("  HDR metadata array length: %d", len);
         if (len > 0 && (size_t)len <= sizeof(g_hdrStaticInfo)) {
             (*env)->GetByteArrayRegion(env, hdrMetadata, 0, len, (jbyte*)g_hdrStaticInfo);
             g_hdrStaticInfoLen = (size_t)len;
-            LOGE("  HDR static info copied: %zu bytes", g_hdrStaticInfoLen);
-            LOGE("  HDR static info content:");
+            LOGD("  HDR static info copied: %zu bytes", g_hdrStaticInfoLen);
+            LOGD("  HDR static info content:");
             for (size_t i = 0; i < g_hdrStaticInfoLen && i < 32; i++) {
-                LOGE("    [%zu]=0x%02x", i, g_hdrStaticInfo[i]);
+                LOGD("    [%zu]=0x%02x", i, g_hdrStaticInfo[i]);
             }
         } else {
-            LOGE("  WARNING: HDR metadata length %d is invalid (max %zu)", len, sizeof(g_hdrStaticInfo));
+            LOGW("  WARNING: HDR metadata length %d is invalid (max %zu)", len, sizeof(g_hdrStaticInfo));
         }
     } else {
-        LOGE("  HDR metadata: %s", (hdrMetadata == NULL) ? "NULL" : "not provided");
+        LOGD("  HDR metadata: %s", (hdrMetadata == NULL) ? "NULL" : "not provided");
     }
     
     // If decoder is already configured and HDR state changed, restart decoder
     if (g_codec_configured && hdrStateChanged) {
-        LOGE("  HDR state changed (was %s, now %s) - decoder restart required", 
+        LOGI("  HDR state changed (was %s, now %s) - decoder restart required", 
              g_lastHdrEnabled ? "enabled" : "disabled",
              g_hdrEnabled ? "enabled" : "disabled");
-        LOGE("  Releasing decoder to trigger restart on next setup");
+        LOGI("  Releasing decoder to trigger restart on next setup");
         release_codec();
         // Note: Decoder will be reconfigured on next nativeDecoderSetup() call
         // The bridge will call setup() again when it detects the decoder needs restart
     }
     
     g_lastHdrEnabled = g_hdrEnabled;
-    // #region agent log
-    logFile = fopen("d:\\Tools\\Moonlight-SpatialSDK\\.cursor\\debug.log", "a");
-    if (logFile) {
-        fprintf(logFile, "{\"sessionId\":\"debug-session\",\"runId\":\"run1\",\"hypothesisId\":\"A\",\"location\":\"native_decoder.c:447\",\"message\":\"nativeDecoderSetHdrMode exit\",\"data\":{\"g_hdrEnabled\":%s,\"g_hdrStaticInfoLen\":%zu},\"timestamp\":%lld}\n",
-                g_hdrEnabled ? "true" : "false", g_hdrStaticInfoLen, (long long)time(NULL) * 1000);
-        fclose(logFile);
-    }
-    // #endregion
-    LOGE("=== nativeDecoderSetHdrMode completed ===");
+    LOGD("=== nativeDecoderSetHdrMode completed ===");
 }
 
-JNIEXPORT jint JNICALL
-Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jclass clazz, jbyteArray data, jint length, jint decodeUnitType, jint frameNumber, jint frameType, jchar frameHostProcessingLatency, jlong receiveTimeMs, jlong enqueueTimeMs) {
-    (void)clazz;
-    (void)frameHostProcessingLatency;
-    (void)receiveTimeMs;
-    (void)frameNumber;
-
+// Returns DR_OK if the decoder can accept input, attempting recovery if it's in an error state
+static int check_decoder_ready(void) {
     if (!g_started || g_codec == NULL) {
         LOGE("nativeDecoderSubmit: decoder not started or NULL (state: %d, decoder: %s)", 
              g_decoderState, g_decoderName[0] != '\0' ? g_decoderName : "unknown");
@@ -951,7 +966,7 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jcla
     // Phase 4: Check decoder state and attempt recovery if in error state
     if (g_decoderState == DECODER_STATE_ERROR) {
         if (g_errorRecoveryAttempts < MAX_RECOVERY_ATTEMPTS) {
-            LOGE("Decoder in error state, attempting recovery (attempt %d/%d)", 
+            LOGW("Decoder in error state, attempting recovery (attempt %d/%d)", 
                  g_errorRecoveryAttempts + 1, MAX_RECOVERY_ATTEMPTS);
             if (attempt_flush_recovery()) {
                 // Flush successful, continue
@@ -967,6 +982,12 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jcla
         }
     }
 
+    return DR_OK;
+}
+
+// Dequeues a codec input buffer large enough for length bytes. Returns the buffer index,
+// or a negative value if no suitable buffer is available.
+static ssize_t acquire_input_buffer(uint32_t frameNumber, size_t length, uint8_t** buf) {
     ssize_t bufIndex = AMediaCodec_dequeueInputBuffer(g_codec, 10000);
     if (bufIndex < 0) {
         // Phase 4: Enhanced error logging
@@ -980,18 +1001,23 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jcla
                 g_decoderState = DECODER_STATE_ERROR;
             }
         }
-        return DR_NEED_IDR;
+        return -1;
     }
 
+    LiTraceVideoFrame(frameNumber, FRAME_TRACE_INPUT_ACQUIRED);
+
     size_t bufSize = 0;
-    uint8_t* buf = AMediaCodec_getInputBuffer(g_codec, (size_t)bufIndex, &bufSize);
-    if (buf == NULL || bufSize < (size_t)length) {
+    *buf = AMediaCodec_getInputBuffer(g_codec, (size_t)bufIndex, &bufSize);
+    if (*buf == NULL || bufSize < length) {
         AMediaCodec_queueInputBuffer(g_codec, (size_t)bufIndex, 0, 0, 0, 0);
-        return DR_NEED_IDR;
+        return -1;
     }
 
-    (*env)->GetByteArrayRegion(env, data, 0, length, (jbyte*)buf);
+    return bufIndex;
+}
 
+static int queue_input_buffer(ssize_t bufIndex, size_t length, int decodeUnitType, int frameType,
+                              uint32_t frameNumber, int64_t enqueueTimeUs) {
     uint32_t flags = 0;
     if (decodeUnitType != BUFFER_TYPE_PICDATA) {
         flags |= AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG;
@@ -1004,14 +1030,14 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jcla
     if ((flags & AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG) != 0) {
         ptsUs = 0;
     } else {
-        ptsUs = enqueueTimeMs * 1000;
+        ptsUs = enqueueTimeUs;
         if (ptsUs <= g_lastPtsUs) {
             ptsUs = g_lastPtsUs + 1;
         }
         g_lastPtsUs = ptsUs;
     }
 
-    media_status_t status = AMediaCodec_queueInputBuffer(g_codec, (size_t)bufIndex, 0, (size_t)length, ptsUs, flags);
+    media_status_t status = AMediaCodec_queueInputBuffer(g_codec, (size_t)bufIndex, 0, length, ptsUs, flags);
     if (status != AMEDIA_OK) {
         LOGE("nativeDecoderSubmit: AMediaCodec_queueInputBuffer failed status=%d (decoder: %s, state: %d)", 
              status, g_decoderName[0] != '\0' ? g_decoderName : "unknown", g_decoderState);
@@ -1022,6 +1048,86 @@ Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jcla
         return DR_NEED_IDR;
     }
 
+    LiTraceVideoFrame(frameNumber, FRAME_TRACE_QUEUED);
+    if (ptsUs != 0) {
+        remember_frame_pts(ptsUs, frameNumber);
+    }
+
     return DR_OK;
 }
 
+JNIEXPORT jint JNICALL
+Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jclass clazz, jbyteArray data, jint length, jint decodeUnitType, jint frameNumber, jint frameType, jchar frameHostProcessingLatency, jlong receiveTimeUs, jlong enqueueTimeUs) {
+    (void)clazz;
+    (void)frameHostProcessingLatency;
+    (void)receiveTimeUs;
+
+    int err = check_decoder_ready();
+    if (err != DR_OK) {
+        return err;
+    }
+
+    uint8_t* buf;
+    ssize_t bufIndex = acquire_input_buffer((uint32_t)frameNumber, (size_t)length, &buf);
+    if (bufIndex < 0) {
+        return DR_NEED_IDR;
+    }
+
+    (*env)->GetByteArrayRegion(env, data, 0, length, (jbyte*)buf);
+
+    return queue_input_buffer(bufIndex, (size_t)length, decodeUnitType, frameType, (uint32_t)frameNumber, enqueueTimeUs);
+}
+
+// Copies a parameter set, or all picture data if paramSet is NULL, from the decode
+// unit's buffer list straight into a codec input buffer and queues it
+static int submit_native_buffer(PDECODE_UNIT decodeUnit, PLENTRY paramSet, int length) {
+    uint8_t* buf;
+    ssize_t bufIndex = acquire_input_buffer(decodeUnit->frameNumber, (size_t)length, &buf);
+    if (bufIndex < 0) {
+        return DR_NEED_IDR;
+    }
+
+    if (paramSet != NULL) {
+        memcpy(buf, paramSet->data, (size_t)length);
+    } else {
+        size_t offset = 0;
+        for (PLENTRY entry = decodeUnit->bufferList; entry != NULL; entry = entry->next) {
+            if (entry->bufferType == BUFFER_TYPE_PICDATA) {
+                memcpy(buf + offset, entry->data, (size_t)entry->length);
+                offset += (size_t)entry->length;
+            }
+        }
+    }
+
+    return queue_input_buffer(bufIndex, (size_t)length,
+                              paramSet != NULL ? paramSet->bufferType : BUFFER_TYPE_PICDATA,
+                              decodeUnit->frameType, decodeUnit->frameNumber,
+                              (int64_t)decodeUnit->enqueueTimeUs);
+}
+
+bool nativeDecoderIsActive(void) {
+    return g_nativeSubmitActive;
+}
+
+int nativeDecoderSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
+    int err = check_decoder_ready();
+    if (err != DR_OK) {
+        return err;
+    }
+
+    // Submit parameter set NALUs separately from picture data, just like
+    // the JNI bridge does for decoders implemented in Java
+    int picDataLength = decodeUnit->fullLength;
+    for (PLENTRY entry = decodeUnit->bufferList; entry != NULL; entry = entry->next) {
+        if (entry->bufferType != BUFFER_TYPE_PICDATA) {
+            err = submit_native_buffer(decodeUnit, entry, entry->length);
+            if (err != DR_OK) {
+                return err;
+            }
+
+            picDataLength -= entry->length;
+        }
+    }
+
+    return submit_native_buffer(decodeUnit, NULL, picDataLength);
+}
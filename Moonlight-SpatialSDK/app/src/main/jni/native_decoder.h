@@ -1,6 +1,9 @@
 #pragma once
 
 #include <jni.h>
+#include <stdbool.h>
+
+#include <Limelight.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,10 +13,17 @@ jint Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(JNIEnv* env,
 void Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderStart(JNIEnv* env, jclass clazz);
 void Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderStop(JNIEnv* env, jclass clazz);
 void Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderCleanup(JNIEnv* env, jclass clazz);
+void Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetPacingPolicy(JNIEnv* env, jclass clazz, jint policy);
 void Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetSurface(JNIEnv* env, jclass clazz, jobject surface);
 void Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetColorConfig(JNIEnv* env, jclass clazz, jint colorRange, jint colorStandard, jint colorTransfer, jint dataspace);
 void Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetHdrMode(JNIEnv* env, jclass clazz, jboolean enabled, jbyteArray hdrMetadata);
-jint Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jclass clazz, jbyteArray data, jint length, jint decodeUnitType, jint frameNumber, jint frameType, jchar frameHostProcessingLatency, jlong receiveTimeMs, jlong enqueueTimeMs);
+jint Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(JNIEnv* env, jclass clazz, jbyteArray data, jint length, jint decodeUnitType, jint frameNumber, jint frameType, jchar frameHostProcessingLatency, jlong receiveTimeUs, jlong enqueueTimeUs);
+
+// Returns true if the native decoder is set up and can accept decode units directly
+bool nativeDecoderIsActive(void);
+
+// Submits a decode unit by copying its buffers straight into codec input buffers
+int nativeDecoderSubmitDecodeUnit(PDECODE_UNIT decodeUnit);
 
 #ifdef __cplusplus
 }
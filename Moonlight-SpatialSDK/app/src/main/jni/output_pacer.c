@@ -0,0 +1,146 @@
+#include "output_pacer.h"
+
+#include <string.h>
+
+// Frames that are more than this many frame intervals old when they come out
+// of the decoder are dropped if another frame was presented recently, since
+// presenting them would only add latency.
+#define STALE_FRAME_INTERVALS 3
+
+// In display-timed mode, never schedule a frame further than this many
+// frame intervals in the future. If we fall that far behind, we resync
+// to the current time instead of building up a queue of frames.
+#define MAX_SCHEDULE_INTERVALS 2
+
+static void render_frame(output_pacer_t* pacer, size_t index, int64_t ptsUs, int64_t nowNs, int64_t renderTimeNs) {
+    pacing_stats_t* stats = &pacer->stats[pacer->policy];
+    int64_t displayNs = renderTimeNs != 0 ? renderTimeNs : nowNs;
+    int64_t latencyUs = displayNs / 1000 - ptsUs;
+
+    pacer->ops.render(pacer->ops.context, index, ptsUs, renderTimeNs);
+
+    stats->framesRendered++;
+    if (latencyUs > 0) {
+        stats->totalLatencyUs += (uint64_t)latencyUs;
+        if (latencyUs > (int64_t)stats->maxLatencyUs) {
+            stats->maxLatencyUs = latencyUs > UINT32_MAX ? UINT32_MAX : (uint32_t)latencyUs;
+        }
+    }
+}
+
+static void drop_frame(output_pacer_t* pacer, size_t index, int64_t ptsUs) {
+    pacer->ops.drop(pacer->ops.context, index, ptsUs);
+    pacer->stats[pacer->policy].framesDropped++;
+}
+
+static bool is_stale(const output_pacer_t* pacer, int64_t ptsUs, int64_t nowNs) {
+    if (nowNs / 1000 - ptsUs <= pacer->staleFrameNs / 1000) {
+        return false;
+    }
+
+    // Never drop a frame if the display has nothing else to show, or a
+    // decoder with high latency would never get anything on screen.
+    return pacer->lastRenderTimeNs != 0 && nowNs - pacer->lastRenderTimeNs < pacer->frameIntervalNs;
+}
+
+static void schedule_frame(output_pacer_t* pacer, size_t index, int64_t ptsUs, int64_t nowNs) {
+    int64_t renderTimeNs = pacer->lastRenderTimeNs + pacer->frameIntervalNs;
+
+    if (renderTimeNs <= nowNs || renderTimeNs - nowNs > pacer->frameIntervalNs * MAX_SCHEDULE_INTERVALS) {
+        // We're either idle or too far behind, so start a new cadence with this frame
+        renderTimeNs = nowNs;
+    }
+
+    pacer->lastRenderTimeNs = renderTimeNs;
+    render_frame(pacer, index, ptsUs, nowNs, renderTimeNs);
+}
+
+void output_pacer_init(output_pacer_t* pacer, pacing_policy_t policy, int fps, const pacer_ops_t* ops) {
+    memset(pacer, 0, sizeof(*pacer));
+
+    pacer->policy = policy;
+    pacer->ops = *ops;
+    pacer->frameIntervalNs = 1000000000LL / (fps > 0 ? fps : 60);
+    pacer->staleFrameNs = pacer->frameIntervalNs * STALE_FRAME_INTERVALS;
+}
+
+void output_pacer_set_policy(output_pacer_t* pacer, pacing_policy_t policy) {
+    if (policy == pacer->policy || policy < 0 || policy >= PACING_POLICY_COUNT) {
+        return;
+    }
+
+    output_pacer_flush(pacer);
+
+    pacer->policy = policy;
+    pacer->lastRenderTimeNs = 0;
+}
+
+void output_pacer_on_output(output_pacer_t* pacer, size_t index, int64_t ptsUs) {
+    int64_t nowNs = pacer->ops.now_ns(pacer->ops.context);
+
+    switch (pacer->policy) {
+    case PACING_POLICY_LATEST_FRAME:
+        // A newer frame is ready, so the held one will never be shown
+        if (pacer->hasPending) {
+            drop_frame(pacer, pacer->pendingIndex, pacer->pendingPtsUs);
+        }
+
+        pacer->hasPending = true;
+        pacer->pendingIndex = index;
+        pacer->pendingPtsUs = ptsUs;
+        break;
+
+    case PACING_POLICY_DISPLAY_TIMED:
+        if (is_stale(pacer, ptsUs, nowNs)) {
+            drop_frame(pacer, index, ptsUs);
+        }
+        else {
+            schedule_frame(pacer, index, ptsUs, nowNs);
+        }
+        break;
+
+    case PACING_POLICY_IMMEDIATE:
+    default:
+        render_frame(pacer, index, ptsUs, nowNs, 0);
+        break;
+    }
+}
+
+bool output_pacer_flush(output_pacer_t* pacer) {
+    if (!pacer->hasPending) {
+        return false;
+    }
+
+    int64_t nowNs = pacer->ops.now_ns(pacer->ops.context);
+
+    pacer->hasPending = false;
+
+    // Never drop the only frame we have, even if it's stale, or
+    // a slow decoder would never get anything on screen.
+    render_frame(pacer, pacer->pendingIndex, pacer->pendingPtsUs, nowNs, 0);
+    return true;
+}
+
+void output_pacer_discard(output_pacer_t* pacer) {
+    if (pacer->hasPending) {
+        pacer->hasPending = false;
+        drop_frame(pacer, pacer->pendingIndex, pacer->pendingPtsUs);
+    }
+}
+
+bool output_pacer_has_pending(const output_pacer_t* pacer) {
+    return pacer->hasPending;
+}
+
+const char* output_pacer_policy_name(pacing_policy_t policy) {
+    switch (policy) {
+    case PACING_POLICY_IMMEDIATE:
+        return "immediate";
+    case PACING_POLICY_LATEST_FRAME:
+        return "latest-frame";
+    case PACING_POLICY_DISPLAY_TIMED:
+        return "display-timed";
+    default:
+        return "unknown";
+    }
+}
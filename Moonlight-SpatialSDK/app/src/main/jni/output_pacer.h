@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// How decoded frames are handed to the display
+typedef enum {
+    // Render every frame as soon as the decoder outputs it
+    PACING_POLICY_IMMEDIATE = 0,
+
+    // Render only the newest frame of each batch the decoder outputs,
+    // dropping any older frames that were ready at the same time
+    PACING_POLICY_LATEST_FRAME = 1,
+
+    // Schedule frames one frame interval apart using timed release, so
+    // bursts are smoothed out rather than presented back to back
+    PACING_POLICY_DISPLAY_TIMED = 2,
+
+    PACING_POLICY_COUNT
+} pacing_policy_t;
+
+// The pacer never touches the codec or the clock itself, so it can be
+// driven by a fake codec and clock outside of Android.
+typedef struct {
+    // Returns the current time on the clock used for presentation timestamps
+    int64_t (*now_ns)(void* context);
+
+    // Renders an output buffer at renderTimeNs, or as soon as possible if it's 0
+    void (*render)(void* context, size_t index, int64_t ptsUs, int64_t renderTimeNs);
+
+    // Releases an output buffer without rendering it
+    void (*drop)(void* context, size_t index, int64_t ptsUs);
+
+    void* context;
+} pacer_ops_t;
+
+typedef struct {
+    uint32_t framesRendered;
+    uint32_t framesDropped;
+
+    // Time from each rendered frame's PTS (when it was queued to the
+    // decoder) to the time it was rendered or scheduled to be rendered
+    uint64_t totalLatencyUs;
+    uint32_t maxLatencyUs;
+} pacing_stats_t;
+
+typedef struct {
+    pacing_policy_t policy;
+    pacer_ops_t ops;
+    int64_t frameIntervalNs;
+
+    // Frames older than this are dropped rather than rendered (except
+    // in immediate mode, which never drops frames)
+    int64_t staleFrameNs;
+
+    // Newest frame waiting for the end of the batch in latest-frame mode
+    bool hasPending;
+    size_t pendingIndex;
+    int64_t pendingPtsUs;
+
+    // Time the previous frame was scheduled for in display-timed mode
+    int64_t lastRenderTimeNs;
+
+    pacing_stats_t stats[PACING_POLICY_COUNT];
+} output_pacer_t;
+
+void output_pacer_init(output_pacer_t* pacer, pacing_policy_t policy, int fps, const pacer_ops_t* ops);
+
+// Switches policies, first rendering any frame held by the old policy
+void output_pacer_set_policy(output_pacer_t* pacer, pacing_policy_t policy);
+
+// Called for each output buffer that the decoder produces
+void output_pacer_on_output(output_pacer_t* pacer, size_t index, int64_t ptsUs);
+
+// Called once the decoder has no more output buffers ready. Returns true if a frame was rendered.
+bool output_pacer_flush(output_pacer_t* pacer);
+
+// Releases any held frame without rendering it (for example, when the codec is stopping)
+void output_pacer_discard(output_pacer_t* pacer);
+
+bool output_pacer_has_pending(const output_pacer_t* pacer);
+
+const char* output_pacer_policy_name(pacing_policy_t policy);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,478 @@
+#include "parallel_opus.h"
+
+#include <opus.h>
+#include <opus_multistream.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Largest Opus packet for a single elementary stream (RFC 6716, section 3.4)
+#define MAX_STREAM_PACKET_SIZE 1275
+
+struct parallel_opus_decoder {
+    // Used instead of the elementary stream decoders when decoding on one thread
+    OpusMSDecoder* msDecoder;
+
+    int channelCount;
+    int streams;
+    int coupledStreams;
+    int samplesPerFrame;
+    unsigned char mapping[AUDIO_CONFIGURATION_MAX_CHANNEL_COUNT];
+
+    OpusDecoder** decoders;
+
+    // The current packet for each elementary stream and its decoded PCM
+    const unsigned char** streamData;
+    int* streamLength;
+    int* streamResult;
+    int16_t* streamPcm;
+
+    // Elementary streams other than the last are self-delimited in the
+    // multistream packet, so we copy them here in the standard format.
+    unsigned char* scratch;
+
+    int threadCount;
+    pthread_t* threads;
+    int threadsStarted;
+    bool syncInitialized;
+
+    // Protects everything below
+    pthread_mutex_t mutex;
+    pthread_cond_t workCond;
+    pthread_cond_t doneCond;
+    uint32_t generation;
+    int frameSize;
+    int pendingThreads;
+    bool stopping;
+};
+
+typedef struct {
+    parallel_opus_decoder_t* decoder;
+    int index;
+} worker_context_t;
+
+// Parses a frame length (RFC 6716, section 3.2.1). Returns the bytes it used or -1.
+static int parse_size(const unsigned char* data, int length, int* size) {
+    if (length < 1) {
+        return -1;
+    }
+    else if (data[0] < 252) {
+        *size = data[0];
+        return 1;
+    }
+    else if (length < 2) {
+        return -1;
+    }
+    else {
+        *size = 4 * data[1] + data[0];
+        return 2;
+    }
+}
+
+// Converts a self-delimited Opus packet (RFC 6716, appendix B) to the standard
+// format by removing the extra length field. Returns the bytes consumed from the
+// input or -1 if the packet is malformed.
+static int unframe_self_delimited(const unsigned char* data, int length, unsigned char* out, int* outLength) {
+    int pos = 1;
+    int frameCount;
+    int frameBytes = 0;
+    int paddingBytes = 0;
+    int lengthStart, lengthEnd;
+    int size, used;
+
+    if (length < 1) {
+        return -1;
+    }
+
+    switch (data[0] & 0x3) {
+    case 0:
+    case 1:
+        // One frame or two equal frames, whose size is the self-delimiting length
+        frameCount = (data[0] & 0x3) + 1;
+        lengthStart = pos;
+        used = parse_size(&data[pos], length - pos, &size);
+        if (used < 0) {
+            return -1;
+        }
+        pos += used;
+        lengthEnd = pos;
+        frameBytes = frameCount * size;
+        break;
+
+    case 2:
+        // Two frames with the size of the first, then the self-delimiting size of the second
+        used = parse_size(&data[pos], length - pos, &size);
+        if (used < 0) {
+            return -1;
+        }
+        pos += used;
+        frameBytes = size;
+
+        lengthStart = pos;
+        used = parse_size(&data[pos], length - pos, &size);
+        if (used < 0) {
+            return -1;
+        }
+        pos += used;
+        lengthEnd = pos;
+        frameBytes += size;
+        break;
+
+    default:
+        // An arbitrary number of frames with optional padding
+        if (length < 2) {
+            return -1;
+        }
+        frameCount = data[1] & 0x3F;
+        if (frameCount == 0) {
+            return -1;
+        }
+        pos = 2;
+
+        if (data[1] & 0x40) {
+            int paddingLength;
+
+            do {
+                if (pos >= length) {
+                    return -1;
+                }
+                paddingLength = data[pos++];
+                paddingBytes += paddingLength == 255 ? 254 : paddingLength;
+            } while (paddingLength == 255);
+        }
+
+        if (data[1] & 0x80) {
+            // VBR frames have explicit sizes for all but the last frame
+            for (int i = 0; i < frameCount - 1; i++) {
+                used = parse_size(&data[pos], length - pos, &size);
+                if (used < 0) {
+                    return -1;
+                }
+                pos += used;
+                frameBytes += size;
+            }
+
+            lengthStart = pos;
+            used = parse_size(&data[pos], length - pos, &size);
+            if (used < 0) {
+                return -1;
+            }
+            pos += used;
+            lengthEnd = pos;
+            frameBytes += size;
+        }
+        else {
+            // CBR frames all share the self-delimiting size
+            lengthStart = pos;
+            used = parse_size(&data[pos], length - pos, &size);
+            if (used < 0) {
+                return -1;
+            }
+            pos += used;
+            lengthEnd = pos;
+            frameBytes = frameCount * size;
+        }
+        break;
+    }
+
+    if (pos + frameBytes + paddingBytes > length ||
+        pos - (lengthEnd - lengthStart) + frameBytes + paddingBytes > MAX_STREAM_PACKET_SIZE) {
+        return -1;
+    }
+
+    memcpy(out, data, lengthStart);
+    memcpy(&out[lengthStart], &data[lengthEnd], pos - lengthEnd + frameBytes + paddingBytes);
+    *outLength = pos - (lengthEnd - lengthStart) + frameBytes + paddingBytes;
+    return pos + frameBytes + paddingBytes;
+}
+
+static int stream_channels(const parallel_opus_decoder_t* decoder, int stream) {
+    return stream < decoder->coupledStreams ? 2 : 1;
+}
+
+static int16_t* stream_pcm(const parallel_opus_decoder_t* decoder, int stream) {
+    return &decoder->streamPcm[stream * 2 * decoder->samplesPerFrame];
+}
+
+// Each thread decodes every threadCount'th stream starting at its own index
+static void decode_streams(parallel_opus_decoder_t* decoder, int index, int frameSize) {
+    for (int i = index; i < decoder->streams; i += decoder->threadCount) {
+        decoder->streamResult[i] = opus_decode(decoder->decoders[i],
+                                               decoder->streamData[i],
+                                               decoder->streamLength[i],
+                                               stream_pcm(decoder, i),
+                                               frameSize,
+                                               0);
+    }
+}
+
+static void* worker_thread_proc(void* context) {
+    worker_context_t* worker = (worker_context_t*)context;
+    parallel_opus_decoder_t* decoder = worker->decoder;
+    int index = worker->index;
+    uint32_t lastGeneration = 0;
+
+    free(worker);
+
+    pthread_mutex_lock(&decoder->mutex);
+    for (;;) {
+        int frameSize;
+
+        while (!decoder->stopping && decoder->generation == lastGeneration) {
+            pthread_cond_wait(&decoder->workCond, &decoder->mutex);
+        }
+        if (decoder->stopping) {
+            break;
+        }
+
+        lastGeneration = decoder->generation;
+        frameSize = decoder->frameSize;
+        pthread_mutex_unlock(&decoder->mutex);
+
+        decode_streams(decoder, index, frameSize);
+
+        pthread_mutex_lock(&decoder->mutex);
+        if (--decoder->pendingThreads == 0) {
+            pthread_cond_signal(&decoder->doneCond);
+        }
+    }
+    pthread_mutex_unlock(&decoder->mutex);
+
+    return NULL;
+}
+
+parallel_opus_decoder_t* parallel_opus_decoder_create(const OPUS_MULTISTREAM_CONFIGURATION* config, int threadCount) {
+    parallel_opus_decoder_t* decoder;
+    int err;
+
+    decoder = calloc(1, sizeof(*decoder));
+    if (decoder == NULL) {
+        return NULL;
+    }
+
+    decoder->channelCount = config->channelCount;
+    decoder->streams = config->streams;
+    decoder->coupledStreams = config->coupledStreams;
+    decoder->samplesPerFrame = config->samplesPerFrame;
+    memcpy(decoder->mapping, config->mapping, sizeof(decoder->mapping));
+
+    // There's no point in using more threads than there are streams
+    decoder->threadCount = threadCount < config->streams ? threadCount : config->streams;
+    if (decoder->threadCount <= 1) {
+        decoder->threadCount = 1;
+        decoder->msDecoder = opus_multistream_decoder_create(config->sampleRate,
+                                                             config->channelCount,
+                                                             config->streams,
+                                                             config->coupledStreams,
+                                                             config->mapping,
+                                                             &err);
+        if (decoder->msDecoder == NULL) {
+            free(decoder);
+            return NULL;
+        }
+
+        return decoder;
+    }
+
+    decoder->decoders = calloc(decoder->streams, sizeof(*decoder->decoders));
+    decoder->streamData = calloc(decoder->streams, sizeof(*decoder->streamData));
+    decoder->streamLength = calloc(decoder->streams, sizeof(*decoder->streamLength));
+    decoder->streamResult = calloc(decoder->streams, sizeof(*decoder->streamResult));
+    decoder->streamPcm = calloc((size_t)decoder->streams * 2 * decoder->samplesPerFrame, sizeof(int16_t));
+    decoder->scratch = malloc((size_t)decoder->streams * MAX_STREAM_PACKET_SIZE);
+    decoder->threads = calloc(decoder->threadCount, sizeof(*decoder->threads));
+    if (decoder->decoders == NULL || decoder->streamData == NULL || decoder->streamLength == NULL ||
+        decoder->streamResult == NULL || decoder->streamPcm == NULL || decoder->scratch == NULL ||
+        decoder->threads == NULL) {
+        parallel_opus_decoder_destroy(decoder);
+        return NULL;
+    }
+
+    for (int i = 0; i < decoder->streams; i++) {
+        decoder->decoders[i] = opus_decoder_create(config->sampleRate, stream_channels(decoder, i), &err);
+        if (decoder->decoders[i] == NULL) {
+            parallel_opus_decoder_destroy(decoder);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_init(&decoder->mutex, NULL);
+    pthread_cond_init(&decoder->workCond, NULL);
+    pthread_cond_init(&decoder->doneCond, NULL);
+    decoder->syncInitialized = true;
+
+    // The calling thread acts as the first worker
+    for (int i = 1; i < decoder->threadCount; i++) {
+        worker_context_t* worker = malloc(sizeof(*worker));
+        if (worker == NULL) {
+            parallel_opus_decoder_destroy(decoder);
+            return NULL;
+        }
+
+        worker->decoder = decoder;
+        worker->index = i;
+        if (pthread_create(&decoder->threads[i], NULL, worker_thread_proc, worker) != 0) {
+            free(worker);
+            parallel_opus_decoder_destroy(decoder);
+            return NULL;
+        }
+        decoder->threadsStarted++;
+    }
+
+    return decoder;
+}
+
+void parallel_opus_decoder_destroy(parallel_opus_decoder_t* decoder) {
+    if (decoder == NULL) {
+        return;
+    }
+
+    if (decoder->msDecoder != NULL) {
+        opus_multistream_decoder_destroy(decoder->msDecoder);
+        free(decoder);
+        return;
+    }
+
+    if (decoder->syncInitialized) {
+        pthread_mutex_lock(&decoder->mutex);
+        decoder->stopping = true;
+        pthread_cond_broadcast(&decoder->workCond);
+        pthread_mutex_unlock(&decoder->mutex);
+
+        for (int i = 1; i <= decoder->threadsStarted; i++) {
+            pthread_join(decoder->threads[i], NULL);
+        }
+
+        pthread_cond_destroy(&decoder->doneCond);
+        pthread_cond_destroy(&decoder->workCond);
+        pthread_mutex_destroy(&decoder->mutex);
+    }
+
+    if (decoder->decoders != NULL) {
+        for (int i = 0; i < decoder->streams; i++) {
+            if (decoder->decoders[i] != NULL) {
+                opus_decoder_destroy(decoder->decoders[i]);
+            }
+        }
+    }
+
+    free(decoder->decoders);
+    free(decoder->streamData);
+    free(decoder->streamLength);
+    free(decoder->streamResult);
+    free(decoder->streamPcm);
+    free(decoder->scratch);
+    free(decoder->threads);
+    free(decoder);
+}
+
+// Points each elementary stream at its packet within the multistream packet
+static int split_packet(parallel_opus_decoder_t* decoder, const unsigned char* data, int length) {
+    for (int i = 0; i < decoder->streams; i++) {
+        if (data == NULL) {
+            // Packet loss concealment for every stream
+            decoder->streamData[i] = NULL;
+            decoder->streamLength[i] = 0;
+        }
+        else if (i == decoder->streams - 1) {
+            // The last stream is in the standard format and takes the rest of the packet
+            if (length <= 0) {
+                return OPUS_INVALID_PACKET;
+            }
+            decoder->streamData[i] = data;
+            decoder->streamLength[i] = length;
+        }
+        else {
+            unsigned char* out = &decoder->scratch[i * MAX_STREAM_PACKET_SIZE];
+            int consumed = unframe_self_delimited(data, length, out, &decoder->streamLength[i]);
+            if (consumed < 0) {
+                return OPUS_INVALID_PACKET;
+            }
+
+            decoder->streamData[i] = out;
+            data += consumed;
+            length -= consumed;
+        }
+    }
+
+    return OPUS_OK;
+}
+
+int parallel_opus_decoder_decode(parallel_opus_decoder_t* decoder, const unsigned char* data, int length,
+                                 int16_t* pcm, int frameSize) {
+    int err;
+    int samples;
+
+    if (decoder->msDecoder != NULL) {
+        return opus_multistream_decode(decoder->msDecoder, data, length, pcm, frameSize, 0);
+    }
+
+    if (frameSize > decoder->samplesPerFrame) {
+        frameSize = decoder->samplesPerFrame;
+    }
+
+    err = split_packet(decoder, data, length);
+    if (err != OPUS_OK) {
+        return err;
+    }
+
+    // Wake the workers, then decode our share of the streams
+    pthread_mutex_lock(&decoder->mutex);
+    decoder->frameSize = frameSize;
+    decoder->pendingThreads = decoder->threadCount - 1;
+    decoder->generation++;
+    pthread_cond_broadcast(&decoder->workCond);
+    pthread_mutex_unlock(&decoder->mutex);
+
+    decode_streams(decoder, 0, frameSize);
+
+    pthread_mutex_lock(&decoder->mutex);
+    while (decoder->pendingThreads != 0) {
+        pthread_cond_wait(&decoder->doneCond, &decoder->mutex);
+    }
+    pthread_mutex_unlock(&decoder->mutex);
+
+    // Every stream must decode the same duration
+    samples = decoder->streamResult[0];
+    for (int i = 0; i < decoder->streams; i++) {
+        if (decoder->streamResult[i] < 0) {
+            return decoder->streamResult[i];
+        }
+        else if (decoder->streamResult[i] != samples) {
+            return OPUS_INVALID_PACKET;
+        }
+    }
+
+    // Interleave the output channels from their streams like libopus does
+    for (int c = 0; c < decoder->channelCount; c++) {
+        int index = decoder->mapping[c];
+        const int16_t* src;
+        int stride;
+
+        if (index == 255) {
+            for (int s = 0; s < samples; s++) {
+                pcm[s * decoder->channelCount + c] = 0;
+            }
+            continue;
+        }
+        else if (index < 2 * decoder->coupledStreams) {
+            src = stream_pcm(decoder, index / 2) + (index & 1);
+            stride = 2;
+        }
+        else {
+            src = stream_pcm(decoder, index - decoder->coupledStreams);
+            stride = 1;
+        }
+
+        for (int s = 0; s < samples; s++) {
+            pcm[s * decoder->channelCount + c] = src[s * stride];
+        }
+    }
+
+    return samples;
+}
+
+int parallel_opus_decoder_thread_count(const parallel_opus_decoder_t* decoder) {
+    return decoder->threadCount;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <Limelight.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decodes an Opus multistream. With more than one thread, the multistream is
+// split into its elementary streams, which are decoded in parallel and then
+// interleaved into the output. Otherwise, this is a plain libopus multistream
+// decoder.
+typedef struct parallel_opus_decoder parallel_opus_decoder_t;
+
+// Creates a decoder using up to threadCount threads, including the one that
+// calls parallel_opus_decoder_decode(). Returns NULL on failure.
+parallel_opus_decoder_t* parallel_opus_decoder_create(const OPUS_MULTISTREAM_CONFIGURATION* config, int threadCount);
+void parallel_opus_decoder_destroy(parallel_opus_decoder_t* decoder);
+
+// Same semantics as opus_multistream_decode(). A NULL packet triggers packet
+// loss concealment. Returns the decoded samples per channel or an Opus error.
+int parallel_opus_decoder_decode(parallel_opus_decoder_t* decoder, const unsigned char* data, int length,
+                                 int16_t* pcm, int frameSize);
+
+// Returns the number of threads actually used for decoding
+int parallel_opus_decoder_thread_count(const parallel_opus_decoder_t* decoder);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,157 @@
+// Measures the cost of submitting a frame to the native decoder when each
+// submit logs a line, as the JNI bridge used to at INFO level. The line is
+// logged synchronously with __android_log_print(), through the async log
+// with it enabled and disabled at runtime, and at a level that is compiled
+// out. The fake logcat writes each message to a temporary file.
+// Usage: async_log_bench [frames] [frame interval us]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "async_log.h"
+#include "fake_ndk.h"
+#include "native_decoder.h"
+
+#define FRAME_SIZE (32 * 1024)
+#define LOG_TAG "AsyncLogBench"
+
+typedef enum {
+    LOG_MODE_SYNC,
+    LOG_MODE_ASYNC,
+    LOG_MODE_RUNTIME_OFF,
+    LOG_MODE_COMPILED_OUT,
+    LOG_MODE_COUNT
+} log_mode_t;
+
+static const char* g_modeNames[LOG_MODE_COUNT] = {
+    "synchronous",
+    "async",
+    "async off",
+    "compiled out",
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadlineNs) {
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(deadlineNs / 1000000000ULL);
+    ts.tv_nsec = (long)(deadlineNs % 1000000000ULL);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t valueA = *(const uint64_t*)a;
+    uint64_t valueB = *(const uint64_t*)b;
+
+    return valueA < valueB ? -1 : (valueA > valueB ? 1 : 0);
+}
+
+static int submit_frame(PDECODE_UNIT decodeUnit, log_mode_t mode) {
+    switch (mode) {
+    case LOG_MODE_SYNC:
+        __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "Submitting frame %d (%d bytes, type %d)",
+                            decodeUnit->frameNumber, decodeUnit->fullLength, decodeUnit->frameType);
+        break;
+    case LOG_MODE_ASYNC:
+    case LOG_MODE_RUNTIME_OFF:
+        ALOGI(LOG_TAG, "Submitting frame %d (%d bytes, type %d)",
+              decodeUnit->frameNumber, decodeUnit->fullLength, decodeUnit->frameType);
+        break;
+    case LOG_MODE_COMPILED_OUT:
+    default:
+        ALOGV(LOG_TAG, "Submitting frame %d (%d bytes, type %d)",
+              decodeUnit->frameNumber, decodeUnit->fullLength, decodeUnit->frameType);
+        break;
+    }
+
+    return nativeDecoderSubmitDecodeUnit(decodeUnit);
+}
+
+int main(int argc, char** argv) {
+    int frameCount = argc > 1 ? atoi(argv[1]) : 2000;
+    int frameIntervalUs = argc > 2 ? atoi(argv[2]) : 500;
+    JNIEnv* env = fake_jni_env();
+    FILE* logFile = tmpfile();
+    uint64_t* submitNs;
+    DECODE_UNIT decodeUnit;
+    LENTRY entry;
+
+    if (frameCount <= 0 || frameIntervalUs < 0 || logFile == NULL) {
+        fprintf(stderr, "Usage: async_log_bench [frames] [frame interval us]\n");
+        return 1;
+    }
+
+    submitNs = malloc(sizeof(*submitNs) * (size_t)frameCount);
+    memset(&decodeUnit, 0, sizeof(decodeUnit));
+    entry.next = NULL;
+    entry.data = calloc(1, FRAME_SIZE);
+    entry.length = FRAME_SIZE;
+    entry.bufferType = BUFFER_TYPE_PICDATA;
+    decodeUnit.bufferList = &entry;
+    decodeUnit.fullLength = FRAME_SIZE;
+    decodeUnit.frameType = FRAME_TYPE_PFRAME;
+
+    fake_codec_reset(FRAME_SIZE, false);
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetSurface(env, NULL, (jobject)&decodeUnit);
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetColorConfig(env, NULL, 2, 1, 3, 0);
+    if (Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(env, NULL, VIDEO_FORMAT_H264, 1920, 1080, 60) != 0) {
+        printf("Decoder setup failed\n");
+        return 1;
+    }
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderStart(env, NULL);
+
+    // Only log what the benchmark itself submits
+    fake_ndk_set_log_fd(fileno(logFile));
+
+    printf("%d frames of %d bytes, one every %d us\n", frameCount, FRAME_SIZE, frameIntervalUs);
+    printf("%-14s %12s %12s %12s\n", "logging", "mean us", "p99 us", "max us");
+
+    for (int mode = 0; mode < LOG_MODE_COUNT; mode++) {
+        uint64_t totalNs = 0;
+        uint64_t nextFrameNs;
+
+        async_log_set_level(mode == LOG_MODE_RUNTIME_OFF ? ANDROID_LOG_SILENT : ANDROID_LOG_VERBOSE);
+
+        nextFrameNs = now_ns();
+        for (int i = 0; i < frameCount; i++) {
+            uint64_t startNs;
+
+            sleep_until_ns(nextFrameNs);
+            nextFrameNs += (uint64_t)frameIntervalUs * 1000;
+
+            decodeUnit.frameNumber++;
+            decodeUnit.enqueueTimeUs = now_ns() / 1000;
+
+            startNs = now_ns();
+            if (submit_frame(&decodeUnit, (log_mode_t)mode) != DR_OK) {
+                printf("Frame %d was not accepted\n", decodeUnit.frameNumber);
+                return 1;
+            }
+            submitNs[i] = now_ns() - startNs;
+            totalNs += submitNs[i];
+        }
+
+        qsort(submitNs, (size_t)frameCount, sizeof(*submitNs), compare_u64);
+        printf("%-14s %12.2f %12.2f %12.2f\n", g_modeNames[mode],
+               totalNs / 1000.0 / frameCount,
+               submitNs[(frameCount - 1) * 99 / 100] / 1000.0,
+               submitNs[frameCount - 1] / 1000.0);
+    }
+
+    fake_ndk_set_log_fd(-1);
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderStop(env, NULL);
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderCleanup(env, NULL);
+
+    free(entry.data);
+    free(submitNs);
+    fclose(logFile);
+    return 0;
+}
@@ -0,0 +1,432 @@
+// Tests for the native audio path. The PCM ring is checked on its own and
+// between a writer and a reader thread. Then a tone is encoded with libopus
+// and played through nativeAudioDecodeAndPlaySample() at the stream rate,
+// into the null sink and the WAV sink. The WAV file must hold the decoded
+// PCM in order, with only silence between packets. The decode and enqueue
+// times from the sink stats are reported for each sink.
+// Usage: audio_sink_test [packets]
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <opus_multistream.h>
+
+#include "audio_sink.h"
+#include "fake_ndk.h"
+#include "native_audio.h"
+
+#define SAMPLE_RATE 48000
+#define CHANNEL_COUNT 2
+#define SAMPLES_PER_FRAME 240
+#define MAX_PACKET_SIZE 1400
+#define TONE_HZ 440
+
+#define RING_CHANNELS 2
+#define RING_STRESS_FRAMES 2000000
+
+typedef struct {
+    unsigned char data[MAX_PACKET_SIZE];
+    int length;
+} opus_packet_t;
+
+static int g_failures;
+
+#define CHECK(test, condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s: check failed at line %d: %s\n", (test), __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+// Every sample of a frame holds the frame number, so a reader can tell
+// exactly which frames it got
+static void fill_numbered_frames(int16_t* pcm, uint32_t first, uint32_t frames) {
+    for (uint32_t i = 0; i < frames; i++) {
+        for (int c = 0; c < RING_CHANNELS; c++) {
+            pcm[i * RING_CHANNELS + c] = (int16_t)(first + i + c);
+        }
+    }
+}
+
+static uint32_t count_bad_frames(const int16_t* pcm, uint32_t first, uint32_t frames) {
+    uint32_t bad = 0;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        for (int c = 0; c < RING_CHANNELS; c++) {
+            if (pcm[i * RING_CHANNELS + c] != (int16_t)(first + i + c)) {
+                bad++;
+                break;
+            }
+        }
+    }
+
+    return bad;
+}
+
+static void test_ring(void) {
+    const char* test = "ring";
+    int16_t in[64 * RING_CHANNELS], out[64 * RING_CHANNELS];
+    pcm_ring_t ring;
+    uint32_t written = 0, read = 0;
+
+    // The capacity is rounded up to a power of 2
+    CHECK(test, pcm_ring_init(&ring, 50, RING_CHANNELS) == 0);
+    CHECK(test, ring.capacityFrames == 64);
+
+    // Writes are all or nothing
+    fill_numbered_frames(in, 0, 40);
+    CHECK(test, pcm_ring_write(&ring, in, 40));
+    CHECK(test, !pcm_ring_write(&ring, in, 25));
+    CHECK(test, pcm_ring_frames_queued(&ring) == 40);
+    written = 40;
+
+    // Reads return what's there, and wrap around the end of the ring
+    for (int i = 0; i < 20; i++) {
+        uint32_t frames = pcm_ring_read(&ring, out, 30);
+
+        CHECK(test, count_bad_frames(out, read, frames) == 0);
+        read += frames;
+
+        fill_numbered_frames(in, written, 37);
+        if (pcm_ring_write(&ring, in, 37)) {
+            written += 37;
+        }
+    }
+    CHECK(test, pcm_ring_frames_queued(&ring) == written - read);
+
+    read += pcm_ring_read(&ring, out, 64);
+    CHECK(test, read == written);
+    CHECK(test, pcm_ring_read(&ring, out, 64) == 0);
+
+    pcm_ring_destroy(&ring);
+}
+
+typedef struct {
+    pcm_ring_t ring;
+    uint32_t framesRead;
+    uint32_t badFrames;
+} ring_stress_t;
+
+static void* ring_reader_thread_proc(void* context) {
+    ring_stress_t* stress = context;
+    int16_t pcm[100 * RING_CHANNELS];
+
+    while (stress->framesRead < RING_STRESS_FRAMES) {
+        // Odd read sizes so the reads and writes never line up
+        uint32_t frames = pcm_ring_read(&stress->ring, pcm, 1 + stress->framesRead % 97);
+
+        stress->badFrames += count_bad_frames(pcm, stress->framesRead, frames);
+        stress->framesRead += frames;
+        if (frames == 0) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+// Frames must arrive intact and in order while both sides run at once
+static void test_ring_threads(void) {
+    const char* test = "ring threads";
+    ring_stress_t stress;
+    int16_t pcm[SAMPLES_PER_FRAME * RING_CHANNELS];
+    pthread_t reader;
+    uint32_t written = 0;
+    uint32_t full = 0;
+
+    memset(&stress, 0, sizeof(stress));
+    CHECK(test, pcm_ring_init(&stress.ring, 4 * SAMPLES_PER_FRAME, RING_CHANNELS) == 0);
+    CHECK(test, pthread_create(&reader, NULL, ring_reader_thread_proc, &stress) == 0);
+
+    while (written < RING_STRESS_FRAMES) {
+        uint32_t frames = RING_STRESS_FRAMES - written < SAMPLES_PER_FRAME ? RING_STRESS_FRAMES - written : SAMPLES_PER_FRAME;
+
+        fill_numbered_frames(pcm, written, frames);
+        if (pcm_ring_write(&stress.ring, pcm, frames)) {
+            written += frames;
+        }
+        else {
+            full++;
+            sched_yield();
+        }
+    }
+
+    pthread_join(reader, NULL);
+    CHECK(test, stress.framesRead == RING_STRESS_FRAMES);
+    CHECK(test, stress.badFrames == 0);
+    printf("%s: %u frames, ring full %u times\n", test, stress.framesRead, full);
+
+    pcm_ring_destroy(&stress.ring);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadlineNs) {
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(deadlineNs / 1000000000ULL);
+    ts.tv_nsec = (long)(deadlineNs % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0);
+}
+
+static void init_opus_config(OPUS_MULTISTREAM_CONFIGURATION* config) {
+    memset(config, 0, sizeof(*config));
+    config->sampleRate = SAMPLE_RATE;
+    config->channelCount = CHANNEL_COUNT;
+    config->streams = 1;
+    config->coupledStreams = 1;
+    config->samplesPerFrame = SAMPLES_PER_FRAME;
+    config->mapping[0] = 0;
+    config->mapping[1] = 1;
+}
+
+// Encodes a tone, and decodes it again with a separate decoder for reference
+static int encode_tone(const OPUS_MULTISTREAM_CONFIGURATION* config, opus_packet_t* packets,
+                       int16_t* decoded, int packetCount) {
+    int16_t pcm[SAMPLES_PER_FRAME * CHANNEL_COUNT];
+    OpusMSEncoder* encoder;
+    OpusMSDecoder* decoder;
+    int err;
+
+    encoder = opus_multistream_encoder_create(config->sampleRate, config->channelCount, config->streams,
+                                              config->coupledStreams, config->mapping,
+                                              OPUS_APPLICATION_RESTRICTED_LOWDELAY, &err);
+    decoder = opus_multistream_decoder_create(config->sampleRate, config->channelCount, config->streams,
+                                              config->coupledStreams, config->mapping, &err);
+    if (encoder == NULL || decoder == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < packetCount; i++) {
+        for (int s = 0; s < SAMPLES_PER_FRAME; s++) {
+            double t = (double)(i * SAMPLES_PER_FRAME + s) / SAMPLE_RATE;
+            int16_t value = (int16_t)(8000 * sin(2 * M_PI * TONE_HZ * t));
+
+            pcm[s * CHANNEL_COUNT] = value;
+            pcm[s * CHANNEL_COUNT + 1] = (int16_t)-value;
+        }
+
+        packets[i].length = opus_multistream_encode(encoder, pcm, SAMPLES_PER_FRAME,
+                                                    packets[i].data, MAX_PACKET_SIZE);
+        if (packets[i].length <= 0 ||
+                opus_multistream_decode(decoder, packets[i].data, packets[i].length,
+                                        &decoded[i * SAMPLES_PER_FRAME * CHANNEL_COUNT],
+                                        SAMPLES_PER_FRAME, 0) != SAMPLES_PER_FRAME) {
+            err = -1;
+            break;
+        }
+    }
+
+    opus_multistream_encoder_destroy(encoder);
+    opus_multistream_decoder_destroy(decoder);
+    return err == OPUS_OK ? 0 : -1;
+}
+
+// Plays the packets through a native sink at the stream rate, like the audio decoder thread
+static int play_packets(audio_sink_type_t sinkType, const char* path, opus_packet_t* packets,
+                        int packetCount, audio_sink_stats_t* stats) {
+    OPUS_MULTISTREAM_CONFIGURATION config;
+    uint64_t periodNs = (uint64_t)SAMPLES_PER_FRAME * 1000000000ULL / SAMPLE_RATE;
+    uint64_t startNs;
+    jstring pathString;
+
+    pathString = path != NULL ? (*fake_jni_env())->NewStringUTF(fake_jni_env(), path) : NULL;
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeAudioSetSink(fake_jni_env(), NULL, sinkType, pathString);
+    if (!nativeAudioIsEnabled()) {
+        return -1;
+    }
+
+    init_opus_config(&config);
+    if (nativeAudioInit(AUDIO_CONFIGURATION_STEREO, &config) != 0) {
+        return -1;
+    }
+
+    nativeAudioStart();
+    startNs = now_ns();
+    for (int i = 0; i < packetCount; i++) {
+        sleep_until_ns(startNs + i * periodNs);
+        nativeAudioDecodeAndPlaySample((char*)packets[i].data, packets[i].length);
+    }
+
+    // Let the sink play out what's left in the ring
+    sleep_until_ns(startNs + (packetCount + 10) * periodNs);
+    nativeAudioStop();
+
+    nativeAudioGetSinkStats(stats);
+    nativeAudioCleanup();
+    return 0;
+}
+
+static void print_stats(const char* name, const audio_sink_stats_t* stats, int packetCount) {
+    printf("%s sink: %u packets queued, %u dropped, %u pulls, %u underrun frames\n",
+           name, stats->packetsQueued, stats->packetsDropped, stats->pulls, stats->underrunFrames);
+    printf("%s sink: decode avg %.1f us (max %.1f us), enqueue avg %.2f us (max %.2f us)\n",
+           name, stats->totalDecodeNs / 1000.0 / packetCount, stats->maxDecodeNs / 1000.0,
+           stats->totalEnqueueNs / 1000.0 / packetCount, stats->maxEnqueueNs / 1000.0);
+}
+
+static void test_null_sink(opus_packet_t* packets, int packetCount) {
+    const char* test = "null sink";
+    audio_sink_stats_t stats;
+
+    memset(&stats, 0, sizeof(stats));
+    CHECK(test, play_packets(AUDIO_SINK_NULL, NULL, packets, packetCount, &stats) == 0);
+    print_stats("null", &stats, packetCount);
+
+    // Every packet is either queued or dropped, and the ring only overflows
+    // if the sink thread falls more than a ring behind, which a loaded host
+    // can cause now and then
+    CHECK(test, stats.packetsQueued + stats.packetsDropped == (uint32_t)packetCount);
+    CHECK(test, stats.packetsDropped <= (uint32_t)packetCount / 50);
+    CHECK(test, stats.pulls >= (uint32_t)packetCount);
+}
+
+static uint32_t get_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_le16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static bool is_silent_frame(const int16_t* frame) {
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        if (frame[c] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns the number of packets found in order in the WAV data, with any
+// amount of silence allowed between them
+static int match_packets(const int16_t* data, uint32_t frames, const int16_t* decoded, int packetCount) {
+    size_t packetBytes = sizeof(int16_t) * SAMPLES_PER_FRAME * CHANNEL_COUNT;
+    uint32_t pos = 0;
+    int matched = 0;
+
+    while (matched < packetCount && pos + SAMPLES_PER_FRAME <= frames) {
+        if (memcmp(&data[pos * CHANNEL_COUNT], &decoded[matched * SAMPLES_PER_FRAME * CHANNEL_COUNT], packetBytes) == 0) {
+            pos += SAMPLES_PER_FRAME;
+            matched++;
+        }
+        else if (is_silent_frame(&data[pos * CHANNEL_COUNT])) {
+            pos++;
+        }
+        else {
+            break;
+        }
+    }
+
+    return matched;
+}
+
+static void test_wav_sink(opus_packet_t* packets, const int16_t* decoded, int packetCount) {
+    const char* test = "wav sink";
+    char path[] = "/tmp/audio_sink_test_XXXXXX";
+    audio_sink_stats_t stats;
+    uint8_t* file = NULL;
+    long fileSize = 0;
+    FILE* f;
+    int fd;
+
+    fd = mkstemp(path);
+    CHECK(test, fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+
+    memset(&stats, 0, sizeof(stats));
+    CHECK(test, play_packets(AUDIO_SINK_WAV, path, packets, packetCount, &stats) == 0);
+    print_stats("wav", &stats, packetCount);
+
+    f = fopen(path, "rb");
+    if (f != NULL) {
+        fseek(f, 0, SEEK_END);
+        fileSize = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        file = malloc(fileSize);
+        if (file != NULL && fread(file, 1, fileSize, f) != (size_t)fileSize) {
+            free(file);
+            file = NULL;
+        }
+        fclose(f);
+    }
+    unlink(path);
+
+    CHECK(test, file != NULL && fileSize >= 44);
+    if (file == NULL || fileSize < 44) {
+        free(file);
+        return;
+    }
+
+    CHECK(test, memcmp(file, "RIFF", 4) == 0 && memcmp(file + 8, "WAVEfmt ", 8) == 0);
+    CHECK(test, get_le32(file + 4) == (uint32_t)fileSize - 8);
+    CHECK(test, get_le16(file + 20) == 1 && get_le16(file + 22) == CHANNEL_COUNT);
+    CHECK(test, get_le32(file + 24) == SAMPLE_RATE && get_le16(file + 34) == 16);
+    CHECK(test, memcmp(file + 36, "data", 4) == 0 && get_le32(file + 40) == (uint32_t)fileSize - 44);
+
+    // Every pull writes one packet interval to the file
+    CHECK(test, get_le32(file + 40) == stats.pulls * SAMPLES_PER_FRAME * CHANNEL_COUNT * sizeof(int16_t));
+
+    if (stats.packetsDropped == 0) {
+        int matched = match_packets((const int16_t*)(file + 44), get_le32(file + 40) / (CHANNEL_COUNT * sizeof(int16_t)),
+                                    decoded, packetCount);
+
+        if (matched != packetCount) {
+            printf("%s: only the first %d of %d packets are in the file\n", test, matched, packetCount);
+            g_failures++;
+        }
+    }
+
+    free(file);
+}
+
+int main(int argc, char** argv) {
+    int packetCount = argc > 1 ? atoi(argv[1]) : 400;
+    OPUS_MULTISTREAM_CONFIGURATION config;
+    opus_packet_t* packets;
+    int16_t* decoded;
+
+    if (packetCount <= 0) {
+        fprintf(stderr, "Usage: audio_sink_test [packets]\n");
+        return 1;
+    }
+
+    test_ring();
+    test_ring_threads();
+
+    init_opus_config(&config);
+    packets = calloc(packetCount, sizeof(*packets));
+    decoded = calloc((size_t)packetCount * SAMPLES_PER_FRAME * CHANNEL_COUNT, sizeof(*decoded));
+    if (packets == NULL || decoded == NULL || encode_tone(&config, packets, decoded, packetCount) != 0) {
+        printf("Failed to encode the test tone\n");
+        return 1;
+    }
+
+    test_null_sink(packets, packetCount);
+    test_wav_sink(packets, decoded, packetCount);
+
+    free(packets);
+    free(decoded);
+
+    if (g_failures != 0) {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+// Checks the native decode unit submit path against the JNI path it replaces.
+// Each decode unit is submitted with nativeDecoderSubmitDecodeUnit(), which
+// gathers the buffer list straight into codec input buffers, and again the
+// way BridgeDrSubmitDecodeUnit() used to: flattened into a byte[] and handed
+// to nativeDecoderSubmit(), which copies it into the codec. The fake codec
+// records every input, and both paths must produce identical inputs. The
+// cost of each path is reported afterwards.
+// Usage: native_decoder_submit_test [frames] [max frame size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <media/NdkMediaCodec.h>
+
+#include "fake_ndk.h"
+#include "native_decoder.h"
+
+#define INPUT_BUFFER_SIZE (1024 * 1024)
+#define IDR_INTERVAL 30
+#define MAX_FRAGMENT_SIZE 1392
+#define MAX_ENTRIES 1024
+#define BENCH_ITERATIONS 5
+
+typedef struct {
+    DECODE_UNIT decodeUnit;
+    LENTRY entries[MAX_ENTRIES];
+    char* data;
+} test_frame_t;
+
+static int g_failures;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void append_entry(test_frame_t* frame, int* entryCount, char* data, int length, int bufferType) {
+    PLENTRY entry = &frame->entries[(*entryCount)++];
+
+    entry->data = data;
+    entry->length = length;
+    entry->bufferType = bufferType;
+    entry->next = NULL;
+    if (*entryCount > 1) {
+        frame->entries[*entryCount - 2].next = entry;
+    }
+}
+
+// Builds a frame whose picture data is split into fragments like the depacketizer's
+static void build_frame(test_frame_t* frame, int frameNumber, int maxFrameSize) {
+    bool idr = frameNumber % IDR_INTERVAL == 0;
+    int length = 64 + rand() % (maxFrameSize - 64);
+    int entryCount = 0;
+    int offset = 0;
+
+    memset(&frame->decodeUnit, 0, sizeof(frame->decodeUnit));
+    frame->data = malloc((size_t)length);
+    for (int i = 0; i < length; i++) {
+        frame->data[i] = (char)rand();
+    }
+
+    if (idr) {
+        append_entry(frame, &entryCount, frame->data, 24, BUFFER_TYPE_SPS);
+        append_entry(frame, &entryCount, frame->data + 24, 8, BUFFER_TYPE_PPS);
+        offset = 32;
+    }
+
+    while (offset < length && entryCount < MAX_ENTRIES) {
+        int fragment = 1 + rand() % MAX_FRAGMENT_SIZE;
+        if (fragment > length - offset || entryCount == MAX_ENTRIES - 1) {
+            fragment = length - offset;
+        }
+
+        append_entry(frame, &entryCount, frame->data + offset, fragment, BUFFER_TYPE_PICDATA);
+        offset += fragment;
+    }
+
+    frame->decodeUnit.frameNumber = frameNumber;
+    frame->decodeUnit.frameType = idr ? FRAME_TYPE_IDR : FRAME_TYPE_PFRAME;
+    frame->decodeUnit.fullLength = length;
+    frame->decodeUnit.bufferList = frame->entries;
+}
+
+// Submits a decode unit the way the JNI bridge does for decoders implemented in Java
+static int submit_through_java(JNIEnv* env, jbyteArray array, PDECODE_UNIT decodeUnit) {
+    int offset = 0;
+    int ret;
+
+    for (PLENTRY entry = decodeUnit->bufferList; entry != NULL; entry = entry->next) {
+        if (entry->bufferType != BUFFER_TYPE_PICDATA) {
+            (*env)->SetByteArrayRegion(env, array, 0, entry->length, (jbyte*)entry->data);
+            ret = Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(env, NULL, array, entry->length, entry->bufferType,
+                                                                                  decodeUnit->frameNumber, decodeUnit->frameType, 0,
+                                                                                  (jlong)decodeUnit->receiveTimeUs, (jlong)decodeUnit->enqueueTimeUs);
+            if (ret != DR_OK) {
+                return ret;
+            }
+        }
+        else {
+            (*env)->SetByteArrayRegion(env, array, offset, entry->length, (jbyte*)entry->data);
+            offset += entry->length;
+        }
+    }
+
+    return Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSubmit(env, NULL, array, offset, BUFFER_TYPE_PICDATA,
+                                                                          decodeUnit->frameNumber, decodeUnit->frameType, 0,
+                                                                          (jlong)decodeUnit->receiveTimeUs, (jlong)decodeUnit->enqueueTimeUs);
+}
+
+// Submits every frame through one of the paths. Returns the time it took.
+static uint64_t submit_frames(JNIEnv* env, jbyteArray array, test_frame_t* frames, int frameCount,
+                              bool native, uint64_t* enqueueTimeUs) {
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < frameCount; i++) {
+        PDECODE_UNIT decodeUnit = &frames[i].decodeUnit;
+        int ret;
+
+        decodeUnit->enqueueTimeUs = ++(*enqueueTimeUs);
+        ret = native ? nativeDecoderSubmitDecodeUnit(decodeUnit) : submit_through_java(env, array, decodeUnit);
+        if (ret != DR_OK) {
+            printf("Frame %d: %s submit failed with %d\n", i, native ? "native" : "JNI", ret);
+            g_failures++;
+        }
+    }
+
+    return now_ns() - start;
+}
+
+static void check_inputs_match(int firstNative, int firstJava, int count) {
+    for (int i = 0; i < count; i++) {
+        const fake_codec_input_t* nativeInput = fake_codec_get_input(firstNative + i);
+        const fake_codec_input_t* javaInput = fake_codec_get_input(firstJava + i);
+
+        if (nativeInput == NULL || javaInput == NULL) {
+            printf("Input %d is missing\n", i);
+            g_failures++;
+            return;
+        }
+
+        if (nativeInput->length != javaInput->length || nativeInput->flags != javaInput->flags ||
+                memcmp(nativeInput->data, javaInput->data, nativeInput->length) != 0) {
+            printf("Input %d differs: native %zu bytes (flags %u), JNI %zu bytes (flags %u)\n",
+                   i, nativeInput->length, nativeInput->flags, javaInput->length, javaInput->flags);
+            g_failures++;
+        }
+    }
+}
+
+// Checks the native inputs against the frames they came from
+static void check_inputs_against_frames(test_frame_t* frames, int frameCount) {
+    int input = 0;
+
+    for (int i = 0; i < frameCount; i++) {
+        PDECODE_UNIT decodeUnit = &frames[i].decodeUnit;
+        uint32_t keyFlag = decodeUnit->frameType == FRAME_TYPE_IDR ? AMEDIACODEC_BUFFER_FLAG_KEY_FRAME : 0;
+        const fake_codec_input_t* picture;
+        int offset = 0;
+
+        for (PLENTRY entry = decodeUnit->bufferList; entry != NULL; entry = entry->next) {
+            const fake_codec_input_t* paramSet;
+
+            if (entry->bufferType == BUFFER_TYPE_PICDATA) {
+                continue;
+            }
+
+            paramSet = fake_codec_get_input(input++);
+            if (paramSet == NULL || paramSet->length != (size_t)entry->length || paramSet->ptsUs != 0 ||
+                    paramSet->flags != (AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG | keyFlag) ||
+                    memcmp(paramSet->data, entry->data, (size_t)entry->length) != 0) {
+                printf("Frame %d: parameter set %d doesn't match\n", i, entry->bufferType);
+                g_failures++;
+            }
+            offset += entry->length;
+        }
+
+        // The picture data is contiguous after the parameter sets
+        picture = fake_codec_get_input(input++);
+        if (picture == NULL || picture->length != (size_t)(decodeUnit->fullLength - offset) ||
+                picture->flags != keyFlag || picture->ptsUs != (int64_t)decodeUnit->enqueueTimeUs ||
+                memcmp(picture->data, frames[i].data + offset, picture->length) != 0) {
+            printf("Frame %d: picture data doesn't match\n", i);
+            g_failures++;
+        }
+    }
+}
+
+static void wait_for_outputs(uint32_t expected) {
+    fake_codec_stats_t stats;
+
+    for (int i = 0; i < 200; i++) {
+        fake_codec_get_stats(&stats);
+        if (stats.outputsRendered >= expected) {
+            return;
+        }
+
+        struct timespec ts = { 0, 5 * 1000 * 1000 };
+        nanosleep(&ts, NULL);
+    }
+
+    printf("%u of %u frames were rendered by the output thread\n", stats.outputsRendered, expected);
+    g_failures++;
+}
+
+int main(int argc, char** argv) {
+    int frameCount = argc > 1 ? atoi(argv[1]) : 300;
+    int maxFrameSize = argc > 2 ? atoi(argv[2]) : 256 * 1024;
+    JNIEnv* env = fake_jni_env();
+    test_frame_t* frames;
+    jbyteArray array;
+    uint64_t enqueueTimeUs = 1000;
+    uint64_t nativeNs = 0, javaNs = 0;
+    fake_codec_stats_t stats;
+    DECODE_UNIT oversized;
+    LENTRY oversizedEntry;
+    int inputCount;
+
+    if (frameCount <= 0 || maxFrameSize <= 64 || maxFrameSize > INPUT_BUFFER_SIZE) {
+        fprintf(stderr, "Usage: native_decoder_submit_test [frames] [max frame size]\n");
+        return 1;
+    }
+
+    frames = calloc((size_t)frameCount, sizeof(*frames));
+    array = fake_jni_new_byte_array(INPUT_BUFFER_SIZE);
+    srand(1);
+    for (int i = 0; i < frameCount; i++) {
+        build_frame(&frames[i], i, maxFrameSize);
+    }
+
+    fake_codec_reset(INPUT_BUFFER_SIZE, true);
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetSurface(env, NULL, (jobject)frames);
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetColorConfig(env, NULL, 2, 1, 3, 0);
+    if (Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderSetup(env, NULL, VIDEO_FORMAT_H264, 1920, 1080, 60) != 0 ||
+            !nativeDecoderIsActive()) {
+        printf("Decoder setup failed\n");
+        return 1;
+    }
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderStart(env, NULL);
+
+    // Both paths must hand the codec exactly the same inputs
+    submit_frames(env, array, frames, frameCount, true, &enqueueTimeUs);
+    inputCount = fake_codec_input_count();
+    check_inputs_against_frames(frames, frameCount);
+    submit_frames(env, array, frames, frameCount, false, &enqueueTimeUs);
+    if (fake_codec_input_count() != inputCount * 2) {
+        printf("Native path queued %d inputs, JNI path queued %d\n", inputCount, fake_codec_input_count() - inputCount);
+        g_failures++;
+    }
+    check_inputs_match(0, inputCount, inputCount);
+    wait_for_outputs((uint32_t)frameCount * 2);
+
+    // A frame that doesn't fit must give the input buffer back and request an IDR frame
+    memset(&oversized, 0, sizeof(oversized));
+    oversizedEntry.next = NULL;
+    oversizedEntry.data = calloc(1, INPUT_BUFFER_SIZE + 1);
+    oversizedEntry.length = INPUT_BUFFER_SIZE + 1;
+    oversizedEntry.bufferType = BUFFER_TYPE_PICDATA;
+    oversized.fullLength = oversizedEntry.length;
+    oversized.bufferList = &oversizedEntry;
+    oversized.enqueueTimeUs = ++enqueueTimeUs;
+    if (nativeDecoderSubmitDecodeUnit(&oversized) != DR_NEED_IDR) {
+        printf("Oversized frame wasn't rejected\n");
+        g_failures++;
+    }
+    fake_codec_get_stats(&stats);
+    if (stats.emptyInputsQueued != 1) {
+        printf("Oversized frame's input buffer wasn't returned\n");
+        g_failures++;
+    }
+    free(oversizedEntry.data);
+
+    // Time both paths without recording the inputs
+    fake_codec_reset(INPUT_BUFFER_SIZE, false);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        javaNs += submit_frames(env, array, frames, frameCount, false, &enqueueTimeUs);
+        nativeNs += submit_frames(env, array, frames, frameCount, true, &enqueueTimeUs);
+    }
+    printf("%d frames of up to %d bytes\n", frameCount, maxFrameSize);
+    printf("JNI path:    %8.2f us/frame\n", javaNs / 1000.0 / (frameCount * BENCH_ITERATIONS));
+    printf("Native path: %8.2f us/frame\n", nativeNs / 1000.0 / (frameCount * BENCH_ITERATIONS));
+
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderStop(env, NULL);
+    Java_com_limelight_nvstream_jni_MoonBridge_nativeDecoderCleanup(env, NULL);
+
+    for (int i = 0; i < frameCount; i++) {
+        free(frames[i].data);
+    }
+    free(frames);
+    fake_jni_delete_array(array);
+
+    if (g_failures != 0) {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    return 0;
+}
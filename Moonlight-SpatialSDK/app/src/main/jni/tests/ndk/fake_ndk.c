@@ -0,0 +1,450 @@
+#include "fake_ndk.h"
+
+#include <android/log.h>
+#include <android/native_window_jni.h>
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaFormat.h>
+#include <sys/system_properties.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FAKE_CODEC_INPUT_BUFFERS 4
+#define FAKE_CODEC_OUTPUT_BUFFERS 16
+#define FAKE_CODEC_MAX_RECORDED_INPUTS 4096
+
+// bionic's stdin, stdout and stderr, which the prebuilt Android libopus refers
+// to for its fatal error messages. Those are only compiled into debug builds
+// of libopus, so nothing ever writes to them here.
+char __sF[3 * 256];
+
+static int g_logFd = -1;
+
+int __android_log_write(int prio, const char* tag, const char* text) {
+    if (g_logFd >= 0) {
+        char line[1100];
+        int length = snprintf(line, sizeof(line), "[%s] %s\n", tag, text);
+
+        if (length > (int)sizeof(line) - 1) {
+            length = sizeof(line) - 1;
+        }
+        return (int)write(g_logFd, line, (size_t)length);
+    }
+    return 0;
+}
+
+int __android_log_vprint(int prio, const char* tag, const char* fmt, va_list ap) {
+    char text[1024];
+
+    vsnprintf(text, sizeof(text), fmt, ap);
+    return __android_log_write(prio, tag, text);
+}
+
+int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+    va_list ap;
+    int ret;
+
+    va_start(ap, fmt);
+    ret = __android_log_vprint(prio, tag, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+void fake_ndk_set_log_fd(int fd) {
+    g_logFd = fd;
+}
+
+int __system_property_get(const char* name, char* value) {
+    // Behave like a device without the property
+    value[0] = 0;
+    return 0;
+}
+
+struct ANativeWindow {
+    int32_t dataSpace;
+};
+
+ANativeWindow* ANativeWindow_fromSurface(JNIEnv* env, jobject surface) {
+    return surface != NULL ? calloc(1, sizeof(ANativeWindow)) : NULL;
+}
+
+void ANativeWindow_release(ANativeWindow* window) {
+    free(window);
+}
+
+int32_t ANativeWindow_setBuffersDataSpace(ANativeWindow* window, int32_t dataSpace) {
+    window->dataSpace = dataSpace;
+    return 0;
+}
+
+// The format doesn't store anything, since nothing reads it back except for logging
+struct AMediaFormat {
+    int unused;
+};
+
+const char* AMEDIAFORMAT_KEY_COLOR_FORMAT = "color-format";
+const char* AMEDIAFORMAT_KEY_COLOR_RANGE = "color-range";
+const char* AMEDIAFORMAT_KEY_COLOR_STANDARD = "color-standard";
+const char* AMEDIAFORMAT_KEY_COLOR_TRANSFER = "color-transfer";
+const char* AMEDIAFORMAT_KEY_FRAME_RATE = "frame-rate";
+const char* AMEDIAFORMAT_KEY_HDR_STATIC_INFO = "hdr-static-info";
+const char* AMEDIAFORMAT_KEY_HEIGHT = "height";
+const char* AMEDIAFORMAT_KEY_MAX_INPUT_SIZE = "max-input-size";
+const char* AMEDIAFORMAT_KEY_MIME = "mime";
+const char* AMEDIAFORMAT_KEY_OPERATING_RATE = "operating-rate";
+const char* AMEDIAFORMAT_KEY_PRIORITY = "priority";
+const char* AMEDIAFORMAT_KEY_WIDTH = "width";
+
+AMediaFormat* AMediaFormat_new(void) {
+    return calloc(1, sizeof(AMediaFormat));
+}
+
+media_status_t AMediaFormat_delete(AMediaFormat* format) {
+    free(format);
+    return AMEDIA_OK;
+}
+
+const char* AMediaFormat_toString(AMediaFormat* format) {
+    return "fake format";
+}
+
+bool AMediaFormat_getInt32(AMediaFormat* format, const char* name, int32_t* out) {
+    return false;
+}
+
+bool AMediaFormat_getBuffer(AMediaFormat* format, const char* name, void** data, size_t* size) {
+    return false;
+}
+
+void AMediaFormat_setInt32(AMediaFormat* format, const char* name, int32_t value) {
+}
+
+void AMediaFormat_setString(AMediaFormat* format, const char* name, const char* value) {
+}
+
+void AMediaFormat_setBuffer(AMediaFormat* format, const char* name, const void* data, size_t size) {
+}
+
+struct AMediaCodec {
+    uint8_t* inputBuffers[FAKE_CODEC_INPUT_BUFFERS];
+    bool inputOwned[FAKE_CODEC_INPUT_BUFFERS];
+
+    // Output buffers waiting to be dequeued, then owned by the caller until released
+    int64_t outputPts[FAKE_CODEC_OUTPUT_BUFFERS];
+    bool outputOwned[FAKE_CODEC_OUTPUT_BUFFERS];
+    uint32_t outputHead;
+    uint32_t outputTail;
+};
+
+static pthread_mutex_t g_codecLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_outputReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_outputTaken = PTHREAD_COND_INITIALIZER;
+static size_t g_inputBufferSize = 1024 * 1024;
+static bool g_recordInputs;
+static fake_codec_input_t g_inputs[FAKE_CODEC_MAX_RECORDED_INPUTS];
+static int g_inputCount;
+static fake_codec_stats_t g_stats;
+
+void fake_codec_reset(size_t inputBufferSize, bool recordInputs) {
+    pthread_mutex_lock(&g_codecLock);
+    for (int i = 0; i < g_inputCount; i++) {
+        free(g_inputs[i].data);
+    }
+    g_inputCount = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_inputBufferSize = inputBufferSize;
+    g_recordInputs = recordInputs;
+    pthread_mutex_unlock(&g_codecLock);
+}
+
+int fake_codec_input_count(void) {
+    return g_inputCount;
+}
+
+const fake_codec_input_t* fake_codec_get_input(int index) {
+    return index < g_inputCount ? &g_inputs[index] : NULL;
+}
+
+void fake_codec_get_stats(fake_codec_stats_t* stats) {
+    pthread_mutex_lock(&g_codecLock);
+    *stats = g_stats;
+    pthread_mutex_unlock(&g_codecLock);
+}
+
+static AMediaCodec* create_codec(void) {
+    AMediaCodec* codec = calloc(1, sizeof(*codec));
+
+    for (int i = 0; i < FAKE_CODEC_INPUT_BUFFERS; i++) {
+        codec->inputBuffers[i] = malloc(g_inputBufferSize);
+    }
+    return codec;
+}
+
+AMediaCodec* AMediaCodec_createCodecByName(const char* name) {
+    return create_codec();
+}
+
+AMediaCodec* AMediaCodec_createDecoderByType(const char* mimeType) {
+    return create_codec();
+}
+
+media_status_t AMediaCodec_delete(AMediaCodec* codec) {
+    for (int i = 0; i < FAKE_CODEC_INPUT_BUFFERS; i++) {
+        free(codec->inputBuffers[i]);
+    }
+    free(codec);
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaCodec_configure(AMediaCodec* codec, const AMediaFormat* format,
+                                     ANativeWindow* surface, AMediaCrypto* crypto, uint32_t flags) {
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaCodec_start(AMediaCodec* codec) {
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaCodec_stop(AMediaCodec* codec) {
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaCodec_flush(AMediaCodec* codec) {
+    pthread_mutex_lock(&g_codecLock);
+    codec->outputHead = codec->outputTail;
+    pthread_mutex_unlock(&g_codecLock);
+    return AMEDIA_OK;
+}
+
+AMediaFormat* AMediaCodec_getInputFormat(AMediaCodec* codec) {
+    return AMediaFormat_new();
+}
+
+AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec* codec) {
+    return AMediaFormat_new();
+}
+
+static void make_deadline(struct timespec* deadline, int64_t timeoutUs) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_nsec += (long)(timeoutUs % 1000000) * 1000;
+    deadline->tv_sec += timeoutUs / 1000000 + deadline->tv_nsec / 1000000000;
+    deadline->tv_nsec %= 1000000000;
+}
+
+ssize_t AMediaCodec_dequeueInputBuffer(AMediaCodec* codec, int64_t timeoutUs) {
+    ssize_t index = AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+
+    pthread_mutex_lock(&g_codecLock);
+
+    // Like a real decoder, stop taking input while the output side is backed up
+    if (codec->outputTail - codec->outputHead == FAKE_CODEC_OUTPUT_BUFFERS && timeoutUs > 0) {
+        struct timespec deadline;
+
+        make_deadline(&deadline, timeoutUs);
+        pthread_cond_timedwait(&g_outputTaken, &g_codecLock, &deadline);
+    }
+    if (codec->outputTail - codec->outputHead == FAKE_CODEC_OUTPUT_BUFFERS) {
+        pthread_mutex_unlock(&g_codecLock);
+        return index;
+    }
+
+    for (int i = 0; i < FAKE_CODEC_INPUT_BUFFERS; i++) {
+        if (!codec->inputOwned[i]) {
+            codec->inputOwned[i] = true;
+            index = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_codecLock);
+
+    return index;
+}
+
+uint8_t* AMediaCodec_getInputBuffer(AMediaCodec* codec, size_t idx, size_t* outSize) {
+    if (idx >= FAKE_CODEC_INPUT_BUFFERS || !codec->inputOwned[idx]) {
+        return NULL;
+    }
+
+    *outSize = g_inputBufferSize;
+    return codec->inputBuffers[idx];
+}
+
+media_status_t AMediaCodec_queueInputBuffer(AMediaCodec* codec, size_t idx, off_t offset,
+                                            size_t size, uint64_t time, uint32_t flags) {
+    pthread_mutex_lock(&g_codecLock);
+
+    if (idx >= FAKE_CODEC_INPUT_BUFFERS || !codec->inputOwned[idx] || offset + size > g_inputBufferSize) {
+        pthread_mutex_unlock(&g_codecLock);
+        return AMEDIA_ERROR_UNKNOWN;
+    }
+
+    codec->inputOwned[idx] = false;
+    if (size == 0) {
+        g_stats.emptyInputsQueued++;
+        pthread_mutex_unlock(&g_codecLock);
+        return AMEDIA_OK;
+    }
+
+    g_stats.inputsQueued++;
+    if (g_recordInputs && g_inputCount < FAKE_CODEC_MAX_RECORDED_INPUTS) {
+        fake_codec_input_t* input = &g_inputs[g_inputCount++];
+
+        input->data = malloc(size);
+        memcpy(input->data, codec->inputBuffers[idx] + offset, size);
+        input->length = size;
+        input->ptsUs = (int64_t)time;
+        input->flags = flags;
+    }
+
+    // Pictures come straight back out
+    if ((flags & AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG) == 0) {
+        codec->outputPts[codec->outputTail++ % FAKE_CODEC_OUTPUT_BUFFERS] = (int64_t)time;
+        pthread_cond_signal(&g_outputReady);
+    }
+
+    pthread_mutex_unlock(&g_codecLock);
+    return AMEDIA_OK;
+}
+
+ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec* codec, AMediaCodecBufferInfo* info, int64_t timeoutUs) {
+    ssize_t index = AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+
+    pthread_mutex_lock(&g_codecLock);
+
+    if (codec->outputHead == codec->outputTail && timeoutUs > 0) {
+        struct timespec deadline;
+
+        make_deadline(&deadline, timeoutUs);
+        pthread_cond_timedwait(&g_outputReady, &g_codecLock, &deadline);
+    }
+
+    if (codec->outputHead != codec->outputTail) {
+        index = codec->outputHead++ % FAKE_CODEC_OUTPUT_BUFFERS;
+        codec->outputOwned[index] = true;
+        memset(info, 0, sizeof(*info));
+        info->presentationTimeUs = codec->outputPts[index];
+        pthread_cond_signal(&g_outputTaken);
+    }
+
+    pthread_mutex_unlock(&g_codecLock);
+    return index;
+}
+
+static media_status_t release_output(AMediaCodec* codec, size_t idx, uint32_t* counter) {
+    media_status_t status = AMEDIA_ERROR_UNKNOWN;
+
+    pthread_mutex_lock(&g_codecLock);
+    if (idx < FAKE_CODEC_OUTPUT_BUFFERS && codec->outputOwned[idx]) {
+        codec->outputOwned[idx] = false;
+        (*counter)++;
+        status = AMEDIA_OK;
+    }
+    pthread_mutex_unlock(&g_codecLock);
+
+    return status;
+}
+
+media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec* codec, size_t idx, bool render) {
+    return release_output(codec, idx, render ? &g_stats.outputsRendered : &g_stats.outputsDropped);
+}
+
+media_status_t AMediaCodec_releaseOutputBufferAtTime(AMediaCodec* codec, size_t idx, int64_t timestampNs) {
+    return release_output(codec, idx, &g_stats.outputsTimed);
+}
+
+// Arrays carry their length in front of the elements
+typedef struct {
+    jsize length;
+    jbyte elements[];
+} fake_array_t;
+
+static jclass fake_find_class(JNIEnv* env, const char* name) {
+    return NULL;
+}
+
+static jboolean fake_exception_check(JNIEnv* env) {
+    return JNI_FALSE;
+}
+
+static jobject fake_new_global_ref(JNIEnv* env, jobject obj) {
+    return obj;
+}
+
+static void fake_delete_ref(JNIEnv* env, jobject obj) {
+}
+
+static jmethodID fake_get_static_method_id(JNIEnv* env, jclass clazz, const char* name, const char* sig) {
+    return NULL;
+}
+
+static jstring fake_new_string_utf(JNIEnv* env, const char* str) {
+    return (jstring)str;
+}
+
+static const char* fake_get_string_utf_chars(JNIEnv* env, jstring str, jboolean* isCopy) {
+    return (const char*)str;
+}
+
+static void fake_release_string_utf_chars(JNIEnv* env, jstring str, const char* chars) {
+}
+
+static jsize fake_get_array_length(JNIEnv* env, jarray array) {
+    return ((fake_array_t*)array)->length;
+}
+
+static jbyteArray fake_new_byte_array(JNIEnv* env, jsize length) {
+    return fake_jni_new_byte_array(length);
+}
+
+static void fake_get_byte_array_region(JNIEnv* env, jbyteArray array, jsize start, jsize len, jbyte* buf) {
+    memcpy(buf, ((fake_array_t*)array)->elements + start, (size_t)len);
+}
+
+static void fake_set_byte_array_region(JNIEnv* env, jbyteArray array, jsize start, jsize len, const jbyte* buf) {
+    memcpy(((fake_array_t*)array)->elements + start, buf, (size_t)len);
+}
+
+static void* fake_get_primitive_array_critical(JNIEnv* env, jarray array, jboolean* isCopy) {
+    return ((fake_array_t*)array)->elements;
+}
+
+static void fake_release_primitive_array_critical(JNIEnv* env, jarray array, void* elements, jint mode) {
+}
+
+static const struct JNINativeInterface g_jniFunctions = {
+    .FindClass = fake_find_class,
+    .ExceptionCheck = fake_exception_check,
+    .NewGlobalRef = fake_new_global_ref,
+    .DeleteGlobalRef = fake_delete_ref,
+    .DeleteLocalRef = fake_delete_ref,
+    .GetStaticMethodID = fake_get_static_method_id,
+    .NewStringUTF = fake_new_string_utf,
+    .GetStringUTFChars = fake_get_string_utf_chars,
+    .ReleaseStringUTFChars = fake_release_string_utf_chars,
+    .GetArrayLength = fake_get_array_length,
+    .NewByteArray = fake_new_byte_array,
+    .GetByteArrayRegion = fake_get_byte_array_region,
+    .SetByteArrayRegion = fake_set_byte_array_region,
+    .GetPrimitiveArrayCritical = fake_get_primitive_array_critical,
+    .ReleasePrimitiveArrayCritical = fake_release_primitive_array_critical,
+};
+static JNIEnv g_jniEnv = &g_jniFunctions;
+
+JNIEnv* fake_jni_env(void) {
+    return &g_jniEnv;
+}
+
+jbyteArray fake_jni_new_byte_array(jsize length) {
+    fake_array_t* array = calloc(1, sizeof(*array) + (size_t)length);
+
+    array->length = length;
+    return (jbyteArray)array;
+}
+
+void fake_jni_delete_array(jarray array) {
+    free(array);
+}
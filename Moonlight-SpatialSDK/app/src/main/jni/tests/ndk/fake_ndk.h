@@ -0,0 +1,54 @@
+#pragma once
+
+// Host implementations of the NDK libraries used by the native modules, so
+// they can be tested on Linux. The codec doesn't decode anything. It records
+// every input buffer that is queued and turns each picture into an output
+// buffer that is immediately ready, which is enough to drive the submit path
+// and the output thread. Input buffers run out while outputs aren't dequeued.
+
+#include <jni.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    int64_t ptsUs;
+    uint32_t flags;
+} fake_codec_input_t;
+
+typedef struct {
+    uint32_t inputsQueued;
+    uint32_t emptyInputsQueued;
+    uint32_t outputsRendered;
+    uint32_t outputsTimed;
+    uint32_t outputsDropped;
+} fake_codec_stats_t;
+
+// Resets the codec state for the next codec that's created. Each input
+// buffer holds inputBufferSize bytes. If recordInputs is set, a copy of
+// every queued input is kept for fake_codec_get_input().
+void fake_codec_reset(size_t inputBufferSize, bool recordInputs);
+
+int fake_codec_input_count(void);
+const fake_codec_input_t* fake_codec_get_input(int index);
+void fake_codec_get_stats(fake_codec_stats_t* stats);
+
+// Log messages are written to this file descriptor, one write() per message
+// like logd's socket. They are discarded if it's -1, which is the default.
+void fake_ndk_set_log_fd(int fd);
+
+// A JNI environment whose strings are plain C strings and whose arrays are
+// heap buffers. Methods are never found, so callers take their fallbacks.
+JNIEnv* fake_jni_env(void);
+jbyteArray fake_jni_new_byte_array(jsize length);
+void fake_jni_delete_array(jarray array);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <jni.h>
+#include <stdint.h>
+
+typedef struct ANativeWindow ANativeWindow;
+
+ANativeWindow* ANativeWindow_fromSurface(JNIEnv* env, jobject surface);
+void ANativeWindow_release(ANativeWindow* window);
+int32_t ANativeWindow_setBuffersDataSpace(ANativeWindow* window, int32_t dataSpace);
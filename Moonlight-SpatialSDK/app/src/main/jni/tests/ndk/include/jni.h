@@ -0,0 +1,70 @@
+#pragma once
+
+// The parts of the JNI interface used by the native modules. Only the
+// function table entries that are actually called are declared, so this
+// is source compatible with the real jni.h but not binary compatible.
+
+#include <stdarg.h>
+#include <stdint.h>
+
+typedef uint8_t jboolean;
+typedef int8_t jbyte;
+typedef uint16_t jchar;
+typedef int16_t jshort;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef jint jsize;
+
+typedef void* jobject;
+typedef jobject jclass;
+typedef jobject jstring;
+typedef jobject jarray;
+typedef jarray jbyteArray;
+typedef jarray jshortArray;
+typedef struct _jmethodID* jmethodID;
+
+#define JNIEXPORT
+#define JNICALL
+
+#define JNI_FALSE 0
+#define JNI_TRUE 1
+#define JNI_OK 0
+#define JNI_ABORT 2
+#define JNI_VERSION_1_4 0x00010004
+
+struct JNINativeInterface;
+struct JNIInvokeInterface;
+typedef const struct JNINativeInterface* JNIEnv;
+typedef const struct JNIInvokeInterface* JavaVM;
+
+struct JNIInvokeInterface {
+    jint (*AttachCurrentThread)(JavaVM*, JNIEnv**, void*);
+    jint (*DetachCurrentThread)(JavaVM*);
+    jint (*GetEnv)(JavaVM*, void**, jint);
+};
+
+struct JNINativeInterface {
+    jclass (*FindClass)(JNIEnv*, const char*);
+    jboolean (*ExceptionCheck)(JNIEnv*);
+    jobject (*NewGlobalRef)(JNIEnv*, jobject);
+    void (*DeleteGlobalRef)(JNIEnv*, jobject);
+    void (*DeleteLocalRef)(JNIEnv*, jobject);
+    jmethodID (*GetStaticMethodID)(JNIEnv*, jclass, const char*, const char*);
+    jobject (*CallStaticObjectMethod)(JNIEnv*, jclass, jmethodID, ...);
+    jboolean (*CallStaticBooleanMethod)(JNIEnv*, jclass, jmethodID, ...);
+    jint (*CallStaticIntMethod)(JNIEnv*, jclass, jmethodID, ...);
+    void (*CallStaticVoidMethod)(JNIEnv*, jclass, jmethodID, ...);
+    jstring (*NewStringUTF)(JNIEnv*, const char*);
+    const char* (*GetStringUTFChars)(JNIEnv*, jstring, jboolean*);
+    void (*ReleaseStringUTFChars)(JNIEnv*, jstring, const char*);
+    jsize (*GetArrayLength)(JNIEnv*, jarray);
+    jbyteArray (*NewByteArray)(JNIEnv*, jsize);
+    jshortArray (*NewShortArray)(JNIEnv*, jsize);
+    jbyte* (*GetByteArrayElements)(JNIEnv*, jbyteArray, jboolean*);
+    void (*ReleaseByteArrayElements)(JNIEnv*, jbyteArray, jbyte*, jint);
+    void (*GetByteArrayRegion)(JNIEnv*, jbyteArray, jsize, jsize, jbyte*);
+    void (*SetByteArrayRegion)(JNIEnv*, jbyteArray, jsize, jsize, const jbyte*);
+    void* (*GetPrimitiveArrayCritical)(JNIEnv*, jarray, jboolean*);
+    void (*ReleasePrimitiveArrayCritical)(JNIEnv*, jarray, void*, jint);
+    jint (*GetJavaVM)(JNIEnv*, JavaVM**);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <android/native_window_jni.h>
+#include <media/NdkMediaFormat.h>
+
+typedef struct AMediaCodec AMediaCodec;
+typedef struct AMediaCrypto AMediaCrypto;
+
+typedef struct AMediaCodecBufferInfo {
+    int32_t offset;
+    int32_t size;
+    int64_t presentationTimeUs;
+    uint32_t flags;
+} AMediaCodecBufferInfo;
+
+enum {
+    AMEDIACODEC_BUFFER_FLAG_KEY_FRAME = 1,
+    AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG = 2,
+    AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM = 4,
+};
+
+enum {
+    AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED = -3,
+    AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED = -2,
+    AMEDIACODEC_INFO_TRY_AGAIN_LATER = -1,
+};
+
+AMediaCodec* AMediaCodec_createCodecByName(const char* name);
+AMediaCodec* AMediaCodec_createDecoderByType(const char* mimeType);
+media_status_t AMediaCodec_delete(AMediaCodec* codec);
+media_status_t AMediaCodec_configure(AMediaCodec* codec, const AMediaFormat* format,
+                                     ANativeWindow* surface, AMediaCrypto* crypto, uint32_t flags);
+media_status_t AMediaCodec_start(AMediaCodec* codec);
+media_status_t AMediaCodec_stop(AMediaCodec* codec);
+media_status_t AMediaCodec_flush(AMediaCodec* codec);
+AMediaFormat* AMediaCodec_getInputFormat(AMediaCodec* codec);
+AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec* codec);
+ssize_t AMediaCodec_dequeueInputBuffer(AMediaCodec* codec, int64_t timeoutUs);
+uint8_t* AMediaCodec_getInputBuffer(AMediaCodec* codec, size_t idx, size_t* outSize);
+media_status_t AMediaCodec_queueInputBuffer(AMediaCodec* codec, size_t idx, off_t offset,
+                                            size_t size, uint64_t time, uint32_t flags);
+ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec* codec, AMediaCodecBufferInfo* info, int64_t timeoutUs);
+media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec* codec, size_t idx, bool render);
+media_status_t AMediaCodec_releaseOutputBufferAtTime(AMediaCodec* codec, size_t idx, int64_t timestampNs);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct AMediaFormat AMediaFormat;
+
+typedef int32_t media_status_t;
+#define AMEDIA_OK 0
+#define AMEDIA_ERROR_UNKNOWN (-10000)
+
+extern const char* AMEDIAFORMAT_KEY_COLOR_FORMAT;
+extern const char* AMEDIAFORMAT_KEY_COLOR_RANGE;
+extern const char* AMEDIAFORMAT_KEY_COLOR_STANDARD;
+extern const char* AMEDIAFORMAT_KEY_COLOR_TRANSFER;
+extern const char* AMEDIAFORMAT_KEY_FRAME_RATE;
+extern const char* AMEDIAFORMAT_KEY_HDR_STATIC_INFO;
+extern const char* AMEDIAFORMAT_KEY_HEIGHT;
+extern const char* AMEDIAFORMAT_KEY_MAX_INPUT_SIZE;
+extern const char* AMEDIAFORMAT_KEY_MIME;
+extern const char* AMEDIAFORMAT_KEY_OPERATING_RATE;
+extern const char* AMEDIAFORMAT_KEY_PRIORITY;
+extern const char* AMEDIAFORMAT_KEY_WIDTH;
+
+AMediaFormat* AMediaFormat_new(void);
+media_status_t AMediaFormat_delete(AMediaFormat* format);
+const char* AMediaFormat_toString(AMediaFormat* format);
+bool AMediaFormat_getInt32(AMediaFormat* format, const char* name, int32_t* out);
+bool AMediaFormat_getBuffer(AMediaFormat* format, const char* name, void** data, size_t* size);
+void AMediaFormat_setInt32(AMediaFormat* format, const char* name, int32_t value);
+void AMediaFormat_setString(AMediaFormat* format, const char* name, const char* value);
+void AMediaFormat_setBuffer(AMediaFormat* format, const char* name, const void* data, size_t size);
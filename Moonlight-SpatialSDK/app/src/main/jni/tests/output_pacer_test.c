@@ -0,0 +1,274 @@
+// Unit tests for the output pacer, driven by a fake clock and a fake codec
+// that records which output buffers were rendered (and when) or dropped.
+// Afterwards, the same bursty decoder output is run through each policy and
+// the resulting drops and display latency are reported.
+// Usage: output_pacer_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output_pacer.h"
+
+#define TEST_FPS 100
+#define FRAME_INTERVAL_NS (1000000000LL / TEST_FPS)
+#define MAX_EVENTS 4096
+
+typedef struct {
+    bool rendered;
+    size_t index;
+    int64_t ptsUs;
+    int64_t renderTimeNs;
+} codec_event_t;
+
+static int64_t g_nowNs;
+static codec_event_t g_events[MAX_EVENTS];
+static int g_eventCount;
+static int g_failures;
+
+static int64_t fake_now_ns(void* context) {
+    return g_nowNs;
+}
+
+static void record_event(bool rendered, size_t index, int64_t ptsUs, int64_t renderTimeNs) {
+    if (g_eventCount < MAX_EVENTS) {
+        codec_event_t* event = &g_events[g_eventCount++];
+
+        event->rendered = rendered;
+        event->index = index;
+        event->ptsUs = ptsUs;
+        event->renderTimeNs = renderTimeNs;
+    }
+}
+
+static void fake_render(void* context, size_t index, int64_t ptsUs, int64_t renderTimeNs) {
+    record_event(true, index, ptsUs, renderTimeNs);
+}
+
+static void fake_drop(void* context, size_t index, int64_t ptsUs) {
+    record_event(false, index, ptsUs, 0);
+}
+
+static const pacer_ops_t g_ops = {
+    .now_ns = fake_now_ns,
+    .render = fake_render,
+    .drop = fake_drop,
+    .context = NULL,
+};
+
+static void reset(output_pacer_t* pacer, pacing_policy_t policy) {
+    g_nowNs = 1000000000LL;
+    g_eventCount = 0;
+    output_pacer_init(pacer, policy, TEST_FPS, &g_ops);
+}
+
+static int64_t now_us(void) {
+    return g_nowNs / 1000;
+}
+
+#define CHECK(test, condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s: check failed at line %d: %s\n", (test), __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+static bool event_is(int i, bool rendered, size_t index, int64_t renderTimeNs) {
+    return i < g_eventCount && g_events[i].rendered == rendered &&
+           g_events[i].index == index && g_events[i].renderTimeNs == renderTimeNs;
+}
+
+static void test_immediate(void) {
+    const char* test = "immediate";
+    output_pacer_t pacer;
+    const pacing_stats_t* stats = &pacer.stats[PACING_POLICY_IMMEDIATE];
+
+    reset(&pacer, PACING_POLICY_IMMEDIATE);
+
+    // Every frame is rendered right away, even stale ones
+    for (size_t i = 0; i < 3; i++) {
+        output_pacer_on_output(&pacer, i, now_us() - 2000);
+    }
+    output_pacer_on_output(&pacer, 3, now_us() - 100000);
+    CHECK(test, !output_pacer_has_pending(&pacer));
+    CHECK(test, !output_pacer_flush(&pacer));
+
+    CHECK(test, g_eventCount == 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(test, event_is(i, true, (size_t)i, 0));
+    }
+    CHECK(test, stats->framesRendered == 4 && stats->framesDropped == 0);
+    CHECK(test, stats->totalLatencyUs == 3 * 2000 + 100000);
+    CHECK(test, stats->maxLatencyUs == 100000);
+}
+
+static void test_latest_frame(void) {
+    const char* test = "latest-frame";
+    output_pacer_t pacer;
+    const pacing_stats_t* stats = &pacer.stats[PACING_POLICY_LATEST_FRAME];
+
+    reset(&pacer, PACING_POLICY_LATEST_FRAME);
+
+    // Only the newest frame of a batch is shown, once the batch is over
+    for (size_t i = 0; i < 3; i++) {
+        output_pacer_on_output(&pacer, i, now_us() - 1000);
+    }
+    CHECK(test, output_pacer_has_pending(&pacer));
+    CHECK(test, g_eventCount == 2 && event_is(0, false, 0, 0) && event_is(1, false, 1, 0));
+
+    g_nowNs += 500000;
+    CHECK(test, output_pacer_flush(&pacer));
+    CHECK(test, !output_pacer_has_pending(&pacer));
+    CHECK(test, g_eventCount == 3 && event_is(2, true, 2, 0));
+    CHECK(test, stats->framesRendered == 1 && stats->framesDropped == 2);
+    CHECK(test, stats->totalLatencyUs == 1500 && stats->maxLatencyUs == 1500);
+
+    // Nothing held, so there's nothing to flush
+    CHECK(test, !output_pacer_flush(&pacer));
+
+    // A lone stale frame is still shown, since there's nothing newer
+    output_pacer_on_output(&pacer, 3, now_us() - 100000);
+    CHECK(test, output_pacer_flush(&pacer));
+    CHECK(test, g_eventCount == 4 && event_is(3, true, 3, 0));
+
+    // Stopping releases the held frame without rendering it
+    output_pacer_on_output(&pacer, 4, now_us());
+    output_pacer_discard(&pacer);
+    CHECK(test, !output_pacer_has_pending(&pacer));
+    CHECK(test, g_eventCount == 5 && event_is(4, false, 4, 0));
+    CHECK(test, stats->framesRendered == 2 && stats->framesDropped == 3);
+}
+
+static void test_display_timed(void) {
+    const char* test = "display-timed";
+    output_pacer_t pacer;
+    const pacing_stats_t* stats = &pacer.stats[PACING_POLICY_DISPLAY_TIMED];
+    int64_t startNs;
+
+    reset(&pacer, PACING_POLICY_DISPLAY_TIMED);
+    startNs = g_nowNs;
+
+    // The first frame starts the cadence now, and a burst is spread over the next intervals
+    output_pacer_on_output(&pacer, 0, now_us());
+    output_pacer_on_output(&pacer, 1, now_us());
+    output_pacer_on_output(&pacer, 2, now_us());
+    CHECK(test, event_is(0, true, 0, startNs));
+    CHECK(test, event_is(1, true, 1, startNs + FRAME_INTERVAL_NS));
+    CHECK(test, event_is(2, true, 2, startNs + 2 * FRAME_INTERVAL_NS));
+
+    // Scheduling any further ahead would build a queue, so the cadence restarts now
+    output_pacer_on_output(&pacer, 3, now_us());
+    CHECK(test, event_is(3, true, 3, startNs));
+    CHECK(test, !output_pacer_has_pending(&pacer));
+
+    // A stale frame is dropped while a frame was shown within the last interval
+    g_nowNs += FRAME_INTERVAL_NS / 2;
+    output_pacer_on_output(&pacer, 4, now_us() - 4 * FRAME_INTERVAL_NS / 1000);
+    CHECK(test, event_is(4, false, 4, 0));
+
+    // A fresh frame continues the cadence
+    output_pacer_on_output(&pacer, 5, now_us());
+    CHECK(test, event_is(5, true, 5, startNs + FRAME_INTERVAL_NS));
+
+    // After the display has been idle, a stale frame is shown immediately
+    g_nowNs += 10 * FRAME_INTERVAL_NS;
+    output_pacer_on_output(&pacer, 6, now_us() - 4 * FRAME_INTERVAL_NS / 1000);
+    CHECK(test, event_is(6, true, 6, g_nowNs));
+
+    CHECK(test, g_eventCount == 7);
+    CHECK(test, stats->framesRendered == 6 && stats->framesDropped == 1);
+    CHECK(test, stats->maxLatencyUs == 4 * FRAME_INTERVAL_NS / 1000);
+}
+
+static void test_policy_switch(void) {
+    const char* test = "policy switch";
+    output_pacer_t pacer;
+
+    reset(&pacer, PACING_POLICY_LATEST_FRAME);
+
+    // A frame held by the old policy is shown and counted against it
+    output_pacer_on_output(&pacer, 0, now_us());
+    output_pacer_set_policy(&pacer, PACING_POLICY_DISPLAY_TIMED);
+    CHECK(test, !output_pacer_has_pending(&pacer));
+    CHECK(test, event_is(0, true, 0, 0));
+    CHECK(test, pacer.stats[PACING_POLICY_LATEST_FRAME].framesRendered == 1);
+
+    // The new policy starts a fresh cadence
+    output_pacer_on_output(&pacer, 1, now_us());
+    CHECK(test, event_is(1, true, 1, g_nowNs));
+    CHECK(test, pacer.stats[PACING_POLICY_DISPLAY_TIMED].framesRendered == 1);
+
+    // Invalid policies are ignored
+    output_pacer_set_policy(&pacer, PACING_POLICY_COUNT);
+    CHECK(test, pacer.policy == PACING_POLICY_DISPLAY_TIMED);
+}
+
+// Decoder output at the stream's frame rate with jitter. Every 20th frame the
+// decoder stalls for three frame intervals and then releases everything at once.
+// Returns the number of frames that came out of the decoder.
+static uint32_t simulate(pacing_policy_t policy, pacing_stats_t* stats) {
+    output_pacer_t pacer;
+    int64_t nextFrameNs;
+    size_t index = 0;
+
+    reset(&pacer, policy);
+    srand(1);
+    nextFrameNs = g_nowNs;
+
+    for (int frame = 0; frame < 2000; frame++) {
+        int64_t ptsUs = nextFrameNs / 1000;
+        int64_t decodeNs = 2000000 + rand() % 3000000;
+
+        nextFrameNs += FRAME_INTERVAL_NS;
+        if (frame % 20 == 19) {
+            // Stall, then the queued frames come out together
+            g_nowNs = nextFrameNs + 3 * FRAME_INTERVAL_NS;
+            for (int i = 0; i < 4; i++) {
+                output_pacer_on_output(&pacer, index++, ptsUs + i * FRAME_INTERVAL_NS / 1000);
+            }
+            output_pacer_flush(&pacer);
+            frame += 3;
+            nextFrameNs += 3 * FRAME_INTERVAL_NS;
+            continue;
+        }
+
+        g_nowNs = ptsUs * 1000 + decodeNs;
+        output_pacer_on_output(&pacer, index++, ptsUs);
+        output_pacer_flush(&pacer);
+    }
+
+    *stats = pacer.stats[policy];
+    return (uint32_t)index;
+}
+
+int main(int argc, char** argv) {
+    test_immediate();
+    test_latest_frame();
+    test_display_timed();
+    test_policy_switch();
+
+    printf("%-14s %9s %8s %16s %16s\n", "policy", "rendered", "dropped", "avg latency ms", "max latency ms");
+    for (int policy = 0; policy < PACING_POLICY_COUNT; policy++) {
+        pacing_stats_t stats;
+        uint32_t frames = simulate((pacing_policy_t)policy, &stats);
+
+        printf("%-14s %9u %8u %16.2f %16.2f\n", output_pacer_policy_name((pacing_policy_t)policy),
+               stats.framesRendered, stats.framesDropped,
+               stats.framesRendered != 0 ? stats.totalLatencyUs / 1000.0 / stats.framesRendered : 0.0,
+               stats.maxLatencyUs / 1000.0);
+
+        if (stats.framesRendered + stats.framesDropped != frames) {
+            printf("%s: %u frames were neither rendered nor dropped\n", output_pacer_policy_name((pacing_policy_t)policy),
+                   frames - stats.framesRendered - stats.framesDropped);
+            g_failures++;
+        }
+    }
+
+    if (g_failures != 0) {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    return 0;
+}
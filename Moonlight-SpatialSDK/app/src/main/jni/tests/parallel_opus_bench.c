@@ -0,0 +1,182 @@
+// Decode time per packet of 7.1 and high quality 7.1 Opus streams with a
+// single multistream decoder and with the parallel decoder at 2 and 4
+// threads. Any speedup depends on idle cores, so compare the rows on the
+// device the numbers are for. The output of each thread count must match
+// the single decoder.
+// Usage: parallel_opus_bench [packets] [passes]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <opus_multistream.h>
+
+#include "parallel_opus.h"
+
+#define SAMPLE_RATE 48000
+#define SAMPLES_PER_FRAME 240
+#define CHANNEL_COUNT 8
+#define MAX_PACKET_SIZE 4000
+#define BITRATE_PER_CHANNEL 96000
+
+typedef struct {
+    const char* name;
+    int streams;
+    int coupledStreams;
+    unsigned char mapping[CHANNEL_COUNT];
+} surround_layout_t;
+
+static const surround_layout_t g_layouts[] = {
+    { "7.1", 5, 3, { 0, 6, 1, 7, 2, 3, 4, 5 } },
+    { "7.1 HQ", 8, 0, { 0, 1, 2, 3, 4, 5, 6, 7 } },
+};
+
+static const int g_threadCounts[] = { 1, 2, 4 };
+
+typedef struct {
+    unsigned char data[MAX_PACKET_SIZE];
+    int length;
+} opus_packet_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void init_opus_config(const surround_layout_t* layout, OPUS_MULTISTREAM_CONFIGURATION* config) {
+    memset(config, 0, sizeof(*config));
+    config->sampleRate = SAMPLE_RATE;
+    config->channelCount = CHANNEL_COUNT;
+    config->streams = layout->streams;
+    config->coupledStreams = layout->coupledStreams;
+    config->samplesPerFrame = SAMPLES_PER_FRAME;
+    memcpy(config->mapping, layout->mapping, CHANNEL_COUNT);
+}
+
+static int encode_packets(const OPUS_MULTISTREAM_CONFIGURATION* config, opus_packet_t* packets, int packetCount) {
+    int16_t pcm[SAMPLES_PER_FRAME * CHANNEL_COUNT];
+    OpusMSEncoder* encoder;
+    int err;
+
+    encoder = opus_multistream_encoder_create(config->sampleRate, config->channelCount, config->streams,
+                                              config->coupledStreams, config->mapping,
+                                              OPUS_APPLICATION_RESTRICTED_LOWDELAY, &err);
+    if (encoder == NULL) {
+        return -1;
+    }
+    opus_multistream_encoder_ctl(encoder, OPUS_SET_BITRATE(config->channelCount * BITRATE_PER_CHANNEL));
+
+    srand(1);
+    for (int i = 0; i < packetCount; i++) {
+        for (int s = 0; s < SAMPLES_PER_FRAME; s++) {
+            double t = (double)(i * SAMPLES_PER_FRAME + s) / SAMPLE_RATE;
+
+            for (int c = 0; c < CHANNEL_COUNT; c++) {
+                pcm[s * CHANNEL_COUNT + c] = (int16_t)(6000 * sin(2 * M_PI * (220 + 110 * c) * t) + rand() % 1000 - 500);
+            }
+        }
+
+        packets[i].length = opus_multistream_encode(encoder, pcm, SAMPLES_PER_FRAME,
+                                                    packets[i].data, MAX_PACKET_SIZE);
+        if (packets[i].length <= 0) {
+            err = -1;
+            break;
+        }
+    }
+
+    opus_multistream_encoder_destroy(encoder);
+    return err == OPUS_OK ? 0 : -1;
+}
+
+// Decodes every packet and returns the mean time per packet in microseconds, or a negative value on failure
+static double time_decoder(const OPUS_MULTISTREAM_CONFIGURATION* config, int threadCount,
+                           const opus_packet_t* packets, int packetCount, int passes, int16_t* pcm) {
+    parallel_opus_decoder_t* decoder = parallel_opus_decoder_create(config, threadCount);
+    uint64_t startNs, elapsedNs;
+
+    if (decoder == NULL) {
+        return -1;
+    }
+
+    startNs = now_ns();
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < packetCount; i++) {
+            if (parallel_opus_decoder_decode(decoder, packets[i].data, packets[i].length,
+                                             &pcm[(size_t)i * SAMPLES_PER_FRAME * CHANNEL_COUNT],
+                                             SAMPLES_PER_FRAME) != SAMPLES_PER_FRAME) {
+                parallel_opus_decoder_destroy(decoder);
+                return -1;
+            }
+        }
+    }
+    elapsedNs = now_ns() - startNs;
+
+    parallel_opus_decoder_destroy(decoder);
+    return (double)elapsedNs / 1000.0 / ((double)packetCount * passes);
+}
+
+int main(int argc, char** argv) {
+    int packetCount = argc > 1 ? atoi(argv[1]) : 2000;
+    int passes = argc > 2 ? atoi(argv[2]) : 5;
+    size_t pcmSize = (size_t)packetCount * SAMPLES_PER_FRAME * CHANNEL_COUNT * sizeof(int16_t);
+    opus_packet_t* packets;
+    int16_t* expectedPcm;
+    int16_t* pcm;
+
+    if (packetCount <= 0 || passes <= 0) {
+        fprintf(stderr, "Usage: parallel_opus_bench [packets] [passes]\n");
+        return 1;
+    }
+
+    packets = calloc(packetCount, sizeof(*packets));
+    expectedPcm = malloc(pcmSize);
+    pcm = malloc(pcmSize);
+    if (packets == NULL || expectedPcm == NULL || pcm == NULL) {
+        return 1;
+    }
+
+    printf("%d packets of %d samples, %d passes\n", packetCount, SAMPLES_PER_FRAME, passes);
+    printf("%-8s %8s %14s %10s\n", "layout", "threads", "us per packet", "speedup");
+
+    for (size_t l = 0; l < sizeof(g_layouts) / sizeof(g_layouts[0]); l++) {
+        OPUS_MULTISTREAM_CONFIGURATION config;
+        double singleUs = 0;
+
+        init_opus_config(&g_layouts[l], &config);
+        if (encode_packets(&config, packets, packetCount) != 0) {
+            printf("%s: failed to encode the test signal\n", g_layouts[l].name);
+            return 1;
+        }
+
+        for (size_t t = 0; t < sizeof(g_threadCounts) / sizeof(g_threadCounts[0]); t++) {
+            int threadCount = g_threadCounts[t];
+            double packetUs = time_decoder(&config, threadCount, packets, packetCount, passes,
+                                           threadCount == 1 ? expectedPcm : pcm);
+
+            if (packetUs < 0) {
+                printf("%s: decoding with %d threads failed\n", g_layouts[l].name, threadCount);
+                return 1;
+            }
+
+            if (threadCount == 1) {
+                singleUs = packetUs;
+            }
+            else if (memcmp(pcm, expectedPcm, pcmSize) != 0) {
+                printf("%s: %d threads decoded different PCM than the single decoder\n",
+                       g_layouts[l].name, threadCount);
+                return 1;
+            }
+
+            printf("%-8s %8d %14.1f %9.2fx\n", g_layouts[l].name, threadCount, packetUs, singleUs / packetUs);
+        }
+    }
+
+    free(packets);
+    free(expectedPcm);
+    free(pcm);
+    return 0;
+}
@@ -0,0 +1,182 @@
+// Checks that the parallel Opus decoder produces exactly what libopus'
+// multistream decoder does. 5.1, 7.1 and high quality 7.1 streams are
+// encoded with libopus, then decoded with opus_multistream_decode() and
+// with parallel_opus_decoder_decode() at 1, 2 and 4 threads. Every few
+// packets is dropped and concealed with PLC by both decoders.
+// Usage: parallel_opus_test [packets]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opus_multistream.h>
+
+#include "parallel_opus.h"
+
+#define SAMPLE_RATE 48000
+#define SAMPLES_PER_FRAME 240
+#define MAX_CHANNELS 8
+#define MAX_PACKET_SIZE 4000
+#define BITRATE_PER_CHANNEL 96000
+#define LOST_PACKET_INTERVAL 17
+
+typedef struct {
+    const char* name;
+    int channelCount;
+    int streams;
+    int coupledStreams;
+    unsigned char mapping[MAX_CHANNELS];
+} surround_layout_t;
+
+// The layouts a host negotiates for surround sound
+static const surround_layout_t g_layouts[] = {
+    { "5.1", 6, 4, 2, { 0, 4, 1, 5, 2, 3 } },
+    { "7.1", 8, 5, 3, { 0, 6, 1, 7, 2, 3, 4, 5 } },
+    { "7.1 HQ", 8, 8, 0, { 0, 1, 2, 3, 4, 5, 6, 7 } },
+};
+
+static const int g_threadCounts[] = { 1, 2, 4 };
+
+typedef struct {
+    unsigned char data[MAX_PACKET_SIZE];
+    int length;
+} opus_packet_t;
+
+static void init_opus_config(const surround_layout_t* layout, OPUS_MULTISTREAM_CONFIGURATION* config) {
+    memset(config, 0, sizeof(*config));
+    config->sampleRate = SAMPLE_RATE;
+    config->channelCount = layout->channelCount;
+    config->streams = layout->streams;
+    config->coupledStreams = layout->coupledStreams;
+    config->samplesPerFrame = SAMPLES_PER_FRAME;
+    memcpy(config->mapping, layout->mapping, layout->channelCount);
+}
+
+// Each channel gets its own tone with some noise, so every stream carries real data
+static int encode_packets(const OPUS_MULTISTREAM_CONFIGURATION* config, opus_packet_t* packets, int packetCount) {
+    int16_t pcm[SAMPLES_PER_FRAME * MAX_CHANNELS];
+    OpusMSEncoder* encoder;
+    int err;
+
+    encoder = opus_multistream_encoder_create(config->sampleRate, config->channelCount, config->streams,
+                                              config->coupledStreams, config->mapping,
+                                              OPUS_APPLICATION_RESTRICTED_LOWDELAY, &err);
+    if (encoder == NULL) {
+        return -1;
+    }
+    opus_multistream_encoder_ctl(encoder, OPUS_SET_BITRATE(config->channelCount * BITRATE_PER_CHANNEL));
+
+    srand(1);
+    for (int i = 0; i < packetCount; i++) {
+        for (int s = 0; s < SAMPLES_PER_FRAME; s++) {
+            double t = (double)(i * SAMPLES_PER_FRAME + s) / SAMPLE_RATE;
+
+            for (int c = 0; c < config->channelCount; c++) {
+                pcm[s * config->channelCount + c] =
+                    (int16_t)(6000 * sin(2 * M_PI * (220 + 110 * c) * t) + rand() % 1000 - 500);
+            }
+        }
+
+        packets[i].length = opus_multistream_encode(encoder, pcm, SAMPLES_PER_FRAME,
+                                                    packets[i].data, MAX_PACKET_SIZE);
+        if (packets[i].length <= 0) {
+            err = -1;
+            break;
+        }
+    }
+
+    opus_multistream_encoder_destroy(encoder);
+    return err == OPUS_OK ? 0 : -1;
+}
+
+// Returns the number of packets that weren't decoded identically
+static int check_layout(const surround_layout_t* layout, const opus_packet_t* packets, int packetCount,
+                        int threadCount) {
+    int16_t expected[SAMPLES_PER_FRAME * MAX_CHANNELS];
+    int16_t actual[SAMPLES_PER_FRAME * MAX_CHANNELS];
+    OPUS_MULTISTREAM_CONFIGURATION config;
+    parallel_opus_decoder_t* decoder;
+    OpusMSDecoder* reference;
+    int mismatches = 0;
+    int err;
+
+    init_opus_config(layout, &config);
+    reference = opus_multistream_decoder_create(config.sampleRate, config.channelCount, config.streams,
+                                                config.coupledStreams, config.mapping, &err);
+    decoder = parallel_opus_decoder_create(&config, threadCount);
+    if (reference == NULL || decoder == NULL) {
+        printf("%s: failed to create the decoders\n", layout->name);
+        return packetCount;
+    }
+
+    for (int i = 0; i < packetCount; i++) {
+        const unsigned char* data = packets[i].data;
+        int length = packets[i].length;
+        int expectedSamples, actualSamples;
+
+        if (i % LOST_PACKET_INTERVAL == LOST_PACKET_INTERVAL - 1) {
+            data = NULL;
+            length = 0;
+        }
+
+        memset(actual, 0, sizeof(actual));
+        expectedSamples = opus_multistream_decode(reference, data, length, expected, SAMPLES_PER_FRAME, 0);
+        actualSamples = parallel_opus_decoder_decode(decoder, data, length, actual, SAMPLES_PER_FRAME);
+        if (actualSamples != expectedSamples ||
+                (expectedSamples > 0 &&
+                 memcmp(actual, expected, sizeof(int16_t) * expectedSamples * config.channelCount) != 0)) {
+            if (mismatches++ < 5) {
+                printf("%s, %d threads: packet %d%s decoded to %d samples instead of %d, or different PCM\n",
+                       layout->name, threadCount, i, data == NULL ? " (PLC)" : "", actualSamples, expectedSamples);
+            }
+        }
+    }
+
+    printf("%-8s %d threads (%d used): %d of %d packets match\n", layout->name, threadCount,
+           parallel_opus_decoder_thread_count(decoder), packetCount - mismatches, packetCount);
+
+    parallel_opus_decoder_destroy(decoder);
+    opus_multistream_decoder_destroy(reference);
+    return mismatches;
+}
+
+int main(int argc, char** argv) {
+    int packetCount = argc > 1 ? atoi(argv[1]) : 2000;
+    opus_packet_t* packets;
+    int failures = 0;
+
+    if (packetCount <= 0) {
+        fprintf(stderr, "Usage: parallel_opus_test [packets]\n");
+        return 1;
+    }
+
+    packets = calloc(packetCount, sizeof(*packets));
+    if (packets == NULL) {
+        return 1;
+    }
+
+    for (size_t l = 0; l < sizeof(g_layouts) / sizeof(g_layouts[0]); l++) {
+        OPUS_MULTISTREAM_CONFIGURATION config;
+
+        init_opus_config(&g_layouts[l], &config);
+        if (encode_packets(&config, packets, packetCount) != 0) {
+            printf("%s: failed to encode the test signal\n", g_layouts[l].name);
+            failures++;
+            continue;
+        }
+
+        for (size_t t = 0; t < sizeof(g_threadCounts) / sizeof(g_threadCounts[0]); t++) {
+            failures += check_layout(&g_layouts[l], packets, packetCount, g_threadCounts[t]);
+        }
+    }
+
+    free(packets);
+
+    if (failures != 0) {
+        printf("%d packets were decoded differently\n", failures);
+        return 1;
+    }
+
+    return 0;
+}